@@ -141,6 +141,12 @@ public:
     template<typename T>
     const T &set(const String &key, const T &value);
 
+    //! Returns iterator to the first key-value pair of the dictionary.
+    std::map<String, DictValue>::const_iterator begin() const;
+
+    //! Returns iterator to the past-the-end key-value pair of the dictionary.
+    std::map<String, DictValue>::const_iterator end() const;
+
     friend std::ostream &operator<<(std::ostream &stream, const Dict &dict);
 };
 
@@ -44,6 +44,9 @@
 
 #include <vector>
 #include <opencv2/core.hpp>
+#ifdef CV_CXX11
+#include <future>
+#endif
 
 #if !defined CV_DOXYGEN && !defined CV_DNN_DONT_ADD_EXPERIMENTAL_NS
 #define CV__DNN_EXPERIMENTAL_NS_BEGIN namespace experimental_dnn_v3 {
@@ -82,6 +85,17 @@ CV__DNN_EXPERIMENTAL_NS_BEGIN
         DNN_TARGET_OPENCL
     };
 
+    /**
+     * @brief Enum of data types to store weights of layers.
+     * @see Net::setWeightsType
+     */
+    enum WeightsType
+    {
+        DNN_WEIGHTS_FP32, //!< single precision floating point numbers.
+        DNN_WEIGHTS_FP16, //!< half precision floating point numbers (IEEE 754).
+        DNN_WEIGHTS_BF16  //!< bfloat16: upper halves of single precision floating point numbers.
+    };
+
     /** @brief This class provides all data needed to initialize layer.
      *
      * It includes dictionary with scalar params (which can be readed by using Dict interface),
@@ -315,6 +329,29 @@ CV__DNN_EXPERIMENTAL_NS_BEGIN
         virtual ~Layer();
     };
 
+    /** @brief Performance statistics of a layer for the last forward pass.
+     * @see Net::getProfile
+     */
+    struct CV_EXPORTS LayerProfile
+    {
+        LayerProfile();
+
+        int id;             //!< Layer id.
+        String name;        //!< Layer name.
+        String type;        //!< Layer type.
+        int backend;        //!< Backend which computed the layer, one of Backend values.
+        int target;         //!< Target device, one of Target values.
+        double time;        //!< Time of the layer forward pass in milliseconds.
+        int64 flops;        //!< Number of floating point operations (see Layer::getFLOPS).
+        int64 bytesRead;    //!< Size of the layer inputs and weights in bytes.
+        int64 bytesWritten; //!< Size of the layer outputs in bytes.
+        double gflops;      //!< Achieved performance in GFLOP/s.
+        double gbps;        //!< Achieved memory throughput in GB/s.
+        bool skipped;       //!< True if the layer isn't computed separately (fused or optimized out).
+        String fusedInto;   //!< Name of the layer which computes the skipped one.
+        String kernel;      //!< Computational kernel variant, e.g. "sparse" for pruned weights. Empty for layers with a single implementation.
+    };
+
     /** @brief This class allows to create and manipulate comprehensive artificial neural networks.
      *
      * Neural network is presented as directed acyclic graph (DAG), where vertices are Layer instances,
@@ -426,6 +463,24 @@ CV__DNN_EXPERIMENTAL_NS_BEGIN
         CV_WRAP_AS(forwardAndRetrieve) void forward(CV_OUT std::vector<std::vector<Mat> >& outputBlobs,
                                                     const std::vector<String>& outBlobNames);
 
+#ifdef CV_CXX11
+        /** @brief Runs forward pass asynchronously to compute output of layer with name @p outputName.
+         *  @param outputName name for layer which output is needed to get
+         *  @return future object which holds a copy of the first output of specified layer.
+         *  @details Network inputs are captured at the moment of the call so the caller may prepare
+         *  the next input or process the previous results while the request is being computed.
+         *  Inputs which are set after the call are kept for the next forward() call.
+         *
+         *  There is no overlap between requests to the same network: pending requests and
+         *  forward() calls are computed one at a time, in no particular order. setInput(), setParam(),
+         *  setPreferableBackend(), setPreferableTarget(), enableFusion(), enableParallelLayers(),
+         *  enableBlockedLayout() and setWeightsType() wait until the running request is finished. Other methods which change the network
+         *  (e.g. addLayer() or connect()) must not be used while requests are pending.
+         *  Use several networks to compute requests simultaneously.
+         */
+        std::future<Mat> forwardAsync(const String& outputName = String());
+#endif
+
         /**
          * @brief Compile Halide layers.
          * @param[in] scheduler Path to YAML file with scheduling directives.
@@ -587,6 +642,61 @@ CV__DNN_EXPERIMENTAL_NS_BEGIN
          */
         CV_WRAP void enableFusion(bool fusion);
 
+        /** @brief Enables or disables concurrent execution of independent layers.
+         * @param parallel true to compute layers which don't depend on each other
+         *                 (e.g. branches of Inception blocks or SSD heads) simultaneously.
+         *                 Disabled by default.
+         * @note Only layers with a small amount of computations are executed simultaneously,
+         * heavy layers are still computed one by one using all the threads.
+         * Memory of intermediate blobs isn't reused between layers in this mode so
+         * the network consumes more memory. Only DNN_BACKEND_DEFAULT and DNN_TARGET_CPU are supported,
+         * other configurations compute layers sequentially.
+         */
+        CV_WRAP void enableParallelLayers(bool parallel);
+
+        /** @brief Enables or disables blocked layout of channels for intermediate blobs.
+         * @param blocked true to store outputs of layers which support it as
+         *                [N, C/8, H, W, 8] arrays (NCHW8c) instead of NCHW ones. Disabled by default.
+         * @details Channels of a block are processed by a single vector instruction that
+         * is useful when number of channels is not a multiple of a vectorized stripe.
+         * Layout is chosen at network allocation: only groups of consecutive layers which support
+         * blocked layout (pooling, eltwise, activations and concatenation) use it so the blobs are
+         * reordered only at the borders of these groups. Outputs of the network are always
+         * returned in NCHW layout. Only DNN_BACKEND_DEFAULT and DNN_TARGET_CPU are supported.
+         */
+        CV_WRAP void enableBlockedLayout(bool blocked);
+
+        /** @brief Sets a data type to store weights of convolution and fully connected layers.
+         * @param weightsType one of WeightsType values. DNN_WEIGHTS_FP32 by default.
+         * @details DNN_WEIGHTS_FP16 and DNN_WEIGHTS_BF16 weights take a half of memory and
+         * they are converted to single precision on the fly so computations are still done in FP32.
+         * The conversion is lossy: weights which are switched back to DNN_WEIGHTS_FP32 keep
+         * the reduced precision. Only DNN_BACKEND_DEFAULT and DNN_TARGET_CPU are supported,
+         * weights are converted back to single precision for other configurations.
+         */
+        CV_WRAP void setWeightsType(int weightsType);
+
+        /** @brief Sets a number of recently used input shapes for which allocated blobs are kept.
+         * @param size maximal number of cached sets of input shapes including the current one.
+         *             4 by default, 0 or 1 disables the cache.
+         * @details Changing shapes of the inputs makes the network reallocate intermediate blobs.
+         * Blobs of the previous shapes are kept in a cache so switching back to them
+         * doesn't allocate memory and only recomputes shape-dependent parameters of layers.
+         * Every cached set of shapes has its own intermediate blobs so the network consumes
+         * more memory. The cache is used only with DNN_BACKEND_DEFAULT and DNN_TARGET_CPU
+         * when the blocked layout is disabled.
+         */
+        CV_WRAP void setAllocationCacheSize(int size);
+
+        /** @brief Allocates the network for the given input shapes in advance.
+         * @param inputShapes shapes of all the network inputs, one set per expected configuration.
+         * @param outBlobNames names of outputs which are requested by forward() for these shapes.
+         * @details Blobs are kept in the allocation cache (see setAllocationCacheSize()). An enabled
+         * cache is enlarged if it can't fit all the sets of shapes. The current inputs are kept.
+         */
+        void preallocate(const std::vector<std::vector<MatShape> >& inputShapes,
+                         const std::vector<String>& outBlobNames = std::vector<String>());
+
         /** @brief Returns overall time for inference and timings (in ticks) for layers.
          * Indexes in returned vector correspond to layers ids. Some layers can be fused with others,
          * in this case zero ticks count will be return for that skipped layers.
@@ -595,11 +705,100 @@ CV__DNN_EXPERIMENTAL_NS_BEGIN
          */
         CV_WRAP int64 getPerfProfile(CV_OUT std::vector<double>& timings);
 
+        /** @brief Returns per-layer statistics of the last forward pass.
+         * @param profile statistics of all the layers except the network inputs, in order of ids.
+         * @details Time is taken from the last forward pass and number of operations and memory traffic
+         * are estimated for the current input shapes. Ratio of them tells whether the layer is limited
+         * by computations or by memory bandwidth. Layers which are fused into others have zero time.
+         * @return overall time of the forward pass in milliseconds.
+         */
+        double getProfile(std::vector<LayerProfile>& profile);
+
+        /** @brief Writes the statistics returned by getProfile() to a file.
+         * @param path path to the output file. JSON is written for the files with
+         *             .json extension and CSV otherwise.
+         */
+        CV_WRAP void writeProfile(const String& path);
+
+        /** @brief Stores the network in a compact binary file which can be loaded by readNetFromOptimized().
+         * @param path path to the output file.
+         * @details Batch normalization and scaling layers which follow convolutions are fused
+         * into the convolution weights before saving so they are neither stored nor computed anymore.
+         * Layers which are network outputs (have no consumers) are kept as is.
+         * Network inputs names, topology and parameters of the other layers are stored unchanged.
+         */
+        CV_WRAP void writeOptimized(const String& path);
+
     private:
         struct Impl;
         Ptr<Impl> impl;
     };
 
+#ifdef CV_CXX11
+    /** @brief Combines single requests from many threads into batches for one network.
+     *
+     * Requests are queued by submit() and computed by a background thread. A batch is started
+     * when it has @p maxBatchSize samples or when the oldest request has waited for @p maxDelay
+     * milliseconds. Blobs of the requests are stacked along the first (batch) dimension, the network
+     * computes them by a single forward pass and the output is split back to the requests.
+     * Requests with different shapes of a sample are computed in different batches.
+     *
+     * The network must produce one output sample per input sample (the first dimension of the
+     * output equals to the batch size). It is used by the executor exclusively until destruction.
+     */
+    class CV_EXPORTS BatchingExecutor
+    {
+    public:
+        /** @brief Latency statistics of the computed requests. Times are in milliseconds. */
+        struct CV_EXPORTS Stats
+        {
+            Stats();
+
+            size_t requests;      //!< number of computed requests
+            size_t batches;       //!< number of forward passes
+            double meanBatchSize; //!< average number of samples in a forward pass
+            double meanQueueTime; //!< average time from submit() to the start of the forward pass
+            double meanLatency;   //!< average time from submit() to the result
+            double p50Latency;    //!< median latency of the last 1024 requests
+            double p90Latency;    //!< 90th percentile of latency of the last 1024 requests
+            double p99Latency;    //!< 99th percentile of latency of the last 1024 requests
+            double maxLatency;    //!< the worst latency
+        };
+
+        /** @brief Creates an executor and starts its thread.
+         * @param net network to compute. It is not copied so it must not be used by anyone else.
+         * @param maxBatchSize maximal number of samples in a forward pass.
+         * @param maxDelay maximal time in milliseconds which the first request of a batch waits for the others.
+         * @param outputName name of the layer which output is returned. The last layer is used by default.
+         */
+        BatchingExecutor(const Net& net, int maxBatchSize = 8, double maxDelay = 2.0,
+                         const String& outputName = String());
+
+        /** @brief Computes all the pending requests and stops the thread. */
+        ~BatchingExecutor();
+
+        /** @brief Adds a request to the queue.
+         * @param blob input blob with one or several samples in the first dimension (e.g. from blobFromImage()).
+         * @return future object which holds the output samples which correspond to the input ones.
+         * Errors of the forward pass are rethrown by std::future::get().
+         */
+        std::future<Mat> submit(const Mat& blob);
+
+        /** @brief Returns statistics of the requests computed since creation or the last resetStats(). */
+        Stats getStats() const;
+
+        /** @brief Clears the statistics. */
+        void resetStats();
+
+        struct Impl;
+    private:
+        BatchingExecutor(const BatchingExecutor&);
+        BatchingExecutor& operator=(const BatchingExecutor&);
+
+        Ptr<Impl> impl;
+    };
+#endif
+
     /** @brief Reads a network model stored in <a href="https://pjreddie.com/darknet/">Darknet</a> model files.
     *  @param cfgFile      path to the .cfg file with text description of the network architecture.
     *  @param darknetModel path to the .weights file with learned network.
@@ -608,6 +807,16 @@ CV__DNN_EXPERIMENTAL_NS_BEGIN
     */
     CV_EXPORTS_W Net readNetFromDarknet(const String &cfgFile, const String &darknetModel = String());
 
+    /** @brief Reads a network stored by Net::writeOptimized().
+     *  @param path path to the file.
+     *  @returns Net object.
+     *  @details The file is mapped into memory and layers weights refer to the mapping instead of
+     *  being parsed and copied. The mapping is released with the last blob which refers to it.
+     *  Layers may still make their own copies of the weights: for example, convolution weights
+     *  are copied once if rows of the kernel matrix are not aligned for the vectorized kernels.
+     */
+    CV_EXPORTS_W Net readNetFromOptimized(const String &path);
+
     /** @brief Reads a network model stored in <a href="http://caffe.berkeleyvision.org">Caffe</a> framework's format.
       * @param prototxt   path to the .prototxt file with text description of the network architecture.
       * @param caffeModel path to the .caffemodel file with learned network.
@@ -695,6 +904,16 @@ CV__DNN_EXPERIMENTAL_NS_BEGIN
      */
     CV_EXPORTS_W Mat blobFromImage(InputArray image, double scalefactor=1.0, const Size& size = Size(),
                                    const Scalar& mean = Scalar(), bool swapRB=true, bool crop=true);
+
+    /** @brief Creates 4-dimensional blob from image.
+     *  @details This is an overloaded member function, provided for convenience.
+     *           It differs from the above function only in what argument(s) it accepts.
+     *           Memory of @p blob is reused if it has the required shape and type.
+     */
+    CV_EXPORTS void blobFromImage(InputArray image, OutputArray blob, double scalefactor=1.0,
+                                  const Size& size = Size(), const Scalar& mean = Scalar(),
+                                  bool swapRB=true, bool crop=true);
+
     /** @brief Creates 4-dimensional blob from series of images. Optionally resizes and
      *  crops @p images from center, subtract @p mean values, scales values by @p scalefactor,
      *  swap Blue and Red channels.
@@ -714,6 +933,16 @@ CV__DNN_EXPERIMENTAL_NS_BEGIN
     CV_EXPORTS_W Mat blobFromImages(const std::vector<Mat>& images, double scalefactor=1.0,
                                     Size size = Size(), const Scalar& mean = Scalar(), bool swapRB=true, bool crop=true);
 
+    /** @brief Creates 4-dimensional blob from series of images.
+     *  @details This is an overloaded member function, provided for convenience.
+     *           It differs from the above function only in what argument(s) it accepts.
+     *           Memory of @p blob is reused if it has the required shape and type so a batch
+     *           of the same size can be converted repeatedly without reallocations.
+     */
+    CV_EXPORTS void blobFromImages(InputArrayOfArrays images, OutputArray blob,
+                                   double scalefactor=1.0, Size size = Size(),
+                                   const Scalar& mean = Scalar(), bool swapRB=true, bool crop=true);
+
     /** @brief Convert all weights of Caffe network to half precision floating point.
      * @param src Path to origin model from Caffe framework contains single
      *            precision floating point weights (usually has `.caffemodel` extension).
@@ -745,6 +974,26 @@ CV__DNN_EXPERIMENTAL_NS_BEGIN
                                CV_OUT std::vector<int>& indices,
                                const float eta = 1.f, const int top_k = 0);
 
+    /** @brief Performs non maximum suppression for boxes of many classes at once.
+
+     * Boxes of different classes never suppress each other. The result is the same
+     * as calling NMSBoxes for every class separately but classes are processed in parallel.
+     * Use unique class ids for different images to process a batch by a single call.
+     * @param bboxes a set of bounding boxes to apply NMS.
+     * @param scores a set of corresponding confidences.
+     * @param class_ids a set of corresponding class ids.
+     * @param score_threshold a threshold used to filter boxes by score.
+     * @param nms_threshold a threshold used in non maximum suppression.
+     * @param indices the kept indices of bboxes after NMS sorted by descending score.
+     * @param eta a coefficient in adaptive threshold formula: \f$nms\_threshold_{i+1}=eta\cdot nms\_threshold_i\f$.
+     * @param top_k if `>0`, keep at most @p top_k picked indices per class.
+     */
+    CV_EXPORTS_W void NMSBoxesBatched(const std::vector<Rect>& bboxes, const std::vector<float>& scores,
+                                      const std::vector<int>& class_ids,
+                                      const float score_threshold, const float nms_threshold,
+                                      CV_OUT std::vector<int>& indices,
+                                      const float eta = 1.f, const int top_k = 0);
+
 
 //! @}
 CV__DNN_EXPERIMENTAL_NS_END
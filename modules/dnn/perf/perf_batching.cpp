@@ -0,0 +1,103 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "perf_precomp.hpp"
+
+#ifdef CV_CXX11
+#include <chrono>
+#include <thread>
+
+namespace
+{
+
+// Small convolutional network which is limited by weights traffic for a single image.
+static Net buildSyntheticNet()
+{
+    Net net;
+    int inpCn = 3;
+    for (int i = 0; i < 3; i++)
+    {
+        const int outCn = 64;
+        LayerParams lp;
+        lp.set("num_output", outCn);
+        lp.set("kernel_size", 3);
+        lp.set("pad", 1);
+        lp.set("stride", 2);
+        int wsz[] = {outCn, inpCn, 3, 3};
+        Mat weights(4, wsz, CV_32F);
+        randu(weights, -0.1f, 0.1f);
+        lp.blobs.push_back(weights);
+        lp.blobs.push_back(Mat::zeros(1, outCn, CV_32F));
+        net.addLayerToPrev(format("conv_%d", i), "Convolution", lp);
+
+        LayerParams reluParams;
+        net.addLayerToPrev(format("relu_%d", i), "ReLU", reluParams);
+        inpCn = outCn;
+    }
+    LayerParams fc;
+    fc.set("num_output", 1000);
+    Mat fcWeights(1000, inpCn * 8 * 8, CV_32F);
+    randu(fcWeights, -0.1f, 0.1f);
+    fc.blobs.push_back(fcWeights);
+    fc.blobs.push_back(Mat::zeros(1, 1000, CV_32F));
+    net.addLayerToPrev("fc", "InnerProduct", fc);
+    return net;
+}
+
+typedef TestBaseWithParam<tuple<int, int> > DNNBatchingExecutor;
+
+// Load generator: every client sends single image requests with a fixed period
+// and waits for all of them. Latency percentiles are reported as test properties.
+PERF_TEST_P_(DNNBatchingExecutor, load)
+{
+    const int maxBatchSize = get<0>(GetParam());
+    const int numClients = get<1>(GetParam());
+    const int requestsPerClient = 32;
+    const std::chrono::microseconds period(500);
+
+    int sz[] = {1, 3, 64, 64};
+    Mat input(4, sz, CV_32F);
+    randu(input, 0.0f, 1.0f);
+
+    Net net = buildSyntheticNet();
+    net.setInput(input);
+    net.forward();  // warm up
+
+    BatchingExecutor executor(net, maxBatchSize, 2.0);
+    TEST_CYCLE()
+    {
+        std::vector<std::thread> clients;
+        for (int t = 0; t < numClients; t++)
+        {
+            clients.push_back(std::thread([&]() {
+                std::vector<std::future<Mat> > outs;
+                for (int i = 0; i < requestsPerClient; i++)
+                {
+                    outs.push_back(executor.submit(input));
+                    std::this_thread::sleep_for(period);
+                }
+                for (size_t i = 0; i < outs.size(); i++)
+                    outs[i].get();
+            }));
+        }
+        for (size_t t = 0; t < clients.size(); t++)
+            clients[t].join();
+    }
+
+    BatchingExecutor::Stats stats = executor.getStats();
+    RecordProperty("mean_batch_size", format("%.2f", stats.meanBatchSize));
+    RecordProperty("mean_latency_ms", format("%.3f", stats.meanLatency));
+    RecordProperty("p50_latency_ms", format("%.3f", stats.p50Latency));
+    RecordProperty("p99_latency_ms", format("%.3f", stats.p99Latency));
+    SANITY_CHECK_NOTHING();
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, DNNBatchingExecutor, Combine(
+    Values(1, 4, 16),  // maxBatchSize
+    Values(1, 4, 16)   // numClients
+));
+
+}  // namespace
+
+#endif  // CV_CXX11
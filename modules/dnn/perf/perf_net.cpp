@@ -30,6 +30,9 @@ public:
     dnn::Target target;
 
     dnn::Net net;
+    bool parallelLayers;
+
+    DNNTestNetwork() : parallelLayers(false) {}
 
     void processNet(std::string weights, std::string proto, std::string halide_scheduler,
                         const Mat& input, const std::string& outputLayer,
@@ -78,6 +81,7 @@ public:
         net.setInput(blobFromImage(input, 1.0, Size(), Scalar(), false));
         net.setPreferableBackend(backend);
         net.setPreferableTarget(target);
+        net.enableParallelLayers(parallelLayers);
         if (backend == DNN_BACKEND_HALIDE)
         {
             net.setHalideScheduler(halide_scheduler);
@@ -100,6 +104,22 @@ public:
             net.forward();
         PERF_SAMPLE_END()
 
+        // Per-layer profile of the last iteration is written to <OPENCV_DNN_PERF_PROFILE><test>.csv and .json
+        const char* profilePrefix = getenv("OPENCV_DNN_PERF_PROFILE");
+        if (profilePrefix)
+        {
+            const ::testing::TestInfo* info = ::testing::UnitTest::GetInstance()->current_test_info();
+            std::string path = std::string(profilePrefix) + info->name() + "_" + info->value_param();
+            for (size_t i = strlen(profilePrefix); i < path.size(); i++)
+            {
+                if (!isalnum((uchar)path[i]))
+                    path[i] = '_';
+            }
+            net.writeProfile(path + ".csv");
+            net.writeProfile(path + ".json");
+            std::cout << "Profile: " << path << ".csv" << std::endl;
+        }
+
         SANITY_CHECK_NOTHING();
     }
 };
@@ -117,6 +137,13 @@ PERF_TEST_P_(DNNTestNetwork, GoogLeNet)
             "", Mat(cv::Size(224, 224), CV_32FC3), "prob", "caffe");
 }
 
+PERF_TEST_P_(DNNTestNetwork, GoogLeNet_parallel_layers)
+{
+    parallelLayers = true;
+    processNet("dnn/bvlc_googlenet.caffemodel", "dnn/bvlc_googlenet.prototxt",
+            "", Mat(cv::Size(224, 224), CV_32FC3), "prob", "caffe");
+}
+
 PERF_TEST_P_(DNNTestNetwork, ResNet50)
 {
     processNet("dnn/ResNet-50-model.caffemodel", "dnn/ResNet-50-deploy.prototxt",
@@ -148,6 +175,13 @@ PERF_TEST_P_(DNNTestNetwork, SSD)
             Mat(cv::Size(300, 300), CV_32FC3), "detection_out", "caffe");
 }
 
+PERF_TEST_P_(DNNTestNetwork, SSD_parallel_layers)
+{
+    parallelLayers = true;
+    processNet("dnn/VGG_ILSVRC2016_SSD_300x300_iter_440000.caffemodel", "dnn/ssd_vgg16.prototxt", "disabled",
+            Mat(cv::Size(300, 300), CV_32FC3), "detection_out", "caffe");
+}
+
 PERF_TEST_P_(DNNTestNetwork, OpenFace)
 {
     processNet("dnn/openface_nn4.small2.v1.t7", "", "",
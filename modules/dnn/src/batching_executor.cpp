@@ -0,0 +1,282 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "precomp.hpp"
+
+#ifdef CV_CXX11
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace cv
+{
+namespace dnn
+{
+CV__DNN_EXPERIMENTAL_NS_BEGIN
+
+BatchingExecutor::Stats::Stats()
+    : requests(0), batches(0), meanBatchSize(0), meanQueueTime(0), meanLatency(0),
+      p50Latency(0), p90Latency(0), p99Latency(0), maxLatency(0)
+{}
+
+struct BatchingExecutor::Impl
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Request
+    {
+        Mat blob;
+        std::promise<Mat> result;
+        Clock::time_point submitted;
+    };
+
+    Impl(const Net& net_, int maxBatchSize_, double maxDelay_, const String& outputName_)
+        : net(net_), outputName(outputName_), maxBatchSize(maxBatchSize_),
+          maxDelay(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(maxDelay_))),
+          stop(false), batches(0), samples(0), requests(0), queueTimeSum(0), latencySum(0), maxLatency(0)
+    {
+        latencies.reserve(LATENCY_WINDOW);
+        worker = std::thread(&Impl::run, this);
+    }
+
+    ~Impl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cond.notify_one();
+        worker.join();
+    }
+
+    static bool sameSampleShape(const Mat& a, const Mat& b)
+    {
+        if (a.type() != b.type() || a.dims != b.dims)
+            return false;
+        for (int i = 1; i < a.dims; i++)
+        {
+            if (a.size[i] != b.size[i])
+                return false;
+        }
+        return true;
+    }
+
+    // Number of requests from the head of the queue which go to the next batch. Must be called under the lock.
+    size_t batchLength(int& numSamples) const
+    {
+        CV_Assert(!queue.empty());
+        const Mat& first = queue.front().blob;
+        numSamples = first.size[0];
+        size_t n = 1;
+        for (; n < queue.size(); n++)
+        {
+            const Mat& blob = queue[n].blob;
+            if (numSamples + blob.size[0] > maxBatchSize || !sameSampleShape(first, blob))
+                break;
+            numSamples += blob.size[0];
+        }
+        return n;
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            cond.wait(lock, [this]() { return stop || !queue.empty(); });
+            if (queue.empty())
+                return;
+
+            // Give other requests a chance to join the batch.
+            const Clock::time_point deadline = queue.front().submitted + maxDelay;
+            int numSamples = 0;
+            size_t n = batchLength(numSamples);
+            while (!stop && numSamples < maxBatchSize && n == queue.size() && Clock::now() < deadline)
+            {
+                cond.wait_until(lock, deadline);
+                n = batchLength(numSamples);
+            }
+
+            std::vector<Request> batch(n);
+            for (size_t i = 0; i < n; i++)
+            {
+                batch[i] = std::move(queue.front());
+                queue.pop_front();
+            }
+            lock.unlock();
+            process(batch, numSamples);
+            lock.lock();
+        }
+    }
+
+    void process(std::vector<Request>& batch, int numSamples)
+    {
+        CV_TRACE_FUNCTION();
+
+        const Clock::time_point start = Clock::now();
+        std::vector<Mat> outputs(batch.size());
+        try
+        {
+            Mat input;
+            if (batch.size() == 1)
+                input = batch[0].blob;
+            else
+            {
+                const Mat& first = batch[0].blob;
+                std::vector<int> shape(first.size.p, first.size.p + first.dims);
+                shape[0] = numSamples;
+                input.create(first.dims, &shape[0], first.type());
+                uchar* dst = input.ptr();
+                for (size_t i = 0; i < batch.size(); i++)
+                {
+                    const Mat& blob = batch[i].blob;
+                    const size_t size = blob.total() * blob.elemSize();
+                    memcpy(dst, blob.ptr(), size);
+                    dst += size;
+                }
+            }
+
+            net.setInput(input);
+            Mat out = net.forward(outputName);
+            CV_Assert(out.dims >= 1 && out.size[0] == numSamples && out.isContinuous());
+
+            std::vector<int> shape(out.size.p, out.size.p + out.dims);
+            const uchar* src = out.ptr();
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                shape[0] = batch[i].blob.size[0];
+                outputs[i].create(out.dims, &shape[0], out.type());
+                const size_t size = outputs[i].total() * outputs[i].elemSize();
+                memcpy(outputs[i].ptr(), src, size);
+                src += size;
+            }
+        }
+        catch (...)
+        {
+            std::exception_ptr error = std::current_exception();
+            for (size_t i = 0; i < batch.size(); i++)
+                batch[i].result.set_exception(error);
+            return;
+        }
+
+        // Statistics are updated before the results are available to make them visible
+        // for the caller which waits for the result.
+        const Clock::time_point finish = Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            batches += 1;
+            samples += numSamples;
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                const double latency = std::chrono::duration<double, std::milli>(finish - batch[i].submitted).count();
+                queueTimeSum += std::chrono::duration<double, std::milli>(start - batch[i].submitted).count();
+                latencySum += latency;
+                maxLatency = std::max(maxLatency, latency);
+                if (latencies.size() < LATENCY_WINDOW)
+                    latencies.push_back(latency);
+                else
+                    latencies[requests % LATENCY_WINDOW] = latency;
+                requests += 1;
+            }
+        }
+        for (size_t i = 0; i < batch.size(); i++)
+            batch[i].result.set_value(outputs[i]);
+    }
+
+    Net net;
+    String outputName;
+    int maxBatchSize;
+    Clock::duration maxDelay;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Request> queue;
+    bool stop;
+    std::thread worker;
+
+    // Percentiles are computed over the latest requests only, so the statistics take constant memory.
+    enum { LATENCY_WINDOW = 1024 };
+
+    mutable std::mutex statsMutex;
+    size_t batches, samples, requests;
+    double queueTimeSum, latencySum, maxLatency;
+    std::vector<double> latencies;  // ring buffer of the last LATENCY_WINDOW latencies
+};
+
+BatchingExecutor::BatchingExecutor(const Net& net, int maxBatchSize, double maxDelay, const String& outputName)
+{
+    CV_TRACE_FUNCTION();
+    CV_Assert(!net.empty(), maxBatchSize > 0, maxDelay >= 0);
+    impl = makePtr<Impl>(net, maxBatchSize, maxDelay, outputName);
+}
+
+BatchingExecutor::~BatchingExecutor()
+{
+}
+
+std::future<Mat> BatchingExecutor::submit(const Mat& blob)
+{
+    CV_TRACE_FUNCTION();
+    CV_Assert(!blob.empty(), blob.dims >= 2);
+
+    Impl::Request request;
+    // Callers usually reuse their input buffers so the data is copied.
+    request.blob = blob.clone();
+    request.submitted = Impl::Clock::now();
+    std::future<Mat> result = request.result.get_future();
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        impl->queue.push_back(std::move(request));
+    }
+    impl->cond.notify_one();
+    return result;
+}
+
+BatchingExecutor::Stats BatchingExecutor::getStats() const
+{
+    std::vector<double> latencies;
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(impl->statsMutex);
+        stats.requests = impl->requests;
+        stats.batches = impl->batches;
+        if (impl->batches)
+            stats.meanBatchSize = (double)impl->samples / impl->batches;
+        if (!impl->requests)
+            return stats;
+        stats.meanQueueTime = impl->queueTimeSum / impl->requests;
+        stats.meanLatency = impl->latencySum / impl->requests;
+        stats.maxLatency = impl->maxLatency;
+        latencies = impl->latencies;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    const size_t n = latencies.size();
+    stats.p50Latency = latencies[std::min(n - 1, (size_t)std::ceil(0.5 * n) - 1)];
+    stats.p90Latency = latencies[std::min(n - 1, (size_t)std::ceil(0.9 * n) - 1)];
+    stats.p99Latency = latencies[std::min(n - 1, (size_t)std::ceil(0.99 * n) - 1)];
+    return stats;
+}
+
+void BatchingExecutor::resetStats()
+{
+    std::lock_guard<std::mutex> lock(impl->statsMutex);
+    impl->batches = 0;
+    impl->samples = 0;
+    impl->requests = 0;
+    impl->queueTimeSum = 0;
+    impl->latencySum = 0;
+    impl->maxLatency = 0;
+    impl->latencies.clear();
+}
+
+CV__DNN_EXPERIMENTAL_NS_END
+}  // namespace dnn
+}  // namespace cv
+
+#endif  // CV_CXX11
@@ -50,6 +50,8 @@
 #include <google/protobuf/text_format.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include "caffe_io.hpp"
+#include "../file_mapping.hpp"
+#include <opencv2/dnn/shape_utils.hpp>
 #endif
 
 namespace cv {
@@ -79,28 +81,45 @@ class CaffeImporter
 {
     caffe::NetParameter net;
     caffe::NetParameter netBinary;
+    // Weights are read from the model data directly. Blobs of the model
+    // loaded from file refer to the file mapping if possible.
+    Ptr<FileMapping> mapping;
+    const uchar* modelData;
+    size_t modelSize;
 
 public:
 
     CaffeImporter(const char *pototxt, const char *caffeModel)
+        : modelData(0), modelSize(0)
     {
         CV_TRACE_FUNCTION();
 
         ReadNetParamsFromTextFileOrDie(pototxt, &net);
 
         if (caffeModel && caffeModel[0])
-            ReadNetParamsFromBinaryFileOrDie(caffeModel, &netBinary);
+        {
+            mapping = Ptr<FileMapping>(new FileMapping(caffeModel));
+            modelData = mapping->data();
+            modelSize = mapping->size();
+            ReadNetParamsSkipBlobsDataOrDie((const char*)modelData, modelSize, &netBinary);
+        }
     }
 
     CaffeImporter(const char *dataProto, size_t lenProto,
                   const char *dataModel, size_t lenModel)
+        : modelData(0), modelSize(0)
     {
         CV_TRACE_FUNCTION();
 
         ReadNetParamsFromTextBufferOrDie(dataProto, lenProto, &net);
 
         if (dataModel != NULL && lenModel > 0)
-            ReadNetParamsFromBinaryBufferOrDie(dataModel, lenModel, &netBinary);
+        {
+            // The buffer is used during import only so values are copied.
+            modelData = (const uchar*)dataModel;
+            modelSize = lenModel;
+            ReadNetParamsSkipBlobsDataOrDie(dataModel, lenModel, &netBinary);
+        }
     }
 
     void addParam(const Message &msg, const FieldDescriptor *field, cv::dnn::LayerParams &params)
@@ -233,6 +252,23 @@ public:
         MatShape shape;
         blobShapeFromProto(pbBlob, shape);
 
+        size_t offset = 0, count = 0;
+        if (GetSkippedBlobData(pbBlob, offset, count))
+        {
+            // Single precision floats in the model data.
+            CV_Assert(offset <= modelSize && count <= (modelSize - offset) / sizeof(float),
+                      count == (size_t)total(shape));
+            const uchar* data = modelData + offset;
+            if (!mapping.empty() && (size_t)data % sizeof(float) == 0)
+                dstBlob = wrapMappedData(mapping, data, (int)shape.size(), &shape[0], CV_32F);
+            else
+            {
+                dstBlob.create((int)shape.size(), &shape[0], CV_32F);
+                memcpy(dstBlob.ptr(), data, count * sizeof(float));
+            }
+            return;
+        }
+
         dstBlob.create((int)shape.size(), &shape[0], CV_32F);
         float *dstData = dstBlob.ptr<float>();
         if (pbBlob.data_size())
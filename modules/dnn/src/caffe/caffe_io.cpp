@@ -91,6 +91,7 @@
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/text_format.h>
+#include <google/protobuf/unknown_field_set.h>
 
 #include <opencv2/core.hpp>
 
@@ -1168,6 +1169,138 @@ void ReadNetParamsFromBinaryBufferOrDie(const char* data, size_t len,
   UpgradeNetAsNeeded("memory buffer", param);
 }
 
+// Packed BlobProto::data fields are replaced by unknown fields with
+// an offset of the values in the buffer and their number.
+static const int kSkippedDataOffsetField = 536870001;
+static const int kSkippedDataCountField = 536870002;
+
+// Protobuf wire types.
+enum { kWireVarint = 0, kWireFixed64 = 1, kWireLengthDelimited = 2, kWireFixed32 = 5 };
+
+enum SerializedMessageType {
+  kOtherMessage, kNetParameter, kLayerParameter, kV1LayerParameter, kBlobProto
+};
+
+static SerializedMessageType GetSubmessageType(SerializedMessageType type, int field) {
+  if (type == kNetParameter)
+    return field == 100 ? kLayerParameter : field == 2 ? kV1LayerParameter : kOtherMessage;
+  if (type == kLayerParameter)
+    return field == 7 ? kBlobProto : kOtherMessage;
+  if (type == kV1LayerParameter)
+    return field == 6 ? kBlobProto : kOtherMessage;
+  return kOtherMessage;
+}
+
+static bool ReadVarint(const uchar*& ptr, const uchar* end, uint64& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && ptr < end; shift += 7) {
+    uchar b = *ptr++;
+    value |= (uint64)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+static void WriteVarint(std::vector<uchar>& dst, uint64 value) {
+  for (; value >= 0x80; value >>= 7)
+    dst.push_back((uchar)(value | 0x80));
+  dst.push_back((uchar)value);
+}
+
+// Copies serialized message of the given type to dst. Blobs data is skipped.
+static bool SkipBlobsData(const uchar* base, const uchar* ptr, const uchar* end,
+                          SerializedMessageType type, std::vector<uchar>& dst) {
+  while (ptr < end) {
+    const uchar* fieldStart = ptr;
+    uint64 tag, value;
+    if (!ReadVarint(ptr, end, tag))
+      return false;
+    int field = (int)(tag >> 3);
+    switch (tag & 7) {
+      case kWireVarint:
+        if (!ReadVarint(ptr, end, value))
+          return false;
+        break;
+      case kWireFixed64:
+        if (end - ptr < 8)
+          return false;
+        ptr += 8;
+        break;
+      case kWireFixed32:
+        if (end - ptr < 4)
+          return false;
+        ptr += 4;
+        break;
+      case kWireLengthDelimited: {
+        if (!ReadVarint(ptr, end, value) || value > (uint64)(end - ptr))
+          return false;
+        const uchar* data = ptr;
+        ptr += value;
+        if (type == kBlobProto && field == 5) {
+          WriteVarint(dst, (uint64)kSkippedDataOffsetField << 3);
+          WriteVarint(dst, (uint64)(data - base));
+          WriteVarint(dst, (uint64)kSkippedDataCountField << 3);
+          WriteVarint(dst, value / sizeof(float));
+          continue;
+        }
+        SerializedMessageType subType = GetSubmessageType(type, field);
+        if (subType != kOtherMessage) {
+          std::vector<uchar> submessage;
+          if (!SkipBlobsData(base, data, ptr, subType, submessage))
+            return false;
+          WriteVarint(dst, tag);
+          WriteVarint(dst, submessage.size());
+          dst.insert(dst.end(), submessage.begin(), submessage.end());
+          continue;
+        }
+        break;
+      }
+      default:
+        // Groups are not used by caffe.proto.
+        return false;
+    }
+    dst.insert(dst.end(), fieldStart, ptr);
+  }
+  return true;
+}
+
+void ReadNetParamsSkipBlobsDataOrDie(const char* data, size_t len,
+                                     NetParameter* param) {
+  const int one = 1;
+  if (*(const char*)&one != 1) {
+    // Values can't be used without conversion on big endian machines.
+    ReadNetParamsFromBinaryBufferOrDie(data, len, param);
+    return;
+  }
+  std::vector<uchar> buffer;
+  const uchar* ptr = (const uchar*)data;
+  CHECK(SkipBlobsData(ptr, ptr, ptr + len, kNetParameter, buffer) &&
+        ReadProtoFromBinaryBuffer(buffer.empty() ? 0 : (const char*)&buffer[0],
+                                  buffer.size(), param))
+      << "Failed to parse NetParameter buffer";
+  UpgradeNetAsNeeded("memory buffer", param);
+}
+
+bool GetSkippedBlobData(const BlobProto& blob, size_t& offset, size_t& count) {
+  const UnknownFieldSet& fields = blob.GetReflection()->GetUnknownFields(blob);
+  int found = 0;
+  for (int i = 0; i < fields.field_count(); i++) {
+    const UnknownField& field = fields.field(i);
+    if (field.type() != UnknownField::TYPE_VARINT)
+      continue;
+    if (field.number() == kSkippedDataOffsetField) {
+      offset = (size_t)field.varint();
+      found |= 1;
+    } else if (field.number() == kSkippedDataCountField) {
+      count = (size_t)field.varint();
+      found |= 2;
+    }
+  }
+  CHECK(found == 0 || found == 3) << "Invalid reference to blob data";
+  return found != 0;
+}
+
 }
 }
 #endif
@@ -109,6 +109,15 @@ void ReadNetParamsFromBinaryBufferOrDie(const char* data, size_t len,
 void ReadNetParamsFromTextBufferOrDie(const char* data, size_t len,
                                       caffe::NetParameter* param);
 
+// Read binary parameters from a memory buffer without BlobProto::data values.
+// Blobs refer to the values in the buffer instead, see GetSkippedBlobData.
+void ReadNetParamsSkipBlobsDataOrDie(const char* data, size_t len,
+                                     caffe::NetParameter* param);
+
+// Returns true if values of the blob were skipped. offset is a position of
+// count single precision floats (little endian) in the buffer.
+bool GetSkippedBlobData(const caffe::BlobProto& blob, size_t& offset, size_t& count);
+
 // Utility functions used internally by Caffe and TensorFlow loaders
 bool ReadProtoFromTextFile(const char* filename, ::google::protobuf::Message* proto);
 bool ReadProtoFromBinaryFile(const char* filename, ::google::protobuf::Message* proto);
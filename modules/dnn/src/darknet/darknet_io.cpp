@@ -73,6 +73,7 @@
 #include <sstream>
 
 #include "darknet_io.hpp"
+#include "../file_mapping.hpp"
 
 namespace cv {
     namespace dnn {
@@ -509,26 +510,67 @@ namespace cv {
             }
 
 
+            // Reads the weights file through the memory mapping. Blobs refer
+            // to the file data instead of copies if the data is aligned.
+            class WeightsReader
+            {
+            public:
+                explicit WeightsReader(const char *path)
+                    : mapping(new FileMapping(path)), pos(0) {}
+
+                const uchar* read(size_t n)
+                {
+                    if (n > mapping->size() - pos)
+                        CV_Error(cv::Error::StsParseError, "Unexpected end of the weights file");
+                    const uchar* ptr = mapping->data() + pos;
+                    pos += n;
+                    return ptr;
+                }
+
+                template<typename T> T readValue()
+                {
+                    T v;
+                    memcpy(&v, read(sizeof(v)), sizeof(v));
+                    return v;
+                }
+
+                cv::Mat readBlob(int dims, const int *sizes)
+                {
+                    size_t total = 1;
+                    for (int i = 0; i < dims; i++)
+                        total *= sizes[i];
+                    if (total > (mapping->size() - pos) / sizeof(float))
+                        CV_Error(cv::Error::StsParseError, "Unexpected end of the weights file");
+                    const uchar* data = read(total * sizeof(float));
+                    if ((size_t)data % sizeof(float) == 0)
+                        return wrapMappedData(mapping, data, dims, sizes, CV_32F);
+                    cv::Mat blob(dims, sizes, CV_32F);
+                    memcpy(blob.ptr(), data, total * sizeof(float));
+                    return blob;
+                }
+
+            private:
+                Ptr<FileMapping> mapping;
+                size_t pos;
+            };
+
             bool ReadDarknetFromWeightsFile(const char *darknetModel, NetParameter *net)
             {
-                std::ifstream ifile;
-                ifile.open(darknetModel, std::ios::binary);
-                CV_Assert(ifile.is_open());
+                WeightsReader reader(darknetModel);
 
-                int32_t major_ver, minor_ver, revision;
-                ifile.read(reinterpret_cast<char *>(&major_ver), sizeof(int32_t));
-                ifile.read(reinterpret_cast<char *>(&minor_ver), sizeof(int32_t));
-                ifile.read(reinterpret_cast<char *>(&revision), sizeof(int32_t));
+                int32_t major_ver = reader.readValue<int32_t>();
+                int32_t minor_ver = reader.readValue<int32_t>();
+                int32_t revision = reader.readValue<int32_t>();
+                (void)revision;
 
                 uint64_t seen;
                 if ((major_ver * 10 + minor_ver) >= 2) {
-                    ifile.read(reinterpret_cast<char *>(&seen), sizeof(uint64_t));
+                    seen = reader.readValue<uint64_t>();
                 }
                 else {
-                    int32_t iseen = 0;
-                    ifile.read(reinterpret_cast<char *>(&iseen), sizeof(int32_t));
-                    seen = iseen;
+                    seen = reader.readValue<int32_t>();
                 }
+                (void)seen;
                 bool transpose = (major_ver > 1000) || (minor_ver > 1000);
                 if(transpose)
                     CV_Error(cv::Error::StsNotImplemented, "Transpose the weights (except for convolutional) is not implemented");
@@ -556,24 +598,20 @@ namespace cv {
                         CV_Assert(kernel_size > 0 && filters > 0);
                         CV_Assert(current_channels > 0);
 
-                        size_t const weights_size = filters * current_channels * kernel_size * kernel_size;
                         int sizes_weights[] = { filters, current_channels, kernel_size, kernel_size };
-                        cv::Mat weightsBlob;
-                        weightsBlob.create(4, sizes_weights, CV_32F);
-                        CV_Assert(weightsBlob.isContinuous());
+                        int sizes_vec[] = { 1, filters };
 
-                        cv::Mat meanData_mat(1, filters, CV_32F);	// mean
-                        cv::Mat stdData_mat(1, filters, CV_32F);	// variance
-                        cv::Mat weightsData_mat(1, filters, CV_32F);// scale
-                        cv::Mat biasData_mat(1, filters, CV_32F);	// bias
+                        cv::Mat meanData_mat;	// mean
+                        cv::Mat stdData_mat;	// variance
+                        cv::Mat weightsData_mat;// scale
+                        cv::Mat biasData_mat = reader.readBlob(2, sizes_vec);	// bias
 
-                        ifile.read(reinterpret_cast<char *>(biasData_mat.ptr<float>()), sizeof(float)*filters);
                         if (use_batch_normalize) {
-                            ifile.read(reinterpret_cast<char *>(weightsData_mat.ptr<float>()), sizeof(float)*filters);
-                            ifile.read(reinterpret_cast<char *>(meanData_mat.ptr<float>()), sizeof(float)*filters);
-                            ifile.read(reinterpret_cast<char *>(stdData_mat.ptr<float>()), sizeof(float)*filters);
+                            weightsData_mat = reader.readBlob(2, sizes_vec);
+                            meanData_mat = reader.readBlob(2, sizes_vec);
+                            stdData_mat = reader.readBlob(2, sizes_vec);
                         }
-                        ifile.read(reinterpret_cast<char *>(weightsBlob.ptr<float>()), sizeof(float)*weights_size);
+                        cv::Mat weightsBlob = reader.readBlob(4, sizes_weights);
 
                         // set convolutional weights
                         std::vector<cv::Mat> conv_blobs;
@@ -42,14 +42,20 @@
 #include "precomp.hpp"
 #include "op_halide.hpp"
 #include "halide_scheduler.hpp"
+#include "file_mapping.hpp"
+#include "layers/layers_common.hpp"
 #include <set>
 #include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <iterator>
 #include <numeric>
+#include <fstream>
 #include <opencv2/dnn/shape_utils.hpp>
 #include <opencv2/imgproc.hpp>
+#include "opencv2/core/hal/intrin.hpp"
+#include <list>
+#include "opencv2/core/utils/configuration.private.hpp"
 
 namespace cv {
 namespace dnn {
@@ -84,20 +90,145 @@ static String toString(const T &v)
     return ss.str();
 }
 
+namespace
+{
+#if CV_SIMD128
+inline void storeNormalized(const v_uint8x16& v, const v_float32x4& mean,
+                            const v_float32x4& scale, float* dst)
+{
+    v_uint16x8 w0, w1;
+    v_uint32x4 d0, d1, d2, d3;
+    v_expand(v, w0, w1);
+    v_expand(w0, d0, d1);
+    v_expand(w1, d2, d3);
+    v_store(dst, (v_cvt_f32(v_reinterpret_as_s32(d0)) - mean) * scale);
+    v_store(dst + 4, (v_cvt_f32(v_reinterpret_as_s32(d1)) - mean) * scale);
+    v_store(dst + 8, (v_cvt_f32(v_reinterpret_as_s32(d2)) - mean) * scale);
+    v_store(dst + 12, (v_cvt_f32(v_reinterpret_as_s32(d3)) - mean) * scale);
+}
+
+inline void storeNormalized(const v_float32x4& v, const v_float32x4& mean,
+                            const v_float32x4& scale, float* dst)
+{
+    v_store(dst, (v - mean) * scale);
+}
+#endif
+
+// dst[c][x] = (src[x*cn + c] - mean[c]) * scale for the pixels of an image row.
+template<typename T, typename VecT>
+void normalizeImageRow(const T* src, float* const* dst, int cols, int cn,
+                       const float* mean, float scale)
+{
+    int x = 0;
+#if CV_SIMD128
+    const int nlanes = VecT::nlanes;
+    v_float32x4 vscale = v_setall_f32(scale), vmean[4];
+    for (int c = 0; c < cn; c++)
+        vmean[c] = v_setall_f32(mean[c]);
+    VecT v[4];
+    for (; x <= cols - nlanes; x += nlanes)
+    {
+        if (cn == 1)
+            v[0] = v_load(src + x);
+        else if (cn == 3)
+            v_load_deinterleave(src + x*3, v[0], v[1], v[2]);
+        else
+            v_load_deinterleave(src + x*4, v[0], v[1], v[2], v[3]);
+        for (int c = 0; c < cn; c++)
+            storeNormalized(v[c], vmean[c], vscale, dst[c] + x);
+    }
+#endif
+    for (; x < cols; x++)
+    {
+        for (int c = 0; c < cn; c++)
+            dst[c][x] = (src[x*cn + c] - mean[c]) * scale;
+    }
+}
+
+// Converts resized images to floats, subtracts mean, scales them and writes channels
+// to the planes of NCHW blob in a single pass. Rows of all the images are processed in parallel.
+class BlobFromImagesInvoker : public ParallelLoopBody
+{
+public:
+    BlobFromImagesInvoker(const std::vector<Mat>& images, Mat& blob, const Scalar& mean,
+                          double scalefactor, bool swapRB)
+        : images_(images), blob_(blob), scale_((float)scalefactor)
+    {
+        int nch = blob.size[1];
+        for (int c = 0; c < 4; c++)
+        {
+            // Mean values are in the order of the output channels.
+            int mc = swapRB && (c == 0 || c == 2) ? 2 - c : c;
+            mean_[c] = (float)mean[mc];
+            plane_[c] = swapRB && nch >= 3 ? mc : c;
+        }
+    }
+
+    void operator()(const Range& r) const
+    {
+        int nch = blob_.size[1], rows = blob_.size[2], cols = blob_.size[3];
+        float* dst[4];
+        for (int i = r.start; i < r.end; i++)
+        {
+            int n = i / rows, y = i % rows;
+            const Mat& image = images_[n];
+            for (int c = 0; c < nch; c++)
+                dst[c] = blob_.ptr<float>(n, plane_[c], y);
+            if (image.depth() == CV_8U)
+                normalizeImageRow<uchar, v_uint8x16>(image.ptr<uchar>(y), dst, cols, nch, mean_, scale_);
+            else
+                normalizeImageRow<float, v_float32x4>(image.ptr<float>(y), dst, cols, nch, mean_, scale_);
+        }
+    }
+
+private:
+    const std::vector<Mat>& images_;
+    Mat& blob_;
+    float mean_[4];
+    float scale_;
+    int plane_[4];
+};
+}
+
 Mat blobFromImage(InputArray image, double scalefactor, const Size& size,
                   const Scalar& mean, bool swapRB, bool crop)
+{
+    CV_TRACE_FUNCTION();
+    Mat blob;
+    blobFromImage(image, blob, scalefactor, size, mean, swapRB, crop);
+    return blob;
+}
+
+void blobFromImage(InputArray image, OutputArray blob, double scalefactor,
+                   const Size& size, const Scalar& mean, bool swapRB, bool crop)
 {
     CV_TRACE_FUNCTION();
     std::vector<Mat> images(1, image.getMat());
-    return blobFromImages(images, scalefactor, size, mean, swapRB, crop);
+    blobFromImages(images, blob, scalefactor, size, mean, swapRB, crop);
+}
+
+Mat blobFromImages(const std::vector<Mat>& images, double scalefactor, Size size,
+                   const Scalar& mean, bool swapRB, bool crop)
+{
+    CV_TRACE_FUNCTION();
+    Mat blob;
+    blobFromImages(images, blob, scalefactor, size, mean, swapRB, crop);
+    return blob;
 }
 
-Mat blobFromImages(const std::vector<Mat>& images_, double scalefactor, Size size,
-                   const Scalar& mean_, bool swapRB, bool crop)
+void blobFromImages(InputArrayOfArrays images_, OutputArray blob_, double scalefactor,
+                    Size size, const Scalar& mean, bool swapRB, bool crop)
 {
     CV_TRACE_FUNCTION();
-    std::vector<Mat> images = images_;
-    for (int i = 0; i < images.size(); i++)
+    std::vector<Mat> images;
+    images_.getMatVector(images);
+    if (images.empty())
+    {
+        blob_.release();
+        return;
+    }
+
+    for (size_t i = 0; i < images.size(); i++)
     {
         Size imgSize = images[i].size();
         if (size == Size())
@@ -117,62 +248,24 @@ Mat blobFromImages(const std::vector<Mat>& images_, double scalefactor, Size siz
             else
               resize(images[i], images[i], size, 0, 0, INTER_LINEAR);
         }
-        if(images[i].depth() == CV_8U)
-            images[i].convertTo(images[i], CV_32F);
-        Scalar mean = mean_;
-        if (swapRB)
-            std::swap(mean[0], mean[2]);
-
-        images[i] -= mean;
-        images[i] *= scalefactor;
     }
 
-    size_t i, nimages = images.size();
-    if(nimages == 0)
-        return Mat();
     Mat image0 = images[0];
     int nch = image0.channels();
-    CV_Assert(image0.dims == 2);
-    Mat blob, image;
-    if (nch == 3 || nch == 4)
+    CV_Assert(image0.dims == 2 && (nch == 1 || nch == 3 || nch == 4));
+    for (size_t i = 0; i < images.size(); i++)
     {
-        int sz[] = { (int)nimages, nch, image0.rows, image0.cols };
-        blob = Mat(4, sz, CV_32F);
-        Mat ch[4];
-
-        for( i = 0; i < nimages; i++ )
-        {
-            image = images[i];
-            CV_Assert(image.depth() == CV_32F);
-            nch = image.channels();
-            CV_Assert(image.dims == 2 && (nch == 3 || nch == 4));
-            CV_Assert(image.size() == image0.size());
-
-            for( int j = 0; j < nch; j++ )
-                ch[j] = Mat(image.rows, image.cols, CV_32F, blob.ptr((int)i, j));
-            if(swapRB)
-                std::swap(ch[0], ch[2]);
-            split(image, ch);
-        }
+        const Mat& image = images[i];
+        CV_Assert(image.depth() == CV_8U || image.depth() == CV_32F);
+        CV_Assert(image.dims == 2 && image.channels() == nch);
+        CV_Assert(image.size() == image0.size());
     }
-    else
-    {
-       CV_Assert(nch == 1);
-       int sz[] = { (int)nimages, 1, image0.rows, image0.cols };
-       blob = Mat(4, sz, CV_32F);
-
-       for( i = 0; i < nimages; i++ )
-       {
-           Mat image = images[i];
-           CV_Assert(image.depth() == CV_32F);
-           nch = image.channels();
-           CV_Assert(image.dims == 2 && (nch == 1));
-           CV_Assert(image.size() == image0.size());
 
-           image.copyTo(Mat(image.rows, image.cols, CV_32F, blob.ptr((int)i, 0)));
-       }
-    }
-    return blob;
+    int sz[] = { (int)images.size(), nch, image0.rows, image0.cols };
+    blob_.create(4, sz, CV_32F);
+    Mat blob = blob_.getMat();
+    parallel_for_(Range(0, sz[0] * sz[2]),
+                  BlobFromImagesInvoker(images, blob, mean, scalefactor, swapRB));
 }
 
 struct LayerPin
@@ -206,9 +299,9 @@ struct LayerPin
 
 struct LayerData
 {
-    LayerData() : id(-1), flag(0) {}
+    LayerData() : id(-1), flag(0), blockSize(0) {}
     LayerData(int _id, const String &_name, const String &_type, LayerParams &_params)
-        : id(_id), name(_name), type(_type), params(_params), flag(0)
+        : id(_id), name(_name), type(_type), params(_params), flag(0), blockSize(0)
     {
         CV_TRACE_FUNCTION();
 
@@ -243,6 +336,15 @@ struct LayerData
 
     int flag;
 
+    // Number of channels in a block if the layer computes in NCHWc layout, 0 for NCHW one.
+    int blockSize;
+    // Shapes of outputs in NCHW layout if blockSize is not zero.
+    std::vector<MatShape> plainOutputShapes;
+    // Copies of inputs which are produced in a layout different from the layer's one
+    // (empty if the layouts match) and the blobs they are copied from.
+    std::vector<Mat> reorderedInputs;
+    std::vector<Mat*> reorderedInputsOrigins;
+
     Ptr<Layer> getLayerInstance()
     {
         CV_TRACE_FUNCTION();
@@ -261,6 +363,126 @@ struct LayerData
     }
 };
 
+// Reorders [N, C, H, W] blobs to [N, ceil(C/b), H, W, b] ones and back.
+// Padding channels of the last block are filled by zeros.
+class BlockedLayoutReorder : public ParallelLoopBody
+{
+public:
+    static void toBlocked(const Mat& src, Mat& dst)
+    {
+        run(src, dst, true);
+    }
+
+    static void toPlain(const Mat& src, Mat& dst)
+    {
+        run(dst, src, false);
+    }
+
+    void operator()(const Range& r) const
+    {
+        int channels = plain.size[1], planeSize = plain.size[2]*plain.size[3];
+        int blk = blocked.size[4], nblocks = blocked.size[1];
+
+        for (int i = r.start; i < r.end; i++)
+        {
+            int n = i / nblocks, b = i - n*nblocks;
+            int cn = std::min(channels - b*blk, blk);
+            float* plainData = (float*)plain.ptr<float>(n, b*blk);
+            float* blkData = (float*)blocked.ptr<float>(n, b);
+            int c = 0;
+#if CV_SIMD128
+            for (; c <= cn - 4; c += 4)
+            {
+                float* pptr = plainData + (size_t)c*planeSize;
+                float* bptr = blkData + c;
+                int j = 0;
+                for (; j <= planeSize - 4; j += 4, bptr += 4*blk)
+                {
+                    v_float32x4 v0, v1, v2, v3;
+                    if (toBlockedLayout)
+                    {
+                        v_transpose4x4(v_load(pptr + j), v_load(pptr + planeSize + j),
+                                       v_load(pptr + planeSize*2 + j), v_load(pptr + planeSize*3 + j),
+                                       v0, v1, v2, v3);
+                        v_store(bptr, v0);
+                        v_store(bptr + blk, v1);
+                        v_store(bptr + blk*2, v2);
+                        v_store(bptr + blk*3, v3);
+                    }
+                    else
+                    {
+                        v_transpose4x4(v_load(bptr), v_load(bptr + blk),
+                                       v_load(bptr + blk*2), v_load(bptr + blk*3),
+                                       v0, v1, v2, v3);
+                        v_store(pptr + j, v0);
+                        v_store(pptr + planeSize + j, v1);
+                        v_store(pptr + planeSize*2 + j, v2);
+                        v_store(pptr + planeSize*3 + j, v3);
+                    }
+                }
+                for (; j < planeSize; j++, bptr += blk)
+                {
+                    for (int k = 0; k < 4; k++)
+                        reorder(pptr + (size_t)k*planeSize + j, bptr + k);
+                }
+            }
+#endif
+            for (; c < cn; c++)
+            {
+                float* pptr = plainData + (size_t)c*planeSize;
+                float* bptr = blkData + c;
+                for (int j = 0; j < planeSize; j++, bptr += blk)
+                    reorder(pptr + j, bptr);
+            }
+            if (toBlockedLayout)
+            {
+                for (int j = 0; j < planeSize; j++)
+                    for (int k = cn; k < blk; k++)
+                        blkData[j*blk + k] = 0.f;
+            }
+        }
+    }
+
+private:
+    static void run(const Mat& plain, const Mat& blocked, bool toBlockedLayout)
+    {
+        CV_Assert(plain.dims == 4 && blocked.dims == 5 && plain.type() == CV_32F &&
+                  blocked.type() == CV_32F && plain.isContinuous() && blocked.isContinuous());
+        CV_Assert(plain.size[0] == blocked.size[0] && plain.size[2] == blocked.size[2] &&
+                  plain.size[3] == blocked.size[3] &&
+                  (plain.size[1] + blocked.size[4] - 1) / blocked.size[4] == blocked.size[1]);
+
+        BlockedLayoutReorder p;
+        p.plain = plain;
+        p.blocked = blocked;
+        p.toBlockedLayout = toBlockedLayout;
+        int nblocks = blocked.size[0]*blocked.size[1];
+        parallel_for_(Range(0, nblocks), p, std::min(nblocks, getNumThreads()));
+    }
+
+    BlockedLayoutReorder() : toBlockedLayout(false) {}
+
+    inline void reorder(float* plainPtr, float* blockedPtr) const
+    {
+        if (toBlockedLayout)
+            *blockedPtr = *plainPtr;
+        else
+            *plainPtr = *blockedPtr;
+    }
+
+    Mat plain, blocked;
+    bool toBlockedLayout;
+};
+
+static MatShape getBlockedShape(const MatShape& plainShape, int blockSize)
+{
+    CV_Assert(plainShape.size() == 4);
+    MatShape blockedShape(plainShape);
+    blockedShape[1] = (plainShape[1] + blockSize - 1) / blockSize;
+    blockedShape.push_back(blockSize);
+    return blockedShape;
+}
+
 //fake layer containing network input blobs
 struct DataLayer : public Layer
 {
@@ -279,6 +501,11 @@ struct DataLayer : public Layer
         outNames.assign(names.begin(), names.end());
     }
 
+    const std::vector<String>& getNames() const
+    {
+        return outNames;
+    }
+
     bool getMemoryShapes(const std::vector<MatShape> &inputs,
                          const int requiredOutputs,
                          std::vector<MatShape> &outputs,
@@ -488,7 +715,8 @@ public:
 
         // Check that layer could work in-place.
         bool inPlace = false;
-        if (layerShapes.supportInPlace)
+        int inPlaceInput = 0;
+        if (layerShapes.supportInPlace && reuseEnabled)
         {
             if (ld.inputBlobs.size() == 1)
             {
@@ -497,6 +725,21 @@ public:
                 // If current layer is one and only customer of this blob.
                 inPlace = numRef == 1;
             }
+            else if (outShapes.size() == 1 && preferableBackend == DNN_BACKEND_DEFAULT && !use_umat)
+            {
+                // Layers with several inputs and a single output (i.e. Eltwise)
+                // write to any input of the same size which is not used by other layers.
+                // Halide pipelines and fused OpenCL kernels keep separate outputs.
+                for (int i = 0; i < (int)ld.inputBlobs.size() && !inPlace; i++)
+                {
+                    if (ld.inputBlobs[i]->total() == total(outShapes[0]) &&
+                        numReferences(ld.inputBlobsId[i]) == 1)
+                    {
+                        inPlace = true;
+                        inPlaceInput = i;
+                    }
+                }
+            }
         }
 
         ShapesVec shapes(outShapes);
@@ -530,7 +773,7 @@ public:
         }
 
         std::map<int, std::vector<int> >::reverse_iterator it;
-        bool force = !maximizeReuse && ld.inputBlobsId.size() > 1;
+        bool force = !reuseEnabled || (!maximizeReuse && ld.inputBlobsId.size() > 1);
         for(it = idxSizes.rbegin(); it != idxSizes.rend(); it++)
         {
             for(int j = 0; j < it->second.size(); j++)
@@ -539,21 +782,21 @@ public:
                 if (total(shapes[index]))
                 {
                     LayerPin blobPin(ld.id, index);
-                    if (index < outShapes.size() && inPlace && !force)
+                    if (index < outShapes.size() && inPlace)
                     {
                         if (use_umat)
                         {
-                            CV_Assert(ld.umat_inputBlobs[0].total() == total(shapes[index]));
+                            CV_Assert(ld.umat_inputBlobs[inPlaceInput].total() == total(shapes[index]));
                             ld.umat_outputBlobs[index] =
-                                ld.umat_inputBlobs[0].reshape(1, shapes[index].size(),
-                                                              &shapes[index][0]);
+                                ld.umat_inputBlobs[inPlaceInput].reshape(1, shapes[index].size(),
+                                                                         &shapes[index][0]);
                         }
                         else
                         {
-                            CV_Assert(ld.inputBlobs[0]->total() == total(shapes[index]));
-                            ld.outputBlobs[index] = ld.inputBlobs[0]->reshape(1, shapes[index]);
+                            CV_Assert(ld.inputBlobs[inPlaceInput]->total() == total(shapes[index]));
+                            ld.outputBlobs[index] = ld.inputBlobs[inPlaceInput]->reshape(1, shapes[index]);
                         }
-                        reuse(ld.inputBlobsId[0], blobPin);
+                        reuse(ld.inputBlobsId[inPlaceInput], blobPin);
                     }
                     else
                     {
@@ -567,6 +810,14 @@ public:
         }
     }
 
+    // Outputs of the layer are views of its input blob <host> so they share its references.
+    void allocateViews(LayerData &ld, const LayerPin& host, const std::vector<Mat>& views)
+    {
+        ld.outputBlobs = views;
+        for (int i = 0; i < (int)views.size(); i++)
+            reuse(host, LayerPin(ld.id, i));
+    }
+
     // Clear internal state. Calls before an every reallocation.
     void reset()
     {
@@ -578,6 +829,7 @@ public:
         umat_memHosts.clear();
         preferableTarget = DNN_TARGET_CPU;
         preferableBackend = DNN_BACKEND_DEFAULT;
+        reuseEnabled = true;
     }
 
     void setPreferableTarget(int targetId)
@@ -585,6 +837,12 @@ public:
         preferableTarget = targetId;
     }
 
+    // Layers which are computed concurrently must not share memory.
+    void setReuseEnabled(bool enabled)
+    {
+        reuseEnabled = enabled;
+    }
+
     void setPreferableBackend(int backendId)
     {
         preferableBackend = backendId;
@@ -614,6 +872,7 @@ private:
     std::map<LayerPin, UMat> umat_memHosts;
     int preferableTarget;
     int preferableBackend;
+    bool reuseEnabled;
 };
 
 static Ptr<BackendWrapper> wrapMat(int backendId, int targetId, const cv::Mat& m)
@@ -653,6 +912,10 @@ struct Net::Impl
         lastLayerId = 0;
         netWasAllocated = false;
         fusion = true;
+        parallelLayers = false;
+        blockedLayout = false;
+        weightsType = DNN_WEIGHTS_FP32;
+        allocationCacheSize = utils::getConfigurationParameterSizeT("OPENCV_DNN_ALLOCATION_CACHE_SIZE", 4);
         preferableBackend = DNN_BACKEND_DEFAULT;
         preferableTarget = DNN_TARGET_CPU;
         blobManager.setPreferableBackend(DNN_BACKEND_DEFAULT);
@@ -675,7 +938,59 @@ struct Net::Impl
 
     bool netWasAllocated;
     bool fusion;
+    bool parallelLayers;
+    bool blockedLayout;
+    int weightsType;
     std::vector<int64> layersTimings;
+    // Groups of layers which are computed concurrently, in order of execution (see buildLayersStages).
+    std::vector<std::vector<int> > layersStages;
+
+    // Blobs of a layer allocated for the specific shapes of the network inputs.
+    struct LayerAllocation
+    {
+        std::vector<Mat> outputBlobs;
+        std::vector<Mat*> inputBlobs;
+        std::vector<Mat> internals;
+        std::map<int, bool> skipFlags;
+    };
+
+    // Blobs of all the layers except the network inputs one (see setUpNet).
+    struct AllocationPlan
+    {
+        ShapesVec inputShapes;
+        // Consumers of the network inputs refer to elements of this array.
+        const Mat* inputBlobs;
+        std::vector<LayerAllocation> layers;
+        std::vector<std::vector<int> > layersStages;
+    };
+
+    // Plans for recently used input shapes, most recent first.
+    std::list<AllocationPlan> allocationPlans;
+    size_t allocationCacheSize;
+    // Shapes of inputs which the current blobs of layers are allocated for.
+    // Empty if the blobs can't be cached.
+    ShapesVec allocatedShapes;
+    // Serializes forward passes and inputs updates of asynchronous requests.
+    Mutex forwardMutex;
+
+    bool useParallelLayers() const
+    {
+        return parallelLayers && preferableBackend == DNN_BACKEND_DEFAULT &&
+               preferableTarget == DNN_TARGET_CPU;
+    }
+
+    bool useBlockedLayout() const
+    {
+        return blockedLayout && preferableBackend == DNN_BACKEND_DEFAULT &&
+               preferableTarget == DNN_TARGET_CPU;
+    }
+
+    // Blocked layers are finalized with NCHW shapes which aren't kept after allocation.
+    bool useAllocationCache() const
+    {
+        return allocationCacheSize > 1 && preferableBackend == DNN_BACKEND_DEFAULT &&
+               preferableTarget == DNN_TARGET_CPU && !useBlockedLayout();
+    }
 
     Ptr<BackendWrapper> wrap(const Mat& host)
     {
@@ -759,6 +1074,13 @@ struct Net::Impl
     {
         CV_TRACE_FUNCTION();
 
+        allocationPlans.clear();
+        allocatedShapes.clear();
+        clearLayers();
+    }
+
+    void clearLayers()
+    {
         MapIdToLayerData::iterator it;
         for (it = layers.begin(); it != layers.end(); it++)
         {
@@ -771,6 +1093,10 @@ struct Net::Impl
                 it->second.umat_internals.clear();
             }
             it->second.skipFlags.clear();
+            it->second.blockSize = 0;
+            it->second.plainOutputShapes.clear();
+            it->second.reorderedInputs.clear();
+            it->second.reorderedInputsOrigins.clear();
             //it->second.consumers.clear();
             Ptr<Layer> currLayer = it->second.layerInstance;
 
@@ -778,6 +1104,7 @@ struct Net::Impl
                 continue;
 
             currLayer->unsetAttached();
+            setBlockedLayout(currLayer, 0, std::vector<MatShape>());
 
             Ptr<PoolingLayer> poolingLayer = currLayer.dynamicCast<PoolingLayer>();
             if( !poolingLayer.empty() )
@@ -798,20 +1125,38 @@ struct Net::Impl
 
         if (!netWasAllocated || this->blobsToKeep != blobsToKeep_)
         {
-            clear();
+            ShapesVec inputShapes;
+            const std::vector<Mat>& inputBlobs = layers[0].outputBlobs;
+            for (size_t i = 0; i < inputBlobs.size(); i++)
+                inputShapes.push_back(shape(inputBlobs[i]));
 
-            allocateLayers(blobsToKeep_);
-            computeNetOutputLayers();
-            initBackend();
+            // Layers fusion depends on the blobs to keep so the cached plans don't suit other ones.
+            if (this->blobsToKeep != blobsToKeep_)
+            {
+                allocationPlans.clear();
+                allocatedShapes.clear();
+            }
+            storeAllocationPlan();
 
-            if (!netWasAllocated )
+            if (!loadAllocationPlan(inputShapes))
             {
+                clearLayers();
+
+                allocateLayers(blobsToKeep_);
+                computeNetOutputLayers();
+                initBackend();
+
+                if (!netWasAllocated )
+                {
 #ifdef HAVE_HALIDE
-                if (preferableBackend == DNN_BACKEND_HALIDE)
-                    compileHalide();
+                    if (preferableBackend == DNN_BACKEND_HALIDE)
+                        compileHalide();
 #else
-                CV_Assert(preferableBackend != DNN_BACKEND_HALIDE);
+                    CV_Assert(preferableBackend != DNN_BACKEND_HALIDE);
 #endif
+                }
+                if (useAllocationCache())
+                    allocatedShapes = inputShapes;
             }
 
             netWasAllocated = true;
@@ -819,6 +1164,94 @@ struct Net::Impl
         }
     }
 
+    // Moves blobs of layers to the cache of allocation plans. States of layers which
+    // don't depend on shapes (fused layers, converted weights) are kept in place.
+    void storeAllocationPlan()
+    {
+        if (allocatedShapes.empty())
+            return;
+        if (!useAllocationCache())
+        {
+            allocationPlans.clear();
+            allocatedShapes.clear();
+            return;
+        }
+        CV_TRACE_FUNCTION();
+
+        // Plans are filled in place: copying of blobs arrays invalidates pointers to their elements.
+        allocationPlans.push_front(AllocationPlan());
+        AllocationPlan& plan = allocationPlans.front();
+        plan.inputShapes.swap(allocatedShapes);
+        plan.inputBlobs = &layers[0].outputBlobs[0];
+        plan.layers.resize(layers.size());
+        size_t i = 0;
+        for (MapIdToLayerData::iterator it = layers.begin(); it != layers.end(); ++it, ++i)
+        {
+            if (it->first == 0)
+                continue;
+            LayerData& ld = it->second;
+            LayerAllocation& la = plan.layers[i];
+            la.outputBlobs.swap(ld.outputBlobs);
+            la.inputBlobs.swap(ld.inputBlobs);
+            la.internals.swap(ld.internals);
+            la.skipFlags.swap(ld.skipFlags);
+        }
+        plan.layersStages.swap(layersStages);
+
+        // One more plan is the current one.
+        while (allocationPlans.size() >= allocationCacheSize)
+            allocationPlans.pop_back();
+    }
+
+    // Restores blobs of layers allocated for the given input shapes if they are in the cache.
+    bool loadAllocationPlan(const ShapesVec& inputShapes)
+    {
+        if (!useAllocationCache() || inputShapes.empty())
+            return false;
+
+        std::list<AllocationPlan>::iterator planIt = allocationPlans.begin();
+        for (; planIt != allocationPlans.end(); ++planIt)
+        {
+            if (planIt->inputShapes == inputShapes)
+                break;
+        }
+        if (planIt == allocationPlans.end())
+            return false;
+        if (planIt->inputBlobs != &layers[0].outputBlobs[0] || planIt->layers.size() != layers.size())
+        {
+            // The network inputs array is reallocated or layers are added.
+            allocationPlans.erase(planIt);
+            return false;
+        }
+        CV_TRACE_FUNCTION();
+
+        AllocationPlan& plan = *planIt;
+        size_t i = 0;
+        for (MapIdToLayerData::iterator it = layers.begin(); it != layers.end(); ++it, ++i)
+        {
+            if (it->first == 0)
+                continue;
+            LayerData& ld = it->second;
+            LayerAllocation& la = plan.layers[i];
+            ld.outputBlobs.swap(la.outputBlobs);
+            ld.inputBlobs.swap(la.inputBlobs);
+            ld.internals.swap(la.internals);
+            ld.skipFlags.swap(la.skipFlags);
+        }
+        layersStages.swap(plan.layersStages);
+        allocatedShapes.swap(plan.inputShapes);
+        allocationPlans.erase(planIt);
+
+        // Layers compute parameters which depend on shapes (paddings, strides) at finalization.
+        for (MapIdToLayerData::iterator it = layers.begin(); it != layers.end(); ++it)
+        {
+            LayerData& ld = it->second;
+            if (it->first != 0)
+                ld.getLayerInstance()->finalize(ld.inputBlobs, ld.outputBlobs);
+        }
+        return true;
+    }
+
     int getLayerId(const String &layerName)
     {
         std::map<String, int>::iterator it = layerNameToId.find(layerName);
@@ -1051,6 +1484,29 @@ struct Net::Impl
         }
     }
 
+    // Slices which are continuous in memory are not copied: outputs of the layer
+    // refer to the input blob which is kept until all the outputs are consumed.
+    bool allocateSliceViews(LayerData &ld, const LayerShapes& layerShapes)
+    {
+        if (preferableBackend != DNN_BACKEND_DEFAULT || preferableTarget != DNN_TARGET_CPU ||
+            ld.inputBlobs.size() != 1 || layerShapes.out.empty())
+            return false;
+        Ptr<SliceLayer> sliceLayer = ld.getLayerInstance().dynamicCast<SliceLayer>();
+        if (sliceLayer.empty())
+            return false;
+
+        std::vector<Mat> views(layerShapes.out.size());
+        sliceLayer->finalize(ld.inputBlobs, views);
+        for (size_t i = 0; i < views.size(); i++)
+        {
+            views[i] = (*ld.inputBlobs[0])(sliceLayer->sliceRanges[i]);
+            if (views[i].empty() || !views[i].isContinuous() || shape(views[i]) != layerShapes.out[i])
+                return false;
+        }
+        blobManager.allocateViews(ld, ld.inputBlobsId[0], views);
+        return true;
+    }
+
     void allocateLayer(int lid, const LayersShapesMap& layersShapes)
     {
         CV_TRACE_FUNCTION();
@@ -1112,7 +1568,8 @@ struct Net::Impl
 
         std::vector<LayerPin> pinsForInternalBlobs;
         bool maximizeReuse = preferableBackend == DNN_BACKEND_HALIDE;
-        blobManager.allocateBlobsForLayer(ld, layerShapesIt->second, pinsForInternalBlobs, maximizeReuse);
+        if (!allocateSliceViews(ld, layerShapesIt->second))
+            blobManager.allocateBlobsForLayer(ld, layerShapesIt->second, pinsForInternalBlobs, maximizeReuse);
         ld.outputBlobsWrappers.resize(ld.outputBlobs.size());
         for (int i = 0; i < ld.outputBlobs.size(); ++i)
         {
@@ -1378,18 +1835,17 @@ struct Net::Impl
             // (and so we eliminate the concatenation layer, because the channels
             // are concatenated implicitly).
             Ptr<ConcatLayer> concatLayer = ld.layerInstance.dynamicCast<ConcatLayer>();
-            if( !concatLayer.empty() && concatLayer->axis == 1 && !concatLayer->padding &&
-                ld.outputBlobs.size() == 1 )
+            if( !concatLayer.empty() && !concatLayer->padding && ld.outputBlobs.size() == 1 )
             {
                 Mat& output = ld.outputBlobs[0];
+                const int axis = clamp(concatLayer->axis, output.dims);
 
                 // TODO: in general, this optimization can always be done, but
                 // many layers currently check that the input/output blobs are
-                // continuous arrays. Unfortunately, this is not true when
-                // the concatenation optimization is applied with batch_size > 1.
-                // so, for now, we only apply this optimization in the most popular
-                // case batch_size == 1.
-                if( output.dims == 4 && output.size[0] == 1 )
+                // continuous arrays. Parts of the output are continuous only if
+                // all the dimensions before the concatenation axis are 1
+                // (i.e. batch_size == 1 for the most popular case of channels).
+                if( total(shape(output), 0, axis) == 1 )
                 {
                     size_t i, ninputs = ld.inputBlobsId.size();
                     std::vector<LayerPin> realinputs(ninputs);
@@ -1414,14 +1870,14 @@ struct Net::Impl
 
                     if( i >= ninputs )
                     {
-                        Range chrange[] = { Range::all(), Range::all(), Range::all(), Range::all() };
+                        std::vector<Range> chrange(output.dims, Range::all());
                         int ofs = 0;
                         for( i = 0; i < ninputs; i++ )
                         {
                             LayerPin pin = realinputs[i];
                             LayerData* inp_i_data = &layers[pin.lid];
-                            int channels_i = ld.inputBlobs[i]->size[1];
-                            chrange[1] = Range(ofs, ofs + channels_i);
+                            int channels_i = ld.inputBlobs[i]->size[axis];
+                            chrange[axis] = Range(ofs, ofs + channels_i);
                             printf_(("\toutput %s(%d) to channels (%d, %d)\n", inp_i_data->layerInstance->name.c_str(),
                                    pin.oid, ofs, ofs + channels_i));
                             ofs += channels_i;
@@ -1467,6 +1923,7 @@ struct Net::Impl
         blobManager.reset();
         blobManager.setPreferableTarget(preferableTarget);
         blobManager.setPreferableBackend(preferableBackend);
+        blobManager.setReuseEnabled(!useParallelLayers());
         backendWrappers.clear();
         // Fake references to input blobs.
         for (int i = 0; i < layers[0].outputBlobs.size(); ++i)
@@ -1490,74 +1947,302 @@ struct Net::Impl
 
         layersTimings.resize(lastLayerId + 1, 0);
         fuseLayers(blobsToKeep_);
+        applyWeightsType();
+
+        if (useBlockedLayout())
+            applyBlockedLayout(layersShapes, blobsToKeep_);
+
+        layersStages.clear();
+        if (useParallelLayers())
+            buildLayersStages(layersShapes);
     }
 
-    void forwardLayer(LayerData &ld)
+    // Converts weights of layers to the requested format. Layers of backends and targets
+    // which don't support FP16/BF16 weights are switched back to single precision.
+    void applyWeightsType()
     {
         CV_TRACE_FUNCTION();
 
-        Ptr<Layer> layer = ld.layerInstance;
+        int type = preferableBackend == DNN_BACKEND_DEFAULT && preferableTarget == DNN_TARGET_CPU ?
+                   weightsType : (int)DNN_WEIGHTS_FP32;
+        for (MapIdToLayerData::iterator it = layers.begin(); it != layers.end(); ++it)
+        {
+            LayerData& ld = it->second;
+            if (ld.id == 0 || ld.params.blobs.empty())
+                continue;
+            Ptr<Layer> layer = ld.getLayerInstance();
+            if (!dnn::setWeightsType(layer, type) || layer->blobs.empty())
+                continue;
+            // Drop references to the weights in the previous format to release the memory.
+            if (layer->blobs[0].depth() != ld.params.blobs[0].depth())
+                ld.params.blobs = layer->blobs;
+        }
+    }
 
-        TickMeter tm;
-        tm.start();
+    // Switches groups of connected layers which support NCHWc layout to it. Blobs are reordered
+    // only at the borders of the groups: by consumers which use a layout different from the producer's one.
+    // Fused layers and layers which outputs are requested keep NCHW layout.
+    void applyBlockedLayout(LayersShapesMap& layersShapes, const std::vector<LayerPin>& blobsToKeep_)
+    {
+        CV_TRACE_FUNCTION();
 
-        if (preferableBackend == DNN_BACKEND_DEFAULT ||
-            !layer->supportBackend(preferableBackend))
+        // Two 4-elements vectors or one 8-elements AVX vector.
+        const int blockSize = 8;
+
+        std::set<LayerPin> pinsToKeep(blobsToKeep_.begin(), blobsToKeep_.end());
+        std::set<int> blockedLayers;
+        MapIdToLayerData::iterator it;
+        for (it = layers.begin(); it != layers.end(); ++it)
         {
-            if( !ld.skipFlags[DNN_BACKEND_DEFAULT] )
+            LayerData &ld = it->second;
+            const LayerShapes& shapes = layersShapes[ld.id];
+            if (ld.id == 0 || ld.skipFlags[DNN_BACKEND_DEFAULT] || ld.consumers.empty() ||
+                shapes.in.empty() || !shapes.internal.empty())
+                continue;
+
+            bool supported = true;
+            for (size_t i = 0; i < shapes.in.size() && supported; i++)
+                supported = shapes.in[i].size() == 4;
+            for (size_t i = 0; i < shapes.out.size() && supported; i++)
+                supported = shapes.out[i].size() == 4 && !pinsToKeep.count(LayerPin(ld.id, i));
+            // Outputs of fused layers are shared with consumers.
+            for (size_t i = 0; i < ld.consumers.size() && supported; i++)
+                supported = !layers[ld.consumers[i].lid].skipFlags[DNN_BACKEND_DEFAULT];
+
+            if (supported && setBlockedLayout(ld.layerInstance, blockSize, shapes.in))
+                blockedLayers.insert(ld.id);
+        }
+
+        // Groups are kept if reorders of blobs are cheaper than layers computations.
+        std::set<int> visited, plainLayers;
+        for (std::set<int>::iterator lid = blockedLayers.begin(); lid != blockedLayers.end(); ++lid)
+        {
+            if (visited.count(*lid))
+                continue;
+
+            std::vector<int> group, queue(1, *lid);
+            int numReorders = 0;
+            visited.insert(*lid);
+            while (!queue.empty())
             {
-                for (int i = 0, n = ld.inputBlobsWrappers.size(); i < n; ++i)
+                LayerData &ld = layers[queue.back()];
+                queue.pop_back();
+                group.push_back(ld.id);
+
+                std::vector<int> neighbours;
+                for (size_t i = 0; i < ld.inputBlobsId.size(); i++)
+                    neighbours.push_back(ld.inputBlobsId[i].lid);
+                for (size_t i = 0; i < ld.consumers.size(); i++)
+                    neighbours.push_back(ld.consumers[i].lid);
+                for (size_t i = 0; i < neighbours.size(); i++)
                 {
-                    if (!ld.inputBlobsWrappers[i].empty())
-                        ld.inputBlobsWrappers[i]->copyToHost();
+                    int nid = neighbours[i];
+                    if (!blockedLayers.count(nid))
+                        numReorders += 1;
+                    else if (visited.insert(nid).second)
+                        queue.push_back(nid);
                 }
-                if (preferableBackend == DNN_BACKEND_DEFAULT && preferableTarget == DNN_TARGET_OPENCL)
-                    layer->forward(ld.umat_inputBlobs, ld.umat_outputBlobs, ld.umat_internals);
+            }
+            if ((int)group.size() <= numReorders)
+                plainLayers.insert(group.begin(), group.end());
+        }
+        for (std::set<int>::iterator lid = plainLayers.begin(); lid != plainLayers.end(); ++lid)
+        {
+            setBlockedLayout(layers[*lid].layerInstance, 0, std::vector<MatShape>());
+            blockedLayers.erase(*lid);
+        }
+        if (blockedLayers.empty())
+            return;
+
+        // Layers which work in-place keep sharing memory with producers.
+        std::set<int> inPlaceLayers;
+        for (std::set<int>::iterator lid = blockedLayers.begin(); lid != blockedLayers.end(); ++lid)
+        {
+            LayerData &ld = layers[*lid];
+            if (ld.inputBlobs.size() == 1 && ld.outputBlobs.size() == 1 &&
+                blockedLayers.count(ld.inputBlobsId[0].lid) &&
+                ld.inputBlobs[0]->data == ld.outputBlobs[0].data)
+                inPlaceLayers.insert(ld.id);
+        }
+
+        // Blocked outputs don't reuse memory of other blobs because they are bigger than plain ones.
+        for (std::set<int>::iterator lid = blockedLayers.begin(); lid != blockedLayers.end(); ++lid)
+        {
+            LayerData &ld = layers[*lid];
+            const LayerShapes& shapes = layersShapes[ld.id];
+            ld.blockSize = blockSize;
+            ld.plainOutputShapes = shapes.out;
+            for (size_t i = 0; i < ld.outputBlobs.size(); i++)
+            {
+                if (inPlaceLayers.count(ld.id))
+                    ld.outputBlobs[i] = *ld.inputBlobs[0];
                 else
-                    layer->forward(ld.inputBlobs, ld.outputBlobs, ld.internals);
-                for (int i = 0, n = ld.outputBlobsWrappers.size(); i < n; ++i)
-                {
-                    if (!ld.outputBlobsWrappers[i].empty())
-                        ld.outputBlobsWrappers[i]->setHostDirty();
-                }
+                    ld.outputBlobs[i] = Mat(getBlockedShape(shapes.out[i], blockSize), CV_32F);
             }
-            else
-                tm.reset();
         }
-        else if (!ld.skipFlags[preferableBackend])
+
+        for (it = layers.begin(); it != layers.end(); ++it)
         {
-            Ptr<BackendNode> node = ld.backendNodes[preferableBackend];
-            if (preferableBackend == DNN_BACKEND_HALIDE)
+            LayerData &ld = it->second;
+            if (ld.skipFlags[DNN_BACKEND_DEFAULT])
+                continue;
+
+            const LayerShapes& shapes = layersShapes[ld.id];
+            for (size_t i = 0; i < ld.inputBlobsId.size(); i++)
             {
-                forwardHalide(ld.outputBlobsWrappers, node);
+                if (layers[ld.inputBlobsId[i].lid].blockSize == ld.blockSize)
+                    continue;
+
+                ld.reorderedInputs.resize(ld.inputBlobsId.size());
+                ld.reorderedInputsOrigins.resize(ld.inputBlobsId.size(), 0);
+                MatShape inpShape = ld.blockSize ? getBlockedShape(shapes.in[i], ld.blockSize) : shapes.in[i];
+                ld.reorderedInputs[i].create(inpShape, CV_32F);
+                ld.reorderedInputsOrigins[i] = ld.inputBlobs[i];
             }
-            else
+            for (size_t i = 0; i < ld.reorderedInputs.size(); i++)
             {
-                CV_Error(Error::StsNotImplemented, "Unknown backend identifier");
+                if (!ld.reorderedInputs[i].empty())
+                    ld.inputBlobs[i] = &ld.reorderedInputs[i];
             }
         }
-
-        tm.stop();
-        layersTimings[ld.id] = tm.getTimeTicks();
-
-        ld.flag = 1;
     }
 
-    void forwardToLayer(LayerData &ld, bool clearFlags = true)
+    // Splits layers into stages so every layer depends only on layers from the previous stages.
+    // Layers of the same stage are computed concurrently if they are cheap enough. Heavy layers
+    // are computed one by one because they use all the threads by themselves and
+    // nested parallel_for_ calls are executed sequentially.
+    void buildLayersStages(LayersShapesMap& layersShapes)
     {
         CV_TRACE_FUNCTION();
 
-        if (clearFlags)
-        {
-            MapIdToLayerData::iterator it;
-            for (it = layers.begin(); it != layers.end(); it++)
-                it->second.flag = 0;
-        }
+        const int64 maxConcurrentLayerCost = 1 << 23;
 
-        //already was forwarded
-        if (ld.flag)
+        std::map<int, int> layerStage;
+        std::vector<std::vector<int> > stages;
+        MapIdToLayerData::iterator it;
+        for (it = layers.begin(); it != layers.end(); ++it)
+        {
+            LayerData &ld = it->second;
+            if (ld.id == 0)
+                continue;
+
+            int stage = 0;
+            for (size_t i = 0; i < ld.inputBlobsId.size(); i++)
+            {
+                std::map<int, int>::iterator parentIt = layerStage.find(ld.inputBlobsId[i].lid);
+                if (parentIt != layerStage.end())
+                    stage = std::max(stage, parentIt->second + 1);
+            }
+            layerStage[ld.id] = stage;
+            if ((int)stages.size() <= stage)
+                stages.resize(stage + 1);
+            // Skipped layers have nothing to compute.
+            if (!ld.skipFlags[DNN_BACKEND_DEFAULT])
+                stages[stage].push_back(ld.id);
+        }
+
+        for (size_t i = 0; i < stages.size(); i++)
+        {
+            std::vector<int> cheapLayers;
+            for (size_t j = 0; j < stages[i].size(); j++)
+            {
+                int lid = stages[i][j];
+                const LayerShapes& shapes = layersShapes[lid];
+                int64 cost = layers[lid].getLayerInstance()->getFLOPS(shapes.in, shapes.out);
+                for (size_t k = 0; k < shapes.out.size(); k++)
+                    cost = std::max(cost, (int64)total(shapes.out[k]));
+
+                if (cost > maxConcurrentLayerCost || stages[i].size() == 1)
+                    layersStages.push_back(std::vector<int>(1, lid));
+                else
+                    cheapLayers.push_back(lid);
+            }
+            if (!cheapLayers.empty())
+                layersStages.push_back(cheapLayers);
+        }
+    }
+
+    void forwardLayer(LayerData &ld)
+    {
+        CV_TRACE_FUNCTION();
+
+        Ptr<Layer> layer = ld.layerInstance;
+
+        TickMeter tm;
+        tm.start();
+
+        if (preferableBackend == DNN_BACKEND_DEFAULT ||
+            !layer->supportBackend(preferableBackend))
+        {
+            if( !ld.skipFlags[DNN_BACKEND_DEFAULT] )
+            {
+                for (int i = 0, n = ld.inputBlobsWrappers.size(); i < n; ++i)
+                {
+                    if (!ld.inputBlobsWrappers[i].empty())
+                        ld.inputBlobsWrappers[i]->copyToHost();
+                }
+                for (size_t i = 0; i < ld.reorderedInputs.size(); ++i)
+                {
+                    if (ld.reorderedInputs[i].empty())
+                        continue;
+                    if (ld.blockSize)
+                        BlockedLayoutReorder::toBlocked(*ld.reorderedInputsOrigins[i], ld.reorderedInputs[i]);
+                    else
+                        BlockedLayoutReorder::toPlain(*ld.reorderedInputsOrigins[i], ld.reorderedInputs[i]);
+                }
+                if (preferableBackend == DNN_BACKEND_DEFAULT && preferableTarget == DNN_TARGET_OPENCL)
+                    layer->forward(ld.umat_inputBlobs, ld.umat_outputBlobs, ld.umat_internals);
+                else
+                    layer->forward(ld.inputBlobs, ld.outputBlobs, ld.internals);
+                for (int i = 0, n = ld.outputBlobsWrappers.size(); i < n; ++i)
+                {
+                    if (!ld.outputBlobsWrappers[i].empty())
+                        ld.outputBlobsWrappers[i]->setHostDirty();
+                }
+            }
+            else
+                tm.reset();
+        }
+        else if (!ld.skipFlags[preferableBackend])
+        {
+            Ptr<BackendNode> node = ld.backendNodes[preferableBackend];
+            if (preferableBackend == DNN_BACKEND_HALIDE)
+            {
+                forwardHalide(ld.outputBlobsWrappers, node);
+            }
+            else
+            {
+                CV_Error(Error::StsNotImplemented, "Unknown backend identifier");
+            }
+        }
+
+        tm.stop();
+        layersTimings[ld.id] = tm.getTimeTicks();
+
+        ld.flag = 1;
+    }
+
+    void forwardToLayer(LayerData &ld, bool clearFlags = true)
+    {
+        CV_TRACE_FUNCTION();
+
+        if (clearFlags)
+        {
+            MapIdToLayerData::iterator it;
+            for (it = layers.begin(); it != layers.end(); it++)
+                it->second.flag = 0;
+        }
+
+        //already was forwarded
+        if (ld.flag)
             return;
 
+        if (useParallelLayers())
+        {
+            forwardLayersParallel(ld);
+            return;
+        }
+
         //forward parents
         MapIdToLayerData::iterator it;
         for (it = layers.begin(); it != layers.end() && (it->second.id < ld.id); ++it)
@@ -1572,6 +2257,79 @@ struct Net::Impl
         forwardLayer(ld);
     }
 
+    class ParallelLayersInvoker : public ParallelLoopBody
+    {
+    public:
+        ParallelLayersInvoker(Impl* net_, const std::vector<LayerData*>& stage_)
+            : net(net_), stage(stage_) {}
+
+        void operator()(const Range& r) const
+        {
+            for (int i = r.start; i < r.end; i++)
+                net->forwardLayer(*stage[i]);
+        }
+
+    private:
+        Impl* net;
+        const std::vector<LayerData*>& stage;
+    };
+
+    // Copies the blob to the <oid> output of the network inputs layer.
+    void setInputBlob(int oid, const Mat& blob)
+    {
+        LayerData &ld = layers[0];
+        ld.outputBlobs.resize( std::max(oid+1, (int)ld.requiredOutputs.size()) );
+        bool use_umat = (preferableBackend == DNN_BACKEND_DEFAULT &&
+                         preferableTarget == DNN_TARGET_OPENCL);
+        if (use_umat)
+            ld.umat_outputBlobs.resize( std::max(oid+1, (int)ld.requiredOutputs.size()) );
+        ld.outputBlobsWrappers.resize(ld.outputBlobs.size());
+        MatShape prevShape = shape(ld.outputBlobs[oid]);
+        bool oldShape = prevShape == shape(blob);
+        if (oldShape)
+        {
+            blob.copyTo(ld.outputBlobs[oid]);
+            if (use_umat)
+                blob.copyTo(ld.umat_outputBlobs[oid]);
+        }
+        else
+        {
+            ld.outputBlobs[oid] = blob.clone();
+            if (use_umat)
+                blob.copyTo(ld.umat_outputBlobs[oid]);
+        }
+
+        if (!ld.outputBlobsWrappers[oid].empty())
+        {
+            ld.outputBlobsWrappers[oid]->setHostDirty();
+        }
+        netWasAllocated = netWasAllocated && oldShape;
+    }
+
+    // Computes layers up to the <ld> using stages from buildLayersStages.
+    void forwardLayersParallel(LayerData &ld)
+    {
+        CV_TRACE_FUNCTION();
+
+        std::vector<LayerData*> stage;
+        for (size_t i = 0; i < layersStages.size(); i++)
+        {
+            stage.clear();
+            for (size_t j = 0; j < layersStages[i].size(); j++)
+            {
+                LayerData &ld_j = layers[layersStages[i][j]];
+                if (ld_j.id <= ld.id && !ld_j.flag)
+                    stage.push_back(&ld_j);
+            }
+            if (stage.size() == 1)
+                forwardLayer(*stage[0]);
+            else if (stage.size() > 1)
+                parallel_for_(Range(0, (int)stage.size()), ParallelLayersInvoker(this, stage), (double)stage.size());
+        }
+        if (ld.skipFlags[DNN_BACKEND_DEFAULT])
+            ld.flag = 1;
+    }
+
     void forwardAll()
     {
         CV_TRACE_FUNCTION();
@@ -1663,6 +2421,12 @@ struct Net::Impl
         if (ld.umat_outputBlobs.size() > 0 && !ld.umat_outputBlobs[pin.oid].empty())
             ld.umat_outputBlobs[pin.oid].copyTo(ld.outputBlobs[pin.oid]);
 
+        if (ld.blockSize)
+        {
+            Mat plain(ld.plainOutputShapes[pin.oid], CV_32F);
+            BlockedLayoutReorder::toPlain(ld.outputBlobs[pin.oid], plain);
+            return plain;
+        }
         return ld.outputBlobs[pin.oid];
     }
 
@@ -1760,6 +2524,7 @@ void Net::connect(String _outPin, String _inPin)
 Mat Net::forward(const String& outputName)
 {
     CV_TRACE_FUNCTION();
+    AutoLock lock(impl->forwardMutex);
 
     String layerName = outputName;
 
@@ -1775,6 +2540,7 @@ Mat Net::forward(const String& outputName)
 void Net::forward(OutputArrayOfArrays outputBlobs, const String& outputName)
 {
     CV_TRACE_FUNCTION();
+    AutoLock lock(impl->forwardMutex);
 
     impl->setUpNet();
 
@@ -1825,6 +2591,7 @@ void Net::forward(OutputArrayOfArrays outputBlobs,
                   const std::vector<String>& outBlobNames)
 {
     CV_TRACE_FUNCTION();
+    AutoLock lock(impl->forwardMutex);
 
     std::vector<LayerPin> pins;
     for (int i = 0; i < outBlobNames.size(); i++)
@@ -1852,6 +2619,7 @@ void Net::forward(std::vector<std::vector<Mat> >& outputBlobs,
                      const std::vector<String>& outBlobNames)
 {
     CV_TRACE_FUNCTION();
+    AutoLock lock(impl->forwardMutex);
 
     std::vector<LayerPin> pins;
     for (int i = 0; i < outBlobNames.size(); i++)
@@ -1870,17 +2638,63 @@ void Net::forward(std::vector<std::vector<Mat> >& outputBlobs,
     for (int i = 0; i < outBlobNames.size(); i++)
     {
         std::vector<LayerPin> lp = impl->getLayerOutPins(outBlobNames[i]);
-        for (int i = 0; i < lp.size(); i++)
+        for (int j = 0; j < lp.size(); j++)
         {
-            outputBlobs[i].push_back(impl->getBlob(lp[i]));
+            outputBlobs[i].push_back(impl->getBlob(lp[j]));
         }
     }
 }
 
+#ifdef CV_CXX11
+std::future<Mat> Net::forwardAsync(const String& outputName)
+{
+    CV_TRACE_FUNCTION();
+
+    String layerName = outputName;
+
+    if (layerName.empty())
+        layerName = getLayerNames().back();
+
+    // Capture current inputs to let user set the next ones without waiting.
+    std::vector<Mat> inputs;
+    {
+        AutoLock lock(impl->forwardMutex);
+        const std::vector<Mat>& netInputs = impl->layers[0].outputBlobs;
+        inputs.resize(netInputs.size());
+        for (size_t i = 0; i < netInputs.size(); i++)
+            netInputs[i].copyTo(inputs[i]);
+    }
+
+    Ptr<Impl> impl_ = impl;
+    return std::async(std::launch::async, [impl_, inputs, layerName]() -> Mat
+    {
+        AutoLock lock(impl_->forwardMutex);
+        // Inputs which are set at the moment belong to the next synchronous forward
+        // so they are restored after the request is computed.
+        const std::vector<Mat>& netInputs = impl_->layers[0].outputBlobs;
+        CV_Assert(netInputs.size() == inputs.size());
+        std::vector<Mat> pendingInputs(netInputs.size());
+        for (size_t i = 0; i < netInputs.size(); i++)
+            netInputs[i].copyTo(pendingInputs[i]);
+
+        for (size_t i = 0; i < inputs.size(); i++)
+            impl_->setInputBlob((int)i, inputs[i]);
+        impl_->setUpNet();
+        impl_->forwardToLayer(impl_->getLayerData(layerName));
+        Mat out = impl_->getBlob(layerName).clone();
+
+        for (size_t i = 0; i < pendingInputs.size(); i++)
+            impl_->setInputBlob((int)i, pendingInputs[i]);
+        return out;
+    });
+}
+#endif
+
 void Net::setPreferableBackend(int backendId)
 {
     CV_TRACE_FUNCTION();
     CV_TRACE_ARG(backendId);
+    AutoLock lock(impl->forwardMutex);
 
     if( impl->preferableBackend != backendId )
     {
@@ -1895,6 +2709,7 @@ void Net::setPreferableTarget(int targetId)
 {
     CV_TRACE_FUNCTION();
     CV_TRACE_ARG(targetId);
+    AutoLock lock(impl->forwardMutex);
 
     if( impl->preferableTarget != targetId )
     {
@@ -1908,6 +2723,7 @@ void Net::setPreferableTarget(int targetId)
 void Net::setInputsNames(const std::vector<String> &inputBlobNames)
 {
     CV_TRACE_FUNCTION();
+    AutoLock lock(impl->forwardMutex);
 
     impl->netInputLayer->setNames(inputBlobNames);
 }
@@ -1916,6 +2732,7 @@ void Net::setInput(InputArray blob, const String& name)
 {
     CV_TRACE_FUNCTION();
     CV_TRACE_ARG_VALUE(name, "name", name.c_str());
+    AutoLock lock(impl->forwardMutex);
 
     LayerPin pin;
     pin.lid = 0;
@@ -1924,34 +2741,7 @@ void Net::setInput(InputArray blob, const String& name)
     if (!pin.valid())
         CV_Error(Error::StsObjectNotFound, "Requested blob \"" + name + "\" not found");
 
-    LayerData &ld = impl->layers[pin.lid];
-    ld.outputBlobs.resize( std::max(pin.oid+1, (int)ld.requiredOutputs.size()) );
-    bool use_umat = (impl->preferableBackend == DNN_BACKEND_DEFAULT &&
-                     impl->preferableTarget == DNN_TARGET_OPENCL);
-    if (use_umat)
-        ld.umat_outputBlobs.resize( std::max(pin.oid+1, (int)ld.requiredOutputs.size()) );
-    ld.outputBlobsWrappers.resize(ld.outputBlobs.size());
-    MatShape prevShape = shape(ld.outputBlobs[pin.oid]);
-    Mat blob_ = blob.getMat();
-    bool oldShape = prevShape == shape(blob_);
-    if (oldShape)
-    {
-        blob_.copyTo(ld.outputBlobs[pin.oid]);
-        if (use_umat)
-            blob_.copyTo(ld.umat_outputBlobs[pin.oid]);
-    }
-    else
-    {
-        ld.outputBlobs[pin.oid] = blob_.clone();
-        if (use_umat)
-            blob_.copyTo(ld.umat_outputBlobs[pin.oid]);
-    }
-
-    if (!ld.outputBlobsWrappers[pin.oid].empty())
-    {
-        ld.outputBlobsWrappers[pin.oid]->setHostDirty();
-    }
-    impl->netWasAllocated = impl->netWasAllocated && oldShape;
+    impl->setInputBlob(pin.oid, blob.getMat());
 }
 
 Mat Net::getParam(LayerId layer, int numParam)
@@ -1965,6 +2755,7 @@ Mat Net::getParam(LayerId layer, int numParam)
 
 void Net::setParam(LayerId layer, int numParam, const Mat &blob)
 {
+    AutoLock lock(impl->forwardMutex);
     LayerData &ld = impl->getLayerData(layer);
 
     std::vector<Mat> &layerBlobs = ld.layerInstance->blobs;
@@ -2269,6 +3060,7 @@ void Net::getMemoryConsumption(const MatShape& netInputShape, std::vector<int>&
 
 void Net::enableFusion(bool fusion)
 {
+    AutoLock lock(impl->forwardMutex);
     if( impl->fusion != fusion )
     {
         impl->fusion = fusion;
@@ -2277,11 +3069,471 @@ void Net::enableFusion(bool fusion)
     }
 }
 
+void Net::enableParallelLayers(bool parallel)
+{
+    AutoLock lock(impl->forwardMutex);
+    if( impl->parallelLayers != parallel )
+    {
+        impl->parallelLayers = parallel;
+        impl->netWasAllocated = false;
+        impl->clear();
+    }
+}
+
+void Net::setWeightsType(int weightsType)
+{
+    CV_Assert(weightsType == DNN_WEIGHTS_FP32 || weightsType == DNN_WEIGHTS_FP16 ||
+              weightsType == DNN_WEIGHTS_BF16);
+    AutoLock lock(impl->forwardMutex);
+    if( impl->weightsType != weightsType )
+    {
+        impl->weightsType = weightsType;
+        impl->netWasAllocated = false;
+        impl->clear();
+    }
+}
+
+void Net::setAllocationCacheSize(int size)
+{
+    AutoLock lock(impl->forwardMutex);
+    impl->allocationCacheSize = (size_t)std::max(size, 0);
+    // One more plan is the current one.
+    while (!impl->allocationPlans.empty() && impl->allocationPlans.size() >= impl->allocationCacheSize)
+        impl->allocationPlans.pop_back();
+}
+
+void Net::preallocate(const std::vector<std::vector<MatShape> >& inputShapes,
+                      const std::vector<String>& outBlobNames)
+{
+    CV_TRACE_FUNCTION();
+    AutoLock lock(impl->forwardMutex);
+
+    std::vector<LayerPin> pins;
+    for (size_t i = 0; i < outBlobNames.size(); i++)
+        pins.push_back(impl->getPinByAlias(outBlobNames[i]));
+
+    if (impl->allocationCacheSize > 1)
+        impl->allocationCacheSize = std::max(impl->allocationCacheSize, inputShapes.size() + 1);
+
+    std::vector<Mat> inputs = impl->layers[0].outputBlobs;
+    for (size_t i = 0; i < inputShapes.size(); i++)
+    {
+        for (size_t j = 0; j < inputShapes[i].size(); j++)
+            impl->setInputBlob((int)j, Mat(inputShapes[i][j], CV_32F, Scalar(0)));
+        impl->setUpNet(pins);
+    }
+
+    // Restore the inputs. The net is set up again for them by the next forward pass.
+    std::vector<Mat>& inputBlobs = impl->layers[0].outputBlobs;
+    for (size_t i = 0; i < inputs.size() && i < inputBlobs.size(); i++)
+    {
+        if (shape(inputBlobs[i]) != shape(inputs[i]))
+            impl->netWasAllocated = false;
+        inputBlobs[i] = inputs[i];
+    }
+}
+
+void Net::enableBlockedLayout(bool blocked)
+{
+    AutoLock lock(impl->forwardMutex);
+    if( impl->blockedLayout != blocked )
+    {
+        impl->blockedLayout = blocked;
+        impl->netWasAllocated = false;
+        impl->clear();
+    }
+}
+
+namespace
+{
+    const char optimizedNetSignature[8] = {'C', 'V', 'D', 'N', 'N', 'O', 'P', 'T'};
+    const int optimizedNetVersion = 1;
+    // Blobs data is aligned in the file to be used directly from the memory mapping.
+    const size_t optimizedNetAlignment = 64;
+
+    class OptimizedNetWriter
+    {
+    public:
+        OptimizedNetWriter(const String& path)
+            : ofs(path.c_str(), std::ios::out | std::ios::binary), pos(0)
+        {
+            if (!ofs.is_open())
+                CV_Error(Error::StsError, "Failed to create file " + path);
+        }
+
+        void write(const void* data, size_t size)
+        {
+            ofs.write((const char*)data, size);
+            pos += size;
+        }
+
+        void writeInt(int v) { write(&v, sizeof(v)); }
+
+        void writeString(const String& str)
+        {
+            writeInt((int)str.size());
+            write(str.c_str(), str.size());
+        }
+
+        void writeDictValue(const DictValue& v)
+        {
+            int n = v.size();
+            if (v.isInt())
+            {
+                writeInt(Param::INT);
+                writeInt(n);
+                for (int i = 0; i < n; i++)
+                {
+                    int64 value = v.get<int64>(i);
+                    write(&value, sizeof(value));
+                }
+            }
+            else if (v.isString())
+            {
+                writeInt(Param::STRING);
+                writeInt(n);
+                for (int i = 0; i < n; i++)
+                    writeString(v.get<String>(i));
+            }
+            else
+            {
+                CV_Assert(v.isReal());
+                writeInt(Param::REAL);
+                writeInt(n);
+                for (int i = 0; i < n; i++)
+                {
+                    double value = v.get<double>(i);
+                    write(&value, sizeof(value));
+                }
+            }
+        }
+
+        void writeBlob(const Mat& blob_)
+        {
+            Mat blob = blob_.isContinuous() ? blob_ : blob_.clone();
+            writeInt(blob.type());
+            writeInt(blob.dims);
+            for (int i = 0; i < blob.dims; i++)
+                writeInt(blob.size[i]);
+
+            static const char zeros[optimizedNetAlignment] = {0};
+            write(zeros, alignSize(pos, (int)optimizedNetAlignment) - pos);
+            write(blob.data, blob.total() * blob.elemSize());
+        }
+
+    private:
+        std::ofstream ofs;
+        size_t pos;
+    };
+
+    class OptimizedNetReader
+    {
+    public:
+        OptimizedNetReader(const Ptr<FileMapping>& mapping_)
+            : mapping(mapping_), data(mapping_->data()), size(mapping_->size()), pos(0) {}
+
+        const uchar* read(size_t n)
+        {
+            if (n > size - pos)
+                CV_Error(Error::StsParseError, "Unexpected end of the optimized network file");
+            const uchar* ptr = data + pos;
+            pos += n;
+            return ptr;
+        }
+
+        int readInt()
+        {
+            int v;
+            memcpy(&v, read(sizeof(v)), sizeof(v));
+            return v;
+        }
+
+        String readString()
+        {
+            int n = readInt();
+            CV_Assert(n >= 0);
+            const char* str = (const char*)read(n);
+            return String(str, str + n);
+        }
+
+        // Arrays may be empty, e.g. a parameter set from an empty list.
+        DictValue readDictValue()
+        {
+            int type = readInt();
+            int n = readInt();
+            if (n < 0)
+                CV_Error(Error::StsParseError, "Invalid parameter size in the optimized network file");
+            if (type == Param::INT)
+            {
+                const uchar* ptr = read(n * sizeof(int64));
+                std::vector<int64> values(n);
+                if (n > 0)
+                    memcpy(&values[0], ptr, n * sizeof(int64));
+                return DictValue::arrayInt(values.begin(), n);
+            }
+            else if (type == Param::STRING)
+            {
+                // Every string takes at least its length.
+                if ((size_t)n > (size - pos) / sizeof(int))
+                    CV_Error(Error::StsParseError, "Unexpected end of the optimized network file");
+                std::vector<String> values(n);
+                for (int i = 0; i < n; i++)
+                    values[i] = readString();
+                return DictValue::arrayString(values.begin(), n);
+            }
+            if (type != Param::REAL)
+                CV_Error(Error::StsParseError, "Invalid parameter type in the optimized network file");
+            const uchar* ptr = read(n * sizeof(double));
+            std::vector<double> values(n);
+            if (n > 0)
+                memcpy(&values[0], ptr, n * sizeof(double));
+            return DictValue::arrayReal(values.begin(), n);
+        }
+
+        // Returned blob refers to the file data and keeps the mapping alive.
+        Mat readBlob()
+        {
+            int type = readInt();
+            int dims = readInt();
+            if (type != CV_MAT_TYPE(type) || 0 >= dims || dims > CV_MAX_DIM)
+                CV_Error(Error::StsParseError, "Invalid blob header in the optimized network file");
+            int sizes[CV_MAX_DIM];
+            for (int i = 0; i < dims; i++)
+            {
+                sizes[i] = readInt();
+                if (sizes[i] < 0)
+                    CV_Error(Error::StsParseError, "Invalid blob shape in the optimized network file");
+            }
+            read(alignSize(pos, (int)optimizedNetAlignment) - pos);
+
+            // Check the blob size in terms of remaining bytes to avoid overflows.
+            size_t available = (size - pos) / CV_ELEM_SIZE(type);
+            size_t total = 1;
+            for (int i = 0; i < dims && total != 0; i++)
+            {
+                if (sizes[i] != 0 && total > available / sizes[i])
+                    CV_Error(Error::StsParseError, "Unexpected end of the optimized network file");
+                total *= sizes[i];
+            }
+            const uchar* blobData = read(total * CV_ELEM_SIZE(type));
+            return wrapMappedData(mapping, blobData, dims, sizes, type);
+        }
+
+    private:
+        Ptr<FileMapping> mapping;
+        uchar* data;
+        size_t size, pos;
+    };
+}
+
+// Weights of layers may be kept in FP16 or BF16 formats (see Net::setWeightsType).
+static Mat toFloatBlob(const Mat& blob)
+{
+    if (blob.depth() != CV_16S && blob.depth() != CV_16U)
+        return blob;
+    Mat floatBlob;
+    convertWeights(blob, floatBlob, CV_32F);
+    return floatBlob;
+}
+
+void Net::writeOptimized(const String& path)
+{
+    CV_TRACE_FUNCTION();
+    CV_TRACE_ARG_VALUE(path, "path", path.c_str());
+
+    AutoLock lock(impl->forwardMutex);
+
+    // Fuse batch normalization and scaling layers into the preceding convolutions.
+    std::map<int, std::vector<Mat> > fusedBlobs;
+    std::map<int, LayerPin> replacedOutputs;
+    Impl::MapIdToLayerData::iterator it;
+    for (it = impl->layers.begin(); it != impl->layers.end(); ++it)
+    {
+        LayerData& ld = it->second;
+        if (ld.id == 0 || ld.type != "Convolution" || ld.params.blobs.empty())
+            continue;
+
+        Mat weights, bias;
+        LayerData* last = &ld;
+        while (last->consumers.size() == 1)
+        {
+            LayerData& next = impl->layers[last->consumers[0].lid];
+            // Keep network outputs to let them be requested by name.
+            if (next.inputBlobsId.size() != 1 || next.consumers.empty())
+                break;
+
+            Ptr<Layer> nextLayer = next.getLayerInstance();
+            Ptr<BatchNormLayer> bnormLayer = nextLayer.dynamicCast<BatchNormLayer>();
+            Ptr<ScaleLayer> scaleLayer = nextLayer.dynamicCast<ScaleLayer>();
+            Mat scale, shift;
+            if (!bnormLayer.empty())
+                bnormLayer->getScaleShift(scale, shift);
+            else if (!scaleLayer.empty() && !scaleLayer->blobs.empty())
+            {
+                scale = scaleLayer->blobs[0];
+                if (scaleLayer->hasBias)
+                    shift = scaleLayer->blobs[1];
+            }
+            else
+                break;
+
+            int outCn = ld.params.blobs[0].size[0];
+            if (scale.type() != CV_32F || scale.total() != (size_t)outCn ||
+                (!shift.empty() && (shift.type() != CV_32F || shift.total() != (size_t)outCn)))
+                break;
+
+            if (weights.empty())
+            {
+                weights = toFloatBlob(ld.params.blobs[0]).clone();
+                if (ld.params.blobs.size() > 1)
+                    ld.params.blobs[1].reshape(1, 1).copyTo(bias);
+                else
+                    bias = Mat::zeros(1, outCn, CV_32F);
+            }
+            CV_Assert(weights.type() == CV_32F && bias.type() == CV_32F);
+
+            Mat weights2d = weights.reshape(1, outCn);
+            scale = scale.reshape(1, 1);
+            for (int i = 0; i < outCn; i++)
+            {
+                float s = scale.at<float>(i);
+                weights2d.row(i) *= s;
+                bias.at<float>(i) = bias.at<float>(i) * s + (shift.empty() ? 0.f : shift.reshape(1, 1).at<float>(i));
+            }
+            replacedOutputs[next.id] = LayerPin(ld.id, 0);
+            last = &next;
+        }
+        if (!weights.empty())
+        {
+            fusedBlobs[ld.id].push_back(weights);
+            fusedBlobs[ld.id].push_back(bias.reshape(1, weights.size[0]));
+        }
+    }
+
+    // Ids of stored layers are sequential.
+    std::map<int, int> newIds;
+    newIds[0] = 0;
+    for (it = impl->layers.begin(); it != impl->layers.end(); ++it)
+    {
+        if (it->first != 0 && replacedOutputs.find(it->first) == replacedOutputs.end())
+            newIds.insert(std::make_pair(it->first, (int)newIds.size()));
+    }
+
+    OptimizedNetWriter writer(path);
+    writer.write(optimizedNetSignature, sizeof(optimizedNetSignature));
+    writer.writeInt(optimizedNetVersion);
+
+    const std::vector<String>& inputsNames = impl->netInputLayer->getNames();
+    writer.writeInt((int)inputsNames.size());
+    for (size_t i = 0; i < inputsNames.size(); i++)
+        writer.writeString(inputsNames[i]);
+
+    writer.writeInt((int)newIds.size() - 1);
+    for (it = impl->layers.begin(); it != impl->layers.end(); ++it)
+    {
+        LayerData& ld = it->second;
+        if (ld.id == 0 || newIds.find(ld.id) == newIds.end())
+            continue;
+
+        writer.writeString(ld.name);
+        writer.writeString(ld.type);
+
+        int numParams = (int)std::distance(ld.params.begin(), ld.params.end());
+        std::map<int, std::vector<Mat> >::iterator fusedIt = fusedBlobs.find(ld.id);
+        bool fused = fusedIt != fusedBlobs.end();
+        bool addBiasTerm = fused && !ld.params.has("bias_term");
+        writer.writeInt(numParams + (int)addBiasTerm);
+        for (std::map<String, DictValue>::const_iterator paramIt = ld.params.begin();
+             paramIt != ld.params.end(); ++paramIt)
+        {
+            writer.writeString(paramIt->first);
+            writer.writeDictValue(fused && paramIt->first == "bias_term" ? DictValue(1) : paramIt->second);
+        }
+        if (addBiasTerm)
+        {
+            writer.writeString("bias_term");
+            writer.writeDictValue(DictValue(1));
+        }
+
+        const std::vector<Mat>& blobs = fused ? fusedIt->second : ld.params.blobs;
+        writer.writeInt((int)blobs.size());
+        for (size_t i = 0; i < blobs.size(); i++)
+            writer.writeBlob(toFloatBlob(blobs[i]));
+
+        writer.writeInt((int)ld.inputBlobsId.size());
+        for (size_t i = 0; i < ld.inputBlobsId.size(); i++)
+        {
+            LayerPin pin = ld.inputBlobsId[i];
+            std::map<int, LayerPin>::iterator replacedIt = replacedOutputs.find(pin.lid);
+            if (replacedIt != replacedOutputs.end())
+                pin = replacedIt->second;
+            CV_Assert(newIds.find(pin.lid) != newIds.end());
+            writer.writeInt(newIds[pin.lid]);
+            writer.writeInt(pin.oid);
+        }
+    }
+}
+
+Net readNetFromOptimized(const String &path)
+{
+    CV_TRACE_FUNCTION();
+    CV_TRACE_ARG_VALUE(path, "path", path.c_str());
+
+    OptimizedNetReader reader(Ptr<FileMapping>(new FileMapping(path)));
+
+    if (memcmp(reader.read(sizeof(optimizedNetSignature)), optimizedNetSignature,
+               sizeof(optimizedNetSignature)) != 0)
+        CV_Error(Error::StsParseError, "File " + path + " isn't an optimized network");
+    int version = reader.readInt();
+    if (version != optimizedNetVersion)
+        CV_Error(Error::StsNotImplemented, format("Unsupported version %d of the optimized network file", version));
+
+    Net net;
+    int numInputsNames = reader.readInt();
+    CV_Assert(numInputsNames >= 0);
+    std::vector<String> inputsNames(numInputsNames);
+    for (size_t i = 0; i < inputsNames.size(); i++)
+        inputsNames[i] = reader.readString();
+    net.setInputsNames(inputsNames);
+
+    int numLayers = reader.readInt();
+    for (int i = 0; i < numLayers; i++)
+    {
+        LayerParams lp;
+        String name = reader.readString();
+        String type = reader.readString();
+
+        int numParams = reader.readInt();
+        for (int j = 0; j < numParams; j++)
+        {
+            String key = reader.readString();
+            lp.set(key, reader.readDictValue());
+        }
+
+        lp.blobs.resize(reader.readInt());
+        for (size_t j = 0; j < lp.blobs.size(); j++)
+            lp.blobs[j] = reader.readBlob();
+
+        int id = net.addLayer(name, type, lp);
+        CV_Assert(id == i + 1);
+
+        int numInputs = reader.readInt();
+        for (int j = 0; j < numInputs; j++)
+        {
+            int inpLayerId = reader.readInt();
+            int inpOutputId = reader.readInt();
+            net.connect(inpLayerId, inpOutputId, id, j);
+        }
+    }
+    return net;
+}
+
 void Net::setHalideScheduler(const String& scheduler)
 {
     CV_TRACE_FUNCTION();
     CV_TRACE_ARG_VALUE(scheduler, "scheduler", scheduler.c_str());
 
+    AutoLock lock(impl->forwardMutex);
     impl->halideConfigFile = scheduler;
 }
 
@@ -2292,6 +3544,155 @@ int64 Net::getPerfProfile(std::vector<double>& timings)
     return total;
 }
 
+LayerProfile::LayerProfile()
+    : id(-1), backend(DNN_BACKEND_DEFAULT), target(DNN_TARGET_CPU), time(0), flops(0),
+      bytesRead(0), bytesWritten(0), gflops(0), gbps(0), skipped(false)
+{}
+
+static int64 getBlobsSize(const std::vector<Mat>& blobs)
+{
+    int64 size = 0;
+    for (size_t i = 0; i < blobs.size(); i++)
+        size += (int64)(blobs[i].total() * blobs[i].elemSize());
+    return size;
+}
+
+double Net::getProfile(std::vector<LayerProfile>& profile)
+{
+    CV_TRACE_FUNCTION();
+    AutoLock lock(impl->forwardMutex);
+
+    profile.clear();
+    if (!impl->netWasAllocated)
+        CV_Error(Error::StsError, "Profile is available after the forward pass");
+
+    ShapesVec inputShapes;
+    const std::vector<Mat>& inputBlobs = impl->layers[0].outputBlobs;
+    for (size_t i = 0; i < inputBlobs.size(); i++)
+        inputShapes.push_back(shape(inputBlobs[i]));
+    // Blobs of layers in the blocked layout have padded shapes.
+    Impl::LayersShapesMap layersShapes;
+    impl->getLayersShapes(inputShapes, layersShapes);
+
+    double totalTime = 0;
+    const double ticksToMs = 1e3 / getTickFrequency();
+    for (Impl::MapIdToLayerData::iterator it = impl->layers.begin(); it != impl->layers.end(); ++it)
+    {
+        LayerData& ld = it->second;
+        if (ld.id == 0)
+            continue;
+        Ptr<Layer> layer = ld.getLayerInstance();
+        const LayerShapes& shapes = layersShapes[ld.id];
+
+        LayerProfile p;
+        p.id = ld.id;
+        p.name = ld.name;
+        p.type = ld.type;
+        p.backend = impl->preferableBackend;
+        if (p.backend != DNN_BACKEND_DEFAULT &&
+            (ld.backendNodes.find(p.backend) == ld.backendNodes.end() || ld.backendNodes[p.backend].empty()))
+            p.backend = DNN_BACKEND_DEFAULT;
+        p.target = impl->preferableTarget;
+        p.time = ld.id < (int)impl->layersTimings.size() ? impl->layersTimings[ld.id] * ticksToMs : 0;
+        p.flops = layer->getFLOPS(shapes.in, shapes.out);
+        for (size_t i = 0; i < ld.inputBlobs.size(); i++)
+            p.bytesRead += (int64)(ld.inputBlobs[i]->total() * ld.inputBlobs[i]->elemSize());
+        p.bytesRead += getBlobsSize(layer->blobs);
+        p.bytesWritten = getBlobsSize(ld.outputBlobs);
+        if (p.time > 0)
+        {
+            p.gflops = p.flops / (p.time * 1e6);
+            p.gbps = (p.bytesRead + p.bytesWritten) / (p.time * 1e6);
+        }
+        p.skipped = ld.skipFlags[p.backend];
+        if (p.skipped && ld.inputBlobsId.size() == 1 && !ld.outputBlobs.empty())
+        {
+            // Fused layers write to the outputs of the layer which computes them.
+            LayerData* host = &impl->layers[ld.inputBlobsId[0].lid];
+            while (host->id != 0 && host->skipFlags[p.backend] && host->inputBlobsId.size() == 1)
+                host = &impl->layers[host->inputBlobsId[0].lid];
+            if (host->id != 0 && !host->outputBlobs.empty() &&
+                host->outputBlobs[0].data == ld.outputBlobs[0].data)
+                p.fusedInto = host->name;
+        }
+        if (!p.skipped)
+            p.kernel = getKernelVariant(layer);
+        totalTime += p.time;
+        profile.push_back(p);
+    }
+    return totalTime;
+}
+
+static std::string escapeProfileString(const String& str, bool json)
+{
+    bool quoted = json || str.find_first_of(",\"\n") != String::npos;
+    std::string res = quoted ? "\"" : "";
+    for (size_t i = 0; i < str.size(); i++)
+    {
+        char c = str[i];
+        if (c == '"')
+            res += json ? "\\\"" : "\"\"";
+        else if (c == '\\' && json)
+            res += "\\\\";
+        else if (c == '\n' && json)
+            res += "\\n";
+        else
+            res += c;
+    }
+    if (quoted)
+        res += '"';
+    return res;
+}
+
+void Net::writeProfile(const String& path)
+{
+    CV_TRACE_FUNCTION();
+
+    std::vector<LayerProfile> profile;
+    double totalTime = getProfile(profile);
+
+    std::ofstream ofs(path.c_str());
+    if (!ofs.is_open())
+        CV_Error(Error::StsError, "Failed to open " + path);
+    ofs.precision(6);
+
+    bool json = path.size() >= 5 && path.substr(path.size() - 5) == ".json";
+    if (json)
+    {
+        ofs << "{\n  \"time\": " << totalTime << ",\n  \"layers\": [";
+        for (size_t i = 0; i < profile.size(); i++)
+        {
+            const LayerProfile& p = profile[i];
+            ofs << (i ? ",\n" : "\n") << "    {\"id\": " << p.id
+                << ", \"name\": " << escapeProfileString(p.name, true)
+                << ", \"type\": " << escapeProfileString(p.type, true)
+                << ", \"backend\": " << p.backend << ", \"target\": " << p.target
+                << ", \"time\": " << p.time << ", \"flops\": " << p.flops
+                << ", \"bytes_read\": " << p.bytesRead << ", \"bytes_written\": " << p.bytesWritten
+                << ", \"gflops\": " << p.gflops << ", \"gbps\": " << p.gbps
+                << ", \"skipped\": " << (p.skipped ? "true" : "false")
+                << ", \"fused_into\": " << escapeProfileString(p.fusedInto, true)
+                << ", \"kernel\": " << escapeProfileString(p.kernel, true) << "}";
+        }
+        ofs << "\n  ]\n}\n";
+    }
+    else
+    {
+        ofs << "id,name,type,backend,target,time,flops,bytes_read,bytes_written,"
+               "gflops,gbps,skipped,fused_into,kernel\n";
+        for (size_t i = 0; i < profile.size(); i++)
+        {
+            const LayerProfile& p = profile[i];
+            ofs << p.id << "," << escapeProfileString(p.name, false) << ","
+                << escapeProfileString(p.type, false) << "," << p.backend << "," << p.target << ","
+                << p.time << "," << p.flops << "," << p.bytesRead << "," << p.bytesWritten << ","
+                << p.gflops << "," << p.gbps << "," << (int)p.skipped << ","
+                << escapeProfileString(p.fusedInto, false) << ","
+                << escapeProfileString(p.kernel, false) << "\n";
+        }
+    }
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 Layer::Layer() { preferableTarget = DNN_TARGET_CPU; }
@@ -0,0 +1,175 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "precomp.hpp"
+#include "file_mapping.hpp"
+#include <fstream>
+
+#if defined _WIN32
+#include <windows.h>
+#elif defined __unix__ || defined __APPLE__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define HAVE_MMAP 1
+#endif
+
+namespace cv
+{
+namespace dnn
+{
+
+static void readWholeFile(const String& path, std::vector<uchar>& buffer)
+{
+    std::ifstream ifs(path.c_str(), std::ios::in | std::ios::binary);
+    if (!ifs.is_open())
+        CV_Error(Error::StsError, "Failed to open file " + path);
+    ifs.seekg(0, std::ios::end);
+    buffer.resize((size_t)ifs.tellg());
+    ifs.seekg(0, std::ios::beg);
+    if (!buffer.empty())
+        ifs.read((char*)&buffer[0], buffer.size());
+    if (!ifs)
+        CV_Error(Error::StsError, "Failed to read file " + path);
+}
+
+#if defined _WIN32
+
+FileMapping::FileMapping(const String& path)
+    : data_(0), size_(0), fileHandle_(INVALID_HANDLE_VALUE), mappingHandle_(0)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        CV_Error(Error::StsError, "Failed to open file " + path);
+    fileHandle_ = file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        CV_Error(Error::StsError, "Failed to get size of file " + path);
+    }
+    size_ = (size_t)fileSize.QuadPart;
+    if (size_ == 0)
+        return;
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (mapping)
+    {
+        mappingHandle_ = mapping;
+        data_ = (uchar*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    }
+    if (!data_)
+    {
+        readWholeFile(path, buffer_);
+        size_ = buffer_.size();
+        data_ = buffer_.empty() ? 0 : &buffer_[0];
+    }
+}
+
+FileMapping::~FileMapping()
+{
+    if (data_ && buffer_.empty())
+        UnmapViewOfFile(data_);
+    if (mappingHandle_)
+        CloseHandle((HANDLE)mappingHandle_);
+    if (fileHandle_ != INVALID_HANDLE_VALUE)
+        CloseHandle((HANDLE)fileHandle_);
+}
+
+#else
+
+FileMapping::FileMapping(const String& path) : data_(0), size_(0)
+{
+#ifdef HAVE_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        CV_Error(Error::StsError, "Failed to open file " + path);
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        size_ = (size_t)st.st_size;
+        void* ptr = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED)
+            data_ = (uchar*)ptr;
+    }
+    close(fd);
+    if (data_ || size_ == 0)
+        return;
+#endif
+    readWholeFile(path, buffer_);
+    size_ = buffer_.size();
+    data_ = buffer_.empty() ? 0 : &buffer_[0];
+}
+
+FileMapping::~FileMapping()
+{
+#ifdef HAVE_MMAP
+    if (data_ && buffer_.empty())
+        munmap(data_, size_);
+#endif
+}
+
+#endif
+
+namespace
+{
+    // Deallocates matrices created over the mapped data. The mapping reference
+    // is kept in UMatData::userdata and released with the last matrix.
+    class MappedDataAllocator : public MatAllocator
+    {
+    public:
+        // New data is never placed into the mapping.
+        UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           int flags, UMatUsageFlags usageFlags) const
+        {
+            return Mat::getDefaultAllocator()->allocate(dims, sizes, type, data, step,
+                                                        flags, usageFlags);
+        }
+
+        bool allocate(UMatData* u, int accessFlags, UMatUsageFlags usageFlags) const
+        {
+            return Mat::getDefaultAllocator()->allocate(u, accessFlags, usageFlags);
+        }
+
+        void deallocate(UMatData* u) const
+        {
+            if (!u)
+                return;
+            CV_Assert(u->urefcount == 0 && u->refcount == 0);
+            delete (Ptr<FileMapping>*)u->userdata;
+            delete u;
+        }
+    };
+
+    MatAllocator* getMappedDataAllocator()
+    {
+        static MappedDataAllocator* allocator = new MappedDataAllocator();
+        return allocator;
+    }
+}
+
+Mat wrapMappedData(const Ptr<FileMapping>& mapping, const uchar* data,
+                   int dims, const int* sizes, int type)
+{
+    CV_Assert(!mapping.empty());
+    Mat m(dims, sizes, type, (void*)data);
+    if (m.empty())
+        return m;
+
+    MatAllocator* allocator = getMappedDataAllocator();
+    UMatData* u = new UMatData(allocator);
+    u->data = u->origdata = (uchar*)data;
+    u->size = m.total() * m.elemSize();
+    u->userdata = new Ptr<FileMapping>(mapping);
+    u->refcount = 1;
+    m.u = u;
+    return m;
+}
+
+}  // namespace dnn
+}  // namespace cv
@@ -0,0 +1,46 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#ifndef __OPENCV_DNN_FILE_MAPPING_HPP__
+#define __OPENCV_DNN_FILE_MAPPING_HPP__
+
+#include "precomp.hpp"
+
+namespace cv
+{
+namespace dnn
+{
+    // Provides access to the file content through the memory mapping. Pages are
+    // mapped privately so the data may be modified in place without changing the file.
+    // If memory mapping isn't supported, the whole file is read into memory.
+    class FileMapping
+    {
+    public:
+        explicit FileMapping(const String& path);
+        ~FileMapping();
+
+        uchar* data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        FileMapping(const FileMapping&);
+        FileMapping& operator=(const FileMapping&);
+
+        uchar* data_;
+        size_t size_;
+        std::vector<uchar> buffer_;  // Used if memory mapping isn't available.
+#ifdef _WIN32
+        void* fileHandle_;
+        void* mappingHandle_;
+#endif
+    };
+
+    // Creates a matrix header over the mapped data. The matrix keeps a reference
+    // to the mapping so the file stays mapped while the data is in use.
+    Mat wrapMappedData(const Ptr<FileMapping>& mapping, const uchar* data,
+                       int dims, const int* sizes, int type);
+}  // namespace dnn
+}  // namespace cv
+
+#endif  // __OPENCV_DNN_FILE_MAPPING_HPP__
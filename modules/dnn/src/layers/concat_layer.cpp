@@ -50,7 +50,7 @@ namespace cv
 namespace dnn
 {
 
-class ConcatLayerImpl : public ConcatLayer
+class ConcatLayerImpl : public ConcatLayer, public BlockedLayoutLayer
 {
 public:
     ConcatLayerImpl(const LayerParams& params)
@@ -58,6 +58,7 @@ public:
         setParamsFrom(params);
         axis = params.get<int>("axis", 1);
         padding = params.get<bool>("padding", false);
+        blockSize = 0;
     }
 
     virtual bool getMemoryShapes(const std::vector<MatShape> &inputs,
@@ -103,6 +104,23 @@ public:
                backendId == DNN_BACKEND_HALIDE && haveHalide() && axis == 1 && !padding;  // By channels
     }
 
+    bool setBlockedLayout(int blockSize_, const std::vector<MatShape> &inputs)
+    {
+        if (blockSize_)
+        {
+            // Concatenation of whole blocks only.
+            if (padding || inputs.empty() || clamp(axis, inputs[0]) != 1)
+                return false;
+            for (size_t i = 0; i < inputs.size(); i++)
+            {
+                if (inputs[i].size() != 4 || inputs[i][1] % blockSize_ != 0)
+                    return false;
+            }
+        }
+        blockSize = blockSize_;
+        return true;
+    }
+
     class ChannelConcatInvoker : public ParallelLoopBody
     {
     public:
@@ -245,6 +263,24 @@ public:
         int cAxis = clamp(axis, inputs[0]->dims);
         Mat& outMat = outputs[0];
 
+        if (blockSize)
+        {
+            // [N, C/b, H, W, b] blobs are concatenated as [N, C/b, H, W*b] ones.
+            std::vector<Mat> inps(inputs.size());
+            std::vector<Mat*> inpPtrs(inputs.size());
+            for (size_t i = 0; i < inputs.size(); i++)
+            {
+                const MatSize& sz = inputs[i]->size;
+                int inpSize[] = {sz[0], sz[1], sz[2], sz[3]*sz[4]};
+                inps[i] = inputs[i]->reshape(1, 4, inpSize);
+                inpPtrs[i] = &inps[i];
+            }
+            int outSize[] = {outMat.size[0], outMat.size[1], outMat.size[2], outMat.size[3]*outMat.size[4]};
+            Mat out = outMat.reshape(1, 4, outSize);
+            ChannelConcatInvoker::run(inpPtrs, out, getNumThreads());
+            return;
+        }
+
         if (padding)
             outMat.setTo(0);
 
@@ -295,6 +331,10 @@ public:
 #endif  // HAVE_HALIDE
         return Ptr<BackendNode>();
     }
+
+private:
+    // Number of channels in a block for NCHWc layout, 0 for NCHW one.
+    int blockSize;
 };
 
 Ptr<ConcatLayer> ConcatLayer::create(const LayerParams& params)
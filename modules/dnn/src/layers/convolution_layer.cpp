@@ -146,11 +146,14 @@ public:
 #define IS_POWER_LAYER(layer) \
             (!layer.empty() && !layer->type.compare("Power"))
 //TODO: simultaneously convolution and bias addition for cache optimization
-class ConvolutionLayerImpl : public BaseConvolutionLayerImpl
+class ConvolutionLayerImpl : public BaseConvolutionLayerImpl, public WeightsTypeLayer, public KernelVariantLayer
 {
 public:
     enum { VEC_ALIGN = 8, DFT_TYPE = CV_32F };
     Mat weightsMat;
+    SparseWeights sparseWeights;
+    float sparseDensity;
+    bool useSparseKernel;
     std::vector<float> biasvec;
     std::vector<float> reluslope;
     Ptr<ActivationLayer> activ;
@@ -166,7 +169,7 @@ public:
     ocl4dnnFusedActiv_t activType;
     float power;
 #endif
-    ConvolutionLayerImpl()
+    ConvolutionLayerImpl() : sparseDensity(getSparseWeightsDensity()), useSparseKernel(false)
     {
 #ifdef HAVE_OPENCL
         fusedBias = false;
@@ -240,7 +243,10 @@ public:
                     newWeightAndBias = true;
 
                 if (activ_power->scale != 1.f)
+                {
                     weightsMat.release();
+                    sparseWeights.release();
+                }
 
                 power = activ_power->power;
                 activType = OCL4DNN_CONV_FUSED_ACTIV_POWER;
@@ -250,6 +256,22 @@ public:
         return !activ.empty();
     }
 
+    virtual bool setWeightsType(int weightsType)
+    {
+        int depth = getWeightsDepth(weightsType);
+        if (blobs[0].depth() != depth)
+        {
+            convertWeights(blobs[0], blobs[0], depth);
+            weightsMat.release();
+            sparseWeights.release();
+#ifdef HAVE_OPENCL
+            umat_blobs[0] = depth == CV_32F ? blobs[0].getUMat(ACCESS_READ) : UMat();
+            newWeightAndBias = true;
+#endif
+        }
+        return true;
+    }
+
     bool setBatchNorm(const Ptr<BatchNormLayer>& layer )
     {
         // for now the scale layer followed by the batch norm cannot be fused, only vice versa.
@@ -259,6 +281,7 @@ public:
         // we will need to re-compute the weights with the batch
         // norm coefficients taken into account
         weightsMat.release();
+        sparseWeights.release();
 #ifdef HAVE_OPENCL
         newWeightAndBias = true;
         fusedBias = false;
@@ -272,6 +295,7 @@ public:
         // we will need to re-compute the weights with the scaling
         // coefficients taken into account
         weightsMat.release();
+        sparseWeights.release();
 #ifdef HAVE_OPENCL
         newWeightAndBias = true;
         fusedBias = false;
@@ -362,7 +386,7 @@ public:
                        weights.rows == output.size[1],
                        weights.cols == (input.size[1]/ngroups)*kernel.width*kernel.height,
                        input.type() == output.type(),
-                       input.type() == weights.type(),
+                       weights.type() == CV_32F || weights.type() == CV_16S || weights.type() == CV_16U,
                        input.type() == CV_32F,
                        input.isContinuous(),
                        output.isContinuous(),
@@ -440,8 +464,13 @@ public:
 
             const float* data_inp0_ = input_->ptr<float>();
             const int* ofstab = &ofstab_[0];
-            const float* wptr_orig_ = weights_->ptr<float>();
-            size_t wstep = weights_->step1();
+            // weights in FP16/BF16 formats are converted to single precision by blocks of input channels
+            const bool convertWeightsBlock = weights_->depth() != CV_32F;
+            const float* wptr_orig_ = convertWeightsBlock ? 0 : weights_->ptr<float>();
+            size_t wstep0 = weights_->step1();
+            size_t wstep = convertWeightsBlock ? alignSize(karea*std::min(inpCn, (int)BLK_SIZE_CN), valign) : wstep0;
+            AutoBuffer<float> wbuf_(convertWeightsBlock ? outCn*wstep + valign : 0);
+            float* wbuf = alignPtr((float*)wbuf_, (int)(valign*sizeof(float)));
             const float* biasptr_ = &biasvec_->at(0);
             const float* reluptr_ = reluslope_->empty() ? 0 : &reluslope_->at(0);
             float* data_out0_ = output_->ptr<float>();
@@ -470,7 +499,7 @@ public:
                 const float* data_inp0 = data_inp0_ + subsampleIdx*inpPlaneSize*inpCn;
                 float* data_out0 = data_out0_ + subsampleIdx*outPlaneSize*outCn;
                 int startOutCn = (subsampleIdx % ngroups)*outCn;
-                const float* wptr_orig = wptr_orig_ + wstep*startOutCn;
+                const float* wptr_orig = wptr_orig_ + wstep0*startOutCn;
                 const float* biasptr = biasptr_ + startOutCn;
 
                 for( int cn0 = 0; cn0 < inpCn; cn0 += BLK_SIZE_CN )
@@ -479,6 +508,18 @@ public:
                     int ncn = cn1 - cn0, vsz = karea*ncn;
                     int vsz_a = (int)alignSize(vsz, valign);
                     const float* wptr = wptr_orig + cn0*karea;
+                    if( convertWeightsBlock )
+                    {
+                        Mat wblock(outCn, vsz, CV_32F, wbuf, wstep*sizeof(float));
+                        convertWeights((*weights_)(Range(startOutCn, startOutCn + outCn),
+                                                   Range(cn0*karea, cn0*karea + vsz)), wblock, CV_32F);
+                        if( vsz < vsz_a )
+                        {
+                            for( i = 0; i < outCn; i++ )
+                                memset(wbuf + i*wstep + vsz, 0, (vsz_a - vsz)*sizeof(wbuf[0]));
+                        }
+                        wptr = wbuf;
+                    }
                     // we apply [Channels][P]ReLU (if any) during the final pass only.
                     const float* relu = cn1 == inpCn && reluptr_ ? reluptr_ + startOutCn : 0;
 
@@ -691,6 +732,75 @@ public:
         }
     };
 
+    // 1x1 convolution with pruned weights: every output plane is
+    // a sum of input planes scaled by nonzero weights.
+    class ParallelSparseConv1x1 : public cv::ParallelLoopBody
+    {
+    public:
+        const Mat* input_;
+        const SparseWeights* weights_;
+        Mat* output_;
+        const std::vector<float>* biasvec_;
+        const ActivationLayer* activ_;
+        int nstripes_;
+
+        ParallelSparseConv1x1()
+            : input_(0), weights_(0), output_(0), biasvec_(0), activ_(0), nstripes_(0)
+        {}
+
+        static void run( const Mat& input, Mat& output, const SparseWeights& weights,
+                         const std::vector<float>& biasvec,
+                         const ActivationLayer* activ, int nstripes )
+        {
+            CV_Assert( input.dims == 4 && output.dims == 4,
+                       input.size[0] == output.size[0],
+                       input.size[2] == output.size[2] && input.size[3] == output.size[3],
+                       weights.rows == output.size[1],
+                       weights.cols == input.size[1],
+                       input.type() == CV_32F && output.type() == CV_32F,
+                       input.isContinuous(),
+                       output.isContinuous(),
+                       biasvec.size() == (size_t)output.size[1]+2);
+            ParallelSparseConv1x1 p;
+
+            p.input_ = &input;
+            p.weights_ = &weights;
+            p.output_ = &output;
+            p.biasvec_ = &biasvec;
+            p.activ_ = activ;
+            p.nstripes_ = nstripes;
+
+            parallel_for_(Range(0, nstripes), p, nstripes);
+        }
+
+        virtual void operator ()(const Range &r) const
+        {
+            int outCn = output_->size[1];
+            size_t planeSize = (size_t)output_->size[2]*output_->size[3];
+            size_t total = (size_t)output_->size[0]*outCn;
+            size_t stripeSize = (total + nstripes_ - 1)/nstripes_;
+            size_t stripeStart = r.start*stripeSize;
+            size_t stripeEnd = std::min(r.end*stripeSize, total);
+
+            for( size_t ofs = stripeStart; ofs < stripeEnd; )
+            {
+                int sampleIdx = (int)(ofs / outCn);
+                int cn0 = (int)(ofs - (size_t)sampleIdx*outCn);
+                int cn1 = (int)std::min((size_t)outCn, cn0 + (stripeEnd - ofs));
+                const float* inptr = input_->ptr<float>(sampleIdx);
+                float* outptr = output_->ptr<float>(sampleIdx, cn0);
+
+                sparseGEMM(*weights_, inptr, planeSize, &biasvec_->at(cn0),
+                           outptr, planeSize, (int)planeSize, cn0, cn1);
+
+                if( activ_ )
+                    activ_->forwardSlice(outptr, outptr, (int)planeSize, planeSize, cn0, cn1);
+
+                ofs += cn1 - cn0;
+            }
+        }
+    };
+
 #ifdef HAVE_OPENCL
     bool forward_ocl(InputArrayOfArrays inps, OutputArrayOfArrays outs, OutputArrayOfArrays internals)
     {
@@ -908,13 +1018,24 @@ public:
         int ngroups = inputs[0]->size[1]/blobs[0].size[1];
         CV_Assert(outputs[0].size[1] % ngroups == 0);
         int k, outCn = blobs[0].size[0];
+        const bool sparseShape = ngroups == 1 && kernel == Size(1, 1) &&
+                                 stride == Size(1, 1) && pad == Size(0, 0);
 
-        if( weightsMat.empty() )
+        // the dense weights are not kept when the sparse kernel is used
+        if( weightsMat.empty() && (sparseWeights.empty() || !sparseShape) )
         {
             // prepare weightsMat where each row is aligned and has enough zero padding on the right to
             // use vectorized (i.e. with intrinsics) loops without tail processing
-            Mat wm = blobs[0].reshape(1, outCn).clone();
-            if( wm.step1() % VEC_ALIGN != 0 )
+            Mat wm = blobs[0].reshape(1, outCn);
+            const int weightsDepth = wm.depth();
+            const bool fuseWeights = !bnorm.empty() || !scaleLayer.empty();
+            if( fuseWeights && weightsDepth != CV_32F )
+            {
+                // FP16/BF16 weights are fused in single precision and converted back below
+                convertWeights(wm, wm, CV_32F);
+            }
+            // weights may refer to the unaligned data of the model file
+            if( wm.step1() % VEC_ALIGN != 0 || (size_t)wm.data % (VEC_ALIGN*wm.elemSize()) != 0 )
             {
                 int newcols = (int)alignSize(wm.step1(), VEC_ALIGN);
                 Mat wm_buffer = Mat(outCn, newcols, wm.type());
@@ -924,6 +1045,11 @@ public:
                 wm.copyTo(wm_aligned);
                 wm = wm_aligned;
             }
+            else if( fuseWeights && weightsDepth == CV_32F )
+            {
+                // the weights are modified below, the aligned ones are used as is otherwise
+                wm = wm.clone();
+            }
             weightsMat = wm;
 
             Mat biasMat = hasBias() ? blobs[1].reshape(1, outCn) : Mat();
@@ -984,8 +1110,26 @@ public:
 
                     biasvec[i] = biasvec[i]*(s1*s2) + (delta1*s2 + delta2);
                 }
+
+                if( weightsDepth != CV_32F )
+                {
+                    // convert whole rows to keep zero padding
+                    int wcols = weightsMat.cols;
+                    Mat wm_buffer(outCn, (int)weightsMat.step1(), CV_32F, weightsMat.data);
+                    convertWeights(wm_buffer, wm_buffer, weightsDepth);
+                    weightsMat = wm_buffer.colRange(0, wcols);
+                }
             }
             biasvec[outCn] = biasvec[outCn+1] = biasvec[outCn-1];
+
+            // pruned 1x1 convolutions are computed by the sparse kernel
+            sparseWeights.release();
+            if( weightsMat.depth() == CV_32F && sparseShape &&
+                getWeightsDensity(weightsMat) < sparseDensity )
+            {
+                sparseWeights = SparseWeights(weightsMat);
+                weightsMat.release();
+            }
         }
 
         reluslope.clear();
@@ -1011,10 +1155,23 @@ public:
 
         int nstripes = std::max(getNumThreads(), 1);
 
+        useSparseKernel = !sparseWeights.empty() && sparseShape;
+        if( useSparseKernel )
+        {
+            ParallelSparseConv1x1::run(*inputs[0], outputs[0], sparseWeights, biasvec,
+                                       activ.get(), nstripes);
+            return;
+        }
+
         ParallelConv::run(*inputs[0], outputs[0], weightsMat, biasvec, reluslope,
                           kernel, pad, stride, dilation, activ.get(), ngroups, nstripes);
     }
 
+    virtual String getKernelVariant() const
+    {
+        return getKernelVariantName(useSparseKernel, weightsMat.empty() ? blobs[0].depth() : weightsMat.depth());
+    }
+
     virtual int64 getFLOPS(const std::vector<MatShape> &inputs,
                            const std::vector<MatShape> &outputs) const
     {
@@ -1472,6 +1629,7 @@ Ptr<BaseConvolutionLayer> ConvolutionLayer::create(const LayerParams &params)
     ConvolutionLayerImpl* conv_ptr = new ConvolutionLayerImpl;
     Ptr<BaseConvolutionLayer> l(conv_ptr);
     initConvDeconvLayerFromCaffe(l, params);
+    conv_ptr->sparseDensity = params.get<float>("sparse_density", conv_ptr->sparseDensity);
 
 #ifdef HAVE_OPENCL
     size_t n = params.blobs.size();
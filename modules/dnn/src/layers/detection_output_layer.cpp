@@ -45,6 +45,8 @@
 #include <float.h>
 #include <string>
 #include "../nms.inl.hpp"
+#include "opencv2/core/hal/hal.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include "opencl_kernels_dnn.hpp"
 
 namespace cv
@@ -55,27 +57,6 @@ namespace dnn
 namespace util
 {
 
-class NormalizedBBox
-{
-public:
-    float xmin, ymin, xmax, ymax;
-
-    NormalizedBBox()
-        : xmin(0), ymin(0), xmax(0), ymax(0), has_size_(false), size_(0) {}
-
-    float size() const { return size_; }
-
-    bool has_size() const { return has_size_; }
-
-    void set_size(float value) { size_ = value; has_size_ = true; }
-
-    void clear_size() { size_ = 0; has_size_ = false; }
-
-private:
-    bool has_size_;
-    float size_;
-};
-
 template <typename T>
 static inline bool SortScorePairDescend(const std::pair<float, T>& pair1,
                           const std::pair<float, T>& pair2)
@@ -83,10 +64,6 @@ static inline bool SortScorePairDescend(const std::pair<float, T>& pair1,
     return pair1.first > pair2.first;
 }
 
-static inline float caffe_box_overlap(const util::NormalizedBBox& a, const util::NormalizedBBox& b);
-
-static inline float caffe_norm_box_overlap(const util::NormalizedBBox& a, const util::NormalizedBBox& b);
-
 } // namespace
 
 class DetectionOutputLayerImpl : public DetectionOutputLayer
@@ -115,7 +92,9 @@ public:
     enum { _numAxes = 4 };
     static const std::string _layerName;
 
-    typedef std::map<int, std::vector<util::NormalizedBBox> > LabelBBox;
+    // Bounding boxes are kept in SoA layout: every location class of an image
+    // is represented by BBOX_ROWS rows of numPriors values.
+    enum { BBOX_XMIN = 0, BBOX_YMIN, BBOX_XMAX, BBOX_YMAX, BBOX_SIZE, BBOX_ROWS };
 
     bool getParameterDict(const LayerParams &params,
                           const std::string &parameterName,
@@ -217,7 +196,7 @@ public:
                              const int num, const int numPriors, const bool share_location,
                              const int num_loc_classes, const int background_label_id,
                              const cv::String& code_type, const bool variance_encoded_in_target,
-                             const bool clip, std::vector<LabelBBox>& all_decode_bboxes)
+                             const bool clip, std::vector<Mat>& all_decode_bboxes)
     {
         UMat outmat = UMat(loc_mat.dims, loc_mat.size, CV_32F);
         size_t nthreads = loc_mat.total();
@@ -248,27 +227,19 @@ public:
                 return false;
         }
 
-        all_decode_bboxes.clear();
         all_decode_bboxes.resize(num);
         {
             Mat mat = outmat.getMat(ACCESS_READ);
             const float* decode_data = mat.ptr<float>();
-            for (int i = 0; i < num; ++i)
+            for (int i = 0; i < num; ++i, decode_data += numPriors * num_loc_classes * 4)
             {
-                LabelBBox& decode_bboxes = all_decode_bboxes[i];
+                Mat& decode_bboxes = all_decode_bboxes[i];
+                decode_bboxes.create(num_loc_classes * BBOX_ROWS, numPriors, CV_32F);
                 for (int c = 0; c < num_loc_classes; ++c)
                 {
-                    int label = share_location ? -1 : c;
-                    decode_bboxes[label].resize(numPriors);
-                    for (int p = 0; p < numPriors; ++p)
-                    {
-                        int startIdx = p * num_loc_classes * 4;
-                        util::NormalizedBBox& bbox = decode_bboxes[label][p];
-                        bbox.xmin = decode_data[startIdx + c * 4];
-                        bbox.ymin = decode_data[startIdx + c * 4 + 1];
-                        bbox.xmax = decode_data[startIdx + c * 4 + 2];
-                        bbox.ymax = decode_data[startIdx + c * 4 + 3];
-                    }
+                    Mat bboxes = decode_bboxes.rowRange(c * BBOX_ROWS, (c + 1) * BBOX_ROWS);
+                    GetLocPredictions(decode_data, numPriors, num_loc_classes, c, false, bboxes);
+                    ComputeBBoxesSize(bboxes, _bboxesNormalized);
                 }
             }
         }
@@ -299,7 +270,7 @@ public:
         inps.getUMatVector(inputs);
         outs.getUMatVector(outputs);
 
-        std::vector<LabelBBox> allDecodedBBoxes;
+        std::vector<Mat> allDecodedBBoxes;
         std::vector<Mat> allConfidenceScores;
 
         int num = inputs[0].size[0];
@@ -320,12 +291,8 @@ public:
                 return false;
         }
 
-        size_t numKept = 0;
         std::vector<std::map<int, std::vector<int> > > allIndices;
-        for (int i = 0; i < num; ++i)
-        {
-            numKept += processDetections_(allDecodedBBoxes[i], allConfidenceScores[i], allIndices);
-        }
+        size_t numKept = processDetections_(allDecodedBBoxes, allConfidenceScores, allIndices);
 
         if (numKept == 0)
         {
@@ -373,7 +340,7 @@ public:
         CV_TRACE_FUNCTION();
         CV_TRACE_ARG_VALUE(name, "name", name.c_str());
 
-        std::vector<LabelBBox> allDecodedBBoxes;
+        std::vector<Mat> allDecodedBBoxes;
         std::vector<Mat> allConfidenceScores;
 
         int num = inputs[0]->size[0];
@@ -386,47 +353,50 @@ public:
             const float* confidenceData = inputs[1]->ptr<float>();
             const float* priorData = inputs[2]->ptr<float>();
 
-            // Retrieve all location predictions
-            std::vector<LabelBBox> allLocationPredictions;
-            GetLocPredictions(locationData, num, numPriors, _numLocClasses,
-                              _shareLocation, _locPredTransposed, allLocationPredictions);
-
             // Retrieve all confidences
             GetConfidenceScores(confidenceData, num, numPriors, _numClasses, allConfidenceScores);
 
             // Retrieve all prior bboxes
-            std::vector<util::NormalizedBBox> priorBBoxes;
-            std::vector<std::vector<float> > priorVariances;
-            GetPriorBBoxes(priorData, numPriors, _bboxesNormalized, priorBBoxes, priorVariances);
+            Mat priors;
+            GetPriorBBoxes(priorData, numPriors, _codeType, _bboxesNormalized, priors);
 
             // Decode all loc predictions to bboxes
-            util::NormalizedBBox clipBounds;
+            float clipBounds[4] = {0.0f, 0.0f, 0.0f, 0.0f};  // xmin, ymin, xmax, ymax
             if (_clip)
             {
                 CV_Assert(_bboxesNormalized || inputs.size() >= 4);
-                clipBounds.xmin = clipBounds.ymin = 0.0f;
                 if (_bboxesNormalized)
-                    clipBounds.xmax = clipBounds.ymax = 1.0f;
+                    clipBounds[2] = clipBounds[3] = 1.0f;
                 else
                 {
                     // Input image sizes;
                     CV_Assert(inputs[3]->dims == 4);
-                    clipBounds.xmax = inputs[3]->size[3] - 1;
-                    clipBounds.ymax = inputs[3]->size[2] - 1;
+                    clipBounds[2] = inputs[3]->size[3] - 1;
+                    clipBounds[3] = inputs[3]->size[2] - 1;
+                }
+            }
+
+            allDecodedBBoxes.resize(num);
+            for (int i = 0; i < num; ++i, locationData += numPriors * _numLocClasses * 4)
+            {
+                Mat& decodedBBoxes = allDecodedBBoxes[i];
+                decodedBBoxes.create(_numLocClasses * BBOX_ROWS, numPriors, CV_32F);
+                for (int c = 0; c < _numLocClasses; ++c)
+                {
+                    int label = _shareLocation ? -1 : c;
+                    if (label == _backgroundLabelId)
+                        continue; // Ignore background class.
+                    Mat bboxes = decodedBBoxes.rowRange(c * BBOX_ROWS, (c + 1) * BBOX_ROWS);
+                    GetLocPredictions(locationData, numPriors, _numLocClasses, c,
+                                      _locPredTransposed, bboxes);
+                    DecodeBBoxes(priors, _codeType, _varianceEncodedInTarget,
+                                 _clip, clipBounds, _bboxesNormalized, bboxes);
                 }
             }
-            DecodeBBoxesAll(allLocationPredictions, priorBBoxes, priorVariances, num,
-                            _shareLocation, _numLocClasses, _backgroundLabelId,
-                            _codeType, _varianceEncodedInTarget, _clip, clipBounds,
-                            _bboxesNormalized, allDecodedBBoxes);
         }
 
-        size_t numKept = 0;
         std::vector<std::map<int, std::vector<int> > > allIndices;
-        for (int i = 0; i < num; ++i)
-        {
-            numKept += processDetections_(allDecodedBBoxes[i], allConfidenceScores[i], allIndices);
-        }
+        size_t numKept = processDetections_(allDecodedBBoxes, allConfidenceScores, allIndices);
 
         if (numKept == 0)
         {
@@ -451,7 +421,7 @@ public:
 
     size_t outputDetections_(
             const int i, float* outputsData,
-            const LabelBBox& decodeBBoxes, Mat& confidenceScores,
+            const Mat& decodeBBoxes, const Mat& confidenceScores,
             const std::map<int, std::vector<int> >& indicesMap
     )
     {
@@ -461,95 +431,138 @@ public:
             int label = it->first;
             if (confidenceScores.rows <= label)
                 CV_ErrorNoReturn_(cv::Error::StsError, ("Could not find confidence predictions for label %d", label));
-            const std::vector<float>& scores = confidenceScores.row(label);
-            int locLabel = _shareLocation ? -1 : label;
-            LabelBBox::const_iterator label_bboxes = decodeBBoxes.find(locLabel);
-            if (label_bboxes == decodeBBoxes.end())
-                CV_ErrorNoReturn_(cv::Error::StsError, ("Could not find location predictions for label %d", locLabel));
+            const float* scores = confidenceScores.ptr<float>(label);
+            int locLabel = _shareLocation ? 0 : label;
+            const float* xmin = decodeBBoxes.ptr<float>(locLabel * BBOX_ROWS + BBOX_XMIN);
+            const float* ymin = decodeBBoxes.ptr<float>(locLabel * BBOX_ROWS + BBOX_YMIN);
+            const float* xmax = decodeBBoxes.ptr<float>(locLabel * BBOX_ROWS + BBOX_XMAX);
+            const float* ymax = decodeBBoxes.ptr<float>(locLabel * BBOX_ROWS + BBOX_YMAX);
             const std::vector<int>& indices = it->second;
 
             for (size_t j = 0; j < indices.size(); ++j, ++count)
             {
                 int idx = indices[j];
-                const util::NormalizedBBox& decode_bbox = label_bboxes->second[idx];
                 outputsData[count * 7] = i;
                 outputsData[count * 7 + 1] = label;
                 outputsData[count * 7 + 2] = scores[idx];
-                outputsData[count * 7 + 3] = decode_bbox.xmin;
-                outputsData[count * 7 + 4] = decode_bbox.ymin;
-                outputsData[count * 7 + 5] = decode_bbox.xmax;
-                outputsData[count * 7 + 6] = decode_bbox.ymax;
+                outputsData[count * 7 + 3] = xmin[idx];
+                outputsData[count * 7 + 4] = ymin[idx];
+                outputsData[count * 7 + 5] = xmax[idx];
+                outputsData[count * 7 + 6] = ymax[idx];
             }
         }
         return count;
     }
 
+    // Runs NMS for every pair of image and class.
+    class NMSInvoker : public ParallelLoopBody
+    {
+    public:
+        NMSInvoker(const DetectionOutputLayerImpl& layer,
+                   const std::vector<Mat>& allDecodedBBoxes,
+                   const std::vector<Mat>& allConfidenceScores,
+                   std::vector<std::vector<int> >& allClassIndices)
+            : layer_(layer), allDecodedBBoxes_(allDecodedBBoxes),
+              allConfidenceScores_(allConfidenceScores), allClassIndices_(allClassIndices) {}
+
+        void operator()(const Range& r) const
+        {
+            const int numClasses = layer_._numClasses;
+            for (int i = r.start; i < r.end; ++i)
+            {
+                const int image = i / numClasses;
+                const int c = i % numClasses;
+                if (c == layer_._backgroundLabelId)
+                    continue; // Ignore background class.
+                const Mat& confidenceScores = allConfidenceScores_[image];
+                int locLabel = layer_._shareLocation ? 0 : c;
+                Mat bboxes = allDecodedBBoxes_[image].rowRange(locLabel * BBOX_ROWS,
+                                                               (locLabel + 1) * BBOX_ROWS);
+                NMSFast(bboxes, confidenceScores.ptr<float>(c), layer_._confidenceThreshold,
+                        layer_._nmsThreshold, layer_._topK, layer_._bboxesNormalized,
+                        allClassIndices_[i]);
+            }
+        }
+
+    private:
+        const DetectionOutputLayerImpl& layer_;
+        const std::vector<Mat>& allDecodedBBoxes_;
+        const std::vector<Mat>& allConfidenceScores_;
+        std::vector<std::vector<int> >& allClassIndices_;
+    };
+
     size_t processDetections_(
-            const LabelBBox& decodeBBoxes, Mat& confidenceScores,
+            const std::vector<Mat>& allDecodedBBoxes,
+            const std::vector<Mat>& allConfidenceScores,
             std::vector<std::map<int, std::vector<int> > >& allIndices
     )
     {
-        std::map<int, std::vector<int> > indices;
-        size_t numDetections = 0;
-        for (int c = 0; c < (int)_numClasses; ++c)
+        const int num = (int)allDecodedBBoxes.size();
+        CV_Assert(allConfidenceScores.size() == (size_t)num);
+        for (int i = 0; i < num; ++i)
         {
-            if (c == _backgroundLabelId)
-                continue; // Ignore background class.
-            if (c >= confidenceScores.rows)
-                CV_ErrorNoReturn_(cv::Error::StsError, ("Could not find confidence predictions for label %d", c));
-
-            const std::vector<float> scores = confidenceScores.row(c);
-            int label = _shareLocation ? -1 : c;
-
-            LabelBBox::const_iterator label_bboxes = decodeBBoxes.find(label);
-            if (label_bboxes == decodeBBoxes.end())
-                CV_ErrorNoReturn_(cv::Error::StsError, ("Could not find location predictions for label %d", label));
-            if (_bboxesNormalized)
-                NMSFast_(label_bboxes->second, scores, _confidenceThreshold, _nmsThreshold, 1.0, _topK,
-                         indices[c], util::caffe_norm_box_overlap);
-            else
-                NMSFast_(label_bboxes->second, scores, _confidenceThreshold, _nmsThreshold, 1.0, _topK,
-                         indices[c], util::caffe_box_overlap);
-            numDetections += indices[c].size();
+            if (allConfidenceScores[i].rows < (int)_numClasses)
+                CV_ErrorNoReturn_(cv::Error::StsError, ("Could not find confidence predictions for image %d", i));
         }
-        if (_keepTopK > -1 && numDetections > (size_t)_keepTopK)
+
+        // Classes are independent so NMS runs for all of them in parallel.
+        std::vector<std::vector<int> > allClassIndices(num * _numClasses);
+        parallel_for_(Range(0, (int)allClassIndices.size()),
+                      NMSInvoker(*this, allDecodedBBoxes, allConfidenceScores, allClassIndices));
+
+        size_t numKept = 0;
+        allIndices.resize(num);
+        for (int i = 0; i < num; ++i)
         {
-            std::vector<std::pair<float, std::pair<int, int> > > scoreIndexPairs;
-            for (std::map<int, std::vector<int> >::iterator it = indices.begin();
-                 it != indices.end(); ++it)
+            std::map<int, std::vector<int> >& indices = allIndices[i];
+            indices.clear();
+            size_t numDetections = 0;
+            for (int c = 0; c < (int)_numClasses; ++c)
             {
-                int label = it->first;
-                const std::vector<int>& labelIndices = it->second;
-                if (label >= confidenceScores.rows)
-                    CV_ErrorNoReturn_(cv::Error::StsError, ("Could not find location predictions for label %d", label));
-                const std::vector<float>& scores = confidenceScores.row(label);
-                for (size_t j = 0; j < labelIndices.size(); ++j)
-                {
-                    size_t idx = labelIndices[j];
-                    CV_Assert(idx < scores.size());
-                    scoreIndexPairs.push_back(std::make_pair(scores[idx], std::make_pair(label, idx)));
-                }
+                if (c == _backgroundLabelId)
+                    continue; // Ignore background class.
+                std::vector<int>& classIndices = allClassIndices[i * _numClasses + c];
+                numDetections += classIndices.size();
+                indices[c].swap(classIndices);
             }
-            // Keep outputs k results per image.
-            std::sort(scoreIndexPairs.begin(), scoreIndexPairs.end(),
-                      util::SortScorePairDescend<std::pair<int, int> >);
-            scoreIndexPairs.resize(_keepTopK);
-
-            std::map<int, std::vector<int> > newIndices;
-            for (size_t j = 0; j < scoreIndexPairs.size(); ++j)
+            if (_keepTopK > -1 && numDetections > (size_t)_keepTopK)
             {
-                int label = scoreIndexPairs[j].second.first;
-                int idx = scoreIndexPairs[j].second.second;
-                newIndices[label].push_back(idx);
+                const Mat& confidenceScores = allConfidenceScores[i];
+                std::vector<std::pair<float, std::pair<int, int> > > scoreIndexPairs;
+                scoreIndexPairs.reserve(numDetections);
+                for (std::map<int, std::vector<int> >::iterator it = indices.begin();
+                     it != indices.end(); ++it)
+                {
+                    int label = it->first;
+                    const std::vector<int>& labelIndices = it->second;
+                    const float* scores = confidenceScores.ptr<float>(label);
+                    for (size_t j = 0; j < labelIndices.size(); ++j)
+                    {
+                        int idx = labelIndices[j];
+                        CV_Assert(idx < confidenceScores.cols);
+                        scoreIndexPairs.push_back(std::make_pair(scores[idx], std::make_pair(label, idx)));
+                    }
+                }
+                // Keep outputs k results per image.
+                std::partial_sort(scoreIndexPairs.begin(), scoreIndexPairs.begin() + _keepTopK,
+                                  scoreIndexPairs.end(),
+                                  util::SortScorePairDescend<std::pair<int, int> >);
+                scoreIndexPairs.resize(_keepTopK);
+
+                std::map<int, std::vector<int> > newIndices;
+                for (size_t j = 0; j < scoreIndexPairs.size(); ++j)
+                {
+                    int label = scoreIndexPairs[j].second.first;
+                    int idx = scoreIndexPairs[j].second.second;
+                    newIndices[label].push_back(idx);
+                }
+                indices.swap(newIndices);
+                numKept += (size_t)_keepTopK;
             }
-            allIndices.push_back(newIndices);
-            return (size_t)_keepTopK;
-        }
-        else
-        {
-            allIndices.push_back(indices);
-            return numDetections;
+            else
+                numKept += numDetections;
         }
+        return numKept;
     }
 
 
@@ -557,245 +570,186 @@ public:
     // Utility functions
     // **************************************************************
 
-    // Compute bbox size
-    static float BBoxSize(const util::NormalizedBBox& bbox, bool normalized)
+    // Compute sizes of bboxes: zero for invalid ones (e.g. xmax < xmin or ymax < ymin),
+    // width * height for normalized and (width + 1) * (height + 1) otherwise.
+    static void ComputeBBoxesSize(Mat& bboxes, bool normalized)
     {
-        if (bbox.xmax < bbox.xmin || bbox.ymax < bbox.ymin)
-        {
-            return 0; // If bbox is invalid (e.g. xmax < xmin or ymax < ymin), return 0.
+        const int n = bboxes.cols;
+        const float* xmin = bboxes.ptr<float>(BBOX_XMIN);
+        const float* ymin = bboxes.ptr<float>(BBOX_YMIN);
+        const float* xmax = bboxes.ptr<float>(BBOX_XMAX);
+        const float* ymax = bboxes.ptr<float>(BBOX_YMAX);
+        float* size = bboxes.ptr<float>(BBOX_SIZE);
+        const float delta = normalized ? 0.0f : 1.0f;
+        int i = 0;
+#if CV_SIMD128
+        v_float32x4 v_delta = v_setall_f32(delta), v_zero = v_setzero_f32();
+        for (; i <= n - 4; i += 4)
+        {
+            v_float32x4 w = v_load(xmax + i) - v_load(xmin + i);
+            v_float32x4 h = v_load(ymax + i) - v_load(ymin + i);
+            v_float32x4 s = (w + v_delta) * (h + v_delta);
+            v_store(size + i, v_select((w >= v_zero) & (h >= v_zero), s, v_zero));
         }
-        else
+#endif
+        for (; i < n; ++i)
         {
-            if (bbox.has_size())
-            {
-                return bbox.size();
-            }
-            else
-            {
-                float width = bbox.xmax - bbox.xmin;
-                float height = bbox.ymax - bbox.ymin;
-                if (normalized)
-                {
-                    return width * height;
-                }
-                else
-                {
-                    // If bbox is not within range [0, 1].
-                    return (width + 1) * (height + 1);
-                }
-            }
+            float w = xmax[i] - xmin[i], h = ymax[i] - ymin[i];
+            size[i] = (w >= 0 && h >= 0) ? (w + delta) * (h + delta) : 0.0f;
         }
     }
 
-
-    // Decode a bbox according to a prior bbox
-    template<bool variance_encoded_in_target>
-    static void DecodeBBox(
-        const util::NormalizedBBox& prior_bbox, const std::vector<float>& prior_variance,
-        const cv::String& code_type,
-        const bool clip_bbox, const util::NormalizedBBox& clip_bounds,
-        const bool normalized_bbox, const util::NormalizedBBox& bbox,
-        util::NormalizedBBox& decode_bbox)
+    // Decode a set of bboxes according to a set of prior bboxes. Both sets are
+    // in SoA layout, decoding is done in place.
+    //    priors: rows of GetPriorBBoxes output.
+    //    bboxes: location predictions (first four rows) which are replaced
+    //            by decoded bboxes and their sizes.
+    static void DecodeBBoxes(const Mat& priors, const cv::String& code_type,
+                             const bool variance_encoded_in_target,
+                             const bool clip_bbox, const float clip_bounds[4],
+                             const bool normalized_bbox, Mat& bboxes)
     {
-        float bbox_xmin = variance_encoded_in_target ? bbox.xmin : prior_variance[0] * bbox.xmin;
-        float bbox_ymin = variance_encoded_in_target ? bbox.ymin : prior_variance[1] * bbox.ymin;
-        float bbox_xmax = variance_encoded_in_target ? bbox.xmax : prior_variance[2] * bbox.xmax;
-        float bbox_ymax = variance_encoded_in_target ? bbox.ymax : prior_variance[3] * bbox.ymax;
+        CV_Assert(priors.cols == bboxes.cols, priors.rows == 8, bboxes.rows == BBOX_ROWS);
+        const int n = bboxes.cols;
+        if (!variance_encoded_in_target)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                Mat row = bboxes.row(k);
+                multiply(row, priors.row(4 + k), row);
+            }
+        }
         if (code_type == "CORNER")
         {
-            decode_bbox.xmin = prior_bbox.xmin + bbox_xmin;
-            decode_bbox.ymin = prior_bbox.ymin + bbox_ymin;
-            decode_bbox.xmax = prior_bbox.xmax + bbox_xmax;
-            decode_bbox.ymax = prior_bbox.ymax + bbox_ymax;
+            for (int k = 0; k < 4; ++k)
+            {
+                Mat row = bboxes.row(k);
+                add(row, priors.row(k), row);
+            }
         }
         else if (code_type == "CENTER_SIZE")
         {
-            float prior_width = prior_bbox.xmax - prior_bbox.xmin;
-            float prior_height = prior_bbox.ymax - prior_bbox.ymin;
-            if (!normalized_bbox)
+            float* xmin = bboxes.ptr<float>(BBOX_XMIN);
+            float* ymin = bboxes.ptr<float>(BBOX_YMIN);
+            float* xmax = bboxes.ptr<float>(BBOX_XMAX);
+            float* ymax = bboxes.ptr<float>(BBOX_YMAX);
+            const float* priorCenterX = priors.ptr<float>(0);
+            const float* priorCenterY = priors.ptr<float>(1);
+            const float* priorWidth = priors.ptr<float>(2);
+            const float* priorHeight = priors.ptr<float>(3);
+            hal::exp32f(xmax, xmax, n);
+            hal::exp32f(ymax, ymax, n);
+            int i = 0;
+#if CV_SIMD128
+            v_float32x4 v_half = v_setall_f32(0.5f);
+            for (; i <= n - 4; i += 4)
             {
-                prior_width += 1.0f;
-                prior_height += 1.0f;
+                v_float32x4 pw = v_load(priorWidth + i), ph = v_load(priorHeight + i);
+                v_float32x4 cx = v_load(xmin + i) * pw + v_load(priorCenterX + i);
+                v_float32x4 cy = v_load(ymin + i) * ph + v_load(priorCenterY + i);
+                v_float32x4 hw = v_load(xmax + i) * pw * v_half;
+                v_float32x4 hh = v_load(ymax + i) * ph * v_half;
+                v_store(xmin + i, cx - hw);
+                v_store(ymin + i, cy - hh);
+                v_store(xmax + i, cx + hw);
+                v_store(ymax + i, cy + hh);
+            }
+#endif
+            for (; i < n; ++i)
+            {
+                float cx = xmin[i] * priorWidth[i] + priorCenterX[i];
+                float cy = ymin[i] * priorHeight[i] + priorCenterY[i];
+                float hw = xmax[i] * priorWidth[i] * 0.5f;
+                float hh = ymax[i] * priorHeight[i] * 0.5f;
+                xmin[i] = cx - hw;
+                ymin[i] = cy - hh;
+                xmax[i] = cx + hw;
+                ymax[i] = cy + hh;
             }
-            CV_Assert(prior_width > 0);
-            CV_Assert(prior_height > 0);
-            float prior_center_x = prior_bbox.xmin + prior_width * .5;
-            float prior_center_y = prior_bbox.ymin + prior_height * .5;
-
-            float decode_bbox_center_x, decode_bbox_center_y;
-            float decode_bbox_width, decode_bbox_height;
-            decode_bbox_center_x = bbox_xmin * prior_width + prior_center_x;
-            decode_bbox_center_y = bbox_ymin * prior_height + prior_center_y;
-            decode_bbox_width = exp(bbox_xmax) * prior_width;
-            decode_bbox_height = exp(bbox_ymax) * prior_height;
-            decode_bbox.xmin = decode_bbox_center_x - decode_bbox_width * .5;
-            decode_bbox.ymin = decode_bbox_center_y - decode_bbox_height * .5;
-            decode_bbox.xmax = decode_bbox_center_x + decode_bbox_width * .5;
-            decode_bbox.ymax = decode_bbox_center_y + decode_bbox_height * .5;
         }
         else
             CV_ErrorNoReturn(Error::StsBadArg, "Unknown type.");
 
         if (clip_bbox)
         {
-            // Clip the util::NormalizedBBox.
-            decode_bbox.xmin = std::max(std::min(decode_bbox.xmin, clip_bounds.xmax), clip_bounds.xmin);
-            decode_bbox.ymin = std::max(std::min(decode_bbox.ymin, clip_bounds.ymax), clip_bounds.ymin);
-            decode_bbox.xmax = std::max(std::min(decode_bbox.xmax, clip_bounds.xmax), clip_bounds.xmin);
-            decode_bbox.ymax = std::max(std::min(decode_bbox.ymax, clip_bounds.ymax), clip_bounds.ymin);
-        }
-        decode_bbox.clear_size();
-        decode_bbox.set_size(BBoxSize(decode_bbox, normalized_bbox));
-    }
-
-    // Decode a set of bboxes according to a set of prior bboxes
-    static void DecodeBBoxes(
-        const std::vector<util::NormalizedBBox>& prior_bboxes,
-        const std::vector<std::vector<float> >& prior_variances,
-        const cv::String& code_type, const bool variance_encoded_in_target,
-        const bool clip_bbox, const util::NormalizedBBox& clip_bounds,
-        const bool normalized_bbox, const std::vector<util::NormalizedBBox>& bboxes,
-        std::vector<util::NormalizedBBox>& decode_bboxes)
-    {
-        CV_Assert(prior_bboxes.size() == prior_variances.size());
-        CV_Assert(prior_bboxes.size() == bboxes.size());
-        size_t num_bboxes = prior_bboxes.size();
-        CV_Assert(num_bboxes == 0 || prior_variances[0].size() == 4);
-        decode_bboxes.clear(); decode_bboxes.resize(num_bboxes);
-        if(variance_encoded_in_target)
-        {
-            for (int i = 0; i < num_bboxes; ++i)
-                DecodeBBox<true>(prior_bboxes[i], prior_variances[i], code_type,
-                                 clip_bbox, clip_bounds, normalized_bbox,
-                                 bboxes[i], decode_bboxes[i]);
-        }
-        else
-        {
-            for (int i = 0; i < num_bboxes; ++i)
-                DecodeBBox<false>(prior_bboxes[i], prior_variances[i], code_type,
-                                  clip_bbox, clip_bounds, normalized_bbox,
-                                  bboxes[i], decode_bboxes[i]);
-        }
-    }
-
-    // Decode all bboxes in a batch
-    static void DecodeBBoxesAll(const std::vector<LabelBBox>& all_loc_preds,
-        const std::vector<util::NormalizedBBox>& prior_bboxes,
-        const std::vector<std::vector<float> >& prior_variances,
-        const int num, const bool share_location,
-        const int num_loc_classes, const int background_label_id,
-        const cv::String& code_type, const bool variance_encoded_in_target,
-        const bool clip, const util::NormalizedBBox& clip_bounds,
-        const bool normalized_bbox, std::vector<LabelBBox>& all_decode_bboxes)
-    {
-        CV_Assert(all_loc_preds.size() == num);
-        all_decode_bboxes.clear();
-        all_decode_bboxes.resize(num);
-        for (int i = 0; i < num; ++i)
-        {
-            // Decode predictions into bboxes.
-            const LabelBBox& loc_preds = all_loc_preds[i];
-            LabelBBox& decode_bboxes = all_decode_bboxes[i];
-            for (int c = 0; c < num_loc_classes; ++c)
+            for (int k = 0; k < 4; ++k)
             {
-                int label = share_location ? -1 : c;
-                if (label == background_label_id)
-                    continue; // Ignore background class.
-                LabelBBox::const_iterator label_loc_preds = loc_preds.find(label);
-                if (label_loc_preds == loc_preds.end())
-                    CV_ErrorNoReturn_(cv::Error::StsError, ("Could not find location predictions for label %d", label));
-                DecodeBBoxes(prior_bboxes, prior_variances,
-                             code_type, variance_encoded_in_target, clip, clip_bounds,
-                             normalized_bbox, label_loc_preds->second, decode_bboxes[label]);
+                Mat row = bboxes.row(k);
+                min(row, clip_bounds[2 + (k & 1)], row);
+                max(row, clip_bounds[k & 1], row);
             }
         }
+        ComputeBBoxesSize(bboxes, normalized_bbox);
     }
 
     // Get prior bounding boxes from prior_data
     //    prior_data: 1 x 2 x num_priors * 4 x 1 blob.
     //    num_priors: number of priors.
-    //    prior_bboxes: stores all the prior bboxes in the format of util::NormalizedBBox.
-    //    prior_variances: stores all the variances needed by prior bboxes.
+    //    priors: 8 x num_priors matrix. The first four rows are xmin, ymin, xmax, ymax
+    //            of prior bboxes (or center x, center y, width, height for CENTER_SIZE
+    //            code type). The rest ones are variances.
     static void GetPriorBBoxes(const float* priorData, const int& numPriors,
-                        bool normalized_bbox, std::vector<util::NormalizedBBox>& priorBBoxes,
-                        std::vector<std::vector<float> >& priorVariances)
+                               const cv::String& code_type, bool normalized_bbox, Mat& priors)
     {
-        priorBBoxes.clear(); priorBBoxes.resize(numPriors);
-        priorVariances.clear(); priorVariances.resize(numPriors);
-        for (int i = 0; i < numPriors; ++i)
-        {
-            int startIdx = i * 4;
-            util::NormalizedBBox& bbox = priorBBoxes[i];
-            bbox.xmin = priorData[startIdx];
-            bbox.ymin = priorData[startIdx + 1];
-            bbox.xmax = priorData[startIdx + 2];
-            bbox.ymax = priorData[startIdx + 3];
-            bbox.set_size(BBoxSize(bbox, normalized_bbox));
-        }
-
-        for (int i = 0; i < numPriors; ++i)
-        {
-            int startIdx = (numPriors + i) * 4;
-            // not needed here: priorVariances[i].clear();
-            for (int j = 0; j < 4; ++j)
+        priors.create(8, numPriors, CV_32F);
+        Mat coords = priors.rowRange(0, 4), variances = priors.rowRange(4, 8);
+        transpose(Mat(numPriors, 4, CV_32F, (void*)priorData), coords);
+        transpose(Mat(numPriors, 4, CV_32F, (void*)(priorData + numPriors * 4)), variances);
+        if (code_type == "CENTER_SIZE")
+        {
+            float* xmin = priors.ptr<float>(0);
+            float* ymin = priors.ptr<float>(1);
+            float* xmax = priors.ptr<float>(2);
+            float* ymax = priors.ptr<float>(3);
+            for (int i = 0; i < numPriors; ++i)
             {
-                priorVariances[i].push_back(priorData[startIdx + j]);
+                float prior_width = xmax[i] - xmin[i];
+                float prior_height = ymax[i] - ymin[i];
+                if (!normalized_bbox)
+                {
+                    prior_width += 1.0f;
+                    prior_height += 1.0f;
+                }
+                CV_Assert(prior_width > 0);
+                CV_Assert(prior_height > 0);
+                xmin[i] += prior_width * 0.5f;
+                ymin[i] += prior_height * 0.5f;
+                xmax[i] = prior_width;
+                ymax[i] = prior_height;
             }
         }
     }
 
-    // Get location predictions from loc_data.
-    //    loc_data: num x num_preds_per_class * num_loc_classes * 4 blob.
-    //    num: the number of images.
+    // Get location predictions of a single class from loc_data.
+    //    loc_data: num_preds_per_class * num_loc_classes * 4 values of an image.
     //    num_preds_per_class: number of predictions per class.
     //    num_loc_classes: number of location classes. It is 1 if share_location is
     //      true; and is equal to number of classes needed to predict otherwise.
-    //    share_location: if true, all classes share the same location prediction.
+    //    c: index of location class.
     //    loc_pred_transposed: if true, represent four bounding box values as
     //                         [y,x,height,width] or [x,y,width,height] otherwise.
-    //    loc_preds: stores the location prediction, where each item contains
-    //      location prediction for an image.
-    static void GetLocPredictions(const float* locData, const int num,
-                           const int numPredsPerClass, const int numLocClasses,
-                           const bool shareLocation, const bool locPredTransposed,
-                           std::vector<LabelBBox>& locPreds)
+    //    loc_preds: first four rows receive xmin, ymin, xmax, ymax of predictions.
+    static void GetLocPredictions(const float* locData, const int numPredsPerClass,
+                                  const int numLocClasses, const int c,
+                                  const bool locPredTransposed, Mat& locPreds)
     {
-        locPreds.clear();
-        if (shareLocation)
+        float* xmin = locPreds.ptr<float>(BBOX_XMIN);
+        float* ymin = locPreds.ptr<float>(BBOX_YMIN);
+        float* xmax = locPreds.ptr<float>(BBOX_XMAX);
+        float* ymax = locPreds.ptr<float>(BBOX_YMAX);
+        if (locPredTransposed)
         {
-            CV_Assert(numLocClasses == 1);
+            std::swap(xmin, ymin);
+            std::swap(xmax, ymax);
         }
-        locPreds.resize(num);
-        for (int i = 0; i < num; ++i, locData += numPredsPerClass * numLocClasses * 4)
+        const int step = numLocClasses * 4;
+        locData += c * 4;
+        for (int p = 0; p < numPredsPerClass; ++p, locData += step)
         {
-            LabelBBox& labelBBox = locPreds[i];
-            for (int p = 0; p < numPredsPerClass; ++p)
-            {
-                int startIdx = p * numLocClasses * 4;
-                for (int c = 0; c < numLocClasses; ++c)
-                {
-                    int label = shareLocation ? -1 : c;
-                    if (labelBBox.find(label) == labelBBox.end())
-                    {
-                        labelBBox[label].resize(numPredsPerClass);
-                    }
-                    util::NormalizedBBox& bbox = labelBBox[label][p];
-                    if (locPredTransposed)
-                    {
-                        bbox.ymin = locData[startIdx + c * 4];
-                        bbox.xmin = locData[startIdx + c * 4 + 1];
-                        bbox.ymax = locData[startIdx + c * 4 + 2];
-                        bbox.xmax = locData[startIdx + c * 4 + 3];
-                    }
-                    else
-                    {
-                        bbox.xmin = locData[startIdx + c * 4];
-                        bbox.ymin = locData[startIdx + c * 4 + 1];
-                        bbox.xmax = locData[startIdx + c * 4 + 2];
-                        bbox.ymax = locData[startIdx + c * 4 + 3];
-                    }
-                }
-            }
+            xmin[p] = locData[0];
+            ymin[p] = locData[1];
+            xmax[p] = locData[2];
+            ymax[p] = locData[3];
         }
     }
 
@@ -810,57 +764,105 @@ public:
                              const int numPredsPerClass, const int numClasses,
                              std::vector<Mat>& confPreds)
     {
-        int shape[] = { numClasses, numPredsPerClass };
-        for (int i = 0; i < num; i++)
-            confPreds.push_back(Mat(2, shape, CV_32F));
-
+        confPreds.resize(num);
         for (int i = 0; i < num; ++i, confData += numPredsPerClass * numClasses)
         {
-            Mat labelScores = confPreds[i];
-            for (int c = 0; c < numClasses; ++c)
-            {
-                for (int p = 0; p < numPredsPerClass; ++p)
-                {
-                    labelScores.at<float>(c, p) = confData[p * numClasses + c];
-                }
-            }
+            transpose(Mat(numPredsPerClass, numClasses, CV_32F, (void*)confData), confPreds[i]);
         }
     }
 
-    // Compute the jaccard (intersection over union IoU) overlap between two bboxes.
-    template<bool normalized>
-    static float JaccardOverlap(const util::NormalizedBBox& bbox1,
-                         const util::NormalizedBBox& bbox2)
+    // Compute the jaccard (intersection over union IoU) overlap between two bboxes
+    // and check that it's higher than a threshold.
+    static inline bool isOverlapped(float xmin1, float ymin1, float xmax1, float ymax1, float size1,
+                                    float xmin2, float ymin2, float xmax2, float ymax2, float size2,
+                                    float delta, float threshold)
     {
-        util::NormalizedBBox intersect_bbox;
-        intersect_bbox.xmin = std::max(bbox1.xmin, bbox2.xmin);
-        intersect_bbox.ymin = std::max(bbox1.ymin, bbox2.ymin);
-        intersect_bbox.xmax = std::min(bbox1.xmax, bbox2.xmax);
-        intersect_bbox.ymax = std::min(bbox1.ymax, bbox2.ymax);
-
-        float intersect_size = BBoxSize(intersect_bbox, normalized);
-        if (intersect_size > 0)
-        {
-            float bbox1_size = BBoxSize(bbox1, normalized);
-            float bbox2_size = BBoxSize(bbox2, normalized);
-            return intersect_size / (bbox1_size + bbox2_size - intersect_size);
-        }
-        else
-        {
-            return 0.;
-        }
+        float w = std::min(xmax1, xmax2) - std::max(xmin1, xmin2);
+        float h = std::min(ymax1, ymax2) - std::max(ymin1, ymin2);
+        if (w < 0 || h < 0)
+            return false;
+        float intersect_size = (w + delta) * (h + delta);
+        return intersect_size > 0 &&
+               !(intersect_size / (size1 + size2 - intersect_size) <= threshold);
     }
-};
 
-float util::caffe_box_overlap(const util::NormalizedBBox& a, const util::NormalizedBBox& b)
-{
-    return DetectionOutputLayerImpl::JaccardOverlap<false>(a, b);
-}
+    // Do non maximum suppression of bboxes of a single class.
+    // Kept bboxes are packed to contiguous arrays so a candidate is
+    // compared with several of them at once.
+    //    bboxes: decoded bboxes in SoA layout.
+    //    scores: corresponding confidences.
+    //    score_threshold: a threshold used to filter detection results.
+    //    nms_threshold: a threshold used in non maximum suppression.
+    //    top_k: if not > 0, keep at most top_k picked indices.
+    //    indices: the kept indices of bboxes after nms.
+    static void NMSFast(const Mat& bboxes, const float* scores, const float score_threshold,
+                        const float nms_threshold, const int top_k, const bool normalized,
+                        std::vector<int>& indices)
+    {
+        std::vector<std::pair<float, int> > score_index_vec;
+        GetMaxScoreIndex(scores, bboxes.cols, score_threshold, top_k, score_index_vec);
 
-float util::caffe_norm_box_overlap(const util::NormalizedBBox& a, const util::NormalizedBBox& b)
-{
-    return DetectionOutputLayerImpl::JaccardOverlap<true>(a, b);
-}
+        indices.clear();
+        const int numCandidates = (int)score_index_vec.size();
+        if (numCandidates == 0)
+            return;
+
+        const float* xmin = bboxes.ptr<float>(BBOX_XMIN);
+        const float* ymin = bboxes.ptr<float>(BBOX_YMIN);
+        const float* xmax = bboxes.ptr<float>(BBOX_XMAX);
+        const float* ymax = bboxes.ptr<float>(BBOX_YMAX);
+        const float* size = bboxes.ptr<float>(BBOX_SIZE);
+
+        AutoBuffer<float> buffer(numCandidates * BBOX_ROWS);
+        float* keptXmin = buffer;
+        float* keptYmin = keptXmin + numCandidates;
+        float* keptXmax = keptYmin + numCandidates;
+        float* keptYmax = keptXmax + numCandidates;
+        float* keptSize = keptYmax + numCandidates;
+        const float delta = normalized ? 0.0f : 1.0f;
+
+        int numKept = 0;
+        for (int i = 0; i < numCandidates; ++i)
+        {
+            const int idx = score_index_vec[i].second;
+            bool keep = true;
+            int k = 0;
+#if CV_SIMD128
+            v_float32x4 v_xmin = v_setall_f32(xmin[idx]), v_ymin = v_setall_f32(ymin[idx]);
+            v_float32x4 v_xmax = v_setall_f32(xmax[idx]), v_ymax = v_setall_f32(ymax[idx]);
+            v_float32x4 v_size = v_setall_f32(size[idx]);
+            v_float32x4 v_delta = v_setall_f32(delta), v_thr = v_setall_f32(nms_threshold);
+            v_float32x4 v_zero = v_setzero_f32();
+            for (; keep && k <= numKept - 4; k += 4)
+            {
+                v_float32x4 w = v_min(v_xmax, v_load(keptXmax + k)) - v_max(v_xmin, v_load(keptXmin + k));
+                v_float32x4 h = v_min(v_ymax, v_load(keptYmax + k)) - v_max(v_ymin, v_load(keptYmin + k));
+                v_float32x4 intersect_size = (w + v_delta) * (h + v_delta);
+                v_float32x4 overlap = intersect_size / (v_size + v_load(keptSize + k) - intersect_size);
+                v_float32x4 suppress = (w >= v_zero) & (h >= v_zero) & (intersect_size > v_zero) &
+                                       ~(overlap <= v_thr);
+                keep = !v_check_any(suppress);
+            }
+#endif
+            for (; keep && k < numKept; ++k)
+            {
+                keep = !isOverlapped(xmin[idx], ymin[idx], xmax[idx], ymax[idx], size[idx],
+                                     keptXmin[k], keptYmin[k], keptXmax[k], keptYmax[k], keptSize[k],
+                                     delta, nms_threshold);
+            }
+            if (keep)
+            {
+                keptXmin[numKept] = xmin[idx];
+                keptYmin[numKept] = ymin[idx];
+                keptXmax[numKept] = xmax[idx];
+                keptYmax[numKept] = ymax[idx];
+                keptSize[numKept] = size[idx];
+                ++numKept;
+                indices.push_back(idx);
+            }
+        }
+    }
+};
 
 const std::string DetectionOutputLayerImpl::_layerName = std::string("DetectionOutput");
 
@@ -59,7 +59,7 @@ using std::tanh;
 using std::pow;
 
 template<typename Func>
-class ElementWiseLayer : public Func::Layer
+class ElementWiseLayer : public Func::Layer, public BlockedLayoutLayer
 {
 public:
     class PBody : public cv::ParallelLoopBody
@@ -189,6 +189,12 @@ public:
         func.apply(src, dst, len, planeSize, cn0, cn1);
     }
 
+    // Blocks of channels are processed as channels with bigger planes.
+    bool setBlockedLayout(int, const std::vector<MatShape>&)
+    {
+        return true;
+    }
+
     virtual int64 getFLOPS(const std::vector<MatShape> &inputs,
                            const std::vector<MatShape> &outputs) const
     {
@@ -384,11 +390,7 @@ struct TanHFunctor
     {
         for( int cn = cn0; cn < cn1; cn++, srcptr += planeSize, dstptr += planeSize )
         {
-            for( int i = 0; i < len; i++ )
-            {
-                float x = srcptr[i];
-                dstptr[i] = tanh(x);
-            }
+            tanh32f(srcptr, dstptr, len);
         }
     }
 
@@ -419,11 +421,7 @@ struct SigmoidFunctor
     {
         for( int cn = cn0; cn < cn1; cn++, srcptr += planeSize, dstptr += planeSize )
         {
-            for( int i = 0; i < len; i++ )
-            {
-                float x = srcptr[i];
-                dstptr[i] = 1.f/(1.f + exp(-x));
-            }
+            sigmoid32f(srcptr, dstptr, len);
         }
     }
 
@@ -456,10 +454,25 @@ struct ELUFunctor
     {
         for( int cn = cn0; cn < cn1; cn++, srcptr += planeSize, dstptr += planeSize )
         {
-            for(int i = 0; i < len; i++ )
+            // exp is computed by blocks, srcptr and dstptr may be the same array
+            float buf[64];
+            for( int i0 = 0; i0 < len; i0 += 64 )
             {
-                float x = srcptr[i];
-                dstptr[i] = x >= 0.f ? x : exp(x) - 1;
+                int blockLen = std::min(len - i0, 64);
+                const float* x = srcptr + i0;
+                float* y = dstptr + i0;
+                exp32f(x, buf, blockLen);
+                int i = 0;
+#if CV_SIMD128
+                v_float32x4 one = v_setall_f32(1.f), z = v_setzero_f32();
+                for( ; i <= blockLen - 4; i += 4 )
+                {
+                    v_float32x4 x0 = v_load(x + i);
+                    v_store(y + i, v_select(x0 >= z, x0, v_load(buf + i) - one));
+                }
+#endif
+                for( ; i < blockLen; i++ )
+                    y[i] = x[i] >= 0.f ? x[i] : buf[i] - 1;
             }
         }
     }
@@ -691,6 +704,13 @@ Ptr<_Layer> _Layer::create() { \
     return return Ptr<_Layer>( new ElementWiseLayer<_Functor>(_Functor()) ); }
 
 
+// Slopes are indexed by channels.
+template<>
+bool ElementWiseLayer<ChannelsPReLUFunctor>::setBlockedLayout(int blockSize, const std::vector<MatShape>&)
+{
+    return blockSize == 0;
+}
+
 Ptr<ReLULayer> ReLULayer::create(const LayerParams& params)
 {
     float negativeSlope = params.get<float>("negative_slope", 0.f);
@@ -49,7 +49,7 @@ namespace cv
 namespace dnn
 {
 
-class EltwiseLayerImpl : public EltwiseLayer
+class EltwiseLayerImpl : public EltwiseLayer, public BlockedLayoutLayer
 {
 public:
     enum EltwiseOp
@@ -63,6 +63,7 @@ public:
     EltwiseLayerImpl(const LayerParams& params)
     {
         setParamsFrom(params);
+        blockSize = 0;
         op = SUM;
         if (params.has("operation"))
         {
@@ -111,7 +112,7 @@ public:
 
         outputs.assign(1, inputs[0]);
 
-        return false;
+        return true;
     }
 
     class EltwiseInvoker : public ParallelLoopBody
@@ -172,15 +173,81 @@ public:
             parallel_for_(Range(0, nstripes), p, nstripes);
         }
 
+        // Combines all the inputs in a single pass so every element is loaded and stored once.
+        // The output may be one of the inputs because the element is stored after all the loads.
+        static void reduceBlock(EltwiseOp op, const float* coeffs, const float** srcs, int n,
+                                float* dst, int len)
+        {
+            int j = 0, k;
+#if CV_SIMD128
+            for( ; j <= len - 8; j += 8 )
+            {
+                v_float32x4 a0 = v_load(srcs[0] + j), a1 = v_load(srcs[0] + j + 4);
+                if( op == SUM && coeffs )
+                {
+                    v_float32x4 c0 = v_setall_f32(coeffs[0]);
+                    a0 *= c0;
+                    a1 *= c0;
+                }
+                for( k = 1; k < n; k++ )
+                {
+                    v_float32x4 b0 = v_load(srcs[k] + j), b1 = v_load(srcs[k] + j + 4);
+                    if( op == PROD )
+                    {
+                        a0 *= b0;
+                        a1 *= b1;
+                    }
+                    else if( op == MAX )
+                    {
+                        a0 = v_max(a0, b0);
+                        a1 = v_max(a1, b1);
+                    }
+                    else if( coeffs )
+                    {
+                        v_float32x4 ck = v_setall_f32(coeffs[k]);
+                        a0 += b0*ck;
+                        a1 += b1*ck;
+                    }
+                    else
+                    {
+                        a0 += b0;
+                        a1 += b1;
+                    }
+                }
+                v_store(dst + j, a0);
+                v_store(dst + j + 4, a1);
+            }
+#endif
+            for( ; j < len; j++ )
+            {
+                float a = srcs[0][j];
+                if( op == SUM && coeffs )
+                    a *= coeffs[0];
+                for( k = 1; k < n; k++ )
+                {
+                    float b = srcs[k][j];
+                    if( op == PROD )
+                        a *= b;
+                    else if( op == MAX )
+                        a = std::max(a, b);
+                    else
+                        a += coeffs ? coeffs[k]*b : b;
+                }
+                dst[j] = a;
+            }
+        }
+
         void operator()(const Range& r) const
         {
             size_t total = dst->size[0]*planeSize;
             size_t stripeSize = (total + nstripes - 1)/nstripes;
             size_t stripeStart = r.start*stripeSize;
             size_t stripeEnd = std::min(r.end*stripeSize, total);
-            int c, j, k, n = nsrcs;
+            int c, k, n = nsrcs;
             const float* coeffsptr = coeffs && !coeffs->empty() ? &coeffs->at(0) : 0;
             float* dstptr0 = dst->ptr<float>();
+            AutoBuffer<const float*> srcptrs_(n);
+            const float** srcptrs = srcptrs_;
             int blockSize0 = 1 << 12, blockSize = blockSize0;
 
             for( size_t ofs = stripeStart; ofs < stripeEnd; ofs += blockSize )
@@ -194,60 +261,9 @@ public:
                 for( c = 0; c < channels; c++ )
                 {
                     size_t globalDelta = delta + (sampleIdx*channels + c)*planeSize;
-                    const float* srcptr0 = srcs[0]->ptr<float>() + globalDelta;
-                    float* dstptr = dstptr0 + globalDelta;
-
-                    if( op == PROD )
-                    {
-                        for( k = 1; k < n; k++ )
-                        {
-                            const float* srcptr1 = srcs[k]->ptr<float>() + globalDelta;
-                            for( j = 0; j < blockSize; j++ )
-                            {
-                                dstptr[j] = srcptr0[j]*srcptr1[j];
-                            }
-                            srcptr0 = (const float*)dstptr;
-                        }
-                    }
-                    else if( op == MAX )
-                    {
-                        for( k = 1; k < n; k++ )
-                        {
-                            const float* srcptr1 = srcs[k]->ptr<float>() + globalDelta;
-                            for( j = 0; j < blockSize; j++ )
-                            {
-                                dstptr[j] = std::max(srcptr0[j], srcptr1[j]);
-                            }
-                            srcptr0 = (const float*)dstptr;
-                        }
-                    }
-                    else if( !coeffsptr )
-                    {
-                        for( k = 1; k < n; k++ )
-                        {
-                            const float* srcptr1 = srcs[k]->ptr<float>() + globalDelta;
-                            for( j = 0; j < blockSize; j++ )
-                            {
-                                dstptr[j] = srcptr0[j] + srcptr1[j];
-                            }
-                            srcptr0 = (const float*)dstptr;
-                        }
-                    }
-                    else
-                    {
-                        float c0 = coeffsptr[0];
-                        for( k = 1; k < n; k++ )
-                        {
-                            const float* srcptr1 = srcs[k]->ptr<float>() + globalDelta;
-                            float c1 = coeffsptr[k];
-                            for( j = 0; j < blockSize; j++ )
-                            {
-                                dstptr[j] = c0*srcptr0[j] + c1*srcptr1[j];
-                            }
-                            srcptr0 = (const float*)dstptr;
-                            c0 = 1;
-                        }
-                    }
+                    for( k = 0; k < n; k++ )
+                        srcptrs[k] = srcs[k]->ptr<float>() + globalDelta;
+                    reduceBlock(op, coeffsptr, srcptrs, n, dstptr0 + globalDelta, blockSize);
                 }
 
                 if( activ )
@@ -274,6 +290,21 @@ public:
 
         CV_Assert(outputs.size() == 1);
         const int nstripes = getNumThreads();
+        if (blockSize)
+        {
+            // Elements of [N, C/b, H, W, b] blobs are processed as [N, C/b*H*W*b] ones.
+            std::vector<Mat> inps(inputs.size());
+            std::vector<const Mat*> inpPtrs(inputs.size());
+            for (size_t i = 0; i < inputs.size(); i++)
+            {
+                inps[i] = inputs[i]->reshape(1, inputs[i]->size[0]);
+                inpPtrs[i] = &inps[i];
+            }
+            Mat out = outputs[0].reshape(1, outputs[0].size[0]);
+            EltwiseInvoker::run(&inpPtrs[0], (int)inputs.size(), out,
+                                coeffs, op, activ.get(), nstripes);
+            return;
+        }
         EltwiseInvoker::run((const Mat**)&inputs[0], (int)inputs.size(), outputs[0],
                             coeffs, op, activ.get(), nstripes);
     }
@@ -341,7 +372,18 @@ public:
         return !activ.empty();
     }
 
+    bool setBlockedLayout(int blockSize_, const std::vector<MatShape>&)
+    {
+        // Parameters of fused activation may depend on channel.
+        if (blockSize_ && activ)
+            return false;
+        blockSize = blockSize_;
+        return true;
+    }
+
     Ptr<ActivationLayer> activ;
+    // Number of channels in a block for NCHWc layout, 0 for NCHW one.
+    int blockSize;
 };
 
 Ptr<EltwiseLayer> EltwiseLayer::create(const LayerParams& params)
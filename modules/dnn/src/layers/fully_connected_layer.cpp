@@ -55,10 +55,10 @@ namespace cv
 namespace dnn
 {
 
-class FullyConnectedLayerImpl : public InnerProductLayer
+class FullyConnectedLayerImpl : public InnerProductLayer, public WeightsTypeLayer, public KernelVariantLayer
 {
 public:
-    enum { VEC_ALIGN = 8 };
+    enum { VEC_ALIGN = 8, WBLOCK_ROWS = 8 };
 
 #ifdef HAVE_OPENCL
     Ptr<OCL4DNNInnerProduct<float> > innerProductOp;
@@ -74,27 +74,21 @@ public:
         int innerSize = (int)blobs[0].total() / numOutput;
         bias = params.get<bool>("bias_term", true);
         axis = params.get<int>("axis", 1);
+        sparseDensity = params.get<float>("sparse_density", getSparseWeightsDensity());
 
         CV_Assert(blobs[0].dims >= 2 && (size_t)(innerSize * numOutput) == blobs[0].total());
         CV_Assert(!bias || (blobs.size() == 2 && (size_t)numOutput == blobs[1].total()));
 
-        weightsMat = blobs[0] = blobs[0].reshape(1, numOutput);
-        int vecsize = weightsMat.cols;
-        if( vecsize % VEC_ALIGN != 0 )
-        {
-            int vecsize_aligned = (int)alignSize(vecsize, VEC_ALIGN);
-            Mat weightsBuf(weightsMat.rows, vecsize_aligned, weightsMat.type());
-            Mat wpadding = weightsBuf.colRange(vecsize, vecsize_aligned);
-            wpadding.setTo(Scalar::all(0.));
-            weightsMat = weightsBuf.colRange(0, vecsize);
-            blobs[0].copyTo(weightsMat);
-        }
+        blobs[0] = blobs[0].reshape(1, numOutput);
+        weightsMat = alignWeights(blobs[0]);
 
         if (bias)
             biasMat = blobs[1] = blobs[1].reshape(1, 1);
         else
             biasMat = Mat::zeros(1, numOutput, weightsMat.type());
 
+        initSparseWeights();
+
 #ifdef HAVE_OPENCL
         size_t n = blobs.size();
         umat_blobs.resize(n);
@@ -124,6 +118,34 @@ public:
         return false;
     }
 
+    // weights may refer to the unaligned data of the model file
+    static Mat alignWeights(const Mat& weights)
+    {
+        int vecsize = weights.cols;
+        if( vecsize % VEC_ALIGN == 0 && (size_t)weights.data % (VEC_ALIGN*sizeof(float)) == 0 )
+            return weights;
+        int vecsize_aligned = (int)alignSize(vecsize, VEC_ALIGN);
+        Mat weightsBuf(weights.rows, vecsize_aligned, weights.type());
+        Mat wpadding = weightsBuf.colRange(vecsize, vecsize_aligned);
+        wpadding.setTo(Scalar::all(0.));
+        Mat aligned = weightsBuf.colRange(0, vecsize);
+        weights.copyTo(aligned);
+        return aligned;
+    }
+
+    // pruned weights are multiplied by sparse kernels if there are enough zero blocks
+    void initSparseWeights()
+    {
+        sparseWeights.release();
+        if (weightsMat.depth() == CV_32F &&
+            getWeightsDensity(weightsMat, SparseWeights::BLOCK) < sparseDensity)
+        {
+            sparseWeights = SparseWeights(weightsMat);
+            // the sparse kernel uses only the shape of the dense weights, the aligned copy is released
+            weightsMat = blobs[0];
+        }
+    }
+
     virtual bool supportBackend(int backendId)
     {
         return backendId == DNN_BACKEND_DEFAULT ||
@@ -136,30 +158,57 @@ public:
         return !activ.empty();
     }
 
+    virtual bool setWeightsType(int weightsType)
+    {
+        int depth = getWeightsDepth(weightsType);
+        if (weightsMat.depth() == depth)
+            return true;
+
+        // the dense kernels need the aligned weights released by the sparse one
+        if (!sparseWeights.empty())
+            weightsMat = alignWeights(blobs[0]);
+        // convert whole rows to keep zero padding
+        int vecsize = weightsMat.cols;
+        Mat weightsBuf(weightsMat.rows, (int)weightsMat.step1(), weightsMat.type(), weightsMat.data);
+        convertWeights(weightsBuf, weightsBuf, depth);
+        weightsMat = weightsBuf.colRange(0, vecsize);
+        // only the converted weights are kept
+        blobs[0] = depth == CV_32F && !weightsMat.isContinuous() ? weightsMat.clone() : weightsMat;
+        initSparseWeights();
+#ifdef HAVE_OPENCL
+        umat_blobs[0] = depth == CV_32F ? blobs[0].getUMat(ACCESS_READ) : UMat();
+#endif
+        return true;
+    }
+
     class FullyConnected : public ParallelLoopBody
     {
     public:
-        FullyConnected() : srcMat(0), weights(0), biasMat(0), activ(0), dstMat(0), nstripes(0), useAVX(false), useAVX2(false) {}
+        FullyConnected() : srcMat(0), weights(0), biasMat(0), sparseWeights(0), activ(0), dstMat(0),
+                           nstripes(0), useAVX2(false) {}
 
         static void run(const Mat& srcMat, const Mat& weights, const Mat& biasMat,
+                        const SparseWeights& sparseWeights,
                         Mat& dstMat, const ActivationLayer* activ, int nstripes)
         {
             CV_Assert( srcMat.dims == 2 && srcMat.cols == weights.cols &&
                        dstMat.rows == srcMat.rows && dstMat.cols == weights.rows &&
-                       srcMat.type() == weights.type() && weights.type() == dstMat.type() &&
-                       srcMat.type() == CV_32F &&
+                       srcMat.type() == dstMat.type() && srcMat.type() == CV_32F &&
+                       (weights.type() == CV_32F || weights.type() == CV_16S || weights.type() == CV_16U) &&
                        (biasMat.empty() || (biasMat.type() == srcMat.type() &&
-                                           biasMat.isContinuous() && (int)biasMat.total() == dstMat.cols)) );
+                                           biasMat.isContinuous() && (int)biasMat.total() == dstMat.cols)) &&
+                       (sparseWeights.empty() || (sparseWeights.rows == weights.rows &&
+                                                 sparseWeights.cols == weights.cols)) );
 
             FullyConnected p;
 
             p.srcMat = &srcMat;
             p.weights = &weights;
             p.biasMat = &biasMat;
+            p.sparseWeights = sparseWeights.empty() ? 0 : &sparseWeights;
             p.dstMat = &dstMat;
             p.nstripes = nstripes;
             p.activ = activ;
-            p.useAVX = checkHardwareSupport(CPU_AVX);
             p.useAVX2 = checkHardwareSupport(CPU_AVX2);
 
             parallel_for_(Range(0, nstripes), p, nstripes);
@@ -183,63 +232,55 @@ public:
             for( k = vecsize; k < vecsize_aligned; k++ )
                 sptr[k] = 0.f;
 
+            // weights in FP16/BF16 formats are converted by blocks of rows if there is no AVX2
+            bool convertWeightsRows = !sparseWeights && weights->depth() != CV_32F && !useAVX2;
+            if( convertWeightsRows )
+            {
+                // the stripes split the weights rows, every block of rows is converted once for all the samples
+                AutoBuffer<float> wbuf_(WBLOCK_ROWS*vecsize_aligned + valign);
+                float* wbuf = alignPtr((float*)wbuf_, (int)(valign*sizeof(float)));
+                memset(wbuf, 0, WBLOCK_ROWS*vecsize_aligned*sizeof(wbuf[0]));
+                int rowStart = (int)((size_t)r.start*nw0/nstripes), rowEnd = (int)((size_t)r.end*nw0/nstripes);
+
+                for( int i = rowStart; i < rowEnd; i += WBLOCK_ROWS )
+                {
+                    int nrows = std::min(rowEnd - i, (int)WBLOCK_ROWS);
+                    Mat wblock(nrows, vecsize, CV_32F, wbuf, vecsize_aligned*sizeof(float));
+                    convertWeights(weights->rowRange(i, i + nrows), wblock, CV_32F);
+                    for( int sampleIdx = 0; sampleIdx < nsamples; sampleIdx++ )
+                    {
+                        memcpy(sptr, srcMat->ptr<float>(sampleIdx), vecsize*sizeof(sptr[0]));
+                        float* dptr = dstMat->ptr<float>(sampleIdx) + i;
+                        fastGEMM1T(sptr, wbuf, vecsize_aligned, biasMat->ptr<float>() + i, dptr, nrows, vecsize);
+                        if(activ)
+                            activ->forwardSlice(dptr, dptr, 1, 1, i, i + nrows);
+                    }
+                }
+                return;
+            }
+
             for( size_t ofs = stripeStart; ofs < stripeEnd; )
             {
                 int sampleIdx = (int)(ofs / nw0);
                 int delta = (int)(ofs - (size_t)sampleIdx*nw0);
                 const float* sptr_ = srcMat->ptr<float>(sampleIdx);
-                const float* wptr = weights->ptr<float>(delta);
                 float* dptr = dstMat->ptr<float>(sampleIdx) + delta;
                 const float* biasptr = biasMat->ptr<float>() + delta;
                 int nw = std::min(nw0 - delta, (int)(stripeEnd - ofs));
 
                 memcpy(sptr, sptr_, vecsize*sizeof(sptr[0]));
 
-            #if CV_TRY_AVX2
-                if( useAVX2 )
-                    opt_AVX2::fastGEMM1T( sptr, wptr, wstep, biasptr, dptr, nw, vecsize);
+                if( sparseWeights )
+                    sparseGEMV(*sparseWeights, sptr, biasptr, dptr, delta, delta + nw);
+                else if( weights->depth() == CV_32F )
+                    fastGEMM1T(sptr, weights->ptr<float>(delta), wstep, biasptr, dptr, nw, vecsize);
                 else
-            #endif
-            #if CV_TRY_AVX
-                if( useAVX )
-                    opt_AVX::fastGEMM1T( sptr, wptr, wstep, biasptr, dptr, nw, vecsize);
-                else
-            #endif
                 {
-                    int i = 0;
-
-            #if CV_SIMD128
-                    for( ; i <= nw - 4; i += 4, wptr += 4*wstep )
-                    {
-                        v_float32x4 vs0 = v_setall_f32(0.f), vs1 = v_setall_f32(0.f);
-                        v_float32x4 vs2 = v_setall_f32(0.f), vs3 = v_setall_f32(0.f);
-
-                        for( k = 0; k < vecsize; k += 4 )
-                        {
-                            v_float32x4 v = v_load_aligned(sptr + k);
-                            vs0 += v*v_load_aligned(wptr + k);
-                            vs1 += v*v_load_aligned(wptr + wstep + k);
-                            vs2 += v*v_load_aligned(wptr + wstep*2 + k);
-                            vs3 += v*v_load_aligned(wptr + wstep*3 + k);
-                        }
-
-                        v_float32x4 s = v_reduce_sum4(vs0, vs1, vs2, vs3);
-                        s += v_load(biasptr + i);
-                        v_store(dptr + i, s);
-                    }
+                    // FP16/BF16 weights without AVX2 are handled above
+            #if CV_TRY_AVX2
+                    opt_AVX2::fastGEMM1T( sptr, weights->ptr<ushort>(delta), weights->depth(),
+                                          wstep, biasptr, dptr, nw, vecsize);
             #endif
-
-                    for( ; i < nw; i++, wptr += wstep )
-                    {
-                        float s0=biasptr[i];
-
-                        for( k = 0; k < vecsize; k++ )
-                        {
-                            float v = sptr[k];
-                            s0 += v*wptr[k];
-                        }
-                        dptr[i] = s0;
-                    }
                 }
 
                 if(activ)
@@ -250,10 +291,10 @@ public:
         }
 
         const Mat *srcMat, *weights, *biasMat;
+        const SparseWeights* sparseWeights;
         const ActivationLayer* activ;
         Mat* dstMat;
         int nstripes;
-        bool useAVX;
         bool useAVX2;
     };
 
@@ -360,7 +401,7 @@ public:
             Mat dstMat = output[i].reshape(1, outerSize);
 
             const int nstripes = getNumThreads();
-            FullyConnected::run(srcMat, weightsMat, biasMat, dstMat, activ.get(), nstripes);
+            FullyConnected::run(srcMat, weightsMat, biasMat, sparseWeights, dstMat, activ.get(), nstripes);
         }
     }
 
@@ -388,6 +429,11 @@ public:
         return Ptr<BackendNode>();
     }
 
+    virtual String getKernelVariant() const
+    {
+        return getKernelVariantName(!sparseWeights.empty(), weightsMat.depth());
+    }
+
     virtual int64 getFLOPS(const std::vector<MatShape> &inputs,
                            const std::vector<MatShape> &outputs) const
     {
@@ -406,6 +452,8 @@ public:
 
     bool bias;
     Mat weightsMat, biasMat;
+    SparseWeights sparseWeights;
+    float sparseDensity;
     Ptr<ActivationLayer> activ;
 };
 
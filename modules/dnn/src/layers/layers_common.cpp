@@ -41,6 +41,9 @@
 //M*/
 
 #include "layers_common.hpp"
+#include "opencv2/core/hal/hal.hpp"
+#include "opencv2/core/hal/intrin.hpp"
+#include "opencv2/core/utils/configuration.private.hpp"
 
 namespace cv
 {
@@ -203,5 +206,465 @@ void getConvPoolPaddings(const Size& inp, const Size& out,
     }
 }
 
+bool setBlockedLayout(const Ptr<Layer>& layer, int blockSize, const std::vector<MatShape> &inputs)
+{
+    BlockedLayoutLayer* blockedLayer = dynamic_cast<BlockedLayoutLayer*>(layer.get());
+    if (!blockedLayer)
+        return blockSize == 0;
+    return blockedLayer->setBlockedLayout(blockSize, inputs);
+}
+
+bool setWeightsType(const Ptr<Layer>& layer, int weightsType)
+{
+    WeightsTypeLayer* weightsLayer = dynamic_cast<WeightsTypeLayer*>(layer.get());
+    if (!weightsLayer)
+        return weightsType == DNN_WEIGHTS_FP32;
+    return weightsLayer->setWeightsType(weightsType);
+}
+
+String getKernelVariant(const Ptr<Layer>& layer)
+{
+    const KernelVariantLayer* variantLayer = dynamic_cast<const KernelVariantLayer*>(layer.get());
+    return variantLayer ? variantLayer->getKernelVariant() : String();
+}
+
+int getWeightsDepth(int weightsType)
+{
+    switch (weightsType)
+    {
+        case DNN_WEIGHTS_FP32: return CV_32F;
+        case DNN_WEIGHTS_FP16: return CV_16S;
+        case DNN_WEIGHTS_BF16: return CV_16U;
+    }
+    CV_Error(Error::StsBadArg, format("Unknown weights type %d", weightsType));
+    return -1;
+}
+
+static void convertToBF16(const float* src_, ushort* dst, size_t n)
+{
+    const unsigned* src = (const unsigned*)src_;
+    size_t i = 0;
+#if CV_SIMD128
+    v_uint32x4 v_one = v_setall_u32(1), v_half = v_setall_u32(0x7fff);
+    for (; i + 8 <= n; i += 8)
+    {
+        // Round to nearest even.
+        v_uint32x4 v0 = v_load(src + i), v1 = v_load(src + i + 4);
+        v0 = (v0 + v_half + ((v0 >> 16) & v_one)) >> 16;
+        v1 = (v1 + v_half + ((v1 >> 16) & v_one)) >> 16;
+        v_store(dst + i, v_pack(v0, v1));
+    }
+#endif
+    for (; i < n; i++)
+        dst[i] = (ushort)((src[i] + 0x7fff + ((src[i] >> 16) & 1)) >> 16);
+}
+
+static void convertFromBF16(const ushort* src, float* dst_, size_t n)
+{
+    unsigned* dst = (unsigned*)dst_;
+    size_t i = 0;
+#if CV_SIMD128
+    for (; i + 8 <= n; i += 8)
+    {
+        v_uint32x4 v0, v1;
+        v_expand(v_load(src + i), v0, v1);
+        v_store(dst + i, v0 << 16);
+        v_store(dst + i + 4, v1 << 16);
+    }
+#endif
+    for (; i < n; i++)
+        dst[i] = (unsigned)src[i] << 16;
+}
+
+void convertWeights(const Mat& src_, Mat& dst_, int ddepth)
+{
+    // Keep the source alive if it's replaced by the destination.
+    Mat src = src_;
+    int sdepth = src.depth();
+    CV_Assert(src.channels() == 1,
+              sdepth == CV_32F || sdepth == CV_16S || sdepth == CV_16U,
+              ddepth == CV_32F || ddepth == CV_16S || ddepth == CV_16U);
+    if (sdepth == ddepth)
+    {
+        src.copyTo(dst_);
+        return;
+    }
+    if (sdepth != CV_32F && ddepth != CV_32F)
+    {
+        Mat tmp;
+        convertWeights(src, tmp, CV_32F);
+        convertWeights(tmp, dst_, ddepth);
+        return;
+    }
+    if (sdepth == CV_16S || ddepth == CV_16S)
+    {
+        convertFp16(src, dst_);
+        return;
+    }
+
+    dst_.create(src.dims, src.size, ddepth);
+    Mat dst = dst_;
+    if (src.dims <= 2)
+    {
+        for (int i = 0; i < src.rows; i++)
+        {
+            if (ddepth == CV_16U)
+                convertToBF16(src.ptr<float>(i), dst.ptr<ushort>(i), src.cols);
+            else
+                convertFromBF16(src.ptr<ushort>(i), dst.ptr<float>(i), src.cols);
+        }
+    }
+    else
+    {
+        const Mat* arrays[] = {&src, &dst, 0};
+        uchar* ptrs[2];
+        NAryMatIterator it(arrays, ptrs);
+        for (size_t i = 0; i < it.nplanes; i++, ++it)
+        {
+            if (ddepth == CV_16U)
+                convertToBF16((const float*)ptrs[0], (ushort*)ptrs[1], it.size);
+            else
+                convertFromBF16((const ushort*)ptrs[0], (float*)ptrs[1], it.size);
+        }
+    }
+}
+
+SparseWeights::SparseWeights(const Mat& weights)
+{
+    CV_Assert(weights.dims == 2, weights.type() == CV_32F);
+    rows = weights.rows;
+    cols = weights.cols;
+    rowofs.resize(rows + 1);
+    rowofs[0] = 0;
+    for (int i = 0; i < rows; i++)
+    {
+        const float* wptr = weights.ptr<float>(i);
+        for (int j = 0; j < cols; j += BLOCK)
+        {
+            int k, n = std::min(cols - j, (int)BLOCK);
+            for (k = 0; k < n && wptr[j + k] == 0.f; k++)
+                ;
+            if (k == n)
+                continue;
+            colidx.push_back(j);
+            for (k = 0; k < BLOCK; k++)
+                values.push_back(k < n ? wptr[j + k] : 0.f);
+        }
+        rowofs[i + 1] = (int)colidx.size();
+    }
+}
+
+void SparseWeights::release()
+{
+    rows = cols = 0;
+    rowofs.clear();
+    colidx.clear();
+    values.clear();
+}
+
+float getWeightsDensity(const Mat& weights, int blockSize)
+{
+    CV_Assert(weights.dims == 2, weights.type() == CV_32F, blockSize > 0);
+    if (weights.empty())
+        return 1.f;
+    size_t nonzeros = 0;
+    for (int i = 0; i < weights.rows; i++)
+    {
+        const float* wptr = weights.ptr<float>(i);
+        for (int j = 0; j < weights.cols; j += blockSize)
+        {
+            int k, n = std::min(weights.cols - j, blockSize);
+            for (k = 0; k < n && wptr[j + k] == 0.f; k++)
+                ;
+            nonzeros += k < n;
+        }
+    }
+    int blocksPerRow = (weights.cols + blockSize - 1) / blockSize;
+    return (float)((double)nonzeros / ((double)weights.rows * blocksPerRow));
+}
+
+float getSparseWeightsDensity()
+{
+    static float density = (float)utils::getConfigurationParameterSizeT("OPENCV_DNN_SPARSE_WEIGHTS_DENSITY", 40) * 0.01f;
+    return density;
+}
+
+String getKernelVariantName(bool sparse, int weightsDepth)
+{
+    String name = "generic";
+    if (sparse)
+        name = "sparse";
+#if CV_TRY_AVX2
+    else if (checkHardwareSupport(CPU_AVX2))
+        name = "avx2";
+#endif
+#if CV_TRY_AVX
+    else if (checkHardwareSupport(CPU_AVX))
+        name = "avx";
+#endif
+    if (weightsDepth == CV_16S)
+        name += "_fp16";
+    else if (weightsDepth == CV_16U)
+        name += "_bf16";
+    return name;
+}
+
+// The activations are computed by blocks, so src and dst may be the same array.
+enum { ACTIV_BLOCK = 64 };
+
+void exp32f(const float* src, float* dst, int n)
+{
+    // hal::exp32f clamps the argument and turns NaN into a finite value, NaN is restored from the copy.
+    float buf[ACTIV_BLOCK];
+    for (int i0 = 0; i0 < n; i0 += ACTIV_BLOCK)
+    {
+        int len = std::min(n - i0, (int)ACTIV_BLOCK);
+        float* y = dst + i0;
+        memcpy(buf, src + i0, len*sizeof(buf[0]));
+        hal::exp32f(buf, y, len);
+        int i = 0;
+#if CV_SIMD128
+        for (; i <= len - 4; i += 4)
+        {
+            v_float32x4 x = v_load(buf + i);
+            v_store(y + i, v_select(x != x, x, v_load(y + i)));
+        }
+#endif
+        for (; i < len; i++)
+        {
+            if (buf[i] != buf[i])
+                y[i] = buf[i];
+        }
+    }
+}
+
+// sigmoid(x) = 1 / (1 + exp(-x))
+void sigmoid32f(const float* src, float* dst, int n)
+{
+    float buf[ACTIV_BLOCK];
+    for (int i0 = 0; i0 < n; i0 += ACTIV_BLOCK)
+    {
+        int len = std::min(n - i0, (int)ACTIV_BLOCK);
+        const float* x = src + i0;
+        float* y = dst + i0;
+        int i = 0;
+#if CV_SIMD128
+        v_float32x4 zero = v_setzero_f32(), one = v_setall_f32(1.f);
+        for (; i <= len - 4; i += 4)
+            v_store(buf + i, zero - v_load(x + i));
+#endif
+        for (; i < len; i++)
+            buf[i] = -x[i];
+
+        exp32f(buf, buf, len);
+
+        i = 0;
+#if CV_SIMD128
+        for (; i <= len - 4; i += 4)
+            v_store(y + i, one / (one + v_load(buf + i)));
+#endif
+        for (; i < len; i++)
+            y[i] = 1.f / (1.f + buf[i]);
+    }
+}
+
+// tanh(x) = sign(x) * (1 - exp(-2|x|)) / (1 + exp(-2|x|)) keeps the odd symmetry. The difference loses
+// precision near zero, where the Taylor series up to x^7 is used instead (its error is below 1e-7 for |x| < 0.25).
+void tanh32f(const float* src, float* dst, int n)
+{
+    float buf[ACTIV_BLOCK];
+    const float c3 = -1.f/3, c5 = 2.f/15, c7 = -17.f/315, small = 0.25f;
+    for (int i0 = 0; i0 < n; i0 += ACTIV_BLOCK)
+    {
+        int len = std::min(n - i0, (int)ACTIV_BLOCK);
+        const float* x = src + i0;
+        float* y = dst + i0;
+        int i = 0;
+#if CV_SIMD128
+        v_float32x4 vm2 = v_setall_f32(-2.f);
+        for (; i <= len - 4; i += 4)
+            v_store(buf + i, v_abs(v_load(x + i)) * vm2);
+#endif
+        for (; i < len; i++)
+            buf[i] = -2.f*std::abs(x[i]);
+
+        exp32f(buf, buf, len);
+
+        i = 0;
+#if CV_SIMD128
+        v_float32x4 one = v_setall_f32(1.f), zero = v_setzero_f32(), vsmall = v_setall_f32(small);
+        v_float32x4 vc3 = v_setall_f32(c3), vc5 = v_setall_f32(c5), vc7 = v_setall_f32(c7);
+        for (; i <= len - 4; i += 4)
+        {
+            v_float32x4 vx = v_load(x + i), e = v_load(buf + i);
+            v_float32x4 t = (one - e) / (one + e);
+            t = v_select(vx < zero, zero - t, t);
+            v_float32x4 x2 = vx * vx;
+            v_float32x4 p = vx + vx * x2 * v_muladd(x2, v_muladd(x2, vc7, vc5), vc3);
+            v_store(y + i, v_select(v_abs(vx) < vsmall, p, t));
+        }
+#endif
+        for (; i < len; i++)
+        {
+            float xi = x[i], e = buf[i];
+            if (std::abs(xi) < small)
+            {
+                float x2 = xi*xi;
+                y[i] = xi + xi*x2*(c3 + x2*(c5 + x2*c7));
+            }
+            else
+            {
+                float t = (1.f - e)/(1.f + e);
+                y[i] = xi < 0 ? -t : t;
+            }
+        }
+    }
+}
+
+void fastGEMM1T(const float* vec, const float* weights, size_t wstep, const float* bias,
+                float* dst, int nvecs, int vecsize)
+{
+#if CV_TRY_AVX2
+    if (checkHardwareSupport(CPU_AVX2))
+    {
+        opt_AVX2::fastGEMM1T(vec, weights, wstep, bias, dst, nvecs, vecsize);
+        return;
+    }
+#endif
+#if CV_TRY_AVX
+    if (checkHardwareSupport(CPU_AVX))
+    {
+        opt_AVX::fastGEMM1T(vec, weights, wstep, bias, dst, nvecs, vecsize);
+        return;
+    }
+#endif
+    int i = 0, k;
+    const float* wptr = weights;
+#if CV_SIMD128
+    for (; i <= nvecs - 4; i += 4, wptr += 4*wstep)
+    {
+        v_float32x4 vs0 = v_setall_f32(0.f), vs1 = v_setall_f32(0.f);
+        v_float32x4 vs2 = v_setall_f32(0.f), vs3 = v_setall_f32(0.f);
+
+        for (k = 0; k < vecsize; k += 4)
+        {
+            v_float32x4 v = v_load_aligned(vec + k);
+            vs0 += v*v_load_aligned(wptr + k);
+            vs1 += v*v_load_aligned(wptr + wstep + k);
+            vs2 += v*v_load_aligned(wptr + wstep*2 + k);
+            vs3 += v*v_load_aligned(wptr + wstep*3 + k);
+        }
+
+        v_float32x4 s = v_reduce_sum4(vs0, vs1, vs2, vs3);
+        v_store(dst + i, s + v_load(bias + i));
+    }
+#endif
+    for (; i < nvecs; i++, wptr += wstep)
+    {
+        float s0 = bias[i];
+        for (k = 0; k < vecsize; k++)
+            s0 += vec[k]*wptr[k];
+        dst[i] = s0;
+    }
+}
+
+void sparseGEMV(const SparseWeights& weights, const float* vec, const float* bias,
+                float* dst, int rowStart, int rowEnd)
+{
+    CV_Assert(0 <= rowStart && rowStart <= rowEnd && rowEnd <= weights.rows);
+    const int* rowofs = &weights.rowofs[0];
+    const int* colidx = weights.colidx.empty() ? 0 : &weights.colidx[0];
+    const float* values = weights.values.empty() ? 0 : &weights.values[0];
+
+    for (int i = rowStart; i < rowEnd; i++)
+    {
+        int b = rowofs[i], bend = rowofs[i + 1];
+        float s = bias ? bias[i - rowStart] : 0.f;
+#if CV_SIMD128
+        v_float32x4 vs0 = v_setzero_f32(), vs1 = v_setzero_f32();
+        for (; b + 2 <= bend; b += 2)
+        {
+            vs0 = v_muladd(v_load(vec + colidx[b]), v_load(values + b*SparseWeights::BLOCK), vs0);
+            vs1 = v_muladd(v_load(vec + colidx[b + 1]), v_load(values + (b + 1)*SparseWeights::BLOCK), vs1);
+        }
+        if (b < bend)
+        {
+            vs0 = v_muladd(v_load(vec + colidx[b]), v_load(values + b*SparseWeights::BLOCK), vs0);
+            b++;
+        }
+        s += v_reduce_sum(vs0 + vs1);
+#endif
+        for (; b < bend; b++)
+        {
+            const float* v = vec + colidx[b];
+            const float* w = values + b*SparseWeights::BLOCK;
+            for (int k = 0; k < SparseWeights::BLOCK; k++)
+                s += v[k]*w[k];
+        }
+        dst[i - rowStart] = s;
+    }
+}
+
+void sparseGEMM(const SparseWeights& weights, const float* src, size_t srcstep,
+                const float* bias, float* dst, size_t dststep, int n,
+                int rowStart, int rowEnd)
+{
+    CV_Assert(0 <= rowStart && rowStart <= rowEnd && rowEnd <= weights.rows);
+    const int* rowofs = &weights.rowofs[0];
+    const int* colidx = weights.colidx.empty() ? 0 : &weights.colidx[0];
+    const float* values = weights.values.empty() ? 0 : &weights.values[0];
+
+    for (int i = rowStart; i < rowEnd; i++, dst += dststep)
+    {
+        int bstart = rowofs[i], bend = rowofs[i + 1];
+        float b0 = bias ? bias[i - rowStart] : 0.f;
+        int j = 0;
+#if CV_SIMD128
+        // columns of the output row are processed by strips which are kept in registers
+        v_float32x4 vb0 = v_setall_f32(b0);
+        for (; j <= n - 16; j += 16)
+        {
+            v_float32x4 vs0 = vb0, vs1 = vb0, vs2 = vb0, vs3 = vb0;
+            for (int b = bstart; b < bend; b++)
+            {
+                const float* w = values + b*SparseWeights::BLOCK;
+                for (int k = 0; k < SparseWeights::BLOCK; k++)
+                {
+                    if (w[k] == 0.f)
+                        continue;
+                    const float* sptr = src + (colidx[b] + k)*srcstep + j;
+                    v_float32x4 vw = v_setall_f32(w[k]);
+                    vs0 = v_muladd(v_load(sptr), vw, vs0);
+                    vs1 = v_muladd(v_load(sptr + 4), vw, vs1);
+                    vs2 = v_muladd(v_load(sptr + 8), vw, vs2);
+                    vs3 = v_muladd(v_load(sptr + 12), vw, vs3);
+                }
+            }
+            v_store(dst + j, vs0);
+            v_store(dst + j + 4, vs1);
+            v_store(dst + j + 8, vs2);
+            v_store(dst + j + 12, vs3);
+        }
+#endif
+        if (j < n)
+        {
+            for (int l = j; l < n; l++)
+                dst[l] = b0;
+            for (int b = bstart; b < bend; b++)
+            {
+                const float* w = values + b*SparseWeights::BLOCK;
+                for (int k = 0; k < SparseWeights::BLOCK; k++)
+                {
+                    if (w[k] == 0.f)
+                        continue;
+                    const float* sptr = src + (colidx[b] + k)*srcstep;
+                    for (int l = j; l < n; l++)
+                        dst[l] += w[k]*sptr[l];
+                }
+            }
+        }
+    }
+}
+
 }
 }
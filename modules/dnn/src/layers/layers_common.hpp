@@ -74,6 +74,120 @@ void getConvPoolPaddings(const Size& inp, const Size& out,
                          const Size &kernel, const Size &stride,
                          const String &padMode, const Size &dilation, Size &pad);
 
+// Layers which can compute their blobs in the blocked layout of channels. It is an internal
+// extension of Layer, the net finds it with dynamic_cast.
+class BlockedLayoutLayer
+{
+public:
+    virtual ~BlockedLayoutLayer() {}
+
+    // Tries to switch the layer to the blocked layout of channels: blockSize channels in a block
+    // or 0 to switch back to the plain layout. inputs are shapes of the layer inputs in the plain layout.
+    // In the blocked layout 4-dimensional [N, C, H, W] blobs are stored as
+    // [N, ceil(C/blockSize), H, W, blockSize] arrays where the last block is padded.
+    // Returns true if the layer computes its inputs and outputs in the requested layout.
+    virtual bool setBlockedLayout(int blockSize, const std::vector<MatShape> &inputs) = 0;
+};
+
+// Calls BlockedLayoutLayer::setBlockedLayout for the layers which implement it,
+// the other layers support only the plain layout.
+bool setBlockedLayout(const Ptr<Layer>& layer, int blockSize, const std::vector<MatShape> &inputs);
+
+// Layers which can keep weights in FP16 and BF16 formats. It is an internal extension of Layer,
+// the net finds it with dynamic_cast.
+class WeightsTypeLayer
+{
+public:
+    virtual ~WeightsTypeLayer() {}
+
+    // Tries to store weights of the layer in the requested format, one of WeightsType values.
+    // Weights in DNN_WEIGHTS_FP16 and DNN_WEIGHTS_BF16 formats are kept in blobs as CV_16S and CV_16U
+    // matrices correspondingly and converted to single precision during computations.
+    // Returns true if the layer keeps weights in the requested format.
+    virtual bool setWeightsType(int weightsType) = 0;
+};
+
+// Calls WeightsTypeLayer::setWeightsType for the layers which implement it,
+// the other layers keep weights only in single precision.
+bool setWeightsType(const Ptr<Layer>& layer, int weightsType);
+
+// Returns a depth of matrices which keep weights of the given WeightsType:
+// CV_32F for DNN_WEIGHTS_FP32, CV_16S for DNN_WEIGHTS_FP16 and CV_16U for DNN_WEIGHTS_BF16.
+int getWeightsDepth(int weightsType);
+
+// Converts weights between the depths above. Conversion to BF16 rounds to nearest even.
+void convertWeights(const Mat& src, Mat& dst, int ddepth);
+
+// Single precision weights matrix in the blocked compressed sparse row format:
+// every row keeps only blocks of BLOCK consecutive columns (starting at multiples
+// of BLOCK) which contain at least one nonzero value.
+struct SparseWeights
+{
+    enum { BLOCK = 4 };
+
+    SparseWeights() : rows(0), cols(0) {}
+    explicit SparseWeights(const Mat& weights);
+
+    bool empty() const { return rowofs.empty(); }
+    void release();
+
+    int rows, cols;
+    std::vector<int> rowofs;    // rows + 1 indices of the first block of every row
+    std::vector<int> colidx;    // first column of every block
+    std::vector<float> values;  // BLOCK values of every block
+};
+
+// Returns a fraction of blocks of blockSize consecutive columns which contain nonzero values.
+float getWeightsDensity(const Mat& weights, int blockSize = 1);
+
+// Returns a maximal weights density for which layers use sparse kernels:
+// OPENCV_DNN_SPARSE_WEIGHTS_DENSITY (in percents, 40 by default). Zero disables sparse kernels.
+// Layers release their aligned or fused dense copies of the weights when they switch to a sparse
+// kernel. Layer::blobs still keeps the model weights for serialization and the other backends.
+float getSparseWeightsDensity();
+
+// Layers with several computational kernels. It is an internal extension of Layer which
+// fills LayerProfile::kernel, the net finds it with dynamic_cast.
+class KernelVariantLayer
+{
+public:
+    virtual ~KernelVariantLayer() {}
+
+    // Returns a short name of the computational kernel used by the last forward pass.
+    virtual String getKernelVariant() const = 0;
+};
+
+// Returns KernelVariantLayer::getKernelVariant for the layers which implement it, an empty string otherwise.
+String getKernelVariant(const Ptr<Layer>& layer);
+
+// Kernel variant reported by convolution and fully connected layers:
+// "sparse" or the instruction set of the dense kernels with a suffix for FP16/BF16 weights.
+String getKernelVariantName(bool sparse, int weightsDepth);
+
+// Activations of the elementwise and the recurrent layers, computed with hal::exp32f.
+// NaN values of src give NaN, src and dst may be the same array.
+void exp32f(const float* src, float* dst, int n);
+void sigmoid32f(const float* src, float* dst, int n);
+// Odd and precise near zero, the relative error is about the float epsilon.
+void tanh32f(const float* src, float* dst, int n);
+
+// dst[i] = bias[i] + <weights row i, vec> for i in [0, nvecs), bias may be equal to dst. The AVX2 or AVX
+// kernel is used if it is available. vec and the weights rows should be aligned to 16 bytes and readable
+// up to alignSize(vecsize, 8) elements, wstep is the weights step in elements.
+void fastGEMM1T(const float* vec, const float* weights, size_t wstep, const float* bias,
+                float* dst, int nvecs, int vecsize);
+
+// dst[i] = bias[i] + <weights row (rowStart + i), vec> for rows in [rowStart, rowEnd).
+// vec should be readable up to alignSize(weights.cols, SparseWeights::BLOCK) elements.
+void sparseGEMV(const SparseWeights& weights, const float* vec, const float* bias,
+                float* dst, int rowStart, int rowEnd);
+
+// Row i of dst is bias[i] + sum_j weights(rowStart + i, j) * (row j of src), for rows in
+// [rowStart, rowEnd). src has weights.cols rows of n elements.
+void sparseGEMM(const SparseWeights& weights, const float* src, size_t srcstep,
+                const float* bias, float* dst, size_t dststep, int n,
+                int rowStart, int rowEnd);
+
 }
 }
 
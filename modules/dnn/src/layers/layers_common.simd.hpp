@@ -56,6 +56,10 @@ void fastGEMM1T( const float* vec, const float* weights,
 void fastGEMM( const float* aptr, size_t astep, const float* bptr,
                size_t bstep, float* cptr, size_t cstep,
                int ma, int na, int nb );
+// weights are FP16 (CV_16S) or BF16 (CV_16U) numbers, implemented for AVX2 only
+void fastGEMM1T( const float* vec, const ushort* weights, int wdepth,
+                 size_t wstep, const float* bias,
+                 float* dst, int nvecs, int vecsize );
 
 #if !defined(CV_CPU_OPTIMIZATION_DECLARATIONS_ONLY) && CV_AVX
 
@@ -364,6 +368,90 @@ void fastGEMM( const float* aptr, size_t astep, const float* bptr,
     _mm256_zeroupper();
 }
 
+#if CV_AVX2
+template<bool bf16>
+static inline __m256 loadWeights( const ushort* ptr )
+{
+    __m128i v = _mm_load_si128((const __m128i*)ptr);
+    return bf16 ? _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(v), 16)) :
+                  _mm256_cvtph_ps(v);
+}
+
+template<bool bf16>
+static void fastGEMM1T_( const float* vec, const ushort* weights,
+                         size_t wstep, const float* bias,
+                         float* dst, int nvecs, int vecsize )
+{
+    int i = 0;
+
+    for( ; i <= nvecs - 8; i += 8 )
+    {
+        const ushort* wptr = weights + i*wstep;
+        __m256 vs0 = _mm256_setzero_ps(), vs1 = _mm256_setzero_ps(),
+               vs2 = _mm256_setzero_ps(), vs3 = _mm256_setzero_ps(),
+               vs4 = _mm256_setzero_ps(), vs5 = _mm256_setzero_ps(),
+               vs6 = _mm256_setzero_ps(), vs7 = _mm256_setzero_ps();
+
+        for( int k = 0; k < vecsize; k += 8, wptr += 8 )
+        {
+            __m256 v = _mm256_load_ps(vec + k);
+
+            vs0 = _mm256_fmadd_ps(loadWeights<bf16>(wptr), v, vs0);
+            vs1 = _mm256_fmadd_ps(loadWeights<bf16>(wptr + wstep), v, vs1);
+            vs2 = _mm256_fmadd_ps(loadWeights<bf16>(wptr + wstep*2), v, vs2);
+            vs3 = _mm256_fmadd_ps(loadWeights<bf16>(wptr + wstep*3), v, vs3);
+            vs4 = _mm256_fmadd_ps(loadWeights<bf16>(wptr + wstep*4), v, vs4);
+            vs5 = _mm256_fmadd_ps(loadWeights<bf16>(wptr + wstep*5), v, vs5);
+            vs6 = _mm256_fmadd_ps(loadWeights<bf16>(wptr + wstep*6), v, vs6);
+            vs7 = _mm256_fmadd_ps(loadWeights<bf16>(wptr + wstep*7), v, vs7);
+        }
+
+        __m256 s0 = _mm256_hadd_ps(_mm256_hadd_ps(vs0, vs1), _mm256_hadd_ps(vs2, vs3));
+        __m256 s1 = _mm256_hadd_ps(_mm256_hadd_ps(vs4, vs5), _mm256_hadd_ps(vs6, vs7));
+
+        s0 = _mm256_add_ps(s0, _mm256_permute2f128_ps(s0, s0, 1));
+        s1 = _mm256_add_ps(s1, _mm256_permute2f128_ps(s1, s1, 1));
+
+        s0 = _mm256_add_ps(s0, _mm256_castps128_ps256(_mm_loadu_ps(bias + i)));
+        s1 = _mm256_add_ps(s1, _mm256_castps128_ps256(_mm_loadu_ps(bias + i + 4)));
+
+        _mm_storeu_ps(dst + i, _mm256_castps256_ps128(s0));
+        _mm_storeu_ps(dst + i + 4, _mm256_castps256_ps128(s1));
+    }
+
+    float temp = 0.f;
+    for( ; i < nvecs; i++ )
+    {
+        const ushort* wptr = weights + i*wstep;
+        __m256 vs0 = _mm256_setzero_ps();
+
+        for( int k = 0; k < vecsize; k += 8, wptr += 8 )
+        {
+            __m256 v = _mm256_load_ps(vec + k);
+            vs0 = _mm256_fmadd_ps(loadWeights<bf16>(wptr), v, vs0);
+        }
+
+        __m256 s0 = _mm256_hadd_ps(_mm256_hadd_ps(vs0, vs0), vs0);
+        s0 = _mm256_add_ps(s0, _mm256_permute2f128_ps(s0, s0, 1));
+        _mm_store_ss(&temp, _mm256_castps256_ps128(s0));
+        dst[i] = temp + bias[i];
+    }
+
+    _mm256_zeroupper();
+}
+
+// dst = vec * weights^t + bias, weights are converted to FP32 on the fly
+void fastGEMM1T( const float* vec, const ushort* weights, int wdepth,
+                 size_t wstep, const float* bias,
+                 float* dst, int nvecs, int vecsize )
+{
+    if( wdepth == CV_16U )
+        fastGEMM1T_<true>(vec, weights, wstep, bias, dst, nvecs, vecsize);
+    else
+        fastGEMM1T_<false>(vec, weights, wstep, bias, dst, nvecs, vecsize);
+}
+#endif // CV_AVX2
+
 #endif // CV_CPU_OPTIMIZATION_DECLARATIONS_ONLY
 
 CV_CPU_OPTIMIZATION_NAMESPACE_END
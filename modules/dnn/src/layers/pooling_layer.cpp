@@ -62,7 +62,7 @@ static inline int roundRoiSize(float v)
     return (int)(v + (v >= 0.f ? 0.5f : -0.5f));
 }
 
-class PoolingLayerImpl : public PoolingLayer
+class PoolingLayerImpl : public PoolingLayer, public BlockedLayoutLayer
 {
 public:
     PoolingLayerImpl(const LayerParams& params)
@@ -70,6 +70,7 @@ public:
         computeMaxIdx = true;
         globalPooling = false;
         stride = Size(1, 1);
+        blockSize = 0;
 
         if (params.has("pool") || params.has("kernel_size") ||
             params.has("kernel_w") || params.has("kernel_h"))
@@ -133,6 +134,15 @@ public:
                (type == MAX || type == AVE && !pad.width && !pad.height);
     }
 
+    bool setBlockedLayout(int blockSize_, const std::vector<MatShape>&)
+    {
+        // Indices of maximal values are computed for NCHW layout.
+        if (blockSize_ && (type != MAX && type != AVE || computeMaxIdx))
+            return false;
+        blockSize = blockSize_;
+        return true;
+    }
+
 #ifdef HAVE_OPENCL
     bool forward_ocl(InputArrayOfArrays inps, OutputArrayOfArrays outs, InputArrayOfArrays internals)
     {
@@ -192,6 +202,13 @@ public:
         CV_TRACE_FUNCTION();
         CV_TRACE_ARG_VALUE(name, "name", name.c_str());
 
+        if (blockSize)
+        {
+            CV_Assert(inputs.size() == 1, !outputs.empty());
+            BlockedPoolingInvoker::run(*inputs[0], outputs[0], kernel, stride, pad, type == MAX);
+            return;
+        }
+
         switch (type)
         {
             case MAX:
@@ -230,7 +247,6 @@ public:
         Size kernel, stride, pad;
         int nstripes;
         bool computeMaxIdx;
-        std::vector<int> ofsbuf;
         int poolingType;
         float spatialScale;
 
@@ -262,16 +278,46 @@ public:
             p.poolingType = poolingType;
             p.spatialScale = spatialScale;
 
-            if( !computeMaxIdx )
+            parallel_for_(Range(0, nstripes), p, nstripes);
+        }
+
+#if CV_SIMD128
+        // Loads ptr[0], ptr[stride], ..., ptr[stride*7]. If contiguous is true, the elements
+        // up to ptr[stride*8 - 1] are readable and small strides are loaded by whole vectors.
+        static inline void loadStrided(const float* ptr, int stride, bool contiguous,
+                                       v_float32x4& v0, v_float32x4& v1)
+        {
+            if( contiguous )
             {
-                p.ofsbuf.resize(kernel.width*kernel.height);
-                for( int i = 0; i < kernel.height; i++ )
-                    for( int j = 0; j < kernel.width; j++ )
-                        p.ofsbuf[i*kernel.width + j] = src.size[3]*i + j;
+                v_float32x4 t0, t1, t2, t3;
+                switch( stride )
+                {
+                case 1:
+                    v0 = v_load(ptr);
+                    v1 = v_load(ptr + 4);
+                    return;
+                case 2:
+                    v_zip(v_load(ptr), v_load(ptr + 4), t0, t1);
+                    v_zip(t0, t1, v0, t2);
+                    v_zip(v_load(ptr + 8), v_load(ptr + 12), t0, t1);
+                    v_zip(t0, t1, v1, t2);
+                    return;
+                case 3:
+                    v_load_deinterleave(ptr, v0, t0, t1);
+                    v_load_deinterleave(ptr + 12, v1, t0, t1);
+                    return;
+                case 4:
+                    v_load_deinterleave(ptr, v0, t0, t1, t2);
+                    v_load_deinterleave(ptr + 16, v1, t0, t1, t3);
+                    return;
+                default:
+                    break;
+                }
             }
-
-            parallel_for_(Range(0, nstripes), p, nstripes);
+            v0 = v_float32x4(ptr[0], ptr[stride], ptr[stride*2], ptr[stride*3]);
+            v1 = v_float32x4(ptr[stride*4], ptr[stride*5], ptr[stride*6], ptr[stride*7]);
         }
+#endif
 
         void operator()(const Range& r) const
         {
@@ -287,7 +333,6 @@ public:
             bool compMaxIdx = computeMaxIdx;
 
 #if CV_SIMD128
-            const int* ofsptr = &ofsbuf[0];
             v_float32x4 idx00(0.f, (float)stride_w, (float)(stride_w*2), (float)(stride_w*3));
             v_float32x4 ones = v_setall_f32(1.f);
             v_float32x4 idx_delta = v_setall_f32((float)(inp_width - kernel_w));
@@ -362,6 +407,7 @@ public:
 #if CV_SIMD128
                         if( xstart > 0 && x0 + 7 < x1 && (x0 + 7) * stride_w - pad_w + kernel_w < inp_width )
                         {
+                            const bool contiguous = (x0 + 8) * stride_w - pad_w + kernel_w <= inp_width + 1;
                             if( compMaxIdx )
                             {
                                 v_float32x4 max_val0 = v_setall_f32(-FLT_MAX);
@@ -376,11 +422,8 @@ public:
                                 {
                                     for (int x = xstart; x < xend; ++x, idx0 += ones, idx1 += ones)
                                     {
-                                        const int index = y * inp_width + x;
-                                        v_float32x4 v0(srcData[index], srcData[index + stride_w],
-                                                       srcData[index + stride_w*2], srcData[index + stride_w*3]);
-                                        v_float32x4 v1(srcData[index + stride_w*4], srcData[index + stride_w*5],
-                                                       srcData[index + stride_w*6], srcData[index + stride_w*7]);
+                                        v_float32x4 v0, v1;
+                                        loadStrided(srcData + y * inp_width + x, stride_w, contiguous, v0, v1);
                                         max_idx0 = v_select(v0 > max_val0, idx0, max_idx0);
                                         max_idx1 = v_select(v1 > max_val1, idx1, max_idx1);
                                         max_val0 = v_max(max_val0, v0);
@@ -402,58 +445,15 @@ public:
                             {
                                 v_float32x4 max_val0 = v_setall_f32(-FLT_MAX);
                                 v_float32x4 max_val1 = max_val0;
-
-                                if( yend - ystart == kernel_h )
-                                {
-                                    const float* srcData1 = srcData + ystart*inp_width + xstart;
-                                    if( stride_w == 1 )
-                                        for (int k = 0; k < kernel_w*kernel_h; k++)
-                                        {
-                                            int index = ofsptr[k];
-                                            v_float32x4 v0 = v_load(srcData1 + index);
-                                            v_float32x4 v1 = v_load(srcData1 + index + 4);
-                                            max_val0 = v_max(max_val0, v0);
-                                            max_val1 = v_max(max_val1, v1);
-                                        }
-#if CV_SSE2
-                                    else if( stride_w == 2 )
-                                        for (int k = 0; k < kernel_w*kernel_h; k++)
-                                        {
-                                            int index = ofsptr[k];
-                                            v_float32x4 v00 = v_load(srcData1 + index), v01 = v_load(srcData1 + index + 4);
-                                            v_float32x4 v0(_mm_shuffle_ps(v00.val, v01.val, _MM_SHUFFLE(2, 0, 2, 0)));
-                                            v_float32x4 v10 = v_load(srcData1 + index + 8), v11 = v_load(srcData1 + index + 12);
-                                            v_float32x4 v1(_mm_shuffle_ps(v10.val, v11.val, _MM_SHUFFLE(2, 0, 2, 0)));
-                                            max_val0 = v_max(max_val0, v0);
-                                            max_val1 = v_max(max_val1, v1);
-                                        }
-#endif
-                                    else
-                                        for (int k = 0; k < kernel_w*kernel_h; k++)
-                                        {
-                                            int index = ofsptr[k];
-                                            v_float32x4 v0(srcData1[index], srcData1[index + stride_w],
-                                                           srcData1[index + stride_w*2], srcData1[index + stride_w*3]);
-                                            v_float32x4 v1(srcData1[index + stride_w*4], srcData1[index + stride_w*5],
-                                                           srcData1[index + stride_w*6], srcData1[index + stride_w*7]);
-                                            max_val0 = v_max(max_val0, v0);
-                                            max_val1 = v_max(max_val1, v1);
-                                        }
-                                }
-                                else
+                                for (int y = ystart; y < yend; ++y)
                                 {
-                                    for (int y = ystart; y < yend; ++y)
+                                    const float* srcRow = srcData + y * inp_width;
+                                    for (int x = xstart; x < xend; ++x)
                                     {
-                                        for (int x = xstart; x < xend; ++x)
-                                        {
-                                            const int index = y * inp_width + x;
-                                            v_float32x4 v0(srcData[index], srcData[index + stride_w],
-                                                           srcData[index + stride_w*2], srcData[index + stride_w*3]);
-                                            v_float32x4 v1(srcData[index + stride_w*4], srcData[index + stride_w*5],
-                                                           srcData[index + stride_w*6], srcData[index + stride_w*7]);
-                                            max_val0 = v_max(max_val0, v0);
-                                            max_val1 = v_max(max_val1, v1);
-                                        }
+                                        v_float32x4 v0, v1;
+                                        loadStrided(srcRow + x, stride_w, contiguous, v0, v1);
+                                        max_val0 = v_max(max_val0, v0);
+                                        max_val1 = v_max(max_val1, v1);
                                     }
                                 }
                                 v_store(dstData + x0, max_val0);
@@ -512,18 +512,17 @@ public:
 #if CV_SIMD128
                         if( xstart > 0 && x0 + 7 < x1 && (x0 + 7) * stride_w - pad_w + kernel_w < inp_width )
                         {
+                            const bool contiguous = (x0 + 8) * stride_w - pad_w + kernel_w <= inp_width + 1;
                             v_float32x4 sum_val0 = v_setzero_f32(), sum_val1 = v_setzero_f32();
                             v_float32x4 ikarea = v_setall_f32(inv_kernel_area);
 
                             for (int y = ystart; y < yend; ++y)
                             {
+                                const float* srcRow = srcData + y * inp_width;
                                 for (int x = xstart; x < xend; ++x)
                                 {
-                                    const int index = y * inp_width + x;
-                                    v_float32x4 v0(srcData[index], srcData[index + stride_w],
-                                                   srcData[index + stride_w*2], srcData[index + stride_w*3]);
-                                    v_float32x4 v1(srcData[index + stride_w*4], srcData[index + stride_w*5],
-                                                   srcData[index + stride_w*6], srcData[index + stride_w*7]);
+                                    v_float32x4 v0, v1;
+                                    loadStrided(srcRow + x, stride_w, contiguous, v0, v1);
                                     sum_val0 += v0;
                                     sum_val1 += v1;
                                 }
@@ -615,6 +614,117 @@ public:
         }
     };
 
+    // Pooling over [N, C/b, H, W, b] blobs. Channels of a block are processed together.
+    class BlockedPoolingInvoker : public ParallelLoopBody
+    {
+    public:
+        const Mat* src;
+        Mat* dst;
+        Size kernel, stride, pad;
+        bool maxPooling;
+
+        BlockedPoolingInvoker() : src(0), dst(0), maxPooling(true) {}
+
+        static void run(const Mat& src, Mat& dst, Size kernel, Size stride, Size pad, bool maxPooling)
+        {
+            CV_Assert(src.isContinuous(), dst.isContinuous(),
+                      src.type() == CV_32F, src.type() == dst.type(),
+                      src.dims == 5, dst.dims == 5,
+                      src.size[0] == dst.size[0], src.size[1] == dst.size[1],
+                      src.size[4] == dst.size[4]);
+
+            BlockedPoolingInvoker p;
+            p.src = &src;
+            p.dst = &dst;
+            p.kernel = kernel;
+            p.stride = stride;
+            p.pad = pad;
+            p.maxPooling = maxPooling;
+
+            int nrows = dst.size[0]*dst.size[1]*dst.size[2];
+            parallel_for_(Range(0, nrows), p, std::min(nrows, getNumThreads()));
+        }
+
+        void operator()(const Range& r) const
+        {
+            int width = dst->size[3], height = dst->size[2], blk = dst->size[4];
+            int inp_width = src->size[3], inp_height = src->size[2];
+            int kernel_w = kernel.width, kernel_h = kernel.height;
+            int pad_w = pad.width, pad_h = pad.height;
+            int stride_w = stride.width, stride_h = stride.height;
+
+            for( int row = r.start; row < r.end; row++ )
+            {
+                int y0 = row % height, nb = row / height;
+                const float* srcData = src->ptr<float>() + (size_t)nb*inp_height*inp_width*blk;
+                float* dstData = dst->ptr<float>() + (size_t)row*width*blk;
+
+                int ystart = y0 * stride_h - pad_h;
+                int yend = min(ystart + kernel_h, inp_height + pad_h);
+                int ydelta = yend - ystart;
+                ystart = max(ystart, 0);
+                yend = min(yend, inp_height);
+
+                for( int x0 = 0; x0 < width; x0++, dstData += blk )
+                {
+                    int xstart = x0 * stride_w - pad_w;
+                    int xend = min(xstart + kernel_w, inp_width + pad_w);
+                    int xdelta = xend - xstart;
+                    xstart = max(xstart, 0);
+                    xend = min(xend, inp_width);
+
+                    if( maxPooling && (xstart >= xend || ystart >= yend) )
+                    {
+                        for( int k = 0; k < blk; k++ )
+                            dstData[k] = 0.f;
+                        continue;
+                    }
+                    float scale = maxPooling ? 1.f : 1.f/(ydelta*xdelta);
+
+                    int k = 0;
+#if CV_SIMD128
+                    v_float32x4 vscale = v_setall_f32(scale);
+                    for( ; k <= blk - 8; k += 8 )
+                    {
+                        v_float32x4 s0 = v_setall_f32(maxPooling ? -FLT_MAX : 0.f), s1 = s0;
+                        for (int y = ystart; y < yend; ++y)
+                        {
+                            const float* ptr = srcData + ((size_t)y*inp_width + xstart)*blk + k;
+                            for (int x = xstart; x < xend; ++x, ptr += blk)
+                            {
+                                v_float32x4 v0 = v_load(ptr), v1 = v_load(ptr + 4);
+                                if( maxPooling )
+                                {
+                                    s0 = v_max(s0, v0);
+                                    s1 = v_max(s1, v1);
+                                }
+                                else
+                                {
+                                    s0 += v0;
+                                    s1 += v1;
+                                }
+                            }
+                        }
+                        v_store(dstData + k, s0*vscale);
+                        v_store(dstData + k + 4, s1*vscale);
+                    }
+#endif
+                    for( ; k < blk; k++ )
+                    {
+                        float s = maxPooling ? -FLT_MAX : 0.f;
+                        for (int y = ystart; y < yend; ++y)
+                        {
+                            const float* ptr = srcData + ((size_t)y*inp_width + xstart)*blk + k;
+                            for (int x = xstart; x < xend; ++x, ptr += blk)
+                                s = maxPooling ? std::max(s, *ptr) : s + *ptr;
+                        }
+                        dstData[k] = s*scale;
+                    }
+                }
+            }
+        }
+    };
+
     void maxPooling(Mat &src, Mat &dst, Mat &mask)
     {
         const int nstripes = getNumThreads();
@@ -836,6 +946,9 @@ public:
         return flops;
     }
 private:
+    // Number of channels in a block for NCHWc layout, 0 for NCHW one.
+    int blockSize;
+
     enum Type
     {
         MAX,
@@ -41,10 +41,13 @@
 //M*/
 
 #include "../precomp.hpp"
+#include "layers_common.hpp"
 #include <iostream>
 #include <iterator>
 #include <cmath>
 #include <opencv2/dnn/shape_utils.hpp>
+#include <opencv2/core/hal/hal.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 
 namespace cv
 {
@@ -66,7 +69,9 @@ static void tanh(const Mat &src, Mat &dst)
 {
     dst.create(src.dims, (const int*)src.size, src.type());
 
-    if (src.type() == CV_32F)
+    if (src.type() == CV_32F && src.isContinuous() && dst.isContinuous())
+        tanh32f(src.ptr<float>(), dst.ptr<float>(), (int)src.total());
+    else if (src.type() == CV_32F)
         tanh<float>(src, dst);
     else if (src.type() == CV_64F)
         tanh<double>(src, dst);
@@ -74,12 +79,112 @@ static void tanh(const Mat &src, Mat &dst)
         CV_Error(Error::StsUnsupportedFormat, "Function supports only floating point types");
 }
 
-static void sigmoid(const Mat &src, Mat &dst)
+// Computes c_t and h_t of a single sample from the gates preactivations (i, f, o, g).
+// The output gate is skipped if <computeOutput> is false: peephole connections of it need c_t.
+static void lstmCell(float* gates, float* c, float* h, int n,
+                     bool computeOutput, bool useCellClip, float cellClip)
 {
-    cv::exp(-src, dst);
-    cv::pow(1 + dst, -1, dst);
+    const float *gateI = gates, *gateF = gates + n, *gateO = gates + 2*n;
+    float *gateG = gates + 3*n;
+    sigmoid32f(gates, gates, computeOutput ? 3*n : 2*n);
+    tanh32f(gateG, gateG, n);
+
+    // c_t = f_t (*) c_{t-1} + i_t (*) g_t
+    int j = 0;
+#if CV_SIMD128
+    v_float32x4 vmax = v_setall_f32(cellClip), vmin = v_setall_f32(-cellClip);
+    for (; j <= n - 4; j += 4)
+    {
+        v_float32x4 vc = v_load(gateF + j) * v_load(c + j) + v_load(gateI + j) * v_load(gateG + j);
+        if (useCellClip)
+            vc = v_min(v_max(vc, vmin), vmax);
+        v_store(c + j, vc);
+    }
+#endif
+    for (; j < n; j++)
+    {
+        float cj = gateF[j] * c[j] + gateI[j] * gateG[j];
+        c[j] = useCellClip ? std::min(std::max(cj, -cellClip), cellClip) : cj;
+    }
+
+    if (!computeOutput)
+        return;
+
+    // h_t = o_t (*) tanh(c_t)
+    tanh32f(c, h, n);
+    j = 0;
+#if CV_SIMD128
+    for (; j <= n - 4; j += 4)
+        v_store(h + j, v_load(h + j) * v_load(gateO + j));
+#endif
+    for (; j < n; j++)
+        h[j] *= gateO[j];
 }
 
+// Adds products of hidden states and the recurrent weights to the gates.
+// Rows of the weights are padded to VEC_ALIGN elements.
+class RecurrentGemm : public ParallelLoopBody
+{
+public:
+    enum { VEC_ALIGN = 8 };
+
+    static void run(const Mat& h, const Mat& weights, Mat& gates)
+    {
+        CV_Assert(h.type() == CV_32F && weights.type() == CV_32F && gates.type() == CV_32F);
+        CV_Assert(h.rows == gates.rows && weights.rows == gates.cols &&
+                  weights.cols == (int)alignSize(h.cols, VEC_ALIGN));
+
+        RecurrentGemm p;
+        p.h = &h;
+        p.weights = &weights;
+        p.gates = &gates;
+
+        // Small products are computed by a single thread: there is one call per time step.
+        size_t numMACs = (size_t)h.rows * weights.rows * h.cols;
+        p.nstripes = (int)std::max((size_t)1, std::min((size_t)getNumThreads(), numMACs >> 16));
+        parallel_for_(Range(0, p.nstripes), p, p.nstripes);
+    }
+
+    void operator()(const Range& r) const
+    {
+        int nsamples = h->rows;
+        int nw0 = weights->rows;
+        int k, vecsize = h->cols;
+        int vecsize_aligned = (int)alignSize(vecsize, VEC_ALIGN);
+        size_t total = (size_t)nsamples*nw0;
+        size_t stripeSize = (total + nstripes - 1)/nstripes;
+        size_t stripeStart = r.start*stripeSize;
+        size_t stripeEnd = r.end == nstripes ? total : std::min(r.end*stripeSize, total);
+        size_t wstep = weights->step1();
+        AutoBuffer<float> srcbuf(vecsize_aligned + VEC_ALIGN);
+        float* sptr = alignPtr((float*)srcbuf, (int)(VEC_ALIGN*sizeof(float)));
+
+        for( k = vecsize; k < vecsize_aligned; k++ )
+            sptr[k] = 0.f;
+
+        for( size_t ofs = stripeStart; ofs < stripeEnd; )
+        {
+            int sampleIdx = (int)(ofs / nw0);
+            int delta = (int)(ofs - (size_t)sampleIdx*nw0);
+            const float* wptr = weights->ptr<float>(delta);
+            float* dptr = gates->ptr<float>(sampleIdx) + delta;
+            int nw = std::min(nw0 - delta, (int)(stripeEnd - ofs));
+
+            memcpy(sptr, h->ptr<float>(sampleIdx), vecsize*sizeof(sptr[0]));
+            fastGEMM1T(sptr, wptr, wstep, dptr, dptr, nw, vecsize);
+
+            ofs += nw;
+        }
+    }
+
+private:
+    RecurrentGemm() : h(0), weights(0), gates(0), nstripes(0) {}
+
+    const Mat *h, *weights;
+    Mat* gates;
+    int nstripes;
+};
+
 class LSTMLayerImpl : public LSTMLayer
 {
     int numTimeStamps, numSamples;
@@ -93,6 +198,9 @@ class LSTMLayerImpl : public LSTMLayer
     float forgetBias, cellClip;
     bool useCellClip, usePeephole;
 
+    // Recurrent weights with rows aligned for vectorized products and bias with forget bias added.
+    Mat WhPacked, biasPacked;
+
 public:
 
     LSTMLayerImpl(const LayerParams& params)
@@ -211,8 +319,7 @@ public:
 
         internals.assign(1, shape(_numSamples, _numOut)); // hInternal
         internals.push_back(shape(_numSamples, _numOut)); // cInternal
-        internals.push_back(shape(_numSamples, 1)); // dummyOnes
-        internals.push_back(shape(_numSamples, 4*_numOut)); // gates
+        internals.push_back(shape(_numTimeStamps*_numSamples, 4*_numOut)); // gates of all time steps
 
         return false;
     }
@@ -226,6 +333,13 @@ public:
         Mat &Wh = blobs[0], &Wx = blobs[1];
         int numOut = Wh.size[1];
         int numInp = Wx.size[1];
+        CV_Assert(Wh.type() == CV_32F);
+
+        WhPacked = Mat::zeros(Wh.rows, (int)alignSize(numOut, RecurrentGemm::VEC_ALIGN), CV_32F);
+        Wh.copyTo(WhPacked.colRange(0, numOut));
+        biasPacked = blobs[2].reshape(1, 1).clone();
+        if (forgetBias)
+            add(biasPacked.colRange(numOut, 2*numOut), forgetBias, biasPacked.colRange(numOut, 2*numOut));
 
         if (!outTailShape.empty())
             CV_Assert(total(outTailShape) == numOut);
@@ -265,17 +379,12 @@ public:
         CV_TRACE_FUNCTION();
         CV_TRACE_ARG_VALUE(name, "name", name.c_str());
 
-        const Mat &Wh = blobs[0];
         const Mat &Wx = blobs[1];
-        const Mat &bias = blobs[2];
+        int numOut = blobs[0].size[1];
 
-        int numOut = Wh.size[1];
-
-        Mat hInternal = internals[0], cInternal = internals[1],
-                dummyOnes = internals[2], gates = internals[3];
+        Mat hInternal = internals[0], cInternal = internals[1], gatesTs = internals[2];
         hInternal.setTo(0.);
         cInternal.setTo(0.);
-        dummyOnes.setTo(1.);
 
         int numSamplesTotal = numTimeStamps*numSamples;
         Mat xTs = input[0]->reshape(1, numSamplesTotal);
@@ -283,58 +392,47 @@ public:
         Mat hOutTs = output[0].reshape(1, numSamplesTotal);
         Mat cOutTs = produceCellOutput ? output[1].reshape(1, numSamplesTotal) : Mat();
 
+        // Input projections of all the time steps are computed at once: b + Wx * x_t
+        repeat(biasPacked, numSamplesTotal, 1, gatesTs);
+        gemm(xTs, Wx, 1, gatesTs, 1, gatesTs, GEMM_2_T);
+
         for (int ts = 0; ts < numTimeStamps; ts++)
         {
             Range curRowRange(ts*numSamples, (ts + 1)*numSamples);
-            Mat xCurr = xTs.rowRange(curRowRange);
-
-            gemm(xCurr, Wx, 1, gates, 0, gates, GEMM_2_T);      // Wx * x_t
-            gemm(hInternal, Wh, 1, gates, 1, gates, GEMM_2_T);  //+Wh * h_{t-1}
-            gemm(dummyOnes, bias, 1, gates, 1, gates);          //+b
+            Mat gates = gatesTs.rowRange(curRowRange);
 
-            Mat gateI = gates.colRange(0*numOut, 1*numOut);
-            Mat gateF = gates.colRange(1*numOut, 2*numOut);
-            Mat gateO = gates.colRange(2*numOut, 3*numOut);
-            Mat gateG = gates.colRange(3*numOut, 4*numOut);
-
-            if (forgetBias)
-                add(gateF, forgetBias, gateF);
+            if (ts > 0)  // h_{-1} = 0
+                RecurrentGemm::run(hInternal, WhPacked, gates);  //+Wh * h_{t-1}
 
             if (usePeephole)
             {
-                Mat gatesIF = gates.colRange(0, 2*numOut);
+                Mat gateI = gates.colRange(0*numOut, 1*numOut);
+                Mat gateF = gates.colRange(1*numOut, 2*numOut);
                 gemm(cInternal, blobs[3], 1, gateI, 1, gateI);
                 gemm(cInternal, blobs[4], 1, gateF, 1, gateF);
-                sigmoid(gatesIF, gatesIF);
-            }
-            else
-            {
-                Mat gatesIFO = gates.colRange(0, 3*numOut);
-                sigmoid(gatesIFO, gatesIFO);
             }
 
-            tanh(gateG, gateG);
-
-            //compute c_t
-            multiply(gateF, cInternal, gateF);  // f_t (*) c_{t-1}
-            multiply(gateI, gateG, gateI);      // i_t (*) g_t
-            add(gateF, gateI, cInternal);       // c_t = f_t (*) c_{t-1} + i_t (*) g_t
-
-            if (useCellClip)
+            for (int i = 0; i < numSamples; i++)
             {
-                min(cInternal, cellClip, cInternal);
-                max(cInternal, -cellClip, cInternal);
+                lstmCell(gates.ptr<float>(i), cInternal.ptr<float>(i), hInternal.ptr<float>(i),
+                         numOut, !usePeephole, useCellClip, cellClip);
             }
+
             if (usePeephole)
             {
+                Mat gateO = gates.colRange(2*numOut, 3*numOut);
                 gemm(cInternal, blobs[5], 1, gateO, 1, gateO);
-                sigmoid(gateO, gateO);
+                for (int i = 0; i < numSamples; i++)
+                {
+                    float* gateOPtr = gateO.ptr<float>(i);
+                    float* h = hInternal.ptr<float>(i);
+                    sigmoid32f(gateOPtr, gateOPtr, numOut);
+                    tanh32f(cInternal.ptr<float>(i), h, numOut);
+                    for (int j = 0; j < numOut; j++)
+                        h[j] *= gateOPtr[j];
+                }
             }
 
-            //compute h_t
-            tanh(cInternal, hInternal);
-            multiply(gateO, hInternal, hInternal);
-
             //save results in output blobs
             hInternal.copyTo(hOutTs.rowRange(curRowRange));
             if (produceCellOutput)
@@ -188,7 +188,10 @@ public:
         CV_Assert(outputs.size() == sliceRanges.size());
         for (size_t i = 0; i < outputs.size(); i++)
         {
-            inpMat(sliceRanges[i]).copyTo(outputs[i]);
+            Mat inpSlice = inpMat(sliceRanges[i]);
+            // The network allocates continuous slices as views of the input.
+            if (inpSlice.data != outputs[i].data)
+                inpSlice.copyTo(outputs[i]);
         }
     }
 };
@@ -28,6 +28,90 @@ void NMSBoxes(const std::vector<Rect>& bboxes, const std::vector<float>& scores,
     NMSFast_(bboxes, scores, score_threshold, nms_threshold, eta, top_k, indices, rectOverlap);
 }
 
+class NMSBoxesBatchedInvoker : public ParallelLoopBody
+{
+public:
+    NMSBoxesBatchedInvoker(const std::vector<Rect>& bboxes, const std::vector<float>& scores,
+                           const std::vector<std::vector<int> >& classIndices,
+                           float score_threshold, float nms_threshold, float eta, int top_k,
+                           std::vector<std::vector<int> >& keptIndices)
+        : bboxes_(bboxes), scores_(scores), classIndices_(classIndices),
+          score_threshold_(score_threshold), nms_threshold_(nms_threshold), eta_(eta),
+          top_k_(top_k), keptIndices_(keptIndices) {}
+
+    void operator()(const Range& r) const
+    {
+        std::vector<Rect> classBBoxes;
+        std::vector<float> classScores;
+        for (int i = r.start; i < r.end; ++i)
+        {
+            const std::vector<int>& indices = classIndices_[i];
+            classBBoxes.resize(indices.size());
+            classScores.resize(indices.size());
+            for (size_t j = 0; j < indices.size(); ++j)
+            {
+                classBBoxes[j] = bboxes_[indices[j]];
+                classScores[j] = scores_[indices[j]];
+            }
+            std::vector<int>& kept = keptIndices_[i];
+            NMSFast_(classBBoxes, classScores, score_threshold_, nms_threshold_, eta_, top_k_,
+                     kept, rectOverlap);
+            for (size_t j = 0; j < kept.size(); ++j)
+                kept[j] = indices[kept[j]];
+        }
+    }
+
+private:
+    const std::vector<Rect>& bboxes_;
+    const std::vector<float>& scores_;
+    const std::vector<std::vector<int> >& classIndices_;
+    float score_threshold_, nms_threshold_, eta_;
+    int top_k_;
+    std::vector<std::vector<int> >& keptIndices_;
+};
+
+void NMSBoxesBatched(const std::vector<Rect>& bboxes, const std::vector<float>& scores,
+                     const std::vector<int>& class_ids,
+                     const float score_threshold, const float nms_threshold,
+                     std::vector<int>& indices, const float eta, const int top_k)
+{
+    CV_Assert(bboxes.size() == scores.size(), bboxes.size() == class_ids.size(),
+        score_threshold >= 0, nms_threshold >= 0, eta > 0);
+
+    // Split boxes by classes keeping an increasing order of indices.
+    std::map<int, int> classes;
+    std::vector<std::vector<int> > classIndices;
+    for (size_t i = 0; i < class_ids.size(); ++i)
+    {
+        if (!(scores[i] > score_threshold))
+            continue;
+        std::map<int, int>::iterator it = classes.find(class_ids[i]);
+        if (it == classes.end())
+        {
+            it = classes.insert(std::make_pair(class_ids[i], (int)classIndices.size())).first;
+            classIndices.push_back(std::vector<int>());
+        }
+        classIndices[it->second].push_back((int)i);
+    }
+
+    std::vector<std::vector<int> > keptIndices(classIndices.size());
+    parallel_for_(Range(0, (int)classIndices.size()),
+                  NMSBoxesBatchedInvoker(bboxes, scores, classIndices, score_threshold,
+                                         nms_threshold, eta, top_k, keptIndices));
+
+    std::vector<std::pair<float, int> > score_index_vec;
+    for (size_t i = 0; i < keptIndices.size(); ++i)
+    {
+        for (size_t j = 0; j < keptIndices[i].size(); ++j)
+            score_index_vec.push_back(std::make_pair(scores[keptIndices[i][j]], keptIndices[i][j]));
+    }
+    std::sort(score_index_vec.begin(), score_index_vec.end(), SortScoreIndexPairDescend);
+
+    indices.resize(score_index_vec.size());
+    for (size_t i = 0; i < score_index_vec.size(); ++i)
+        indices[i] = score_index_vec[i].second;
+}
+
 CV__DNN_EXPERIMENTAL_NS_END
 }// dnn
 }// cv
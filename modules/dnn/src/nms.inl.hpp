@@ -23,6 +23,15 @@ static inline bool SortScorePairDescend(const std::pair<float, T>& pair1,
     return pair1.first > pair2.first;
 }
 
+// Descending by score, ascending by index for equal scores. Gives the same
+// order as a stable sort of pairs generated in increasing index order.
+static inline bool SortScoreIndexPairDescend(const std::pair<float, int>& pair1,
+                                             const std::pair<float, int>& pair2)
+{
+    return pair1.first > pair2.first ||
+           (pair1.first == pair2.first && pair1.second < pair2.second);
+}
+
 } // namespace
 
 // Get max scores with corresponding indices.
@@ -30,12 +39,12 @@ static inline bool SortScorePairDescend(const std::pair<float, T>& pair1,
 //    threshold: only consider scores higher than the threshold.
 //    top_k: if -1, keep all; otherwise, keep at most top_k.
 //    score_index_vec: store the sorted (score, index) pair.
-inline void GetMaxScoreIndex(const std::vector<float>& scores, const float threshold, const int top_k,
+inline void GetMaxScoreIndex(const float* scores, const int num, const float threshold, const int top_k,
                       std::vector<std::pair<float, int> >& score_index_vec)
 {
     CV_DbgAssert(score_index_vec.empty());
     // Generate index score pairs.
-    for (size_t i = 0; i < scores.size(); ++i)
+    for (int i = 0; i < num; ++i)
     {
         if (scores[i] > threshold)
         {
@@ -43,15 +52,26 @@ inline void GetMaxScoreIndex(const std::vector<float>& scores, const float thres
         }
     }
 
-    // Sort the score pair according to the scores in descending order
-    std::stable_sort(score_index_vec.begin(), score_index_vec.end(),
-                     SortScorePairDescend<int>);
-
-    // Keep top_k scores if needed.
+    // Sort the score pair according to the scores in descending order.
+    // Only top_k pairs are ordered if it's required.
     if (top_k > 0 && top_k < (int)score_index_vec.size())
     {
+        std::partial_sort(score_index_vec.begin(), score_index_vec.begin() + top_k,
+                          score_index_vec.end(), SortScoreIndexPairDescend);
         score_index_vec.resize(top_k);
     }
+    else
+    {
+        std::sort(score_index_vec.begin(), score_index_vec.end(),
+                  SortScoreIndexPairDescend);
+    }
+}
+
+inline void GetMaxScoreIndex(const std::vector<float>& scores, const float threshold, const int top_k,
+                      std::vector<std::pair<float, int> >& score_index_vec)
+{
+    GetMaxScoreIndex(scores.empty() ? 0 : &scores[0], (int)scores.size(), threshold, top_k,
+                     score_index_vec);
 }
 
 // Do non maximum suppression given bboxes and scores.
@@ -0,0 +1,599 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+/*
+Implementation of TensorFlow graph transformations which are applied before import.
+*/
+
+#include "../precomp.hpp"
+
+#ifdef HAVE_PROTOBUF
+
+#include "tf_graph_simplifier.hpp"
+#include <opencv2/dnn/shape_utils.hpp>
+
+namespace cv { namespace dnn {
+CV__DNN_EXPERIMENTAL_NS_BEGIN
+
+using ::google::protobuf::RepeatedField;
+
+namespace
+{
+
+typedef std::map<std::string, int> NodeIdsMap;
+typedef std::map<std::string, std::string> InputsMap;
+
+bool isControlInput(const std::string& input)
+{
+    return !input.empty() && input[0] == '^';
+}
+
+// Returns name of the node which produces the input: "^node" and "node:1" are both "node".
+std::string getNodeName(const std::string& input)
+{
+    size_t start = isControlInput(input) ? 1 : 0;
+    size_t end = input.find(':');
+    return input.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+int getOutputIndex(const std::string& input)
+{
+    size_t delimiter = input.find(':');
+    return delimiter == std::string::npos ? 0 : atoi(input.c_str() + delimiter + 1);
+}
+
+// Unique key of the output: "node" and "node:0" are the same.
+std::string getOutputKey(const std::string& input)
+{
+    return format("%s:%d", getNodeName(input).c_str(), getOutputIndex(input));
+}
+
+void removeNodes(tensorflow::GraphDef& net, std::vector<int> ids)
+{
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    for (int i = (int)ids.size() - 1; i >= 0; --i)
+        net.mutable_node()->DeleteSubrange(ids[i], 1);
+}
+
+// Removes nodes from <candidates> which have no consumers. Inputs of the removed nodes are
+// checked in the same way so whole subgraphs which became unused are removed.
+void removeUnusedNodes(tensorflow::GraphDef& net, std::set<std::string> candidates)
+{
+    NodeIdsMap nodeIds;
+    std::map<std::string, int> numConsumers;
+    for (int i = 0; i < net.node_size(); ++i)
+    {
+        const tensorflow::NodeDef& node = net.node(i);
+        nodeIds[node.name()] = i;
+        for (int j = 0; j < node.input_size(); ++j)
+            numConsumers[getNodeName(node.input(j))] += 1;
+    }
+
+    std::vector<int> unusedIds;
+    while (!candidates.empty())
+    {
+        std::string name = *candidates.begin();
+        candidates.erase(candidates.begin());
+
+        NodeIdsMap::iterator it = nodeIds.find(name);
+        if (it == nodeIds.end() || numConsumers[name] != 0)
+            continue;
+
+        const tensorflow::NodeDef& node = net.node(it->second);
+        unusedIds.push_back(it->second);
+        nodeIds.erase(it);
+        for (int j = 0; j < node.input_size(); ++j)
+        {
+            std::string inpName = getNodeName(node.input(j));
+            if (--numConsumers[inpName] == 0)
+                candidates.insert(inpName);
+        }
+    }
+    removeNodes(net, unusedIds);
+}
+
+bool isIdentityOp(const std::string& type)
+{
+    return type == "Identity" || type == "Dropout" || type == "StopGradient" || type == "Snapshot";
+}
+
+// Follows replacements of the input until the final one.
+std::string resolveInput(const InputsMap& replaced, const std::string& input)
+{
+    std::string result = input;
+    for (size_t i = 0; i <= replaced.size() && !result.empty(); ++i)
+    {
+        InputsMap::const_iterator it = replaced.find(getOutputKey(result));
+        if (it == replaced.end())
+            break;
+        result = it->second;
+    }
+    return result;
+}
+
+// Returns value of the boolean predicate of Switch node. Predicates which are not
+// constants (e.g. is_training placeholder) are treated as false to choose inference branches.
+bool getPredicateValue(const tensorflow::GraphDef& net, const NodeIdsMap& nodeIds,
+                       const std::string& input)
+{
+    NodeIdsMap::const_iterator it = nodeIds.find(getNodeName(input));
+    if (it == nodeIds.end())
+        return false;
+    const tensorflow::NodeDef* node = &net.node(it->second);
+    if (node->op() == "PlaceholderWithDefault" && node->input_size() > 0)
+    {
+        it = nodeIds.find(getNodeName(node->input(0)));
+        if (it == nodeIds.end())
+            return false;
+        node = &net.node(it->second);
+    }
+    if (node->op() != "Const" || node->attr().find("value") == node->attr().end())
+        return false;
+
+    const tensorflow::TensorProto& tensor = node->attr().at("value").tensor();
+    if (tensor.dtype() != tensorflow::DT_BOOL)
+        return false;
+    if (tensor.bool_val_size() > 0)
+        return tensor.bool_val(0);
+    return !tensor.tensor_content().empty() && tensor.tensor_content()[0] != 0;
+}
+
+MatShape getTensorShape(const tensorflow::TensorProto& tensor)
+{
+    MatShape shape;
+    const tensorflow::TensorShapeProto& tensorShape = tensor.tensor_shape();
+    for (int i = 0; i < tensorShape.dim_size(); ++i)
+        shape.push_back((int)tensorShape.dim(i).size());
+    return shape;  // Empty for scalars.
+}
+
+// Reads float values of Const node. Returns an empty Mat if it's not possible.
+Mat getConstValues(const tensorflow::NodeDef& node, MatShape& shape)
+{
+    if (node.op() != "Const" || node.attr().find("value") == node.attr().end())
+        return Mat();
+
+    const tensorflow::TensorProto& tensor = node.attr().at("value").tensor();
+    if (tensor.dtype() != tensorflow::DT_FLOAT && tensor.dtype() != tensorflow::DT_HALF)
+        return Mat();
+
+    shape = getTensorShape(tensor);
+    Mat values = getTensorContent(tensor);
+    size_t numValues = shape.empty() ? 1 : total(shape);
+    if (values.total() == 1 && numValues != 1)
+        values = Mat(1, (int)numValues, CV_32FC1, Scalar(values.at<float>(0)));
+    if (values.total() != numValues)
+        return Mat();
+    return values;
+}
+
+// NumPy style broadcasting of shapes.
+bool broadcastShapes(const MatShape& a, const MatShape& b, MatShape& out)
+{
+    int dims = (int)std::max(a.size(), b.size());
+    out.resize(dims);
+    for (int i = 0; i < dims; ++i)
+    {
+        int da = i < dims - (int)a.size() ? 1 : a[i - (dims - a.size())];
+        int db = i < dims - (int)b.size() ? 1 : b[i - (dims - b.size())];
+        if (da != db && da != 1 && db != 1)
+            return false;
+        out[i] = da == 1 ? db : da;
+    }
+    return true;
+}
+
+// Steps of the tensor in terms of broadcasted shape: broadcasted dimensions have zero steps.
+std::vector<size_t> getBroadcastSteps(const MatShape& shape, const MatShape& outShape)
+{
+    std::vector<size_t> steps(outShape.size(), 0);
+    size_t step = 1;
+    for (int i = (int)shape.size() - 1, j = (int)outShape.size() - 1; i >= 0; --i, --j)
+    {
+        if (shape[i] != 1)
+            steps[j] = step;
+        step *= shape[i];
+    }
+    return steps;
+}
+
+enum ElementwiseOp
+{
+    OP_UNSUPPORTED, OP_NEG, OP_SQRT, OP_RSQRT, OP_RECIPROCAL, OP_SQUARE,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MAX, OP_MIN
+};
+
+ElementwiseOp getElementwiseOp(const tensorflow::NodeDef& node)
+{
+    const std::string& type = node.op();
+    if (type == "Neg") return OP_NEG;
+    if (type == "Sqrt") return OP_SQRT;
+    if (type == "Rsqrt") return OP_RSQRT;
+    if (type == "Reciprocal") return OP_RECIPROCAL;
+    if (type == "Square") return OP_SQUARE;
+    if (type == "Add" || type == "AddV2") return OP_ADD;
+    if (type == "BiasAdd")
+    {
+        // Only NHWC bias is broadcasted in the same way as other operations.
+        if (node.attr().find("data_format") != node.attr().end() &&
+            node.attr().at("data_format").s() != "NHWC")
+            return OP_UNSUPPORTED;
+        return OP_ADD;
+    }
+    if (type == "Sub") return OP_SUB;
+    if (type == "Mul") return OP_MUL;
+    if (type == "RealDiv") return OP_DIV;
+    if (type == "Maximum") return OP_MAX;
+    if (type == "Minimum") return OP_MIN;
+    return OP_UNSUPPORTED;
+}
+
+inline float computeElementwise(ElementwiseOp op, float a, float b)
+{
+    switch (op)
+    {
+        case OP_NEG: return -a;
+        case OP_SQRT: return std::sqrt(a);
+        case OP_RSQRT: return 1.0f / std::sqrt(a);
+        case OP_RECIPROCAL: return 1.0f / a;
+        case OP_SQUARE: return a * a;
+        case OP_ADD: return a + b;
+        case OP_SUB: return a - b;
+        case OP_MUL: return a * b;
+        case OP_DIV: return a / b;
+        case OP_MAX: return std::max(a, b);
+        case OP_MIN: return std::min(a, b);
+        default: CV_Error(Error::StsNotImplemented, "Unsupported elementwise operation");
+    }
+    return 0;
+}
+
+}  // namespace
+
+Mat getTensorContent(const tensorflow::TensorProto &tensor)
+{
+    std::string content = tensor.tensor_content();
+    switch (tensor.dtype())
+    {
+        case tensorflow::DT_FLOAT:
+        {
+            if (!content.empty())
+                return Mat(1, content.size() / sizeof(float), CV_32FC1, (void*)content.c_str()).clone();
+            else
+            {
+                const RepeatedField<float>& field = tensor.float_val();
+                CV_Assert(!field.empty());
+                return Mat(1, field.size(), CV_32FC1, (void*)field.data()).clone();
+            }
+        }
+        case tensorflow::DT_DOUBLE:
+        {
+            if (!content.empty())
+                return Mat(1, content.size() / sizeof(double), CV_64FC1, (void*)content.c_str()).clone();
+            else
+            {
+                const RepeatedField<double>& field = tensor.double_val();
+                CV_Assert(!field.empty());
+                return Mat(1, field.size(), CV_64FC1, (void*)field.data()).clone();
+            }
+        }
+        case tensorflow::DT_INT32:
+        {
+            if (!content.empty())
+                return Mat(1, content.size() / sizeof(int32_t), CV_32SC1, (void*)content.c_str()).clone();
+            else
+            {
+                const RepeatedField<int32_t>& field = tensor.int_val();
+                CV_Assert(!field.empty());
+                return Mat(1, field.size(), CV_32SC1, (void*)field.data()).clone();
+            }
+        }
+        case tensorflow::DT_HALF:
+        {
+            Mat halfs;
+            if (!content.empty())
+            {
+                static const int kHalfSize = 2;
+                halfs = Mat(1, content.size() / kHalfSize, CV_16UC1, (void*)content.c_str());
+            }
+            else
+            {
+                const RepeatedField<int32_t>& field = tensor.half_val();
+                CV_Assert(!field.empty());
+                Mat ints(1, field.size(), CV_32SC1, (void*)field.data());
+                ints.convertTo(halfs, CV_16UC1);
+            }
+            // Reinterpret as a signed shorts just for a convertFp16 call.
+            Mat halfsSigned(halfs.size(), CV_16SC1, halfs.data);
+            Mat floats(halfs.size(), CV_32FC1);
+            convertFp16(halfsSigned, floats);
+            return floats;
+        }
+        case tensorflow::DT_QUINT8:
+        {
+            CV_Assert(!content.empty());
+            return Mat(1, content.size(), CV_8UC1, (void*)content.c_str()).clone();
+        }
+        default:
+            CV_Error(Error::StsError, "Tensor's data type is not supported");
+            break;
+    }
+    return Mat();
+}
+
+void RemoveIdentityOps(tensorflow::GraphDef& net)
+{
+    typedef std::map<String, String>  IdentityOpsMap;
+    IdentityOpsMap identity_ops;
+
+    std::vector<int> identity_ops_idx;
+
+    int layersCount = net.node_size();
+    for (int li = 0; li < layersCount; li++)
+    {
+        const tensorflow::NodeDef &layer = net.node(li);
+        String type = layer.op();
+
+        if (isIdentityOp(type) && layer.input_size() > 0 && !isControlInput(layer.input(0))) {
+            identity_ops_idx.push_back(li);
+            identity_ops[layer.name()] = layer.input(0);
+        }
+    }
+
+    // Chains of identity ops are replaced by the first input.
+    IdentityOpsMap::iterator it;
+    for (it = identity_ops.begin(); it != identity_ops.end(); ++it)
+    {
+        for (size_t i = 0; i < identity_ops.size(); i++)
+        {
+            IdentityOpsMap::iterator next = identity_ops.find(getNodeName(it->second));
+            if (next == identity_ops.end() || getOutputIndex(it->second) != 0)
+                break;
+            it->second = next->second;
+        }
+    }
+
+    for (int li = 0; li < layersCount; li++)
+    {
+        tensorflow::NodeDef* layer = net.mutable_node(li);
+        for (int input_id = 0; input_id < layer->input_size(); input_id++) {
+            String input_op_name = layer->input(input_id);
+            it = identity_ops.find(getNodeName(input_op_name));
+            if (it == identity_ops.end())
+                continue;
+
+            if (isControlInput(input_op_name))
+                layer->set_input(input_id, "^" + getNodeName(it->second));
+            else if (getOutputIndex(input_op_name) == 0)
+                layer->set_input(input_id, it->second);
+        }
+    }
+
+    removeNodes(net, identity_ops_idx);
+}
+
+void RemovePhaseSwitches(tensorflow::GraphDef& net)
+{
+    NodeIdsMap nodeIds;
+    bool hasSwitches = false;
+    for (int i = 0; i < net.node_size(); ++i)
+    {
+        nodeIds[net.node(i).name()] = i;
+        hasSwitches = hasSwitches || net.node(i).op() == "Switch";
+    }
+    if (!hasSwitches)
+        return;
+
+    // Switch and Merge outputs are replaced by their selected inputs.
+    // Outputs of branches which are not executed are replaced by empty strings.
+    InputsMap replaced;
+    std::set<std::string> deadNodes;
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int i = 0; i < net.node_size(); ++i)
+        {
+            const tensorflow::NodeDef& node = net.node(i);
+            const std::string& name = node.name();
+            if (deadNodes.find(name) != deadNodes.end() || replaced.find(name + ":0") != replaced.end())
+                continue;
+
+            // Resolve inputs. Wait for Switch and Merge nodes which aren't processed yet.
+            std::vector<std::string> inputs;
+            bool ready = true;
+            for (int j = 0; j < node.input_size() && ready; ++j)
+            {
+                if (isControlInput(node.input(j)))
+                    continue;
+                std::string input = resolveInput(replaced, node.input(j));
+                if (!input.empty() && deadNodes.find(getNodeName(input)) != deadNodes.end())
+                    input = "";
+                NodeIdsMap::iterator it = nodeIds.find(getNodeName(input));
+                if (!input.empty() && it != nodeIds.end())
+                {
+                    const std::string& inpType = net.node(it->second).op();
+                    ready = inpType != "Switch" && inpType != "Merge";
+                }
+                inputs.push_back(input);
+            }
+            if (!ready)
+                continue;
+
+            if (node.op() == "Switch")
+            {
+                CV_Assert(inputs.size() == 2);
+                if (inputs[0].empty())
+                    deadNodes.insert(name);
+                else
+                {
+                    bool pred = getPredicateValue(net, nodeIds, inputs[1]);
+                    replaced[name + (pred ? ":1" : ":0")] = inputs[0];
+                    replaced[name + (pred ? ":0" : ":1")] = "";
+                }
+                changed = true;
+            }
+            else if (node.op() == "Merge")
+            {
+                std::string selected;
+                for (size_t j = 0; j < inputs.size() && selected.empty(); ++j)
+                    selected = inputs[j];
+                if (selected.empty())
+                    deadNodes.insert(name);
+                else
+                    replaced[name + ":0"] = selected;
+                changed = true;
+            }
+            else if (std::find(inputs.begin(), inputs.end(), std::string()) != inputs.end())
+            {
+                deadNodes.insert(name);
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<int> removedIds;
+    std::set<std::string> removedNames, candidates;
+    for (int i = 0; i < net.node_size(); ++i)
+    {
+        const tensorflow::NodeDef& node = net.node(i);
+        if (node.op() == "Switch" || node.op() == "Merge")
+        {
+            // Unresolved nodes are parts of loops which are not supported.
+            if (replaced.find(node.name() + ":0") == replaced.end() &&
+                deadNodes.find(node.name()) == deadNodes.end())
+                return;
+        }
+        else if (deadNodes.find(node.name()) == deadNodes.end())
+            continue;
+
+        removedIds.push_back(i);
+        removedNames.insert(node.name());
+        for (int j = 0; j < node.input_size(); ++j)
+            candidates.insert(getNodeName(node.input(j)));
+    }
+
+    for (int i = 0; i < net.node_size(); ++i)
+    {
+        tensorflow::NodeDef* node = net.mutable_node(i);
+        if (removedNames.find(node->name()) != removedNames.end())
+            continue;
+
+        std::vector<std::string> inputs;
+        for (int j = 0; j < node->input_size(); ++j)
+        {
+            const std::string& input = node->input(j);
+            if (!isControlInput(input))
+                inputs.push_back(resolveInput(replaced, input));
+            else if (removedNames.find(getNodeName(input)) == removedNames.end())
+                inputs.push_back(input);
+        }
+        node->clear_input();
+        for (size_t j = 0; j < inputs.size(); ++j)
+            node->add_input(inputs[j]);
+    }
+    removeNodes(net, removedIds);
+    removeUnusedNodes(net, candidates);
+}
+
+void FoldConstants(tensorflow::GraphDef& net)
+{
+    NodeIdsMap nodeIds;
+    for (int i = 0; i < net.node_size(); ++i)
+        nodeIds[net.node(i).name()] = i;
+
+    std::set<std::string> candidates;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int i = 0; i < net.node_size(); ++i)
+        {
+            const tensorflow::NodeDef& node = net.node(i);
+            ElementwiseOp op = getElementwiseOp(node);
+            if (op == OP_UNSUPPORTED)
+                continue;
+            int numInputs = op < OP_ADD ? 1 : 2;
+
+            std::vector<Mat> values;
+            std::vector<MatShape> shapes;
+            for (int j = 0; j < node.input_size(); ++j)
+            {
+                const std::string& input = node.input(j);
+                if (isControlInput(input))
+                    continue;
+                NodeIdsMap::iterator it = nodeIds.find(getNodeName(input));
+                if (it == nodeIds.end() || getOutputIndex(input) != 0)
+                    break;
+                shapes.push_back(MatShape());
+                values.push_back(getConstValues(net.node(it->second), shapes.back()));
+                if (values.back().empty())
+                    break;
+            }
+            if ((int)values.size() != numInputs || values.back().empty())
+                continue;
+
+            MatShape outShape = shapes[0];
+            if (numInputs == 2 && !broadcastShapes(shapes[0], shapes[1], outShape))
+                continue;
+
+            Mat result(1, (int)(outShape.empty() ? 1 : total(outShape)), CV_32FC1);
+            float* dst = result.ptr<float>();
+            const float* src0 = values[0].ptr<float>();
+            if (numInputs == 1)
+            {
+                for (size_t j = 0; j < result.total(); ++j)
+                    dst[j] = computeElementwise(op, src0[j], 0.f);
+            }
+            else
+            {
+                const float* src1 = values[1].ptr<float>();
+                std::vector<size_t> steps0 = getBroadcastSteps(shapes[0], outShape);
+                std::vector<size_t> steps1 = getBroadcastSteps(shapes[1], outShape);
+                for (size_t j = 0; j < result.total(); ++j)
+                {
+                    size_t idx = j, offset0 = 0, offset1 = 0;
+                    for (int d = (int)outShape.size() - 1; d >= 0; --d)
+                    {
+                        size_t k = idx % outShape[d];
+                        idx /= outShape[d];
+                        offset0 += k * steps0[d];
+                        offset1 += k * steps1[d];
+                    }
+                    dst[j] = computeElementwise(op, src0[offset0], src1[offset1]);
+                }
+            }
+
+            for (int j = 0; j < node.input_size(); ++j)
+                candidates.insert(getNodeName(node.input(j)));
+
+            tensorflow::NodeDef* constNode = net.mutable_node(i);
+            constNode->set_op("Const");
+            constNode->clear_input();
+            constNode->mutable_attr()->clear();
+            (*constNode->mutable_attr())["dtype"].set_type(tensorflow::DT_FLOAT);
+            tensorflow::TensorProto* tensor = (*constNode->mutable_attr())["value"].mutable_tensor();
+            tensor->set_dtype(tensorflow::DT_FLOAT);
+            for (size_t j = 0; j < outShape.size(); ++j)
+                tensor->mutable_tensor_shape()->add_dim()->set_size(outShape[j]);
+            tensor->set_tensor_content(result.data, result.total() * result.elemSize());
+            changed = true;
+        }
+    }
+    removeUnusedNodes(net, candidates);
+}
+
+void simplifyGraph(tensorflow::GraphDef& net)
+{
+    RemoveIdentityOps(net);
+    RemovePhaseSwitches(net);
+    FoldConstants(net);
+}
+
+CV__DNN_EXPERIMENTAL_NS_END
+}}  // namespace dnn, namespace cv
+
+#endif  // HAVE_PROTOBUF
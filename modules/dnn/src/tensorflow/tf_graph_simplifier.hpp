@@ -0,0 +1,41 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+/*
+Declaration of TensorFlow graph transformations which are applied before import.
+*/
+
+#ifndef __OPENCV_DNN_TF_SIMPLIFIER_HPP__
+#define __OPENCV_DNN_TF_SIMPLIFIER_HPP__
+
+#include "../precomp.hpp"
+
+#ifdef HAVE_PROTOBUF
+
+#include "graph.pb.h"
+
+namespace cv { namespace dnn {
+CV__DNN_EXPERIMENTAL_NS_BEGIN
+
+Mat getTensorContent(const tensorflow::TensorProto &tensor);
+
+// Replaces inputs of nodes which consume Identity, StopGradient, Snapshot or Dropout
+// by inputs of that nodes and removes them from the graph.
+void RemoveIdentityOps(tensorflow::GraphDef& net);
+
+// Removes Switch and Merge nodes produced by tf.cond (e.g. batch normalization with
+// is_training flag) together with branches which are never executed.
+void RemovePhaseSwitches(tensorflow::GraphDef& net);
+
+// Replaces elementwise operations over Const nodes by Const nodes with computed values.
+void FoldConstants(tensorflow::GraphDef& net);
+
+// Applies all the transformations above.
+void simplifyGraph(tensorflow::GraphDef& net);
+
+CV__DNN_EXPERIMENTAL_NS_END
+}}  // namespace dnn, namespace cv
+
+#endif  // HAVE_PROTOBUF
+#endif  // __OPENCV_DNN_TF_SIMPLIFIER_HPP__
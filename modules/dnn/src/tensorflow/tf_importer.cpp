@@ -22,6 +22,7 @@ Implementation of Tensorflow models parser
 #include <google/protobuf/text_format.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include "tf_io.hpp"
+#include "tf_graph_simplifier.hpp"
 #endif
 
 namespace cv {
@@ -87,77 +88,6 @@ void blobShapeFromTensor(const tensorflow::TensorProto &tensor, MatShape& shape)
     }
 }
 
-static Mat getTensorContent(const tensorflow::TensorProto &tensor)
-{
-    std::string content = tensor.tensor_content();
-    switch (tensor.dtype())
-    {
-        case tensorflow::DT_FLOAT:
-        {
-            if (!content.empty())
-                return Mat(1, content.size() / sizeof(float), CV_32FC1, (void*)content.c_str()).clone();
-            else
-            {
-                const RepeatedField<float>& field = tensor.float_val();
-                CV_Assert(!field.empty());
-                return Mat(1, field.size(), CV_32FC1, (void*)field.data()).clone();
-            }
-        }
-        case tensorflow::DT_DOUBLE:
-        {
-            if (!content.empty())
-                return Mat(1, content.size() / sizeof(double), CV_64FC1, (void*)content.c_str()).clone();
-            else
-            {
-                const RepeatedField<double>& field = tensor.double_val();
-                CV_Assert(!field.empty());
-                return Mat(1, field.size(), CV_64FC1, (void*)field.data()).clone();
-            }
-        }
-        case tensorflow::DT_INT32:
-        {
-            if (!content.empty())
-                return Mat(1, content.size() / sizeof(int32_t), CV_32SC1, (void*)content.c_str()).clone();
-            else
-            {
-                const RepeatedField<int32_t>& field = tensor.int_val();
-                CV_Assert(!field.empty());
-                return Mat(1, field.size(), CV_32SC1, (void*)field.data()).clone();
-            }
-        }
-        case tensorflow::DT_HALF:
-        {
-            Mat halfs;
-            if (!content.empty())
-            {
-                static const int kHalfSize = 2;
-                halfs = Mat(1, content.size() / kHalfSize, CV_16UC1, (void*)content.c_str());
-            }
-            else
-            {
-                const RepeatedField<int32_t>& field = tensor.half_val();
-                CV_Assert(!field.empty());
-                Mat ints(1, field.size(), CV_32SC1, (void*)field.data());
-                ints.convertTo(halfs, CV_16UC1);
-            }
-            // Reinterpret as a signed shorts just for a convertFp16 call.
-            Mat halfsSigned(halfs.size(), CV_16SC1, halfs.data);
-            Mat floats(halfs.size(), CV_32FC1);
-            convertFp16(halfsSigned, floats);
-            return floats;
-        }
-        case tensorflow::DT_QUINT8:
-        {
-            CV_Assert(!content.empty());
-            return Mat(1, content.size(), CV_8UC1, (void*)content.c_str()).clone();
-        }
-        default:
-            CV_Error(Error::StsError, "Tensor's data type is not supported");
-            break;
-    }
-    return Mat();
-}
-
 template <typename T>
 void parseTensor(const tensorflow::TensorProto &tensor, Mat &dstBlob)
 {
@@ -364,47 +294,6 @@ void setPadding(LayerParams &layerParams, const tensorflow::NodeDef &layer)
         layerParams.set("pad_mode", getLayerAttr(layer, "padding").s());
 }
 
-void RemoveIdentityOps(tensorflow::GraphDef& net) {
-    typedef std::map<String, String>  IdentityOpsMap;
-    IdentityOpsMap identity_ops;
-
-    std::vector<int> identity_ops_idx;
-
-    int layersCount = net.node_size();
-    for (int li = 0; li < layersCount; li++)
-    {
-        const tensorflow::NodeDef &layer = net.node(li);
-        String type = layer.op();
-
-        if (type == "Identity" || type == "Dropout") {
-            identity_ops_idx.push_back(li);
-            identity_ops[layer.name()] = layer.input(0);
-        }
-    }
-
-    for (int li = 0; li < layersCount; li++)
-    {
-        tensorflow::NodeDef* layer = net.mutable_node(li);
-        for (int input_id = 0; input_id < layer->input_size(); input_id++) {
-            String input_op_name = layer->input(input_id);
-            IdentityOpsMap::iterator it = identity_ops.find(input_op_name);
-
-            if (it != identity_ops.end()) {
-                layer->set_input(input_id, it->second);
-            }
-        }
-    }
-
-    std::sort(identity_ops_idx.begin(), identity_ops_idx.end());
-
-    int removed_nodes = 0;
-    for(size_t i = 0; i < identity_ops_idx.size(); i++) {
-        int start_id = identity_ops_idx[i] - removed_nodes;
-        net.mutable_node()->DeleteSubrange(start_id, 1);
-        removed_nodes++;
-    }
-}
-
 Pin parsePin(const std::string &name)
 {
     Pin pin(name);
@@ -476,6 +365,8 @@ private:
                            const int input_layer_id, const int input_blobs_count);
     const tensorflow::TensorProto& getConstBlob(const tensorflow::NodeDef &layer, std::map<String, int> const_layers,
                                                 int input_blob_index = -1, int* actual_inp_blob_idx = 0);
+    void foldBatchNorm(tensorflow::GraphDef& net, const String& name, const std::map<String, int>& const_layers,
+                       std::set<String>& layers_to_ignore, LayerParams& layerParams);
 
 
     // Binary serialized TensorFlow graph includes weights.
@@ -601,6 +492,67 @@ const tensorflow::TensorProto& TFImporter::getConstBlob(const tensorflow::NodeDe
     }
 }
 
+// Merges FusedBatchNorm which is the only consumer of convolution <name> into its weights and bias.
+void TFImporter::foldBatchNorm(tensorflow::GraphDef& net, const String& name, const std::map<String, int>& const_layers,
+                               std::set<String>& layers_to_ignore, LayerParams& layerParams)
+{
+    StrIntVector next_layers = getNextLayers(net, name);
+    int bn_index = -1;
+    for (size_t i = 0; i < next_layers.size(); i++)
+    {
+        if (layers_to_ignore.find(next_layers[i].first) != layers_to_ignore.end())
+            continue;
+        if (bn_index != -1)
+            return;  // Convolution output is used somewhere else.
+        bn_index = next_layers[i].second;
+    }
+    if (bn_index == -1)
+        return;
+
+    const tensorflow::NodeDef& bn = net.node(bn_index);
+    if (bn.op() != "FusedBatchNorm" || bn.input_size() != 5 || bn.input(0) != name ||
+        (hasLayerAttr(bn, "is_training") && getLayerAttr(bn, "is_training").b()))
+        return;
+    for (int i = 1; i < 5; i++)
+    {
+        if (const_layers.find(parsePin(bn.input(i)).name) == const_layers.end())
+            return;
+    }
+
+    Mat gamma, beta, mean, variance;
+    blobFromTensor(getConstBlob(bn, const_layers, 1), gamma);
+    blobFromTensor(getConstBlob(bn, const_layers, 2), beta);
+    blobFromTensor(getConstBlob(bn, const_layers, 3), mean);
+    blobFromTensor(getConstBlob(bn, const_layers, 4), variance);
+    // The same default value as BatchNorm layer uses.
+    float eps = hasLayerAttr(bn, "epsilon") ? getLayerAttr(bn, "epsilon").f() : 1e-5f;
+
+    Mat& weights = layerParams.blobs[0];
+    int outCn = weights.size[0];
+    if (gamma.total() != (size_t)outCn || beta.total() != (size_t)outCn ||
+        mean.total() != (size_t)outCn || variance.total() != (size_t)outCn)
+        return;
+
+    if (layerParams.blobs.size() < 2)
+    {
+        layerParams.blobs.push_back(Mat::zeros(1, outCn, CV_32F));
+        layerParams.set("bias_term", true);
+    }
+    float* bias = layerParams.blobs[1].ptr<float>();
+    size_t kernelSize = weights.total() / outCn;
+    for (int i = 0; i < outCn; i++)
+    {
+        float scale = gamma.ptr<float>()[i] / std::sqrt(variance.ptr<float>()[i] + eps);
+        float* w = weights.ptr<float>() + i * kernelSize;
+        for (size_t j = 0; j < kernelSize; j++)
+            w[j] *= scale;
+        bias[i] = (bias[i] - mean.ptr<float>()[i]) * scale + beta.ptr<float>()[i];
+    }
+
+    ExcludeLayer(net, bn_index, 0, false);
+    layers_to_ignore.insert(bn.name());
+}
+
 static void addConstNodes(tensorflow::GraphDef& net, std::map<String, int>& const_layers,
                           std::set<String>& layers_to_ignore)
 {
@@ -693,8 +645,8 @@ static int predictOutputDataLayout(const tensorflow::NodeDef& layer, const std::
 
 void TFImporter::populateNet(Net dstNet)
 {
-    RemoveIdentityOps(netBin);
-    RemoveIdentityOps(netTxt);
+    simplifyGraph(netBin);
+    simplifyGraph(netTxt);
 
     std::set<String> layers_to_ignore;
 
@@ -800,6 +752,8 @@ void TFImporter::populateNet(Net dstNet)
             layerParams.set("kernel_w", kshape[3]);
             layerParams.set("num_output", kshape[0]);
 
+            foldBatchNorm(net, name, value_id, layers_to_ignore, layerParams);
+
             setStrides(layerParams, layer);
             setPadding(layerParams, layer);
 
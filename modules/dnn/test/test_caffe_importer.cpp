@@ -447,4 +447,74 @@ TEST(Test_Caffe, multiple_inputs)
     normAssert(out, first_image + second_image);
 }
 
+static void appendVarint(std::string& dst, uint64 value)
+{
+    for (; value >= 0x80; value >>= 7)
+        dst.push_back((char)(value | 0x80));
+    dst.push_back((char)value);
+}
+
+// Appends a length-delimited field of protobuf message.
+static void appendField(std::string& dst, int field, const std::string& value)
+{
+    appendVarint(dst, ((uint64)field << 3) | 2);
+    appendVarint(dst, value.size());
+    dst += value;
+}
+
+static std::string serializeBlob(const Mat& m)
+{
+    std::string dims, blob, shape;
+    for (int i = 0; i < m.dims; i++)
+        appendVarint(dims, m.size[i]);
+    appendField(shape, 1, dims);
+    appendField(blob, 7, shape);
+    appendField(blob, 5, std::string((const char*)m.data, m.total() * m.elemSize()));
+    return blob;
+}
+
+// Weights are read from the memory mapped model file at any alignment.
+TEST(Test_Caffe, mapped_weights)
+{
+    Mat weights(3, 5, CV_32F), bias(1, 3, CV_32F), input(2, 5, CV_32F);
+    randu(weights, -1.0f, 1.0f);
+    randu(bias, -1.0f, 1.0f);
+    randu(input, -1.0f, 1.0f);
+    Mat ref;
+    gemm(input, weights, 1, repeat(bias, 2, 1), 1, ref, GEMM_2_T);
+
+    for (int nameLength = 1; nameLength <= 4; nameLength++)
+    {
+        const std::string name(nameLength, 'a');
+        std::string layer, model;
+        appendField(layer, 1, name);
+        appendField(layer, 7, serializeBlob(weights));
+        appendField(layer, 7, serializeBlob(bias.reshape(1, 3)));
+        appendField(model, 100, layer);
+
+        const std::string proto =
+            "input: \"data\" input_shape { dim: 2 dim: 5 } "
+            "layer { name: \"" + name + "\" type: \"InnerProduct\" bottom: \"data\" top: \"ip\" "
+            "inner_product_param { num_output: 3 } }";
+
+        const std::string protoPath = cv::tempfile(".prototxt");
+        const std::string modelPath = cv::tempfile(".caffemodel");
+        std::ofstream(protoPath.c_str()) << proto;
+        std::ofstream(modelPath.c_str(), std::ios::binary).write(model.data(), model.size());
+
+        {
+            Net net = readNetFromCaffe(protoPath, modelPath);
+            net.setInput(input);
+            normAssert(ref, net.forward(), name.c_str());
+        }
+        {
+            Net net = readNetFromCaffe(proto.data(), proto.size(), model.data(), model.size());
+            net.setInput(input);
+            normAssert(ref, net.forward(), name.c_str());
+        }
+        remove(protoPath.c_str());
+        remove(modelPath.c_str());
+    }
+}
+
 }
@@ -305,4 +305,67 @@ TEST(Reproducibility_YoloVoc, Accuracy)
     normAssert(ref, detection);
 }
 
+// Weights are read through the memory mapping for both versions of the header.
+TEST(Test_Darknet, mapped_weights)
+{
+    const int filters = 3, channels = 2;
+    Mat bias(1, filters, CV_32F), scale(1, filters, CV_32F), mean(1, filters, CV_32F), var(1, filters, CV_32F);
+    Mat weights(filters, channels, CV_32F);
+    randu(bias, -1.0f, 1.0f);
+    randu(scale, 0.5f, 1.5f);
+    randu(mean, -1.0f, 1.0f);
+    randu(var, 0.5f, 1.5f);
+    randu(weights, -1.0f, 1.0f);
+
+    int inpSize[] = {1, channels, 4, 4};
+    Mat input(4, inpSize, CV_32F);
+    randu(input, -1.0f, 1.0f);
+
+    Mat ref = weights * input.reshape(1, channels);
+    for (int i = 0; i < filters; i++)
+    {
+        float s = scale.at<float>(i) / std::sqrt(var.at<float>(i) + 1e-6f);
+        Mat row = ref.row(i);
+        row = (row - mean.at<float>(i)) * s + bias.at<float>(i);
+    }
+    ref = max(ref, ref * 0.1f);
+    int outSize[] = {1, filters, 4, 4};
+    ref = ref.reshape(1, 4, outSize);
+
+    const std::string cfg =
+        "[net]\nwidth=4\nheight=4\nchannels=2\n\n"
+        "[convolutional]\nbatch_normalize=1\nfilters=3\nsize=1\nstride=1\npad=1\nactivation=leaky\n";
+    const std::string cfgPath = cv::tempfile(".cfg");
+    std::ofstream(cfgPath.c_str()) << cfg;
+
+    for (int minor = 1; minor <= 2; minor++)
+    {
+        const std::string weightsPath = cv::tempfile(".weights");
+        {
+            std::ofstream ofs(weightsPath.c_str(), std::ios::binary);
+            int32_t header[] = {0, minor, 0};
+            ofs.write((const char*)header, sizeof(header));
+            if (minor >= 2)
+            {
+                uint64_t seen = 0;
+                ofs.write((const char*)&seen, sizeof(seen));
+            }
+            else
+            {
+                int32_t seen = 0;
+                ofs.write((const char*)&seen, sizeof(seen));
+            }
+            const Mat* blobs[] = {&bias, &scale, &mean, &var, &weights};
+            for (int i = 0; i < 5; i++)
+                ofs.write((const char*)blobs[i]->data, blobs[i]->total() * sizeof(float));
+        }
+
+        Net net = readNetFromDarknet(cfgPath, weightsPath);
+        net.setInput(input);
+        normAssert(ref, net.forward(), format("minor version %d", minor).c_str());
+        remove(weightsPath.c_str());
+    }
+    remove(cfgPath.c_str());
+}
+
 }
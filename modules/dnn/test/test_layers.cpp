@@ -467,6 +467,113 @@ TEST(Layer_LSTM_Test_Accuracy_with_, CaffeRecurrent)
     normAssert(h_t_reference, outputs[0]);
 }
 
+static float sigmoidRef(float x)
+{
+    return 1.f / (1.f + std::exp(-x));
+}
+
+// Straightforward implementation of LSTM used as a reference.
+static void lstmRef(const Mat& x, const std::vector<Mat>& blobs, float forgetBias,
+                    bool usePeephole, float cellClip, Mat& hOut, Mat& cOut)
+{
+    const Mat &Wh = blobs[0], &Wx = blobs[1], &b = blobs[2];
+    int numTimeStamps = x.size[0], numSamples = x.size[1], numInp = x.size[2];
+    int numOut = Wh.cols;
+    int outSizes[] = {numTimeStamps, numSamples, numOut};
+    hOut.create(3, outSizes, CV_32F);
+    cOut.create(3, outSizes, CV_32F);
+    for (int n = 0; n < numSamples; n++)
+    {
+        std::vector<float> h(numOut, 0.f), c(numOut, 0.f), gates(4 * numOut);
+        for (int t = 0; t < numTimeStamps; t++)
+        {
+            const float* xt = x.ptr<float>(t, n);
+            for (int i = 0; i < 4 * numOut; i++)
+            {
+                float s = b.at<float>(i);
+                for (int j = 0; j < numInp; j++)
+                    s += Wx.at<float>(i, j) * xt[j];
+                for (int j = 0; j < numOut; j++)
+                    s += Wh.at<float>(i, j) * h[j];
+                gates[i] = s;
+            }
+            for (int i = 0; i < numOut; i++)
+            {
+                float gi = gates[i], gf = gates[numOut + i] + forgetBias;
+                float go = gates[2 * numOut + i], gg = gates[3 * numOut + i];
+                if (usePeephole)
+                {
+                    for (int j = 0; j < numOut; j++)
+                    {
+                        gi += c[j] * blobs[3].at<float>(j, i);
+                        gf += c[j] * blobs[4].at<float>(j, i);
+                    }
+                }
+                gates[i] = sigmoidRef(gi) * std::tanh(gg);
+                gates[numOut + i] = sigmoidRef(gf);
+                gates[2 * numOut + i] = go;
+            }
+            for (int i = 0; i < numOut; i++)
+            {
+                float ci = gates[numOut + i] * c[i] + gates[i];
+                if (cellClip > 0)
+                    ci = std::min(std::max(ci, -cellClip), cellClip);
+                c[i] = ci;
+            }
+            for (int i = 0; i < numOut; i++)
+            {
+                float go = gates[2 * numOut + i];
+                if (usePeephole)
+                {
+                    for (int j = 0; j < numOut; j++)
+                        go += c[j] * blobs[5].at<float>(j, i);
+                }
+                h[i] = sigmoidRef(go) * std::tanh(c[i]);
+                hOut.ptr<float>(t, n)[i] = h[i];
+                cOut.ptr<float>(t, n)[i] = c[i];
+            }
+        }
+    }
+}
+
+typedef testing::TestWithParam<tuple<bool, bool> > Layer_LSTM_Test_Accuracy;
+TEST_P(Layer_LSTM_Test_Accuracy, Reference)
+{
+    bool usePeephole = get<0>(GetParam());
+    bool useCellClip = get<1>(GetParam());
+    const int numTimeStamps = 5, numSamples = 3, numInp = 7, numOut = 13;
+    const float forgetBias = 0.5f, cellClip = 0.7f;
+
+    LayerParams lp;
+    lp.blobs.resize(usePeephole ? 6 : 3);
+    lp.blobs[0].create(4 * numOut, numOut, CV_32F);
+    lp.blobs[1].create(4 * numOut, numInp, CV_32F);
+    lp.blobs[2].create(4 * numOut, 1, CV_32F);
+    for (size_t i = 3; i < lp.blobs.size(); i++)
+        lp.blobs[i].create(numOut, numOut, CV_32F);
+    for (size_t i = 0; i < lp.blobs.size(); i++)
+        randu(lp.blobs[i], -0.5f, 0.5f);
+    lp.set("produce_cell_output", true);
+    lp.set("forget_bias", forgetBias);
+    lp.set("use_peephole", usePeephole);
+    lp.set("use_cell_clip", useCellClip);
+    lp.set("cell_clip", cellClip);
+    Ptr<LSTMLayer> layer = LSTMLayer::create(lp);
+
+    int inpSizes[] = {numTimeStamps, numSamples, numInp};
+    Mat inp(3, inpSizes, CV_32F);
+    randu(inp, -1.f, 1.f);
+    std::vector<Mat> inputs(1, inp), outputs;
+    runLayer(layer, inputs, outputs);
+    ASSERT_EQ(2u, outputs.size());
+
+    Mat hRef, cRef;
+    lstmRef(inp, lp.blobs, forgetBias, usePeephole, useCellClip ? cellClip : 0.f, hRef, cRef);
+    normAssert(hRef.reshape(1, numTimeStamps * numSamples), outputs[0].reshape(1, numTimeStamps * numSamples), "h", 1e-5, 1e-4);
+    normAssert(cRef.reshape(1, numTimeStamps * numSamples), outputs[1].reshape(1, numTimeStamps * numSamples), "c", 1e-5, 1e-4);
+}
+INSTANTIATE_TEST_CASE_P(/**/, Layer_LSTM_Test_Accuracy, testing::Combine(testing::Bool(), testing::Bool()));
+
 TEST(Layer_RNN_Test_Accuracy_with_, CaffeRecurrent)
 {
     Ptr<RNNLayer> layer = RNNLayer::create(LayerParams());
@@ -486,6 +593,33 @@ TEST(Layer_RNN_Test_Accuracy_with_, CaffeRecurrent)
 }
 
 
+TEST(Layer_RNN_Test_Accuracy, tanhNearZero)
+{
+    // h = tanh(x), o = tanh(h): the relative precision should be kept for the small values.
+    const int n = 64;
+    Mat Wxh = Mat::eye(n, n, CV_32F), Who = Mat::eye(n, n, CV_32F);
+    Mat Whh = Mat::zeros(n, n, CV_32F), bh = Mat::zeros(n, 1, CV_32F), bo = Mat::zeros(n, 1, CV_32F);
+    Ptr<RNNLayer> layer = RNNLayer::create(LayerParams());
+    layer->setProduceHiddenOutput(true);
+    layer->setWeights(Wxh, bh, Whh, Who, bo);
+
+    int sz[] = {1, 1, n};
+    Mat inp(3, sz, CV_32F);
+    for (int i = 0; i < n; i++)
+        inp.ptr<float>()[i] = (i % 2 ? -1.f : 1.f) * std::pow(10.f, -6.f + 7.f * i / n);
+    std::vector<Mat> inputs(1, inp), outputs;
+    runLayer(layer, inputs, outputs);
+    ASSERT_EQ(2u, outputs.size());
+
+    for (int i = 0; i < n; i++)
+    {
+        float x = inp.ptr<float>()[i];
+        float h = outputs[1].ptr<float>()[i], o = outputs[0].ptr<float>()[i];
+        EXPECT_LE(std::abs(h - std::tanh(x)), 1e-6 * std::abs(std::tanh(x))) << x;
+        EXPECT_LE(std::abs(o - std::tanh(h)), 1e-6 * std::abs(std::tanh(h))) << x;
+    }
+}
+
 class Layer_RNN_Test : public ::testing::Test
 {
 public:
@@ -576,6 +710,460 @@ TEST(Layer_Test_ROIPooling, Accuracy)
     normAssert(out, ref);
 }
 
+static float iouRef(const Vec4f& a, const Vec4f& b)
+{
+    float w = std::min(a[2], b[2]) - std::max(a[0], b[0]);
+    float h = std::min(a[3], b[3]) - std::max(a[1], b[1]);
+    if (w < 0 || h < 0)
+        return 0;
+    float inter = w * h;
+    return inter / ((a[2] - a[0]) * (a[3] - a[1]) + (b[2] - b[0]) * (b[3] - b[1]) - inter);
+}
+
+static bool scoreDescendRef(const std::pair<float, Vec2i>& a, const std::pair<float, Vec2i>& b)
+{
+    return a.first > b.first;
+}
+
+// Straightforward implementation of DetectionOutput with normalized bounding boxes
+// and the first class as a background.
+static Mat detectionOutputRef(const Mat& loc, const Mat& conf, const Mat& priors,
+                              int numClasses, bool shareLocation, bool centerSize,
+                              int topK, int keepTopK, float confThreshold, float nmsThreshold)
+{
+    const int num = loc.size[0], numPriors = priors.size[2] / 4;
+    const int numLocClasses = shareLocation ? 1 : numClasses;
+    const float* pr = priors.ptr<float>();
+    const float* var = pr + numPriors * 4;
+    std::vector<Vec<float, 7> > dets;
+    for (int n = 0; n < num; ++n)
+    {
+        std::vector<std::vector<Vec4f> > boxes(numLocClasses, std::vector<Vec4f>(numPriors));
+        for (int c = 0; c < numLocClasses; ++c)
+        {
+            for (int p = 0; p < numPriors; ++p)
+            {
+                const float* l = loc.ptr<float>(n) + (p * numLocClasses + c) * 4;
+                const float* b = pr + p * 4;
+                const float* v = var + p * 4;
+                Vec4f& box = boxes[c][p];
+                if (centerSize)
+                {
+                    float pw = b[2] - b[0], ph = b[3] - b[1];
+                    float cx = v[0] * l[0] * pw + b[0] + 0.5f * pw;
+                    float cy = v[1] * l[1] * ph + b[1] + 0.5f * ph;
+                    float w = std::exp(v[2] * l[2]) * pw, h = std::exp(v[3] * l[3]) * ph;
+                    box = Vec4f(cx - 0.5f * w, cy - 0.5f * h, cx + 0.5f * w, cy + 0.5f * h);
+                }
+                else
+                    box = Vec4f(b[0] + v[0] * l[0], b[1] + v[1] * l[1],
+                                b[2] + v[2] * l[2], b[3] + v[3] * l[3]);
+            }
+        }
+        std::vector<std::pair<float, Vec2i> > kept;
+        for (int c = 1; c < numClasses; ++c)
+        {
+            std::vector<std::pair<float, int> > candidates;
+            for (int p = 0; p < numPriors; ++p)
+            {
+                float score = conf.ptr<float>(n)[p * numClasses + c];
+                if (score > confThreshold)
+                    candidates.push_back(std::make_pair(-score, p));
+            }
+            std::sort(candidates.begin(), candidates.end());
+            if (topK > 0 && (int)candidates.size() > topK)
+                candidates.resize(topK);
+            const std::vector<Vec4f>& classBoxes = boxes[shareLocation ? 0 : c];
+            std::vector<int> classKept;
+            for (size_t i = 0; i < candidates.size(); ++i)
+            {
+                bool keep = true;
+                for (size_t j = 0; j < classKept.size() && keep; ++j)
+                    keep = iouRef(classBoxes[candidates[i].second], classBoxes[classKept[j]]) <= nmsThreshold;
+                if (keep)
+                {
+                    classKept.push_back(candidates[i].second);
+                    kept.push_back(std::make_pair(-candidates[i].first, Vec2i(c, candidates[i].second)));
+                }
+            }
+        }
+        // Keep the best detections per image, ordered by label and then by score.
+        std::stable_sort(kept.begin(), kept.end(), scoreDescendRef);
+        if (keepTopK > -1 && (int)kept.size() > keepTopK)
+            kept.resize(keepTopK);
+        for (int c = 1; c < numClasses; ++c)
+        {
+            for (size_t i = 0; i < kept.size(); ++i)
+            {
+                if (kept[i].second[0] != c)
+                    continue;
+                const Vec4f& box = boxes[shareLocation ? 0 : c][kept[i].second[1]];
+                Vec<float, 7> det;
+                det[0] = n; det[1] = c; det[2] = kept[i].first;
+                det[3] = box[0]; det[4] = box[1]; det[5] = box[2]; det[6] = box[3];
+                dets.push_back(det);
+            }
+        }
+    }
+    return Mat(dets, true).reshape(1, (int)dets.size());
+}
+
+typedef testing::TestWithParam<tuple<bool, bool> > Layer_Test_DetectionOutput;
+TEST_P(Layer_Test_DetectionOutput, Reference)
+{
+    bool shareLocation = get<0>(GetParam());
+    bool centerSize = get<1>(GetParam());
+    const int num = 2, numPriors = 300, numClasses = 5, topK = 50, keepTopK = 40;
+    const float confThreshold = 0.3f, nmsThreshold = 0.45f;
+    const int numLocClasses = shareLocation ? 1 : numClasses;
+
+    RNG& rng = theRNG();
+    int priorsShape[] = {1, 2, numPriors * 4};
+    Mat priors(3, priorsShape, CV_32F);
+    float* pr = priors.ptr<float>();
+    for (int i = 0; i < numPriors; ++i)
+    {
+        float x = rng.uniform(0.f, 0.8f), y = rng.uniform(0.f, 0.8f);
+        pr[i * 4] = x;
+        pr[i * 4 + 1] = y;
+        pr[i * 4 + 2] = x + rng.uniform(0.05f, 0.2f);
+        pr[i * 4 + 3] = y + rng.uniform(0.05f, 0.2f);
+        pr[(numPriors + i) * 4] = pr[(numPriors + i) * 4 + 1] = 0.1f;
+        pr[(numPriors + i) * 4 + 2] = pr[(numPriors + i) * 4 + 3] = 0.2f;
+    }
+    Mat loc(num, numPriors * numLocClasses * 4, CV_32F);
+    randu(loc, -1.f, 1.f);
+    Mat conf(num, numPriors * numClasses, CV_32F);
+    randu(conf, 0.f, 1.f);
+
+    LayerParams lp;
+    lp.set("num_classes", numClasses);
+    lp.set("share_location", shareLocation);
+    lp.set("background_label_id", 0);
+    lp.set("nms_threshold", nmsThreshold);
+    lp.set("top_k", topK);
+    lp.set("keep_top_k", keepTopK);
+    lp.set("confidence_threshold", confThreshold);
+    lp.set("code_type", centerSize ? "CENTER_SIZE" : "CORNER");
+    Ptr<Layer> layer = DetectionOutputLayer::create(lp);
+
+    std::vector<Mat> inputs, outputs;
+    inputs.push_back(loc);
+    inputs.push_back(conf);
+    inputs.push_back(priors);
+    runLayer(layer, inputs, outputs);
+    ASSERT_EQ(1u, outputs.size());
+
+    Mat ref = detectionOutputRef(loc, conf, priors, numClasses, shareLocation, centerSize,
+                                 topK, keepTopK, confThreshold, nmsThreshold);
+    ASSERT_FALSE(ref.empty());
+    normAssert(ref, outputs[0].reshape(1, outputs[0].total() / 7), "", 1e-5, 1e-4);
+}
+INSTANTIATE_TEST_CASE_P(/**/, Layer_Test_DetectionOutput, testing::Combine(testing::Bool(), testing::Bool()));
+
+// Pruned weights: compare the sparse kernels (sparse_density = 1) with the dense ones (sparse_density = 0).
+typedef testing::TestWithParam<tuple<bool, bool> > Layer_Test_SparseWeights;
+TEST_P(Layer_Test_SparseWeights, Accuracy)
+{
+    const bool isConv = get<0>(GetParam());
+    const bool withReLU = get<1>(GetParam());
+    const int inpCn = 19, outCn = 11;
+
+    int inpSz[] = {2, inpCn, 9, 7};
+    Mat input(4, inpSz, CV_32F);
+    randu(input, -1.0f, 1.0f);
+
+    Mat weights, bias(1, outCn, CV_32F);
+    if (isConv)
+    {
+        int wsz[] = {outCn, inpCn, 1, 1};
+        weights.create(4, wsz, CV_32F);
+    }
+    else
+        weights.create(outCn, inpCn * 9 * 7, CV_32F);
+    randu(weights, -1.0f, 1.0f);
+    randu(bias, -1.0f, 1.0f);
+
+    // ~90% of zeros
+    Mat mask(1, (int)weights.total(), CV_32F);
+    randu(mask, 0.0f, 1.0f);
+    float* wptr = weights.ptr<float>();
+    for (size_t i = 0; i < weights.total(); i++)
+        wptr[i] = mask.at<float>((int)i) < 0.9f ? 0.f : wptr[i];
+
+    Mat outs[2];
+    for (int i = 0; i < 2; i++)
+    {
+        LayerParams lp;
+        lp.set("num_output", outCn);
+        lp.set("sparse_density", (float)i);
+        lp.blobs.push_back(weights.clone());
+        lp.blobs.push_back(bias.clone());
+        if (isConv)
+        {
+            lp.set("kernel_size", 1);
+            lp.type = "Convolution";
+        }
+        else
+            lp.type = "InnerProduct";
+        lp.name = "testLayer";
+
+        Net net;
+        net.addLayerToPrev(lp.name, lp.type, lp);
+        if (withReLU)
+        {
+            LayerParams reluParams;
+            reluParams.set("negative_slope", 0.1f);
+            net.addLayerToPrev("relu", "ReLU", reluParams);
+        }
+        net.setInput(input);
+        outs[i] = net.forward().clone();
+        if (i == 1)
+        {
+            // The dense kernels are restored for FP16 weights after the sparse one released them.
+            net.setWeightsType(DNN_WEIGHTS_FP16);
+            normAssert(outs[0], net.forward(), "FP16", 2e-3, 1e-2);
+            net.setWeightsType(DNN_WEIGHTS_FP32);
+            normAssert(outs[0], net.forward(), "FP32", 2e-3, 1e-2);
+        }
+    }
+    normAssert(outs[0], outs[1], "", 1e-5, 1e-4);
+}
+INSTANTIATE_TEST_CASE_P(/**/, Layer_Test_SparseWeights, testing::Combine(testing::Bool(), testing::Bool()));
+
+static Mat poolingRef(const Mat& inp, const Size& outSize, bool isMax, int kernel, int stride, int pad)
+{
+    const int inpH = inp.size[2], inpW = inp.size[3];
+    int outSz[] = {inp.size[0], inp.size[1], outSize.height, outSize.width};
+    Mat out(4, outSz, CV_32F);
+    const float* src = inp.ptr<float>();
+    float* dst = out.ptr<float>();
+    for (int plane = 0; plane < inp.size[0] * inp.size[1]; ++plane, src += inpH * inpW)
+    {
+        for (int y = 0; y < outSize.height; ++y)
+        {
+            for (int x = 0; x < outSize.width; ++x, ++dst)
+            {
+                int y0 = y * stride - pad, x0 = x * stride - pad;
+                int y1 = std::min(y0 + kernel, inpH + pad), x1 = std::min(x0 + kernel, inpW + pad);
+                const float area = (float)((y1 - y0) * (x1 - x0));
+                y0 = std::max(y0, 0); x0 = std::max(x0, 0);
+                y1 = std::min(y1, inpH); x1 = std::min(x1, inpW);
+                float res = isMax ? -FLT_MAX : 0.f;
+                for (int i = y0; i < y1; ++i)
+                    for (int j = x0; j < x1; ++j)
+                        res = isMax ? std::max(res, src[i * inpW + j]) : res + src[i * inpW + j];
+                *dst = isMax ? (y0 < y1 && x0 < x1 ? res : 0.f) : res / area;
+            }
+        }
+    }
+    return out;
+}
+
+// Strides without a dedicated kernel and padded borders take the vectorized path as well.
+typedef testing::TestWithParam<tuple<bool, int, int> > Layer_Test_PoolingStrides;
+TEST_P(Layer_Test_PoolingStrides, Accuracy)
+{
+    const bool isMax = get<0>(GetParam());
+    const int stride = get<1>(GetParam());
+    const int kernel = get<2>(GetParam());
+    const int pad = kernel / 2;
+
+    int inpSz[] = {1, 3, 13, 83};
+    Mat input(4, inpSz, CV_32F);
+    randu(input, -1.0f, 1.0f);
+
+    LayerParams lp;
+    lp.set("pool", isMax ? "MAX" : "AVE");
+    lp.set("kernel_size", kernel);
+    lp.set("stride", stride);
+    lp.set("pad", pad);
+    lp.type = "Pooling";
+    lp.name = "testLayer";
+
+    Net net;
+    net.addLayerToPrev(lp.name, lp.type, lp);
+    net.setInput(input);
+    Mat out = net.forward();
+    ASSERT_EQ(out.dims, 4);
+
+    Mat ref = poolingRef(input, Size(out.size[3], out.size[2]), isMax, kernel, stride, pad);
+    normAssert(out, ref, "", 1e-6, 1e-5);
+}
+INSTANTIATE_TEST_CASE_P(/**/, Layer_Test_PoolingStrides, testing::Combine(
+    testing::Bool(), testing::Values(1, 2, 3, 4, 5), testing::Values(2, 3, 5)
+));
+
+typedef testing::TestWithParam<std::string> Layer_Test_Activations;
+TEST_P(Layer_Test_Activations, Accuracy)
+{
+    const std::string type = GetParam();
+
+    int inpSz[] = {2, 3, 7, 29};
+    Mat input(4, inpSz, CV_32F);
+    randu(input, -10.0f, 10.0f);
+    // Saturated and denormal-producing arguments.
+    float* inp = input.ptr<float>();
+    inp[0] = 100.f; inp[1] = -100.f; inp[2] = 88.5f; inp[3] = -88.5f; inp[4] = 0.f; inp[5] = 1e-6f;
+    // NaN should stay NaN in the vectorized loops and in the tails.
+    const int nanIdx[] = {6, 100, 202, (int)input.total() - 1};
+    for (int k = 0; k < 4; k++)
+        inp[nanIdx[k]] = std::numeric_limits<float>::quiet_NaN();
+
+    Mat ref(4, inpSz, CV_32F);
+    float* refptr = ref.ptr<float>();
+    for (size_t i = 0; i < input.total(); ++i)
+    {
+        double x = inp[i];
+        if (type == "TanH")
+            refptr[i] = (float)std::tanh(x);
+        else if (type == "Sigmoid")
+            refptr[i] = (float)(1.0 / (1.0 + std::exp(-x)));
+        else
+            refptr[i] = (float)(x >= 0 ? x : std::exp(x) - 1.0);
+    }
+
+    LayerParams lp;
+    lp.type = type;
+    lp.name = "testLayer";
+    Net net;
+    net.addLayerToPrev(lp.name, lp.type, lp);
+    net.setInput(input);
+    Mat out = net.forward();
+    for (int k = 0; k < 4; k++)
+    {
+        EXPECT_TRUE(cvIsNaN(out.ptr<float>()[nanIdx[k]])) << nanIdx[k];
+        out.ptr<float>()[nanIdx[k]] = refptr[nanIdx[k]] = 0.f;
+    }
+    normAssert(out, ref, "", 1e-6, 1e-6);
+}
+INSTANTIATE_TEST_CASE_P(/**/, Layer_Test_Activations, testing::Values("TanH", "Sigmoid", "ELU"));
+
+// Continuous slices are views of the input blob so no data is copied.
+TEST(Layer_Test_Slice, views)
+{
+    int inpSz[] = {1, 6, 5, 7};
+    Mat input(4, inpSz, CV_32F);
+    randu(input, -1.0f, 1.0f);
+
+    Net net;
+    LayerParams powerParams;
+    powerParams.set("scale", 2.0f);
+    net.addLayerToPrev("scale", "Power", powerParams);
+
+    LayerParams sliceParams;
+    sliceParams.set("axis", 1);
+    sliceParams.set("slice_point", 2);
+    int sliceId = net.addLayerToPrev("slice", "Slice", sliceParams);
+
+    // Consumers of both parts.
+    LayerParams reluParams;
+    int reluId = net.addLayer("relu", "ReLU", reluParams);
+    net.connect(sliceId, 0, reluId, 0);
+    LayerParams absParams;
+    int absId = net.addLayer("abs", "AbsVal", absParams);
+    net.connect(sliceId, 1, absId, 0);
+
+    net.setInput(input);
+    net.forward();  // Outputs of layers are known after the first pass.
+    std::vector<String> outNames(1, "scale");
+    outNames.push_back("slice");
+    outNames.push_back("relu");
+    outNames.push_back("abs");
+    std::vector<std::vector<Mat> > outs;
+    net.forward(outs, outNames);
+    ASSERT_EQ(outs.size(), (size_t)4);
+    ASSERT_EQ(outs[1].size(), (size_t)2);
+
+    Mat scaled = input * 2;
+    Range ranges[][4] = {{Range::all(), Range(0, 2), Range::all(), Range::all()},
+                         {Range::all(), Range(2, 6), Range::all(), Range::all()}};
+    normAssert(outs[0][0], scaled);
+    for (int i = 0; i < 2; i++)
+    {
+        normAssert(outs[1][i], scaled(ranges[i]));
+        EXPECT_EQ(outs[1][i].data, outs[0][0](ranges[i]).data);
+    }
+    normAssert(outs[2][0], max(scaled(ranges[0]), 0));
+    normAssert(outs[3][0], abs(scaled(ranges[1])));
+}
+
+// Concatenation along spatial axes is also implicit if the outer dimensions are 1.
+TEST(Layer_Test_Concat, spatial_axis)
+{
+    int inpSz[] = {1, 1, 4, 6};
+    Mat input(4, inpSz, CV_32F);
+    randu(input, -1.0f, 1.0f);
+
+    Net net;
+    LayerParams reluParams, absParams, concatParams;
+    int reluId = net.addLayer("relu", "ReLU", reluParams);
+    int absId = net.addLayer("abs", "AbsVal", absParams);
+    concatParams.set("axis", 2);
+    int concatId = net.addLayer("concat", "Concat", concatParams);
+    net.connect(0, 0, reluId, 0);
+    net.connect(0, 0, absId, 0);
+    net.connect(reluId, 0, concatId, 0);
+    net.connect(absId, 0, concatId, 1);
+
+    net.setInput(input);
+    Mat out = net.forward();
+
+    Mat inp2d(4, 6, CV_32F, input.ptr<float>()), ref;
+    vconcat(max(inp2d, 0), abs(inp2d), ref);
+    int refSz[] = {1, 1, 8, 6};
+    normAssert(out, ref.reshape(1, 4, refSz));
+}
+
+// Several inputs are combined in a single pass and the output overwrites one of them.
+typedef testing::TestWithParam<std::string> Layer_Test_Eltwise_MultiInput;
+TEST_P(Layer_Test_Eltwise_MultiInput, Accuracy)
+{
+    const std::string op = GetParam();
+    const float coeffs[] = {0.5f, -1.0f, 2.0f};
+    int inpSz[] = {2, 3, 5, 11};
+    Mat input(4, inpSz, CV_32F);
+    randu(input, -1.0f, 1.0f);
+
+    Net net;
+    const float scales[] = {1.0f, -2.0f, 3.0f};
+    std::vector<Mat> branches(3);
+    int ids[3];
+    for (int i = 0; i < 3; i++)
+    {
+        LayerParams lp;
+        lp.set("scale", scales[i]);
+        ids[i] = net.addLayer(format("branch_%d", i), "Power", lp);
+        net.connect(0, 0, ids[i], 0);
+        branches[i] = input * scales[i];
+    }
+
+    LayerParams eltwiseParams;
+    eltwiseParams.set("operation", op);
+    if (op == "sum")
+        eltwiseParams.set("coeff", DictValue::arrayReal<const float*>(coeffs, 3));
+    int eltwiseId = net.addLayer("eltwise", "Eltwise", eltwiseParams);
+    for (int i = 0; i < 3; i++)
+        net.connect(ids[i], 0, eltwiseId, i);
+
+    Mat ref = branches[0].clone();
+    if (op == "sum")
+        ref *= coeffs[0];
+    for (int i = 1; i < 3; i++)
+    {
+        if (op == "sum")
+            ref += branches[i] * coeffs[i];
+        else if (op == "prod")
+            ref = ref.mul(branches[i]);
+        else
+            ref = max(ref, branches[i]);
+    }
+
+    net.setInput(input);
+    normAssert(net.forward(), ref);
+}
+INSTANTIATE_TEST_CASE_P(/**/, Layer_Test_Eltwise_MultiInput, testing::Values("sum", "prod", "max"));
+
 TEST(Layer_Test_FasterRCNN_Proposal, Accuracy)
 {
     Net net = readNetFromCaffe(_tf("net_faster_rcnn_proposal.prototxt"));
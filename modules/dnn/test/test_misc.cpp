@@ -6,6 +6,11 @@
 // Third party copyrights are property of their respective owners.
 
 #include "test_precomp.hpp"
+#include <fstream>
+#include <iterator>
+#ifdef CV_CXX11
+#include <thread>
+#endif
 
 namespace cvtest
 {
@@ -27,4 +32,669 @@ TEST(blobFromImage_4ch, Regression)
     }
 }
 
+typedef testing::TestWithParam<tuple<int, int, bool, bool> > blobFromImages_accuracy;
+TEST_P(blobFromImages_accuracy, Accuracy)
+{
+    const int depth = get<0>(GetParam());
+    const int cn = get<1>(GetParam());
+    const bool swapRB = get<2>(GetParam());
+    const bool crop = get<3>(GetParam());
+    const Size size(37, 29);
+    const Scalar mean(10, 20, 30, 40);
+    const double scale = 0.5;
+
+    std::vector<Mat> images(3);
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        images[i].create(45 + (int)i, 41, CV_MAKETYPE(depth, cn));
+        randu(images[i], 0, 255);
+    }
+
+    Mat blob = dnn::blobFromImages(images, scale, size, mean, swapRB, crop);
+    ASSERT_EQ(4, blob.dims);
+    ASSERT_EQ((int)images.size(), blob.size[0]);
+    ASSERT_EQ(cn, blob.size[1]);
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        Mat img = images[i];
+        if (crop)
+        {
+            float factor = std::max(size.width / (float)img.cols, size.height / (float)img.rows);
+            resize(img, img, Size(), factor, factor, INTER_LINEAR);
+            img = img(Rect(Point(0.5 * (img.cols - size.width), 0.5 * (img.rows - size.height)), size));
+        }
+        else
+            resize(img, img, size, 0, 0, INTER_LINEAR);
+        img.convertTo(img, CV_32F);
+        std::vector<Mat> ch;
+        split(img, ch);
+        for (int c = 0; c < cn; c++)
+        {
+            int plane = swapRB && cn >= 3 && c != 1 && c != 3 ? 2 - c : c;
+            double m = mean[swapRB && c != 1 && c != 3 ? 2 - c : c];
+            Mat ref = (ch[c] - m) * scale;
+            Mat out(size.height, size.width, CV_32F, blob.ptr((int)i, plane));
+            normAssert(ref, out, format("image %d, channel %d", (int)i, c).c_str(), 1e-5, 1e-4);
+        }
+    }
+
+    // The preallocated blob is reused.
+    Mat out = Mat::zeros(4, &blob.size[0], CV_32F);
+    const uchar* data = out.data;
+    dnn::blobFromImages(images, out, scale, size, mean, swapRB, crop);
+    EXPECT_EQ(data, out.data);
+    normAssert(blob, out);
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, blobFromImages_accuracy, testing::Combine(
+    testing::Values(CV_8U, CV_32F),
+    testing::Values(1, 3, 4),
+    testing::Bool(),
+    testing::Bool()
+));
+
+// input -> (AbsVal, Power, ReLU) -> Concat -> Eltwise(concat, concat)
+static dnn::Net buildBranchyNet()
+{
+    dnn::Net net;
+    std::vector<int> branches;
+    const char* types[] = {"AbsVal", "Power", "ReLU"};
+    for (int i = 0; i < 3; i++)
+    {
+        dnn::LayerParams lp;
+        lp.type = types[i];
+        lp.name = format("branch_%d", i);
+        if (lp.type == "Power")
+            lp.set("power", 2.0f);
+        int id = net.addLayer(lp.name, lp.type, lp);
+        net.connect(0, 0, id, 0);
+        branches.push_back(id);
+    }
+    dnn::LayerParams concatParams;
+    concatParams.set("axis", 1);
+    int concatId = net.addLayer("concat", "Concat", concatParams);
+    for (int i = 0; i < (int)branches.size(); i++)
+        net.connect(branches[i], 0, concatId, i);
+
+    dnn::LayerParams sumParams;
+    int sumId = net.addLayer("sum", "Eltwise", sumParams);
+    net.connect(concatId, 0, sumId, 0);
+    net.connect(concatId, 0, sumId, 1);
+    return net;
+}
+
+TEST(Net, parallel_layers)
+{
+    int sz[] = {2, 3, 5, 7};
+    Mat input(4, sz, CV_32F);
+    randu(input, -1.0f, 1.0f);
+
+    dnn::Net net = buildBranchyNet();
+    net.setInput(input);
+    Mat ref = net.forward().clone();
+
+    Mat refBranch = net.forward("branch_1").clone();
+
+    net.enableParallelLayers(true);
+    net.setInput(input);
+    Mat out = net.forward();
+    normAssert(ref, out);
+    normAssert(refBranch, net.forward("branch_1"));
+}
+
+// input -> MaxPool -> ReLU -> (AvePool, MaxPool) -> Eltwise -> Concat(eltwise, max pool) -> ReLU
+static dnn::Net buildPoolingNet()
+{
+    dnn::Net net;
+    dnn::LayerParams lp;
+    lp.set("pool", "max");
+    lp.set("kernel_size", 3);
+    lp.set("pad", 1);
+    int pool1 = net.addLayerToPrev("pool1", "Pooling", lp);
+
+    lp = dnn::LayerParams();
+    lp.set("negative_slope", 0.1f);
+    int relu = net.addLayer("relu1", "ReLU", lp);
+    net.connect(pool1, 0, relu, 0);
+
+    lp = dnn::LayerParams();
+    lp.set("pool", "ave");
+    lp.set("kernel_size", 3);
+    lp.set("stride", 2);
+    lp.set("pad", 1);
+    int pool2 = net.addLayer("pool2", "Pooling", lp);
+    net.connect(relu, 0, pool2, 0);
+
+    lp = dnn::LayerParams();
+    lp.set("pool", "max");
+    lp.set("kernel_size", 2);
+    lp.set("stride", 2);
+    int pool3 = net.addLayer("pool3", "Pooling", lp);
+    net.connect(relu, 0, pool3, 0);
+
+    lp = dnn::LayerParams();
+    int sum = net.addLayer("sum", "Eltwise", lp);
+    net.connect(pool2, 0, sum, 0);
+    net.connect(pool3, 0, sum, 1);
+
+    lp = dnn::LayerParams();
+    lp.set("axis", 1);
+    int concat = net.addLayer("concat", "Concat", lp);
+    net.connect(sum, 0, concat, 0);
+    net.connect(pool3, 0, concat, 1);
+
+    lp = dnn::LayerParams();
+    lp.set("negative_slope", 0.2f);
+    int out = net.addLayer("out", "ReLU", lp);
+    net.connect(concat, 0, out, 0);
+    return net;
+}
+
+TEST(Net, blockedLayout)
+{
+    // Number of channels is not a multiple of a block (concatenation is computed in NCHW layout)
+    // and a multiple of it.
+    for (int channels = 12; channels <= 16; channels += 4)
+    {
+        int sz[] = {2, channels, 9, 7};
+        Mat input(4, sz, CV_32F);
+        randu(input, -1.0f, 1.0f);
+
+        dnn::Net net = buildPoolingNet();
+        net.setInput(input);
+        Mat ref = net.forward().clone();
+        Mat refSum = net.forward("sum").clone();
+
+        net.enableBlockedLayout(true);
+        net.setInput(input);
+        normAssert(ref, net.forward());
+        normAssert(refSum, net.forward("sum"));
+
+        std::vector<Mat> outs;
+        std::vector<String> names(1, "pool3");
+        names.push_back("out");
+        net.forward(outs, names);
+        ASSERT_EQ(2u, outs.size());
+        normAssert(ref, outs[1]);
+        EXPECT_EQ(channels, outs[0].size[1]);
+    }
+}
+
+TEST(Net, writeOptimized)
+{
+    const int inpCn = 3, outCn = 4;
+    dnn::Net net;
+    {
+        dnn::LayerParams lp;
+        lp.set("kernel_size", 3);
+        lp.set("pad", 1);
+        lp.set("num_output", outCn);
+        int wsz[] = {outCn, inpCn, 3, 3};
+        lp.blobs.push_back(Mat(4, wsz, CV_32F));
+        lp.blobs.push_back(Mat(outCn, 1, CV_32F));
+        randu(lp.blobs[0], -1.0f, 1.0f);
+        randu(lp.blobs[1], -1.0f, 1.0f);
+        net.addLayerToPrev("conv", "Convolution", lp);
+    }
+    {
+        dnn::LayerParams lp;
+        lp.blobs.push_back(Mat(1, outCn, CV_32F));
+        lp.blobs.push_back(Mat(1, outCn, CV_32F));
+        lp.blobs.push_back(Mat(1, 1, CV_32F, Scalar(1)));
+        randu(lp.blobs[0], -1.0f, 1.0f);
+        randu(lp.blobs[1], 0.5f, 1.0f);
+        net.addLayerToPrev("bn", "BatchNorm", lp);
+    }
+    {
+        dnn::LayerParams lp;
+        lp.set("bias_term", true);
+        lp.blobs.push_back(Mat(1, outCn, CV_32F));
+        lp.blobs.push_back(Mat(1, outCn, CV_32F));
+        randu(lp.blobs[0], -1.0f, 1.0f);
+        randu(lp.blobs[1], -1.0f, 1.0f);
+        net.addLayerToPrev("scale", "Scale", lp);
+    }
+    {
+        dnn::LayerParams lp;
+        net.addLayerToPrev("relu", "ReLU", lp);
+    }
+
+    int sz[] = {1, inpCn, 6, 7};
+    Mat input(4, sz, CV_32F);
+    randu(input, -1.0f, 1.0f);
+    net.setInput(input);
+    Mat ref = net.forward().clone();
+
+    std::string path = cv::tempfile(".bin");
+    net.writeOptimized(path);
+    {
+        dnn::Net optimized = dnn::readNetFromOptimized(path);
+        EXPECT_EQ(0, optimized.getLayersCount("BatchNorm"));
+        EXPECT_EQ(0, optimized.getLayersCount("Scale"));
+        optimized.setInput(input);
+        normAssert(ref, optimized.forward(), "", 1e-5, 1e-4);
+    }
+    remove(path.c_str());
+}
+
+TEST(Net, writeOptimized_keep_outputs)
+{
+    dnn::Net net;
+    {
+        dnn::LayerParams lp;
+        lp.set("kernel_size", 1);
+        lp.set("num_output", 2);
+        lp.set("bias_term", false);
+        int wsz[] = {2, 3, 1, 1};
+        lp.blobs.push_back(Mat(4, wsz, CV_32F));
+        randu(lp.blobs[0], -1.0f, 1.0f);
+        net.addLayerToPrev("conv", "Convolution", lp);
+    }
+    {
+        dnn::LayerParams lp;
+        lp.set("bias_term", false);
+        lp.blobs.push_back(Mat(1, 2, CV_32F));
+        randu(lp.blobs[0], -1.0f, 1.0f);
+        net.addLayerToPrev("scale", "Scale", lp);
+    }
+
+    int sz[] = {1, 3, 4, 5};
+    Mat input(4, sz, CV_32F);
+    randu(input, -1.0f, 1.0f);
+    net.setInput(input);
+    Mat ref = net.forward("scale").clone();
+
+    std::string path = cv::tempfile(".bin");
+    net.writeOptimized(path);
+    {
+        dnn::Net optimized = dnn::readNetFromOptimized(path);
+        EXPECT_EQ(1, optimized.getLayersCount("Scale"));
+        optimized.setInput(input);
+        normAssert(ref, optimized.forward("scale"));
+    }
+    remove(path.c_str());
+}
+
+TEST(Net, writeOptimized_empty_params)
+{
+    dnn::Net net;
+    {
+        dnn::LayerParams lp;
+        lp.set("negative_slope", 0.5);
+        std::vector<int> ints;
+        std::vector<double> reals;
+        std::vector<String> strings;
+        lp.set("ints", dnn::DictValue::arrayInt(ints.begin(), 0));
+        lp.set("reals", dnn::DictValue::arrayReal(reals.begin(), 0));
+        lp.set("strings", dnn::DictValue::arrayString(strings.begin(), 0));
+        net.addLayerToPrev("relu", "ReLU", lp);
+    }
+
+    int sz[] = {1, 2, 3, 4};
+    Mat input(4, sz, CV_32F);
+    randu(input, -1.0f, 1.0f);
+    net.setInput(input);
+    Mat ref = net.forward().clone();
+
+    std::string path = cv::tempfile(".bin");
+    net.writeOptimized(path);
+    {
+        dnn::Net optimized;
+        ASSERT_NO_THROW(optimized = dnn::readNetFromOptimized(path));
+        optimized.setInput(input);
+        normAssert(ref, optimized.forward());
+    }
+    remove(path.c_str());
+}
+
+typedef testing::TestWithParam<tuple<int, bool> > Net_WeightsType;
+TEST_P(Net_WeightsType, Accuracy)
+{
+    const int weightsType = get<0>(GetParam());
+    const bool useOptimized = get<1>(GetParam());
+    const int lowpDepth = weightsType == dnn::DNN_WEIGHTS_FP16 ? CV_16S : CV_16U;
+
+    dnn::Net net;
+    {
+        dnn::LayerParams lp;
+        lp.set("kernel_size", 3);
+        lp.set("pad", 1);
+        lp.set("num_output", 13);
+        int wsz[] = {13, 3, 3, 3};
+        lp.blobs.push_back(Mat(4, wsz, CV_32F));
+        lp.blobs.push_back(Mat(1, 13, CV_32F));
+        randu(lp.blobs[0], -0.5f, 0.5f);
+        randu(lp.blobs[1], -0.5f, 0.5f);
+        net.addLayerToPrev("conv", "Convolution", lp);
+    }
+    {
+        dnn::LayerParams lp;
+        Mat mean(1, 13, CV_32F), var(1, 13, CV_32F);
+        randu(mean, -0.5f, 0.5f);
+        randu(var, 0.5f, 1.5f);
+        lp.blobs.push_back(mean);
+        lp.blobs.push_back(var);
+        lp.blobs.push_back(Mat::ones(1, 1, CV_32F));
+        net.addLayerToPrev("bn", "BatchNorm", lp);
+    }
+    {
+        dnn::LayerParams lp;
+        net.addLayerToPrev("relu", "ReLU", lp);
+    }
+    {
+        dnn::LayerParams lp;
+        lp.set("num_output", 10);
+        lp.blobs.push_back(Mat(10, 13 * 10 * 10, CV_32F));
+        lp.blobs.push_back(Mat(1, 10, CV_32F));
+        randu(lp.blobs[0], -0.1f, 0.1f);
+        randu(lp.blobs[1], -0.5f, 0.5f);
+        net.addLayerToPrev("fc", "InnerProduct", lp);
+    }
+
+    int sz[] = {2, 3, 10, 10};
+    Mat input(4, sz, CV_32F);
+    randu(input, -1.0f, 1.0f);
+
+    const bool prevUseOptimized = cv::useOptimized();
+    cv::setUseOptimized(useOptimized);
+
+    net.setInput(input);
+    Mat ref = net.forward().clone();
+
+    const double l1 = weightsType == dnn::DNN_WEIGHTS_FP16 ? 2e-3 : 2e-2;
+    const double lInf = weightsType == dnn::DNN_WEIGHTS_FP16 ? 1e-2 : 1e-1;
+
+    net.setWeightsType(weightsType);
+    net.setInput(input);
+    Mat out = net.forward().clone();
+    normAssert(ref, out, "", l1, lInf);
+    EXPECT_EQ(lowpDepth, net.getParam(net.getLayerId("conv")).depth());
+    EXPECT_EQ(lowpDepth, net.getParam(net.getLayerId("fc")).depth());
+
+    // Switching back keeps the reduced precision but computes in FP32.
+    net.setWeightsType(dnn::DNN_WEIGHTS_FP32);
+    net.setInput(input);
+    normAssert(ref, net.forward(), "", l1, lInf);
+    EXPECT_EQ(CV_32F, net.getParam(net.getLayerId("conv")).depth());
+    EXPECT_EQ(CV_32F, net.getParam(net.getLayerId("fc")).depth());
+
+    cv::setUseOptimized(prevUseOptimized);
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, Net_WeightsType, testing::Combine(
+    testing::Values((int)dnn::DNN_WEIGHTS_FP16, (int)dnn::DNN_WEIGHTS_BF16),
+    testing::Bool()
+));
+
+TEST(Net, allocation_cache)
+{
+    int sizes[][4] = {{1, 3, 5, 7}, {2, 3, 6, 4}, {1, 3, 8, 8}};
+    std::vector<Mat> inputs(3), refs(3);
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        inputs[i].create(4, sizes[i], CV_32F);
+        randu(inputs[i], -1.0f, 1.0f);
+        dnn::Net ref = buildBranchyNet();
+        ref.setInput(inputs[i]);
+        refs[i] = ref.forward().clone();
+    }
+
+    dnn::Net net = buildBranchyNet();
+    std::vector<std::vector<dnn::MatShape> > shapes(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++)
+        shapes[i].push_back(dnn::MatShape(sizes[i], sizes[i] + 4));
+    net.preallocate(shapes);
+
+    std::vector<const uchar*> outData(inputs.size());
+    for (int iter = 0; iter < 3; iter++)
+    {
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            net.setInput(inputs[i]);
+            Mat out = net.forward();
+            normAssert(refs[i], out);
+            // Blobs of all the shapes are allocated once.
+            if (iter == 0)
+                outData[i] = out.data;
+            else
+                EXPECT_EQ(outData[i], out.data);
+        }
+    }
+
+    net.setAllocationCacheSize(0);
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        net.setInput(inputs[i]);
+        normAssert(refs[i], net.forward());
+    }
+}
+
+TEST(Net, profile)
+{
+    dnn::Net net;
+    {
+        dnn::LayerParams lp;
+        lp.set("kernel_size", 3);
+        lp.set("num_output", 4);
+        int wsz[] = {4, 3, 3, 3};
+        lp.blobs.push_back(Mat(4, wsz, CV_32F));
+        randu(lp.blobs[0], -0.5f, 0.5f);
+        net.addLayerToPrev("conv", "Convolution", lp);
+    }
+    {
+        dnn::LayerParams lp;
+        lp.blobs.push_back(Mat::zeros(1, 4, CV_32F));
+        lp.blobs.push_back(Mat::ones(1, 4, CV_32F));
+        lp.blobs.push_back(Mat::ones(1, 1, CV_32F));
+        net.addLayerToPrev("bn", "BatchNorm", lp);
+    }
+    {
+        dnn::LayerParams lp;
+        net.addLayerToPrev("relu", "ReLU", lp);
+    }
+    {
+        dnn::LayerParams lp;
+        lp.set("num_output", 2);
+        lp.blobs.push_back(Mat(2, 4 * 6 * 6, CV_32F));
+        lp.blobs.push_back(Mat(1, 2, CV_32F));
+        randu(lp.blobs[0], -0.1f, 0.1f);
+        randu(lp.blobs[1], -0.5f, 0.5f);
+        net.addLayerToPrev("fc", "InnerProduct", lp);
+    }
+
+    int sz[] = {1, 3, 8, 8};
+    Mat input(4, sz, CV_32F);
+    randu(input, -1.0f, 1.0f);
+    net.setInput(input);
+    net.forward();
+
+    std::vector<dnn::LayerProfile> profile;
+    double time = net.getProfile(profile);
+    ASSERT_EQ(4u, profile.size());
+    double sum = 0;
+    for (size_t i = 0; i < profile.size(); i++)
+    {
+        const dnn::LayerProfile& p = profile[i];
+        EXPECT_EQ(net.getLayerId(p.name), p.id);
+        EXPECT_EQ(net.getFLOPS(p.id, dnn::MatShape(sz, sz + 4)), p.flops);
+        EXPECT_GT(p.bytesWritten, 0);
+        sum += p.time;
+    }
+    EXPECT_DOUBLE_EQ(sum, time);
+
+    EXPECT_EQ("conv", profile[0].name);
+    EXPECT_FALSE(profile[0].skipped);
+    EXPECT_FALSE(profile[0].kernel.empty());
+    EXPECT_EQ((int64)(3 * 8 * 8 + 4 * 3 * 3 * 3) * 4, profile[0].bytesRead);
+    EXPECT_EQ((int64)(4 * 6 * 6) * 4, profile[0].bytesWritten);
+    EXPECT_TRUE(profile[1].skipped);
+    EXPECT_EQ("conv", profile[1].fusedInto);
+    EXPECT_EQ(0.0, profile[1].time);
+    EXPECT_TRUE(profile[2].skipped);
+    EXPECT_EQ("conv", profile[2].fusedInto);
+    EXPECT_FALSE(profile[3].skipped);
+    EXPECT_TRUE(profile[3].fusedInto.empty());
+
+    std::string csvPath = cv::tempfile(".csv"), jsonPath = cv::tempfile(".json");
+    net.writeProfile(csvPath);
+    net.writeProfile(jsonPath);
+
+    std::ifstream csv(csvPath.c_str());
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(csv, line))
+        lines.push_back(line);
+    ASSERT_EQ(5u, lines.size());
+    EXPECT_EQ(0u, lines[0].find("id,name,type,"));
+    EXPECT_EQ(0u, lines[2].find("2,bn,BatchNorm,"));
+
+    std::ifstream json(jsonPath.c_str());
+    std::string content((std::istreambuf_iterator<char>(json)), std::istreambuf_iterator<char>());
+    EXPECT_NE(std::string::npos, content.find("\"name\": \"fc\", \"type\": \"InnerProduct\""));
+    EXPECT_NE(std::string::npos, content.find("\"fused_into\": \"conv\""));
+    csv.close();
+    json.close();
+    remove(csvPath.c_str());
+    remove(jsonPath.c_str());
+}
+
+#ifdef CV_CXX11
+TEST(Net, forwardAsync)
+{
+    int sz[] = {1, 3, 5, 7};
+    std::vector<Mat> inputs(3), refs(3);
+    dnn::Net net = buildBranchyNet();
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        inputs[i].create(4, sz, CV_32F);
+        randu(inputs[i], -1.0f, 1.0f);
+        net.setInput(inputs[i]);
+        refs[i] = net.forward().clone();
+    }
+
+    std::vector<std::future<Mat> > outs;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        net.setInput(inputs[i]);
+        outs.push_back(net.forwardAsync());
+    }
+    for (size_t i = 0; i < outs.size(); i++)
+        normAssert(refs[i], outs[i].get());
+}
+
+TEST(Net, forwardAsync_interleaved)
+{
+    int sz[] = {1, 3, 5, 7};
+    std::vector<Mat> inputs(2), refs(2);
+    dnn::Net net = buildBranchyNet();
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        inputs[i].create(4, sz, CV_32F);
+        randu(inputs[i], -1.0f, 1.0f);
+        net.setInput(inputs[i]);
+        refs[i] = net.forward().clone();
+    }
+
+    for (int iter = 0; iter < 10; iter++)
+    {
+        net.setInput(inputs[0]);
+        std::future<Mat> out = net.forwardAsync();
+        net.setInput(inputs[1]);
+        normAssert(refs[1], net.forward());
+        normAssert(refs[0], out.get());
+        // The pending request doesn't replace inputs of the next forward.
+        normAssert(refs[1], net.forward());
+    }
+}
+
+TEST(BatchingExecutor, accuracy)
+{
+    const int numClients = 4, numRequests = 24, maxBatchSize = 4;
+    // Requests of different shapes and with several samples are mixed.
+    int sz[][4] = {{1, 3, 5, 7}, {1, 3, 4, 4}, {2, 3, 5, 7}};
+    std::vector<Mat> inputs(numRequests), refs(numRequests);
+    dnn::Net net = buildBranchyNet();
+    for (int i = 0; i < numRequests; i++)
+    {
+        inputs[i].create(4, sz[i % 3], CV_32F);
+        randu(inputs[i], -1.0f, 1.0f);
+        net.setInput(inputs[i]);
+        refs[i] = net.forward().clone();
+    }
+
+    std::vector<std::future<Mat> > outs(numRequests);
+    dnn::BatchingExecutor executor(net, maxBatchSize, 20.0);
+    std::vector<std::thread> clients;
+    for (int t = 0; t < numClients; t++)
+    {
+        clients.push_back(std::thread([&, t]() {
+            for (int i = t; i < numRequests; i += numClients)
+                outs[i] = executor.submit(inputs[i]);
+        }));
+    }
+    for (size_t t = 0; t < clients.size(); t++)
+        clients[t].join();
+
+    for (int i = 0; i < numRequests; i++)
+        normAssert(refs[i], outs[i].get());
+
+    dnn::BatchingExecutor::Stats stats = executor.getStats();
+    EXPECT_EQ((size_t)numRequests, stats.requests);
+    EXPECT_LE(stats.batches, (size_t)numRequests);
+    EXPECT_GE(stats.meanBatchSize, 1.0);
+    EXPECT_LE(stats.meanBatchSize, (double)maxBatchSize);
+    EXPECT_LE(stats.meanQueueTime, stats.meanLatency);
+    EXPECT_LE(stats.p50Latency, stats.p90Latency);
+    EXPECT_LE(stats.p90Latency, stats.p99Latency);
+    EXPECT_LE(stats.p99Latency, stats.maxLatency);
+
+    executor.resetStats();
+    EXPECT_EQ((size_t)0, executor.getStats().requests);
+}
+
+TEST(BatchingExecutor, errors)
+{
+    dnn::Net net;
+    dnn::LayerParams lp;
+    lp.set("num_output", 2);
+    lp.set("bias_term", false);
+    lp.blobs.push_back(Mat::ones(2, 6, CV_32F));
+    net.addLayerToPrev("fc", "InnerProduct", lp);
+
+    dnn::BatchingExecutor executor(net, 8, 0);
+    // Number of input features doesn't match the weights.
+    std::future<Mat> out = executor.submit(Mat::ones(1, 5, CV_32F));
+    EXPECT_ANY_THROW(out.get());
+    // The executor is still functional.
+    out = executor.submit(Mat::ones(1, 6, CV_32F));
+    normAssert(out.get(), Mat(1, 2, CV_32F, Scalar(6)));
+}
+
+TEST(BatchingExecutor, statsOfManyRequests)
+{
+    dnn::Net net;
+    dnn::LayerParams lp;
+    lp.set("num_output", 2);
+    lp.set("bias_term", false);
+    lp.blobs.push_back(Mat::ones(2, 6, CV_32F));
+    net.addLayerToPrev("fc", "InnerProduct", lp);
+
+    // More requests than the latency window keeps.
+    const int numRequests = 1500;
+    dnn::BatchingExecutor executor(net, 16, 0);
+    std::vector<std::future<Mat> > outs(numRequests);
+    for (int i = 0; i < numRequests; i++)
+        outs[i] = executor.submit(Mat::ones(1, 6, CV_32F));
+    for (int i = 0; i < numRequests; i++)
+        outs[i].get();
+
+    dnn::BatchingExecutor::Stats stats = executor.getStats();
+    EXPECT_EQ((size_t)numRequests, stats.requests);
+    EXPECT_GT(stats.meanLatency, 0.0);
+    EXPECT_LE(stats.p50Latency, stats.p90Latency);
+    EXPECT_LE(stats.p90Latency, stats.p99Latency);
+    EXPECT_LE(stats.p99Latency, stats.maxLatency);
+}
+#endif
+
 }
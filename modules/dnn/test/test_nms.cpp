@@ -38,4 +38,55 @@ TEST(NMS, Accuracy)
         ASSERT_EQ(indices[i], ref_indices[i]);
 }
 
+TEST(NMS, Batched)
+{
+    RNG& rng = theRNG();
+    const int numBoxes = 500, numClasses = 7;
+    std::vector<Rect> bboxes(numBoxes);
+    std::vector<float> scores(numBoxes);
+    std::vector<int> classIds(numBoxes);
+    for (int i = 0; i < numBoxes; ++i)
+    {
+        bboxes[i] = Rect(rng.uniform(0, 100), rng.uniform(0, 100),
+                         rng.uniform(1, 50), rng.uniform(1, 50));
+        scores[i] = rng.uniform(0.0f, 1.0f);
+        classIds[i] = rng.uniform(0, numClasses);
+    }
+
+    for (int top_k = 0; top_k < 20; top_k += 10)
+    {
+        std::vector<int> indices;
+        cv::dnn::NMSBoxesBatched(bboxes, scores, classIds, 0.1f, 0.4f, indices, 1.f, top_k);
+
+        std::vector<int> ref_indices;
+        for (int c = 0; c < numClasses; ++c)
+        {
+            std::vector<int> classMap;
+            std::vector<Rect> classBBoxes;
+            std::vector<float> classScores;
+            for (int i = 0; i < numBoxes; ++i)
+            {
+                if (classIds[i] != c)
+                    continue;
+                classMap.push_back(i);
+                classBBoxes.push_back(bboxes[i]);
+                classScores.push_back(scores[i]);
+            }
+            std::vector<int> classIndices;
+            cv::dnn::NMSBoxes(classBBoxes, classScores, 0.1f, 0.4f, classIndices, 1.f, top_k);
+            for (size_t i = 0; i < classIndices.size(); ++i)
+                ref_indices.push_back(classMap[classIndices[i]]);
+        }
+
+        ASSERT_EQ(ref_indices.size(), indices.size());
+        for (size_t i = 1; i < indices.size(); ++i)
+            ASSERT_GE(scores[indices[i - 1]], scores[indices[i]]);
+
+        std::sort(indices.begin(), indices.end());
+        std::sort(ref_indices.begin(), ref_indices.end());
+        for (size_t i = 0; i < indices.size(); i++)
+            ASSERT_EQ(indices[i], ref_indices[i]);
+    }
+}
+
 }//cvtest
@@ -195,6 +195,82 @@ TEST(Test_TensorFlow, quantized)
     runTensorFlowNet("uint8_single_conv");
 }
 
+static std::string tfConstNode(const std::string& name, const std::vector<int>& shape,
+                               const std::vector<float>& values)
+{
+    std::ostringstream ss;
+    ss << "node { name: \"" << name << "\" op: \"Const\" "
+       << "attr { key: \"dtype\" value { type: DT_FLOAT } } "
+       << "attr { key: \"value\" value { tensor { dtype: DT_FLOAT tensor_shape { ";
+    for (size_t i = 0; i < shape.size(); ++i)
+        ss << "dim { size: " << shape[i] << " } ";
+    ss << "} ";
+    for (size_t i = 0; i < values.size(); ++i)
+        ss << "float_val: " << values[i] << " ";
+    ss << "} } } }\n";
+    return ss.str();
+}
+
+// Identity, Switch/Merge, constant subgraphs and batch normalization are removed at import.
+TEST(Test_TensorFlow, graph_simplifier)
+{
+    const float kernel[] = {0.5f, -1.0f, 1.5f, 2.0f};  // HWIO
+    const float bias[] = {0.1f, -0.2f}, gamma[] = {1.5f, 0.5f}, beta[] = {0.3f, -0.1f};
+    const float mean[] = {0.2f, -0.4f}, variance[] = {4.0f, 0.25f}, eps = 1e-3f;
+    const int kernelShape[] = {1, 1, 2, 2};
+
+    std::string graph =
+        "node { name: \"input\" op: \"Placeholder\" attr { key: \"dtype\" value { type: DT_FLOAT } } }\n" +
+        tfConstNode("kernel_base", std::vector<int>(kernelShape, kernelShape + 4), std::vector<float>(kernel, kernel + 4)) +
+        tfConstNode("kernel_scale", std::vector<int>(), std::vector<float>(1, 2.0f)) +
+        "node { name: \"kernel\" op: \"Mul\" input: \"kernel_base\" input: \"kernel_scale\" }\n"
+        "node { name: \"conv\" op: \"Conv2D\" input: \"input\" input: \"kernel\" "
+        "attr { key: \"strides\" value { list { i: 1 i: 1 i: 1 i: 1 } } } "
+        "attr { key: \"padding\" value { s: \"VALID\" } } }\n"
+        "node { name: \"conv_id\" op: \"Identity\" input: \"conv\" }\n" +
+        tfConstNode("bias", std::vector<int>(1, 2), std::vector<float>(bias, bias + 2)) +
+        "node { name: \"bias_add\" op: \"BiasAdd\" input: \"conv_id\" input: \"bias\" }\n"
+        "node { name: \"is_training\" op: \"Const\" attr { key: \"value\" value { tensor { "
+        "dtype: DT_BOOL tensor_shape { } bool_val: false } } } }\n"
+        "node { name: \"switch\" op: \"Switch\" input: \"bias_add\" input: \"is_training\" }\n" +
+        tfConstNode("gamma", std::vector<int>(1, 2), std::vector<float>(gamma, gamma + 2)) +
+        tfConstNode("beta", std::vector<int>(1, 2), std::vector<float>(beta, beta + 2)) +
+        tfConstNode("mean", std::vector<int>(1, 2), std::vector<float>(mean, mean + 2)) +
+        tfConstNode("variance", std::vector<int>(1, 2), std::vector<float>(variance, variance + 2)) +
+        "node { name: \"bn\" op: \"FusedBatchNorm\" input: \"switch\" input: \"gamma\" "
+        "input: \"beta\" input: \"mean\" input: \"variance\" "
+        "attr { key: \"epsilon\" value { f: 0.001 } } attr { key: \"is_training\" value { b: false } } }\n"
+        "node { name: \"train_relu\" op: \"Relu\" input: \"switch:1\" }\n"
+        "node { name: \"merge\" op: \"Merge\" input: \"bn\" input: \"train_relu\" }\n"
+        "node { name: \"relu6\" op: \"Relu6\" input: \"merge\" }\n";
+
+    Net net = readNetFromTensorflow(0, 0, graph.c_str(), graph.size());
+    std::vector<String> layerNames = net.getLayerNames();
+    ASSERT_EQ(2u, layerNames.size());
+    EXPECT_EQ("conv", layerNames[0]);
+    EXPECT_EQ("relu6", layerNames[1]);
+
+    int sz[] = {1, 2, 3, 3};
+    Mat input(4, sz, CV_32F);
+    randu(input, -2.0f, 2.0f);
+    Mat ref(4, sz, CV_32F);
+    for (int o = 0; o < 2; ++o)
+    {
+        float scale = gamma[o] / std::sqrt(variance[o] + eps);
+        for (int i = 0; i < 9; ++i)
+        {
+            float v = bias[o];
+            for (int c = 0; c < 2; ++c)
+                v += input.ptr<float>(0, c)[i] * kernel[c * 2 + o] * 2.0f;
+            v = (v - mean[o]) * scale + beta[o];
+            ref.ptr<float>(0, o)[i] = std::min(std::max(v, 0.0f), 6.0f);
+        }
+    }
+
+    net.setInput(input);
+    normAssert(ref, net.forward(), "", 1e-5, 1e-4);
+}
+
 TEST(Test_TensorFlow, MobileNet_SSD)
 {
     std::string netPath = findDataFile("dnn/ssd_mobilenet_v1_coco.pb", false);
@@ -403,6 +403,29 @@ public:
                                         CV_OUT std::vector<std::vector<Point> >& msers,
                                         CV_OUT std::vector<Rect>& bboxes ) = 0;
 
+    /** @brief Detect %MSER regions and return the points of all of them in one array
+
+    The regions are the same and in the same order as in the method above, without the allocation
+    of a vector per region.
+
+    @param image input image (8UC1, 8UC3 or 8UC4, must be greater or equal than 3x3)
+    @param points points of all the regions, the points of i-th region are points[offsets[i]] ..
+    points[offsets[i+1]-1]
+    @param offsets resulting offsets of the regions, it has one element more than bboxes
+    @param bboxes resulting bounding boxes
+    */
+    void detectRegions( InputArray image, std::vector<Point>& points,
+                        std::vector<int>& offsets, std::vector<Rect>& bboxes );
+
+    /** @brief Detect %MSER regions and return only their bounding boxes and areas
+
+    @param image input image (8UC1, 8UC3 or 8UC4, must be greater or equal than 3x3)
+    @param bboxes resulting bounding boxes
+    @param areas resulting numbers of pixels in the regions
+    */
+    CV_WRAP void detectRegionStats( InputArray image, CV_OUT std::vector<Rect>& bboxes,
+                                    CV_OUT std::vector<int>& areas );
+
     CV_WRAP virtual void setDelta(int delta) = 0;
     CV_WRAP virtual int getDelta() const = 0;
 
@@ -462,6 +485,16 @@ public:
                                                     bool nonmaxSuppression=true,
                                                     int type=FastFeatureDetector::TYPE_9_16 );
 
+    /** @brief Creates the detector in the grid mode which distributes the keypoints over the image.
+
+    The image is split into gridSize.width x gridSize.height cells which are detected in parallel, at most
+    maxPerCell keypoints with the highest response are kept in every cell. The cells which give fewer
+    keypoints are detected again with minThreshold. The keypoints are returned cell by cell, strongest first.
+    An empty gridSize detects the whole image at once.
+    */
+    CV_WRAP static Ptr<FastFeatureDetector> create( int threshold, bool nonmaxSuppression, int type,
+                                                    Size gridSize, int maxPerCell, int minThreshold );
+
     CV_WRAP virtual void setThreshold(int threshold) = 0;
     CV_WRAP virtual int getThreshold() const = 0;
 
@@ -470,6 +503,7 @@ public:
 
     CV_WRAP virtual void setType(int type) = 0;
     CV_WRAP virtual int getType() const = 0;
+
     CV_WRAP virtual String getDefaultName() const;
 };
 
@@ -517,6 +551,14 @@ public:
                                                      bool nonmaxSuppression=true,
                                                      int type=AgastFeatureDetector::OAST_9_16 );
 
+    /** @brief Creates the detector in the grid mode, as FastFeatureDetector::create.
+
+    The non-maximum suppression keeps one corner of every connected group of corners, the groups which cross
+    the cell borders are suppressed in every cell separately.
+    */
+    CV_WRAP static Ptr<AgastFeatureDetector> create( int threshold, bool nonmaxSuppression, int type,
+                                                     Size gridSize, int maxPerCell, int minThreshold );
+
     CV_WRAP virtual void setThreshold(int threshold) = 0;
     CV_WRAP virtual int getThreshold() const = 0;
 
@@ -525,6 +567,7 @@ public:
 
     CV_WRAP virtual void setType(int type) = 0;
     CV_WRAP virtual int getType() const = 0;
+
     CV_WRAP virtual String getDefaultName() const;
 };
 
@@ -1035,6 +1078,9 @@ protected:
 
         // Vector of matrices "descriptors" will be merged to one matrix "mergedDescriptors" here.
         void set( const std::vector<Mat>& descriptors );
+        // Merges the descriptors of the images which were added to "descriptors" after the last set() or
+        // append() call. The matrix grows geometrically so its data usually stays in place.
+        void append( const std::vector<Mat>& descriptors );
         virtual void clear();
 
         const Mat& getDescriptors() const;
@@ -1101,6 +1147,34 @@ public:
      */
     CV_WRAP static Ptr<BFMatcher> create( int normType=NORM_L2, bool crossCheck=false ) ;
 
+    /** @brief Finds the best match for each descriptor from a query set which passes the ratio test.
+
+    Two nearest neighbours of every query descriptor are found in a single pass over the train
+    collection, and the best match is kept only if its distance is less than ratio times the distance
+    to the second one (D. Lowe's test). The result is the same as knnMatch with k=2 followed by the
+    test, but the intermediate matches are not built. Query descriptors with less than two candidates
+    are dropped. crossCheck is not applied.
+    @param queryDescriptors Query set of descriptors.
+    @param matches Matches which passed the test.
+    @param ratio Maximum ratio of the best and the second best distances.
+    @param masks Set of masks. Each masks[i] specifies permissible matches between the input query
+    descriptors and stored train descriptors from the i-th image trainDescCollection[i].
+     */
+    CV_WRAP void ratioMatch( InputArray queryDescriptors, CV_OUT std::vector<DMatch>& matches,
+                             float ratio=0.8f, InputArrayOfArrays masks=noArray() );
+
+    /** @overload
+    @param queryDescriptors Query set of descriptors.
+    @param trainDescriptors Train set of descriptors. This set is not added to the train descriptors
+    collection stored in the class object.
+    @param matches Matches which passed the test.
+    @param ratio Maximum ratio of the best and the second best distances.
+    @param mask Mask specifying permissible matches between an input query and train matrices of
+    descriptors.
+     */
+    CV_WRAP void ratioMatch( InputArray queryDescriptors, InputArray trainDescriptors,
+                             CV_OUT std::vector<DMatch>& matches, float ratio=0.8f, InputArray mask=noArray() ) const;
+
     virtual Ptr<DescriptorMatcher> clone( bool emptyTrainData=false ) const;
 protected:
     virtual void knnMatchImpl( InputArray queryDescriptors, std::vector<std::vector<DMatch> >& matches, int k,
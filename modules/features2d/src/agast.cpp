@@ -44,6 +44,7 @@ The references are:
 
 #include "precomp.hpp"
 #include "agast_score.hpp"
+#include "fast.hpp"
 
 namespace cv
 {
@@ -7941,12 +7942,23 @@ void AGAST(InputArray _img, std::vector<KeyPoint>& keypoints, int threshold, boo
     AGAST(_img, keypoints, threshold, nonmax_suppression, AgastFeatureDetector::OAST_9_16);
 }
 
+// AGAST detects the whole area before the scoring, the grid keeps the strongest keypoints afterwards
+static void AGAST_cell(const Mat& img, std::vector<KeyPoint>& keypoints, int threshold, bool nonmax_suppression,
+                       int type, int /*maxKeypoints*/, const Rect& /*keepArea*/)
+{
+    AGAST(img, keypoints, threshold, nonmax_suppression, type);
+}
+
 class AgastFeatureDetector_Impl : public AgastFeatureDetector
 {
 public:
-    AgastFeatureDetector_Impl( int _threshold, bool _nonmaxSuppression, int _type )
-    : threshold(_threshold), nonmaxSuppression(_nonmaxSuppression), type((short)_type)
-    {}
+    AgastFeatureDetector_Impl( int _threshold, bool _nonmaxSuppression, int _type,
+                               Size _gridSize=Size(), int _maxPerCell=0, int _minThreshold=0 )
+    : threshold(_threshold), nonmaxSuppression(_nonmaxSuppression), type((short)_type),
+      gridSize(_gridSize), maxPerCell(_maxPerCell), minThreshold(_minThreshold)
+    {
+        CV_Assert( gridSize.area() == 0 || maxPerCell > 0 );
+    }
 
     void detect( InputArray _image, std::vector<KeyPoint>& keypoints, InputArray _mask )
     {
@@ -7961,6 +7973,12 @@ public:
             cvtColor( _image, ogray, COLOR_BGR2GRAY );
             gray = ogray;
         }
+        if( gridSize.area() > 0 )
+        {
+            detectInGrid( gray.getMat(), mask, keypoints, gridSize, maxPerCell, threshold,
+                          std::min(minThreshold, threshold), nonmaxSuppression, type, AGAST_cell );
+            return;
+        }
         keypoints.clear();
         AGAST( gray, keypoints, threshold, nonmaxSuppression, type );
         KeyPointsFilter::runByPixelsMask( keypoints, mask );
@@ -7998,6 +8016,9 @@ public:
     int threshold;
     bool nonmaxSuppression;
     int type;
+    Size gridSize;
+    int maxPerCell;
+    int minThreshold;
 };
 
 Ptr<AgastFeatureDetector> AgastFeatureDetector::create( int threshold, bool nonmaxSuppression, int type )
@@ -8005,6 +8026,12 @@ Ptr<AgastFeatureDetector> AgastFeatureDetector::create( int threshold, bool nonm
     return makePtr<AgastFeatureDetector_Impl>(threshold, nonmaxSuppression, type);
 }
 
+Ptr<AgastFeatureDetector> AgastFeatureDetector::create( int threshold, bool nonmaxSuppression, int type,
+                                                        Size gridSize, int maxPerCell, int minThreshold )
+{
+    return makePtr<AgastFeatureDetector_Impl>(threshold, nonmaxSuppression, type, gridSize, maxPerCell, minThreshold);
+}
+
 void AGAST(InputArray _img, std::vector<KeyPoint>& keypoints, int threshold, bool nonmax_suppression, int type)
 {
     CV_INSTRUMENT_REGION()
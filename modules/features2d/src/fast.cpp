@@ -52,13 +52,26 @@ The references are:
 namespace cv
 {
 
+namespace
+{
+struct KeypointResponseGreater
+{
+    bool operator()(const KeyPoint& a, const KeyPoint& b) const { return a.response > b.response; }
+};
+}
+
+// maxKeypoints > 0 keeps only that many keypoints with the highest response in a heap, so the scores
+// are computed without the non-maximum suppression too. A non-empty keepArea drops the keypoints outside of it.
 template<int patternSize>
-void FAST_t(InputArray _img, std::vector<KeyPoint>& keypoints, int threshold, bool nonmax_suppression)
+void FAST_t(InputArray _img, std::vector<KeyPoint>& keypoints, int threshold, bool nonmax_suppression,
+            int maxKeypoints = 0, const Rect& keepArea = Rect())
 {
     Mat img = _img.getMat();
     const int K = patternSize/2, N = patternSize + K + 1;
     int i, j, k, pixel[25];
     makeOffsets(pixel, (int)img.step, patternSize);
+    const bool computeScore = nonmax_suppression || maxKeypoints > 0;
+    const Rect area = keepArea.area() > 0 ? keepArea : Rect(0, 0, img.cols, img.rows);
 
 #if CV_SIMD128
     const int quarterPatternSize = patternSize/4;
@@ -67,7 +80,7 @@ void FAST_t(InputArray _img, std::vector<KeyPoint>& keypoints, int threshold, bo
 #if CV_TRY_AVX2
     Ptr<opt_AVX2::FAST_t_patternSize16_AVX2> fast_t_impl_avx2;
     if(CV_CPU_HAS_SUPPORT_AVX2)
-        fast_t_impl_avx2 = opt_AVX2::FAST_t_patternSize16_AVX2::getImpl(img.cols, threshold, nonmax_suppression, pixel);
+        fast_t_impl_avx2 = opt_AVX2::FAST_t_patternSize16_AVX2::getImpl(img.cols, threshold, computeScore, pixel);
 #endif
 
 #endif
@@ -168,7 +181,7 @@ void FAST_t(InputArray _img, std::vector<KeyPoint>& keypoints, int threshold, bo
                                 if(m & 1)
                                 {
                                     cornerpos[ncorners++] = j+k;
-                                    if(nonmax_suppression)
+                                    if(computeScore)
                                         curr[j+k] = (uchar)cornerScore<patternSize>(ptr+k, pixel, threshold);
                                 }
                             }
@@ -210,7 +223,7 @@ void FAST_t(InputArray _img, std::vector<KeyPoint>& keypoints, int threshold, bo
                             if( ++count > K )
                             {
                                 cornerpos[ncorners++] = j;
-                                if(nonmax_suppression)
+                                if(computeScore)
                                     curr[j] = (uchar)cornerScore<patternSize>(ptr, pixel, threshold);
                                 break;
                             }
@@ -232,7 +245,7 @@ void FAST_t(InputArray _img, std::vector<KeyPoint>& keypoints, int threshold, bo
                             if( ++count > K )
                             {
                                 cornerpos[ncorners++] = j;
-                                if(nonmax_suppression)
+                                if(computeScore)
                                     curr[j] = (uchar)cornerScore<patternSize>(ptr, pixel, threshold);
                                 break;
                             }
@@ -254,16 +267,33 @@ void FAST_t(InputArray _img, std::vector<KeyPoint>& keypoints, int threshold, bo
         cornerpos = cpbuf[(i - 4 + 3)%3];
         ncorners = cornerpos[-1];
 
+        if( i - 1 < area.y || i - 1 >= area.y + area.height )
+            continue;
+
         for( k = 0; k < ncorners; k++ )
         {
             j = cornerpos[k];
             int score = prev[j];
-            if( !nonmax_suppression ||
-               (score > prev[j+1] && score > prev[j-1] &&
-                score > pprev[j-1] && score > pprev[j] && score > pprev[j+1] &&
-                score > curr[j-1] && score > curr[j] && score > curr[j+1]) )
+            if( (!nonmax_suppression ||
+                (score > prev[j+1] && score > prev[j-1] &&
+                 score > pprev[j-1] && score > pprev[j] && score > pprev[j+1] &&
+                 score > curr[j-1] && score > curr[j] && score > curr[j+1])) &&
+                j >= area.x && j < area.x + area.width )
             {
-                keypoints.push_back(KeyPoint((float)j, (float)(i-1), 7.f, -1, (float)score));
+                KeyPoint kpt((float)j, (float)(i-1), 7.f, -1, (float)score);
+                if( maxKeypoints <= 0 )
+                    keypoints.push_back(kpt);
+                else if( (int)keypoints.size() < maxKeypoints )
+                {
+                    keypoints.push_back(kpt);
+                    std::push_heap(keypoints.begin(), keypoints.end(), KeypointResponseGreater());
+                }
+                else if( kpt.response > keypoints.front().response )
+                {
+                    std::pop_heap(keypoints.begin(), keypoints.end(), KeypointResponseGreater());
+                    keypoints.back() = kpt;
+                    std::push_heap(keypoints.begin(), keypoints.end(), KeypointResponseGreater());
+                }
             }
         }
     }
@@ -450,14 +480,131 @@ void FAST(InputArray _img, std::vector<KeyPoint>& keypoints, int threshold, bool
     FAST(_img, keypoints, threshold, nonmax_suppression, FastFeatureDetector::TYPE_9_16);
 }
 
+static void FAST_cell(const Mat& img, std::vector<KeyPoint>& keypoints, int threshold, bool nonmax_suppression,
+                      int type, int maxKeypoints, const Rect& keepArea)
+{
+    switch(type) {
+    case FastFeatureDetector::TYPE_5_8:
+        FAST_t<8>(img, keypoints, threshold, nonmax_suppression, maxKeypoints, keepArea);
+        break;
+    case FastFeatureDetector::TYPE_7_12:
+        FAST_t<12>(img, keypoints, threshold, nonmax_suppression, maxKeypoints, keepArea);
+        break;
+    case FastFeatureDetector::TYPE_9_16:
+        FAST_t<16>(img, keypoints, threshold, nonmax_suppression, maxKeypoints, keepArea);
+        break;
+    }
+}
+
+namespace
+{
+// Strongest first, the position breaks the ties so the order doesn't depend on the detector
+struct KeypointCellOrder
+{
+    bool operator()(const KeyPoint& a, const KeyPoint& b) const
+    {
+        if( a.response != b.response )
+            return a.response > b.response;
+        return a.pt.y < b.pt.y || (a.pt.y == b.pt.y && a.pt.x < b.pt.x);
+    }
+};
 
-class FastFeatureDetector_Impl : public FastFeatureDetector
+class GridDetectInvoker : public ParallelLoopBody
 {
 public:
-    FastFeatureDetector_Impl( int _threshold, bool _nonmaxSuppression, int _type )
-    : threshold(_threshold), nonmaxSuppression(_nonmaxSuppression), type((short)_type)
+    GridDetectInvoker(const Mat& _img, const Mat& _mask, Size _gridSize, int _maxPerCell, int _threshold,
+                      int _minThreshold, bool _nonmaxSuppression, int _type, GridCellDetector _detector,
+                      std::vector<std::vector<KeyPoint> >& _cells)
+        : img(_img), mask(_mask), gridSize(_gridSize), maxPerCell(_maxPerCell), threshold(_threshold),
+          minThreshold(_minThreshold), nonmaxSuppression(_nonmaxSuppression), type(_type), detector(_detector),
+          cells(&_cells)
     {}
 
+    void operator()(const Range& range) const
+    {
+        // the circles have the radius of 3 pixels and the non-maximum suppression compares the neighbors
+        const int margin = 4;
+        for( int c = range.start; c < range.end; c++ )
+        {
+            int gx = c % gridSize.width, gy = c / gridSize.width;
+            int x0 = gx*img.cols/gridSize.width, x1 = (gx + 1)*img.cols/gridSize.width;
+            int y0 = gy*img.rows/gridSize.height, y1 = (gy + 1)*img.rows/gridSize.height;
+            Rect cell(x0, y0, x1 - x0, y1 - y0);
+            Rect roi = Rect(x0 - margin, y0 - margin, cell.width + 2*margin, cell.height + 2*margin) &
+                       Rect(0, 0, img.cols, img.rows);
+
+            std::vector<KeyPoint>& keypoints = (*cells)[c];
+            detectCell(roi, cell, threshold, keypoints);
+            // weak cells get the lower threshold to keep the keypoints distributed
+            if( (int)keypoints.size() < maxPerCell && minThreshold < threshold )
+                detectCell(roi, cell, minThreshold, keypoints);
+            std::sort(keypoints.begin(), keypoints.end(), KeypointCellOrder());
+            if( (int)keypoints.size() > maxPerCell )
+                keypoints.resize(maxPerCell);
+        }
+    }
+
+private:
+    void detectCell(const Rect& roi, const Rect& cell, int cellThreshold, std::vector<KeyPoint>& keypoints) const
+    {
+        keypoints.clear();
+        // the masked keypoints are dropped before the selection
+        detector(img(roi), keypoints, cellThreshold, nonmaxSuppression, type, mask.empty() ? maxPerCell : 0,
+                 cell - roi.tl());
+        const Point2f offset((float)roi.x, (float)roi.y);
+        size_t n = 0;
+        for( size_t i = 0; i < keypoints.size(); i++ )
+        {
+            KeyPoint kpt = keypoints[i];
+            kpt.pt += offset;
+            Point pt((int)kpt.pt.x, (int)kpt.pt.y);
+            if( !cell.contains(pt) || (!mask.empty() && mask.at<uchar>(pt) == 0) )
+                continue;
+            keypoints[n++] = kpt;
+        }
+        keypoints.resize(n);
+    }
+
+    Mat img, mask;
+    Size gridSize;
+    int maxPerCell, threshold, minThreshold;
+    bool nonmaxSuppression;
+    int type;
+    GridCellDetector detector;
+    std::vector<std::vector<KeyPoint> >* cells;
+};
+}
+
+void detectInGrid(const Mat& img, const Mat& mask, std::vector<KeyPoint>& keypoints, Size gridSize,
+                  int maxPerCell, int threshold, int minThreshold, bool nonmaxSuppression, int type,
+                  GridCellDetector detector)
+{
+    CV_INSTRUMENT_REGION()
+
+    CV_Assert( img.type() == CV_8UC1 && gridSize.width > 0 && gridSize.height > 0 && maxPerCell > 0 );
+    CV_Assert( mask.empty() || (mask.type() == CV_8UC1 && mask.size() == img.size()) );
+
+    std::vector<std::vector<KeyPoint> > cells(gridSize.area());
+    parallel_for_(Range(0, (int)cells.size()), GridDetectInvoker(img, mask, gridSize, maxPerCell, threshold,
+                  minThreshold, nonmaxSuppression, type, detector, cells));
+
+    keypoints.clear();
+    for( size_t c = 0; c < cells.size(); c++ )
+        keypoints.insert(keypoints.end(), cells[c].begin(), cells[c].end());
+}
+
+
+class FastFeatureDetector_Impl : public FastFeatureDetector
+{
+public:
+    FastFeatureDetector_Impl( int _threshold, bool _nonmaxSuppression, int _type,
+                              Size _gridSize=Size(), int _maxPerCell=0, int _minThreshold=0 )
+    : threshold(_threshold), nonmaxSuppression(_nonmaxSuppression), type((short)_type),
+      gridSize(_gridSize), maxPerCell(_maxPerCell), minThreshold(_minThreshold)
+    {
+        CV_Assert( gridSize.area() == 0 || maxPerCell > 0 );
+    }
+
     void detect( InputArray _image, std::vector<KeyPoint>& keypoints, InputArray _mask )
     {
         CV_INSTRUMENT_REGION()
@@ -471,6 +618,12 @@ public:
             cvtColor( _image, ogray, COLOR_BGR2GRAY );
             gray = ogray;
         }
+        if( gridSize.area() > 0 )
+        {
+            detectInGrid( gray.getMat(), mask, keypoints, gridSize, maxPerCell, threshold,
+                          std::min(minThreshold, threshold), nonmaxSuppression, type, FAST_cell );
+            return;
+        }
         FAST( gray, keypoints, threshold, nonmaxSuppression, type );
         KeyPointsFilter::runByPixelsMask( keypoints, mask );
     }
@@ -511,6 +664,9 @@ public:
     int threshold;
     bool nonmaxSuppression;
     int type;
+    Size gridSize;
+    int maxPerCell;
+    int minThreshold;
 };
 
 Ptr<FastFeatureDetector> FastFeatureDetector::create( int threshold, bool nonmaxSuppression, int type )
@@ -518,6 +674,12 @@ Ptr<FastFeatureDetector> FastFeatureDetector::create( int threshold, bool nonmax
     return makePtr<FastFeatureDetector_Impl>(threshold, nonmaxSuppression, type);
 }
 
+Ptr<FastFeatureDetector> FastFeatureDetector::create( int threshold, bool nonmaxSuppression, int type,
+                                                      Size gridSize, int maxPerCell, int minThreshold )
+{
+    return makePtr<FastFeatureDetector_Impl>(threshold, nonmaxSuppression, type, gridSize, maxPerCell, minThreshold);
+}
+
 String FastFeatureDetector::getDefaultName() const
 {
     return (Feature2D::getDefaultName() + ".FastFeatureDetector");
@@ -46,6 +46,18 @@ The references are:
 
 namespace cv
 {
+
+/* Detects the corners in an image area for detectInGrid(). maxKeypoints > 0 limits the output to the keypoints
+   with the highest response, the keypoints outside of keepArea are dropped. */
+typedef void (*GridCellDetector)(const Mat& img, std::vector<KeyPoint>& keypoints, int threshold,
+                                 bool nonmaxSuppression, int type, int maxKeypoints, const Rect& keepArea);
+
+/* Splits the image into gridSize cells detected in parallel and keeps at most maxPerCell strongest keypoints
+   per cell. The cells with fewer keypoints are detected again with minThreshold. */
+void detectInGrid(const Mat& img, const Mat& mask, std::vector<KeyPoint>& keypoints, Size gridSize,
+                  int maxPerCell, int threshold, int minThreshold, bool nonmaxSuppression, int type,
+                  GridCellDetector detector);
+
 namespace opt_AVX2
 {
 #if CV_TRY_AVX2
@@ -12,6 +12,7 @@
 #include "nldiffusion_functions.h"
 #include "utils.h"
 #include "opencl_kernels_features2d.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 #include <iostream>
 
@@ -290,6 +291,169 @@ non_linear_diffusion_step(InputArray Lt_, InputArray Lf_, OutputArray Lstep_, fl
   parallel_for_(Range(0, Lt.rows), NonLinearScalarDiffusionStep(Lt, Lf, Lstep, step_size));
 }
 
+/**
+ * @brief Computes one explicit diffusion step for a row: dst = Lt + step_size * div(Lf * grad(Lt))
+ * @details The arithmetic is the same as in nld_step_scalar_one_lane followed by the addition
+ * of Lstep, so the fused passes give the same evolution. The missing neighbours of the first and
+ * the last row are passed as NULL, the corners of these rows are not changed.
+ */
+static inline void
+fed_step_row(const float* lt_a, const float* lt_c, const float* lt_b,
+             const float* lf_a, const float* lf_c, const float* lf_b,
+             float* dst, int width, float step_size)
+{
+  const int cols = width - 1;
+
+  if (!lt_a || !lt_b) {
+    // the top or the bottom row: only one vertical neighbour
+    const float* lt_n = lt_a ? lt_a : lt_b;
+    const float* lf_n = lf_a ? lf_a : lf_b;
+    dst[0] = lt_c[0];
+    for (int j = 1; j < cols; j++) {
+      float step_r = (lf_c[j] + lf_c[j + 1])*(lt_c[j + 1] - lt_c[j]) +
+                     (lf_c[j] + lf_c[j - 1])*(lt_c[j - 1] - lt_c[j]) +
+                     (lf_c[j] + lf_n[j    ])*(lt_n[j    ] - lt_c[j]);
+      dst[j] = lt_c[j] + step_r * step_size;
+    }
+    dst[cols] = lt_c[cols];
+    return;
+  }
+
+  // The left-most column
+  float step_r = (lf_c[0] + lf_c[1])*(lt_c[1] - lt_c[0]) +
+                 (lf_c[0] + lf_b[0])*(lt_b[0] - lt_c[0]) +
+                 (lf_c[0] + lf_a[0])*(lt_a[0] - lt_c[0]);
+  dst[0] = lt_c[0] + step_r * step_size;
+
+  // The middle columns
+  int j = 1;
+#if CV_SIMD128
+  if (hasSIMD128()) {
+    v_float32x4 v_step = v_setall_f32(step_size);
+    for (; j <= cols - 4; j += 4) {
+      v_float32x4 c = v_load(lt_c + j), f = v_load(lf_c + j);
+      v_float32x4 r = (f + v_load(lf_c + j + 1))*(v_load(lt_c + j + 1) - c) +
+                      (f + v_load(lf_c + j - 1))*(v_load(lt_c + j - 1) - c) +
+                      (f + v_load(lf_b + j    ))*(v_load(lt_b + j    ) - c) +
+                      (f + v_load(lf_a + j    ))*(v_load(lt_a + j    ) - c);
+      v_store(dst + j, c + r * v_step);
+    }
+  }
+#endif
+  for (; j < cols; j++) {
+    step_r = (lf_c[j] + lf_c[j + 1])*(lt_c[j + 1] - lt_c[j]) +
+             (lf_c[j] + lf_c[j - 1])*(lt_c[j - 1] - lt_c[j]) +
+             (lf_c[j] + lf_b[j    ])*(lt_b[j    ] - lt_c[j]) +
+             (lf_c[j] + lf_a[j    ])*(lt_a[j    ] - lt_c[j]);
+    dst[j] = lt_c[j] + step_r * step_size;
+  }
+
+  // The right-most column
+  step_r = (lf_c[cols] + lf_c[cols - 1])*(lt_c[cols - 1] - lt_c[cols]) +
+           (lf_c[cols] + lf_b[cols    ])*(lt_b[cols    ] - lt_c[cols]) +
+           (lf_c[cols] + lf_a[cols    ])*(lt_a[cols    ] - lt_c[cols]);
+  dst[cols] = lt_c[cols] + step_r * step_size;
+}
+
+/**
+ * @brief Runs several consecutive FED steps over bands of rows
+ * @details Every band is evolved in a thread local buffer together with a halo which shrinks by one row
+ * per step, so the steps are done while the band is in cache and the image is read and written once.
+ */
+class FEDStepsInvoker : public ParallelLoopBody
+{
+public:
+  FEDStepsInvoker(const Mat& src, const Mat& Lf, Mat& dst, const float* step_sizes, int nsteps, int band_rows)
+    : src_(&src), Lf_(&Lf), dst_(&dst), step_sizes_(step_sizes), nsteps_(nsteps), band_rows_(band_rows)
+  {}
+
+  void operator()(const Range& range) const
+  {
+    const Mat& src = *src_;
+    const Mat& Lf = *Lf_;
+    Mat& dst = *dst_;
+    const int rows = src.rows, cols = src.cols;
+    AutoBuffer<float> _buf((size_t)2 * (band_rows_ + 2 * nsteps_) * cols);
+
+    for (int band = range.start; band < range.end; band++) {
+      const int r0 = band * band_rows_, r1 = std::min(r0 + band_rows_, rows);
+      const int lo = std::max(r0 - nsteps_, 0), hi = std::min(r1 + nsteps_, rows);
+      float* bufs[] = { _buf, _buf + (size_t)(band_rows_ + 2 * nsteps_) * cols };
+      const float* prev = NULL;  // NULL means the rows of src
+
+      for (int s = 0; s < nsteps_; s++) {
+        const bool last = s == nsteps_ - 1;
+        // the rows which don't depend on the rows outside of the halo
+        const int begin = last ? r0 : (lo == 0 ? 0 : lo + s + 1);
+        const int end = last ? r1 : (hi == rows ? rows : hi - s - 1);
+        float* next = bufs[s & 1];
+
+        for (int i = begin; i < end; i++) {
+          const float* lt_a = i > 0 ? (prev ? prev + (size_t)(i - 1 - lo) * cols : src.ptr<float>(i - 1)) : NULL;
+          const float* lt_c = prev ? prev + (size_t)(i - lo) * cols : src.ptr<float>(i);
+          const float* lt_b = i < rows - 1 ? (prev ? prev + (size_t)(i + 1 - lo) * cols : src.ptr<float>(i + 1)) : NULL;
+          float* out = last ? dst.ptr<float>(i) : next + (size_t)(i - lo) * cols;
+          fed_step_row(lt_a, lt_c, lt_b, i > 0 ? Lf.ptr<float>(i - 1) : NULL, Lf.ptr<float>(i),
+                       i < rows - 1 ? Lf.ptr<float>(i + 1) : NULL, out, cols, step_sizes_[s]);
+        }
+        prev = next;
+      }
+    }
+  }
+
+private:
+  const Mat* src_;
+  const Mat* Lf_;
+  Mat* dst_;
+  const float* step_sizes_;
+  int nsteps_;
+  int band_rows_;
+};
+
+/**
+ * @brief Performs a cycle of Fast Explicit Diffusion on Lt
+ * @param Lt Evolution image, replaced by the result
+ * @param Lf Conductivity image
+ * @param Lbuf Temporary image
+ * @param tsteps FED time steps of the cycle
+ */
+static inline void
+fed_cycle(Mat& Lt, const Mat& Lf, Mat& Lbuf, const std::vector<float>& tsteps)
+{
+  CV_INSTRUMENT_REGION()
+
+  // the fused steps recompute the halo rows, more of them don't pay off
+  const int max_fused = 4;
+
+  if (Lt.rows < 2 || Lt.cols < 2) {
+    return;
+  }
+
+  std::vector<float> step_sizes(tsteps.size());
+  for (size_t j = 0; j < tsteps.size(); j++)
+    step_sizes[j] = tsteps[j] * 0.5f;
+
+  // about 64K floats per band
+  const int band_rows = std::max(std::min((1 << 16) / Lt.cols, 128), 16);
+  const int nbands = (Lt.rows + band_rows - 1) / band_rows;
+  Lbuf.create(Lt.size(), Lt.type());
+  for (size_t j = 0; j < step_sizes.size(); j += max_fused) {
+    const int nsteps = (int)std::min(step_sizes.size() - j, (size_t)max_fused);
+    parallel_for_(Range(0, nbands), FEDStepsInvoker(Lt, Lf, Lbuf, &step_sizes[j], nsteps, band_rows));
+    std::swap(Lt, Lbuf);
+  }
+}
+
+static inline void
+fed_cycle(UMat& Lt, const UMat& Lf, UMat& Lstep, const std::vector<float>& tsteps)
+{
+  for (size_t j = 0; j < tsteps.size(); j++) {
+    const float step_size = tsteps[j] * 0.5f;
+    non_linear_diffusion_step(Lt, Lf, Lstep, step_size);
+    add(Lt, Lstep, Lt);
+  }
+}
+
 /**
  * @brief This function computes a good empirical value for the k contrast factor
  * given two gradient images, the percentile (0-1), the temporal storage to hold
@@ -403,6 +567,112 @@ compute_diffusivity(InputArray Lx, InputArray Ly, OutputArray Lflow, float kcont
   }
 }
 
+/**
+ * @brief Computes the Perona and Malik g2 conductivity from the Scharr derivatives of a row band
+ * @details The derivatives are not stored, the vertical part of the Scharr kernels is applied
+ * to a row first and the horizontal part to the buffered row.
+ */
+class ScharrPMG2Invoker : public ParallelLoopBody
+{
+public:
+  ScharrPMG2Invoker(const Mat& Lsmooth, Mat& Lflow, float kcontrast)
+    : Lsmooth_(&Lsmooth), Lflow_(&Lflow), k2inv_(1.0f / (kcontrast * kcontrast))
+  {}
+
+  void operator()(const Range& range) const
+  {
+    const Mat& src = *Lsmooth_;
+    Mat& dst = *Lflow_;
+    const int rows = src.rows, cols = src.cols;
+    // the rows are extended by one reflected pixel on each side (BORDER_REFLECT_101)
+    AutoBuffer<float> _buf((size_t)2 * (cols + 2));
+    float* smooth = _buf;
+    float* diff = smooth + cols + 2;
+
+    for (int i = range.start; i < range.end; i++) {
+      const float* a = src.ptr<float>(i > 0 ? i - 1 : 1);
+      const float* c = src.ptr<float>(i);
+      const float* b = src.ptr<float>(i < rows - 1 ? i + 1 : rows - 2);
+      float* g = dst.ptr<float>(i);
+
+      int j = 0;
+#if CV_SIMD128
+      const bool useSIMD = hasSIMD128();
+      v_float32x4 v_3 = v_setall_f32(3.0f), v_10 = v_setall_f32(10.0f);
+      if (useSIMD) {
+        for (; j <= cols - 4; j += 4) {
+          v_float32x4 va = v_load(a + j), vb = v_load(b + j);
+          v_store(smooth + j + 1, (va + vb) * v_3 + v_load(c + j) * v_10);
+          v_store(diff + j + 1, vb - va);
+        }
+      }
+#endif
+      for (; j < cols; j++) {
+        smooth[j + 1] = (a[j] + b[j]) * 3.0f + c[j] * 10.0f;
+        diff[j + 1] = b[j] - a[j];
+      }
+      smooth[0] = smooth[2]; smooth[cols + 1] = smooth[cols - 1];
+      diff[0] = diff[2]; diff[cols + 1] = diff[cols - 1];
+
+      j = 0;
+#if CV_SIMD128
+      if (useSIMD) {
+        v_float32x4 v_one = v_setall_f32(1.0f), v_k2inv = v_setall_f32(k2inv_);
+        for (; j <= cols - 4; j += 4) {
+          v_float32x4 lx = v_load(smooth + j + 2) - v_load(smooth + j);
+          v_float32x4 ly = (v_load(diff + j) + v_load(diff + j + 2)) * v_3 + v_load(diff + j + 1) * v_10;
+          v_store(g + j, v_one / (v_one + (lx * lx + ly * ly) * v_k2inv));
+        }
+      }
+#endif
+      for (; j < cols; j++) {
+        float lx = smooth[j + 2] - smooth[j];
+        float ly = (diff[j] + diff[j + 2]) * 3.0f + diff[j + 1] * 10.0f;
+        g[j] = 1.0f / (1.0f + (lx * lx + ly * ly) * k2inv_);
+      }
+    }
+  }
+
+private:
+  const Mat* Lsmooth_;
+  Mat* Lflow_;
+  float k2inv_;
+};
+
+/**
+ * @brief Computes the conductivity image from the smoothed evolution image
+ * @param Lsmooth Smoothed image
+ * @param Lflow Output conductivity image
+ * @param kcontrast Contrast factor parameter
+ * @param diffusivity Diffusivity type
+ */
+static inline void
+compute_flow(const Mat& Lsmooth, Mat& Lflow, float kcontrast, int diffusivity)
+{
+  CV_INSTRUMENT_REGION()
+
+  if (diffusivity == KAZE::DIFF_PM_G2 && Lsmooth.rows > 1 && Lsmooth.cols > 1) {
+    Lflow.create(Lsmooth.size(), CV_32F);
+    parallel_for_(Range(0, Lsmooth.rows), ScharrPMG2Invoker(Lsmooth, Lflow, kcontrast),
+                  Lsmooth.total() / (double)(1 << 16));
+    return;
+  }
+
+  Mat Lx, Ly;
+  Scharr(Lsmooth, Lx, CV_32F, 1, 0, 1.0, 0, BORDER_DEFAULT);
+  Scharr(Lsmooth, Ly, CV_32F, 0, 1, 1.0, 0, BORDER_DEFAULT);
+  compute_diffusivity(Lx, Ly, Lflow, kcontrast, diffusivity);
+}
+
+static inline void
+compute_flow(const UMat& Lsmooth, UMat& Lflow, float kcontrast, int diffusivity)
+{
+  UMat Lx, Ly;
+  Scharr(Lsmooth, Lx, CV_32F, 1, 0, 1.0, 0, BORDER_DEFAULT);
+  Scharr(Lsmooth, Ly, CV_32F, 0, 1, 1.0, 0, BORDER_DEFAULT);
+  compute_diffusivity(Lx, Ly, Lflow, kcontrast, diffusivity);
+}
+
 /**
  * @brief Converts input image to grayscale float image
  *
@@ -460,6 +730,8 @@ create_nonlinear_scale_space(InputArray image, const AKAZEOptions &options,
   Lsmooth.release();
   // compute the kcontrast factor
   float kcontrast = compute_kcontrast(Lx, Ly, options.kcontrast_percentile, options.kcontrast_nbins);
+  Lx.release();
+  Ly.release();
 
   // Now generate the rest of evolution levels
   for (size_t i = 1; i < evolution.size(); i++) {
@@ -476,20 +748,11 @@ create_nonlinear_scale_space(InputArray image, const AKAZEOptions &options,
 
     GaussianBlur(e.Lt, e.Lsmooth, Size(5, 5), 1.0f, 1.0f, BORDER_REPLICATE);
 
-    // Compute the Gaussian derivatives Lx and Ly
-    Scharr(e.Lsmooth, Lx, CV_32F, 1, 0, 1.0, 0, BORDER_DEFAULT);
-    Scharr(e.Lsmooth, Ly, CV_32F, 0, 1, 1.0, 0, BORDER_DEFAULT);
-
-    // Compute the conductivity equation
-    compute_diffusivity(Lx, Ly, Lflow, kcontrast, options.diffusivity);
+    // Compute the conductivity equation from the Gaussian derivatives Lx and Ly
+    compute_flow(e.Lsmooth, Lflow, kcontrast, options.diffusivity);
 
     // Perform Fast Explicit Diffusion on Lt
-    const std::vector<float> &tsteps = tsteps_evolution[i - 1];
-    for (size_t j = 0; j < tsteps.size(); j++) {
-      const float step_size = tsteps[j] * 0.5f;
-      non_linear_diffusion_step(e.Lt, Lflow, Lstep, step_size);
-      add(e.Lt, Lstep, e.Lt);
-    }
+    fed_cycle(e.Lt, Lflow, Lstep, tsteps_evolution[i - 1]);
   }
 
   Compute_Determinant_Hessian_Response(evolution);
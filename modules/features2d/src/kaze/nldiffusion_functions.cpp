@@ -24,6 +24,7 @@
 
 #include "../precomp.hpp"
 #include "nldiffusion_functions.h"
+#include "opencv2/core/hal/intrin.hpp"
 #include <iostream>
 
 // Namespaces
@@ -134,11 +135,25 @@ void pm_g2(InputArray _Lx, InputArray _Ly, OutputArray _dst, float k) {
     dst.create(sz, Lx.type());
     float k2inv = 1.0f / (k * k);
 
+#if CV_SIMD128
+    const bool useSIMD = hasSIMD128();
+    v_float32x4 v_one = v_setall_f32(1.0f), v_k2inv = v_setall_f32(k2inv);
+#endif
     for(int y = 0; y < sz.height; y++) {
         const float *Lx_row = Lx.ptr<float>(y);
         const float *Ly_row = Ly.ptr<float>(y);
         float* dst_row = dst.ptr<float>(y);
-        for(int x = 0; x < sz.width; x++) {
+        int x = 0;
+#if CV_SIMD128
+        // the same operations as in the scalar loop, the results are identical
+        if (useSIMD) {
+            for(; x <= sz.width - 4; x += 4) {
+                v_float32x4 lx = v_load(Lx_row + x), ly = v_load(Ly_row + x);
+                v_store(dst_row + x, v_one / (v_one + (lx * lx + ly * ly) * v_k2inv));
+            }
+        }
+#endif
+        for(; x < sz.width; x++) {
             dst_row[x] = 1.0f / (1.0f + ((Lx_row[x] * Lx_row[x] + Ly_row[x] * Ly_row[x]) * k2inv));
         }
     }
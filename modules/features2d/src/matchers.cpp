@@ -42,6 +42,7 @@
 #include "precomp.hpp"
 #include <limits>
 #include "opencl_kernels_features2d.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 #if defined(HAVE_EIGEN) && EIGEN_WORLD_VERSION == 2
 #include <Eigen/Array>
@@ -457,6 +458,27 @@ void DescriptorMatcher::DescriptorCollection::set( const std::vector<Mat>& descr
     }
 }
 
+void DescriptorMatcher::DescriptorCollection::append( const std::vector<Mat>& descriptors )
+{
+    if( startIdxs.empty() )
+    {
+        set( descriptors );
+        return;
+    }
+    CV_Assert( descriptors.size() >= startIdxs.size() );
+
+    for( size_t i = startIdxs.size(); i < descriptors.size(); i++ )
+    {
+        startIdxs.push_back( mergedDescriptors.rows );
+        if( !descriptors[i].empty() )
+        {
+            CV_Assert( mergedDescriptors.empty() ||
+                       (descriptors[i].cols == mergedDescriptors.cols && descriptors[i].type() == mergedDescriptors.type()) );
+            mergedDescriptors.push_back( descriptors[i] );
+        }
+    }
+}
+
 void DescriptorMatcher::DescriptorCollection::clear()
 {
     startIdxs.clear();
@@ -737,15 +759,403 @@ static bool ocl_knnMatch(InputArray query, InputArray _train, std::vector< std::
 }
 #endif
 
+/////////////////////////////////////////// Tiled brute-force search ///////////////////////////////////////////////
+
+// Computes distances from nquery <= 4 query descriptors to ntrain consecutive train descriptors.
+// The result for i-th query is stored in dist + i*BF_TILE_TRAIN. L2 distances are returned squared.
+typedef void (*BFTileDistFunc)(const uchar* const* query, int nquery, const uchar* train, size_t trainStep,
+                               int ntrain, int len, float* dist);
+
+static const int BF_TILE_QUERY = 4;
+static const int BF_TILE_TRAIN = 256;
+static const int BF_QUERY_BLOCK = 32;
+
+static void bfTileDistL2Sqr_32f(const uchar* const* query, int nquery, const uchar* train, size_t trainStep,
+                                int ntrain, int len, float* dist)
+{
+    const float* q0 = (const float*)query[0];
+    const float* q1 = (const float*)query[std::min(1, nquery - 1)];
+    const float* q2 = (const float*)query[std::min(2, nquery - 1)];
+    const float* q3 = (const float*)query[std::min(3, nquery - 1)];
+    float s[BF_TILE_QUERY];
+
+    for( int t = 0; t < ntrain; t++ )
+    {
+        const float* tr = (const float*)(train + trainStep*t);
+        int j = 0;
+        s[0] = s[1] = s[2] = s[3] = 0.f;
+#if CV_SIMD128
+        v_float32x4 s0 = v_setzero_f32(), s1 = v_setzero_f32(), s2 = v_setzero_f32(), s3 = v_setzero_f32();
+        for( ; j <= len - 4; j += 4 )
+        {
+            // every train vector is loaded once for all the queries of the tile
+            v_float32x4 v = v_load(tr + j);
+            v_float32x4 d0 = v_load(q0 + j) - v, d1 = v_load(q1 + j) - v;
+            v_float32x4 d2 = v_load(q2 + j) - v, d3 = v_load(q3 + j) - v;
+            s0 = v_muladd(d0, d0, s0);
+            s1 = v_muladd(d1, d1, s1);
+            s2 = v_muladd(d2, d2, s2);
+            s3 = v_muladd(d3, d3, s3);
+        }
+        s[0] = v_reduce_sum(s0); s[1] = v_reduce_sum(s1);
+        s[2] = v_reduce_sum(s2); s[3] = v_reduce_sum(s3);
+#endif
+        for( ; j < len; j++ )
+        {
+            float v = tr[j], d0 = q0[j] - v, d1 = q1[j] - v, d2 = q2[j] - v, d3 = q3[j] - v;
+            s[0] += d0*d0; s[1] += d1*d1; s[2] += d2*d2; s[3] += d3*d3;
+        }
+        for( int i = 0; i < nquery; i++ )
+            dist[i*BF_TILE_TRAIN + t] = s[i];
+    }
+}
+
+static void bfTileDistL1_32f(const uchar* const* query, int nquery, const uchar* train, size_t trainStep,
+                             int ntrain, int len, float* dist)
+{
+    const float* q0 = (const float*)query[0];
+    const float* q1 = (const float*)query[std::min(1, nquery - 1)];
+    const float* q2 = (const float*)query[std::min(2, nquery - 1)];
+    const float* q3 = (const float*)query[std::min(3, nquery - 1)];
+    float s[BF_TILE_QUERY];
+
+    for( int t = 0; t < ntrain; t++ )
+    {
+        const float* tr = (const float*)(train + trainStep*t);
+        int j = 0;
+        s[0] = s[1] = s[2] = s[3] = 0.f;
+#if CV_SIMD128
+        v_float32x4 s0 = v_setzero_f32(), s1 = v_setzero_f32(), s2 = v_setzero_f32(), s3 = v_setzero_f32();
+        for( ; j <= len - 4; j += 4 )
+        {
+            v_float32x4 v = v_load(tr + j);
+            s0 += v_absdiff(v_load(q0 + j), v);
+            s1 += v_absdiff(v_load(q1 + j), v);
+            s2 += v_absdiff(v_load(q2 + j), v);
+            s3 += v_absdiff(v_load(q3 + j), v);
+        }
+        s[0] = v_reduce_sum(s0); s[1] = v_reduce_sum(s1);
+        s[2] = v_reduce_sum(s2); s[3] = v_reduce_sum(s3);
+#endif
+        for( ; j < len; j++ )
+        {
+            float v = tr[j];
+            s[0] += std::abs(q0[j] - v); s[1] += std::abs(q1[j] - v);
+            s[2] += std::abs(q2[j] - v); s[3] += std::abs(q3[j] - v);
+        }
+        for( int i = 0; i < nquery; i++ )
+            dist[i*BF_TILE_TRAIN + t] = s[i];
+    }
+}
+
+static void bfTileDistHamming(const uchar* const* query, int nquery, const uchar* train, size_t trainStep,
+                              int ntrain, int len, float* dist)
+{
+#if CV_SIMD128
+    const uchar* q0 = query[0];
+    const uchar* q1 = query[std::min(1, nquery - 1)];
+    const uchar* q2 = query[std::min(2, nquery - 1)];
+    const uchar* q3 = query[std::min(3, nquery - 1)];
+    const int len0 = len & -16;
+
+    for( int t = 0; t < ntrain; t++ )
+    {
+        const uchar* tr = train + trainStep*t;
+        v_uint32x4 s0 = v_setzero_u32(), s1 = v_setzero_u32(), s2 = v_setzero_u32(), s3 = v_setzero_u32();
+        for( int j = 0; j < len0; j += 16 )
+        {
+            v_uint8x16 v = v_load(tr + j);
+            s0 += v_popcount(v_load(q0 + j) ^ v);
+            s1 += v_popcount(v_load(q1 + j) ^ v);
+            s2 += v_popcount(v_load(q2 + j) ^ v);
+            s3 += v_popcount(v_load(q3 + j) ^ v);
+        }
+        int s[BF_TILE_QUERY] = { (int)v_reduce_sum(s0), (int)v_reduce_sum(s1),
+                                 (int)v_reduce_sum(s2), (int)v_reduce_sum(s3) };
+        for( int i = 0; i < nquery; i++ )
+        {
+            if( len0 < len )
+                s[i] += hal::normHamming(query[i] + len0, tr + len0, len - len0);
+            dist[i*BF_TILE_TRAIN + t] = (float)s[i];
+        }
+    }
+#else
+    for( int i = 0; i < nquery; i++ )
+        for( int t = 0; t < ntrain; t++ )
+            dist[i*BF_TILE_TRAIN + t] = (float)hal::normHamming(query[i], train + trainStep*t, len);
+#endif
+}
+
+static void bfTileDistHamming2(const uchar* const* query, int nquery, const uchar* train, size_t trainStep,
+                               int ntrain, int len, float* dist)
+{
+    for( int i = 0; i < nquery; i++ )
+        for( int t = 0; t < ntrain; t++ )
+            dist[i*BF_TILE_TRAIN + t] = (float)hal::normHamming(query[i], train + trainStep*t, len, 2);
+}
+
+static void bfTileDistL1_8u(const uchar* const* query, int nquery, const uchar* train, size_t trainStep,
+                            int ntrain, int len, float* dist)
+{
+    for( int i = 0; i < nquery; i++ )
+        for( int t = 0; t < ntrain; t++ )
+            dist[i*BF_TILE_TRAIN + t] = (float)normL1<uchar, int>(query[i], train + trainStep*t, len);
+}
+
+static void bfTileDistL2Sqr_8u(const uchar* const* query, int nquery, const uchar* train, size_t trainStep,
+                               int ntrain, int len, float* dist)
+{
+    for( int i = 0; i < nquery; i++ )
+        for( int t = 0; t < ntrain; t++ )
+            dist[i*BF_TILE_TRAIN + t] = normL2Sqr<uchar, float>(query[i], train + trainStep*t, len);
+}
+
+static BFTileDistFunc getBFTileDistFunc(int type, int normType)
+{
+    if( type == CV_32F )
+    {
+        if( normType == NORM_L2 || normType == NORM_L2SQR )
+            return bfTileDistL2Sqr_32f;
+        if( normType == NORM_L1 )
+            return bfTileDistL1_32f;
+    }
+    else if( type == CV_8U )
+    {
+        if( normType == NORM_HAMMING )
+            return bfTileDistHamming;
+        if( normType == NORM_HAMMING2 )
+            return bfTileDistHamming2;
+        if( normType == NORM_L1 )
+            return bfTileDistL1_8u;
+        if( normType == NORM_L2 || normType == NORM_L2SQR )
+            return bfTileDistL2Sqr_8u;
+    }
+    CV_Error_(Error::StsUnsupportedFormat,
+              ("The combination of type=%d and normType=%d is not supported", type, normType));
+    return 0;
+}
+
+// Finds K nearest train descriptors for every query one by one block of queries and train descriptors,
+// so the train block stays in cache while the queries of the block are processed and no distance matrix
+// is built. The sorted K best distances and indices of every query are updated in dist/nidx, the indices
+// are shifted by `update`. Optionally, the nearest query is found for every train descriptor in the same pass.
+class BFKnnTileInvoker : public ParallelLoopBody
+{
+public:
+    BFKnnTileInvoker(const Mat& query, const Mat& train, const Mat& mask, BFTileDistFunc func,
+                     int K, int update, Mat& dist, Mat& nidx, Mat* trainDist, Mat* trainIdx)
+        : query_(&query), train_(&train), mask_(&mask), func_(func), K_(K), update_(update),
+          dist_(&dist), nidx_(&nidx), trainDist_(trainDist), trainIdx_(trainIdx)
+    {}
+
+    void operator()(const Range& range) const
+    {
+        const Mat& query = *query_;
+        const Mat& train = *train_;
+        const int K = K_, len = query.cols;
+        const int qstart = range.start*BF_QUERY_BLOCK;
+        const int qend = std::min(range.end*BF_QUERY_BLOCK, query.rows);
+        const int ntrain = train.rows;
+
+        AutoBuffer<float> buf(BF_TILE_QUERY*BF_TILE_TRAIN);
+        float* tile = buf;
+
+        // column minimums of this part of the queries
+        AutoBuffer<float> tdistBuf(trainDist_ ? ntrain : 1);
+        AutoBuffer<int> tidxBuf(trainDist_ ? ntrain : 1);
+        float* tdist = tdistBuf;
+        int* tidx = tidxBuf;
+        if( trainDist_ )
+        {
+            for( int t = 0; t < ntrain; t++ )
+            {
+                tdist[t] = FLT_MAX;
+                tidx[t] = -1;
+            }
+        }
+
+        for( int q0 = qstart; q0 < qend; q0 += BF_QUERY_BLOCK )
+        {
+            int q1 = std::min(q0 + BF_QUERY_BLOCK, qend);
+            for( int t0 = 0; t0 < ntrain; t0 += BF_TILE_TRAIN )
+            {
+                int nt = std::min(BF_TILE_TRAIN, ntrain - t0);
+                for( int q = q0; q < q1; q += BF_TILE_QUERY )
+                {
+                    int nq = std::min(BF_TILE_QUERY, q1 - q);
+                    const uchar* qptr[BF_TILE_QUERY];
+                    for( int i = 0; i < nq; i++ )
+                        qptr[i] = query.ptr(q + i);
+                    func_(qptr, nq, train.ptr(t0), train.step, nt, len, tile);
+
+                    for( int i = 0; i < nq; i++ )
+                    {
+                        const float* d = tile + i*BF_TILE_TRAIN;
+                        const uchar* m = mask_->empty() ? 0 : mask_->ptr(q + i) + t0;
+                        float* distptr = dist_->ptr<float>(q + i);
+                        int* nidxptr = nidx_->ptr<int>(q + i);
+                        float worst = distptr[K-1];
+
+                        for( int t = 0; t < nt; t++ )
+                        {
+                            float v = d[t];
+                            if( m && !m[t] )
+                                continue;
+                            if( v < worst )
+                            {
+                                int k = K-2;
+                                for( ; k >= 0 && distptr[k] > v; k-- )
+                                {
+                                    nidxptr[k+1] = nidxptr[k];
+                                    distptr[k+1] = distptr[k];
+                                }
+                                nidxptr[k+1] = t0 + t + update_;
+                                distptr[k+1] = v;
+                                worst = distptr[K-1];
+                            }
+                            if( trainDist_ && v < tdist[t0 + t] )
+                            {
+                                tdist[t0 + t] = v;
+                                tidx[t0 + t] = q + i;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        if( trainDist_ )
+        {
+            // the smallest query index wins the ties as in the sequential search
+            AutoLock lock(mutex_);
+            float* gdist = trainDist_->ptr<float>();
+            int* gidx = trainIdx_->ptr<int>();
+            for( int t = 0; t < ntrain; t++ )
+            {
+                if( tidx[t] >= 0 && (tdist[t] < gdist[t] || (tdist[t] == gdist[t] && tidx[t] < gidx[t])) )
+                {
+                    gdist[t] = tdist[t];
+                    gidx[t] = tidx[t];
+                }
+            }
+        }
+    }
+
+private:
+    const Mat* query_;
+    const Mat* train_;
+    const Mat* mask_;
+    BFTileDistFunc func_;
+    int K_, update_;
+    Mat* dist_;
+    Mat* nidx_;
+    Mat* trainDist_;
+    Mat* trainIdx_;
+    mutable Mutex mutex_;
+};
+
+// K nearest neighbours over the whole train collection. The result is the same as batchDistance()
+// gives for every train image, dist is CV_32F and contains actual (not squared) distances.
+static void bfKnnSearch(const Mat& query, const std::vector<Mat>& trainCollection, const std::vector<Mat>& masks,
+                        int normType, int K, bool crossCheck, int imgIdxShift, Mat& dist, Mat& nidx)
+{
+    CV_Assert( query.type() == CV_32F || query.type() == CV_8U );
+    BFTileDistFunc func = getBFTileDistFunc(query.type(), normType);
+
+    int imgCount = (int)trainCollection.size(), maxRows = 0;
+    for( int iIdx = 0; iIdx < imgCount; iIdx++ )
+        maxRows = std::max(maxRows, trainCollection[iIdx].rows);
+    K = std::max(std::min(K, maxRows), 1);
+
+    dist.create(query.rows, K, CV_32F);
+    nidx.create(query.rows, K, CV_32S);
+    dist = Scalar::all(FLT_MAX);
+    nidx = Scalar::all(-1);
+
+    const int nblocks = (query.rows + BF_QUERY_BLOCK - 1)/BF_QUERY_BLOCK;
+    if( crossCheck )
+    {
+        CV_Assert( K == 1 && imgCount == 1 && (masks.empty() || masks[0].empty()) );
+        const Mat& train = trainCollection[0];
+        Mat tdist(1, std::max(train.rows, 1), CV_32F, Scalar::all(FLT_MAX));
+        Mat tidx(1, std::max(train.rows, 1), CV_32S, Scalar::all(-1));
+
+        // every stripe merges its own column minimums, so keep their number small
+        parallel_for_(Range(0, nblocks),
+                      BFKnnTileInvoker(query, train, Mat(), func, 1, 0, dist, nidx, &tdist, &tidx),
+                      std::min((double)nblocks, (double)getNumThreads()*2));
+
+        // The same as in batchDistance(): i-th train descriptor is assigned to its nearest query
+        // if it's the closest one among all the train descriptors which have chosen this query.
+        Mat cdist(dist.size(), CV_32F, Scalar::all(FLT_MAX));
+        Mat cidx(nidx.size(), CV_32S, Scalar::all(-1));
+        for( int i = 0; i < train.rows; i++ )
+        {
+            int idx = tidx.at<int>(i);
+            float d = tdist.at<float>(i);
+            if( idx >= 0 && d < cdist.at<float>(idx) )
+            {
+                cdist.at<float>(idx) = d;
+                cidx.at<int>(idx) = i;
+            }
+        }
+        dist = cdist;
+        nidx = cidx;
+    }
+    else
+    {
+        for( int iIdx = 0; iIdx < imgCount; iIdx++ )
+        {
+            const Mat& train = trainCollection[iIdx];
+            if( train.empty() )
+                continue;
+            CV_Assert( train.type() == query.type() && train.cols == query.cols );
+            Mat mask = masks.empty() ? Mat() : masks[iIdx];
+            parallel_for_(Range(0, nblocks),
+                          BFKnnTileInvoker(query, train, mask, func, K, iIdx << imgIdxShift, dist, nidx, 0, 0));
+        }
+    }
+
+    if( normType == NORM_L2 )
+    {
+        for( int i = 0; i < dist.rows; i++ )
+        {
+            float* d = dist.ptr<float>(i);
+            const int* idx = nidx.ptr<int>(i);
+            for( int k = 0; k < K; k++ )
+                if( idx[k] >= 0 )
+                    d[k] = std::sqrt(d[k]);
+        }
+    }
+}
+
+// bfKnnSearch() packs the image index into the high bits of the train descriptor index
+enum { IMGIDX_SHIFT = 18, IMGIDX_ONE = 1 << IMGIDX_SHIFT };
+
+// Moves the UMat train descriptors into the Mat collection for bfKnnSearch()
+// and checks that all their indices can be packed
+static void prepareKnnTrainCollection( std::vector<Mat>& trainDescCollection, std::vector<UMat>& utrainDescCollection )
+{
+    for( int i = 0; i < (int)utrainDescCollection.size(); i++ )
+    {
+        Mat tempMat;
+        utrainDescCollection[i].copyTo(tempMat);
+        trainDescCollection.push_back(tempMat);
+    }
+    utrainDescCollection.clear();
+
+    int iIdx, imgCount = (int)trainDescCollection.size();
+    CV_Assert( (int64)imgCount*IMGIDX_ONE < INT_MAX );
+    for( iIdx = 0; iIdx < imgCount; iIdx++ )
+        CV_Assert( trainDescCollection[iIdx].rows < IMGIDX_ONE );
+}
+
 void BFMatcher::knnMatchImpl( InputArray _queryDescriptors, std::vector<std::vector<DMatch> >& matches, int knn,
                              InputArrayOfArrays _masks, bool compactResult )
 {
     int trainDescType = trainDescCollection.empty() ? utrainDescCollection[0].type() : trainDescCollection[0].type();
     CV_Assert( _queryDescriptors.type() == trainDescType );
 
-    const int IMGIDX_SHIFT = 18;
-    const int IMGIDX_ONE = (1 << IMGIDX_SHIFT);
-
     if( _queryDescriptors.empty() || (trainDescCollection.empty() && utrainDescCollection.empty()))
     {
         matches.clear();
@@ -756,15 +1166,7 @@ void BFMatcher::knnMatchImpl( InputArray _queryDescriptors, std::vector<std::vec
     _masks.getMatVector(masks);
 
     if(!trainDescCollection.empty() && !utrainDescCollection.empty())
-    {
-        for(int i = 0; i < (int)utrainDescCollection.size(); i++)
-        {
-            Mat tempMat;
-            utrainDescCollection[i].copyTo(tempMat);
-            trainDescCollection.push_back(tempMat);
-        }
-        utrainDescCollection.clear();
-    }
+        prepareKnnTrainCollection(trainDescCollection, utrainDescCollection);
 
 #ifdef HAVE_OPENCL
     int trainDescVectorSize = trainDescCollection.empty() ? (int)utrainDescCollection.size() : (int)trainDescCollection.size();
@@ -817,41 +1219,12 @@ void BFMatcher::knnMatchImpl( InputArray _queryDescriptors, std::vector<std::vec
 #endif
 
     Mat queryDescriptors = _queryDescriptors.getMat();
-    if(trainDescCollection.empty() && !utrainDescCollection.empty())
-    {
-        for(int i = 0; i < (int)utrainDescCollection.size(); i++)
-        {
-            Mat tempMat;
-            utrainDescCollection[i].copyTo(tempMat);
-            trainDescCollection.push_back(tempMat);
-        }
-        utrainDescCollection.clear();
-    }
+    prepareKnnTrainCollection(trainDescCollection, utrainDescCollection);
 
     matches.reserve(queryDescriptors.rows);
 
     Mat dist, nidx;
-
-    int iIdx, imgCount = (int)trainDescCollection.size(), update = 0;
-    int dtype = normType == NORM_HAMMING || normType == NORM_HAMMING2 ||
-        (normType == NORM_L1 && queryDescriptors.type() == CV_8U) ? CV_32S : CV_32F;
-
-    CV_Assert( (int64)imgCount*IMGIDX_ONE < INT_MAX );
-
-    for( iIdx = 0; iIdx < imgCount; iIdx++ )
-    {
-        CV_Assert( trainDescCollection[iIdx].rows < IMGIDX_ONE );
-        batchDistance(queryDescriptors, trainDescCollection[iIdx], dist, dtype, nidx,
-                      normType, knn, masks.empty() ? Mat() : masks[iIdx], update, crossCheck);
-        update += IMGIDX_ONE;
-    }
-
-    if( dtype == CV_32S )
-    {
-        Mat temp;
-        dist.convertTo(temp, CV_32F);
-        dist = temp;
-    }
+    bfKnnSearch(queryDescriptors, trainDescCollection, masks, normType, knn, crossCheck, IMGIDX_SHIFT, dist, nidx);
 
     for( int qIdx = 0; qIdx < queryDescriptors.rows; qIdx++ )
     {
@@ -875,6 +1248,51 @@ void BFMatcher::knnMatchImpl( InputArray _queryDescriptors, std::vector<std::vec
     }
 }
 
+void BFMatcher::ratioMatch( InputArray _queryDescriptors, std::vector<DMatch>& matches,
+                           float ratio, InputArrayOfArrays _masks )
+{
+    CV_INSTRUMENT_REGION()
+
+    matches.clear();
+    if( empty() || _queryDescriptors.empty() )
+        return;
+
+    CV_Assert( ratio > 0 );
+    checkMasks( _masks, _queryDescriptors.size().height );
+
+    std::vector<Mat> masks;
+    _masks.getMatVector(masks);
+
+    prepareKnnTrainCollection(trainDescCollection, utrainDescCollection);
+
+    Mat queryDescriptors = _queryDescriptors.getMat();
+    CV_Assert( queryDescriptors.type() == trainDescCollection[0].type() );
+
+    Mat dist, nidx;
+    bfKnnSearch(queryDescriptors, trainDescCollection, masks, normType, 2, false, IMGIDX_SHIFT, dist, nidx);
+    if( dist.cols < 2 )
+        return;
+
+    for( int qIdx = 0; qIdx < queryDescriptors.rows; qIdx++ )
+    {
+        const float* distptr = dist.ptr<float>(qIdx);
+        const int* nidxptr = nidx.ptr<int>(qIdx);
+        if( nidxptr[1] >= 0 && distptr[0] < ratio*distptr[1] )
+            matches.push_back( DMatch(qIdx, nidxptr[0] & (IMGIDX_ONE - 1),
+                                      nidxptr[0] >> IMGIDX_SHIFT, distptr[0]) );
+    }
+}
+
+void BFMatcher::ratioMatch( InputArray queryDescriptors, InputArray trainDescriptors,
+                           std::vector<DMatch>& matches, float ratio, InputArray mask ) const
+{
+    CV_INSTRUMENT_REGION()
+
+    Ptr<BFMatcher> tempMatcher = makePtr<BFMatcher>(normType, crossCheck);
+    tempMatcher->add(trainDescriptors);
+    tempMatcher->ratioMatch( queryDescriptors, matches, ratio, std::vector<Mat>(1, mask.getMat()) );
+}
+
 #ifdef HAVE_OPENCL
 static bool ocl_radiusMatch(InputArray query, InputArray _train, std::vector< std::vector<DMatch> > &matches,
         float maxDistance, int dstType, bool compactResult)
@@ -1144,6 +1562,28 @@ void FlannBasedMatcher::train()
 {
     CV_INSTRUMENT_REGION()
 
+    if( flannIndex && mergedDescriptors.size() > 0 && mergedDescriptors.size() < addedDescCount &&
+        utrainDescCollection.empty() )
+    {
+        cvflann::flann_algorithm_t algo = flannIndex->getAlgorithm();
+        if( algo == cvflann::FLANN_INDEX_LINEAR || algo == cvflann::FLANN_INDEX_KDTREE ||
+            algo == cvflann::FLANN_INDEX_KMEANS || algo == cvflann::FLANN_INDEX_LSH ||
+            algo == cvflann::FLANN_INDEX_IVF_PQ )
+        {
+            // The index refers to the merged descriptors, so the new ones are inserted into it
+            // as long as the merged matrix is not reallocated.
+            const uchar* data = mergedDescriptors.getDescriptors().data;
+            int oldCount = mergedDescriptors.size();
+            mergedDescriptors.append( trainDescCollection );
+            const Mat& descriptors = mergedDescriptors.getDescriptors();
+            if( descriptors.data == data )
+                flannIndex->addPoints( descriptors.rowRange(oldCount, descriptors.rows) );
+            else
+                flannIndex = makePtr<flann::Index>( descriptors, *indexParams );
+            return;
+        }
+    }
+
     if( !flannIndex || mergedDescriptors.size() < addedDescCount )
     {
         // FIXIT: Workaround for 'utrainDescCollection' issue (PR #2142)
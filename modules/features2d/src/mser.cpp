@@ -124,8 +124,12 @@ public:
     struct WParams
     {
         Params p;
+        // the points go either to the region vectors or to one array,
+        // they are not stored when both are NULL
         vector<vector<Point> >* msers;
+        vector<Point>* points;
         vector<Rect>* bboxvec;
+        vector<int>* areas;
         Pixel* pix0;
         int step;
     };
@@ -214,9 +218,18 @@ public:
             if( var > 0.f && parent_ && parent_->var >= 0.f && var >= parent_->var )
                 return;
             int xmin = INT_MAX, ymin = INT_MAX, xmax = INT_MIN, ymax = INT_MIN, j = 0;
-            wp.msers->push_back(vector<Point>());
-            vector<Point>& region = wp.msers->back();
-            region.resize(size);
+            Point* region = 0;
+            if( wp.msers )
+            {
+                wp.msers->push_back(vector<Point>(size));
+                region = &wp.msers->back()[0];
+            }
+            else if( wp.points )
+            {
+                size_t ofs = wp.points->size();
+                wp.points->resize(ofs + size);
+                region = &(*wp.points)[ofs];
+            }
             const Pixel* pix0 = wp.pix0;
             int step = wp.step;
 
@@ -230,10 +243,12 @@ public:
                 ymin = std::min(ymin, y);
                 ymax = std::max(ymax, y);
 
-                region[j] = Point(x, y);
+                if( region )
+                    region[j] = Point(x, y);
             }
 
             wp.bboxvec->push_back(Rect(xmin, ymin, xmax - xmin + 1, ymax - ymin + 1));
+            wp.areas->push_back(size);
         }
 
         CompHistory* child_;
@@ -362,82 +377,98 @@ public:
         int size;
     };
 
+    // the working memory of one pass
+    struct WorkBuffers
+    {
+        vector<Pixel> pixbuf;
+        vector<Pixel*> heapbuf;
+        vector<CompHistory> histbuf;
+    };
+
+    // the regions of one pass, reused for the next images
+    struct PassBuffers
+    {
+        vector<vector<Point> > msers;
+        vector<Point> points;
+        vector<Rect> bboxes;
+        vector<int> areas;
+    };
+
     void detectRegions( InputArray image,
                         std::vector<std::vector<Point> >& msers,
                         std::vector<Rect>& bboxes );
+    void findRegionPoints( InputArray image, std::vector<Point>& points,
+                           std::vector<int>& offsets, std::vector<Rect>& bboxes );
+    void findRegionStats( InputArray image, std::vector<Rect>& bboxes, std::vector<int>& areas );
     void detect( InputArray _src, vector<KeyPoint>& keypoints, InputArray _mask );
 
-    void preprocess1( const Mat& img, int* level_size )
+    Mat getInput( InputArray _src );
+    void runPasses( const Mat& img, int output );
+
+    void preprocess( const Mat& img, int* level_size )
     {
         memset(level_size, 0, 256*sizeof(level_size[0]));
 
+        int i, j, cols = img.cols, rows = img.rows;
+        for( i = 1; i < rows-1; i++ )
+        {
+            const uchar* imgptr = img.ptr(i);
+            for( j = 1; j < cols-1; j++ )
+                level_size[imgptr[j]]++;
+        }
+    }
+
+    void initPass( const Mat& img, WorkBuffers& work, PassBuffers& buf )
+    {
         int i, j, cols = img.cols, rows = img.rows;
         int step = cols;
-        pixbuf.resize(step*rows);
-        heapbuf.resize(cols*rows + 256);
-        histbuf.resize(cols*rows);
+        work.pixbuf.resize(step*rows);
+        work.heapbuf.resize(cols*rows + 256);
+        work.histbuf.resize(cols*rows);
+        buf.msers.clear();
+        buf.points.clear();
+        buf.bboxes.clear();
+        buf.areas.clear();
         Pixel borderpix;
         borderpix.setDir(5);
 
         for( j = 0; j < step; j++ )
         {
-            pixbuf[j] = pixbuf[j + (rows-1)*step] = borderpix;
+            work.pixbuf[j] = work.pixbuf[j + (rows-1)*step] = borderpix;
         }
 
         for( i = 1; i < rows-1; i++ )
         {
-            const uchar* imgptr = img.ptr(i);
-            Pixel* pptr = &pixbuf[i*step];
+            Pixel* pptr = &work.pixbuf[i*step];
             pptr[0] = pptr[cols-1] = borderpix;
             for( j = 1; j < cols-1; j++ )
-            {
-                int val = imgptr[j];
-                level_size[val]++;
                 pptr[j].val = 0;
-            }
         }
     }
 
-    void preprocess2( const Mat& img, int* level_size )
-    {
-        int i;
-
-        for( i = 0; i < 128; i++ )
-            std::swap(level_size[i], level_size[255-i]);
-
-        if( !params.pass2Only )
-        {
-            int j, cols = img.cols, rows = img.rows;
-            int step = cols;
-            for( i = 1; i < rows-1; i++ )
-            {
-                Pixel* pptr = &pixbuf[i*step];
-                for( j = 1; j < cols-1; j++ )
-                {
-                    pptr[j].val = 0;
-                }
-            }
-        }
-    }
+    // the form of the regions points
+    enum { OUTPUT_REGIONS = 0, OUTPUT_POINTS = 1, OUTPUT_STATS = 2 };
 
-    void pass( const Mat& img, vector<vector<Point> >& msers, vector<Rect>& bboxvec,
+    void pass( const Mat& img, WorkBuffers& work, PassBuffers& buf, int output,
               Size size, const int* level_size, int mask )
     {
-        CompHistory* histptr = &histbuf[0];
+        CompHistory* histptr = &work.histbuf[0];
         int step = size.width;
-        Pixel *ptr0 = &pixbuf[0], *ptr = &ptr0[step+1];
+        Pixel *ptr0 = &work.pixbuf[0], *ptr = &ptr0[step+1];
         const uchar* imgptr0 = img.ptr();
         Pixel** heap[256];
         ConnectedComp comp[257];
         ConnectedComp* comptr = &comp[0];
         WParams wp;
         wp.p = params;
-        wp.msers = &msers;
-        wp.bboxvec = &bboxvec;
+        wp.msers = output == OUTPUT_REGIONS ? &buf.msers : 0;
+        wp.points = output == OUTPUT_POINTS ? &buf.points : 0;
+        wp.bboxvec = &buf.bboxes;
+        wp.areas = &buf.areas;
         wp.pix0 = ptr0;
         wp.step = step;
 
-        heap[0] = &heapbuf[0];
+        heap[0] = &work.heapbuf[0];
         heap[0][0] = 0;
 
         for( int i = 1; i < 256; i++ )
@@ -539,9 +570,10 @@ public:
     }
 
     Mat tempsrc;
-    vector<Pixel> pixbuf;
-    vector<Pixel*> heapbuf;
-    vector<CompHistory> histbuf;
+    // the working memory of the passes which run sequentially or of the first parallel pass
+    WorkBuffers workbuf;
+    // MSER+ (darker to brighter) and MSER- (brighter to darker) passes
+    PassBuffers passbuf[2];
 
     Params params;
 };
@@ -1034,41 +1066,175 @@ extractMSER_8uC3( const Mat& src,
     cvFree( &map );
 }
 
+class MSERPassInvoker : public ParallelLoopBody
+{
+public:
+    MSERPassInvoker( MSER_Impl* _mser, const Mat& _img, const int* _level_size, int _output,
+                     MSER_Impl::WorkBuffers* _work0, MSER_Impl::WorkBuffers* _work1 )
+        : mser(_mser), img(_img), level_size(_level_size), output(_output)
+    {
+        work[0] = _work0;
+        work[1] = _work1;
+    }
+
+    void operator()( const Range& range ) const
+    {
+        for( int k = range.start; k < range.end; k++ )
+        {
+            // the gray levels of the second pass are inverted
+            int levels[256];
+            for( int i = 0; i < 256; i++ )
+                levels[i] = level_size[k == 0 ? i : 255 - i];
+            MSER_Impl::PassBuffers& buf = mser->passbuf[k];
+            mser->initPass(img, *work[k], buf);
+            mser->pass(img, *work[k], buf, output, img.size(), levels, k == 0 ? 0 : 255);
+        }
+    }
+
+private:
+    MSER_Impl* mser;
+    Mat img;
+    const int* level_size;
+    int output;
+    MSER_Impl::WorkBuffers* work[2];
+};
+
+Mat MSER_Impl::getInput( InputArray _src )
+{
+    Mat src = _src.getMat();
+
+    if( src.rows < 3 || src.cols < 3 )
+        CV_Error(Error::StsBadArg, "Input image is too small. Expected at least 3x3");
+
+    if( src.type() != CV_8U )
+    {
+        CV_Assert( src.type() == CV_8UC3 || src.type() == CV_8UC4 );
+    }
+    else if( !src.isContinuous() )
+    {
+        src.copyTo(tempsrc);
+        src = tempsrc;
+    }
+    return src;
+}
+
+// The regions are left in passbuf, MSER+ (darker to brighter) in the first one
+// and MSER- (brighter to darker) in the second one. The passes are independent and run in parallel
+// when there are several threads. The working memory of the second parallel pass is released
+// afterwards, so only one set of the image-sized buffers is kept between the images.
+void MSER_Impl::runPasses( const Mat& src, int output )
+{
+    int level_size[256];
+    preprocess( src, level_size );
+
+    PassBuffers& dark = passbuf[0];
+    dark.msers.clear();
+    dark.points.clear();
+    dark.bboxes.clear();
+    dark.areas.clear();
+
+    if( !params.pass2Only && getNumThreads() > 1 )
+    {
+        WorkBuffers work1;
+        parallel_for_(Range(0, 2), MSERPassInvoker(this, src, level_size, output, &workbuf, &work1));
+    }
+    else
+    {
+        MSERPassInvoker invoker(this, src, level_size, output, &workbuf, &workbuf);
+        invoker(Range(params.pass2Only ? 1 : 0, 2));
+    }
+}
+
 void MSER_Impl::detectRegions( InputArray _src, vector<vector<Point> >& msers, vector<Rect>& bboxes )
 {
     CV_INSTRUMENT_REGION()
 
-    Mat src = _src.getMat();
+    Mat src = getInput(_src);
 
     msers.clear();
     bboxes.clear();
 
-    if( src.rows < 3 || src.cols < 3 )
-        CV_Error(Error::StsBadArg, "Input image is too small. Expected at least 3x3");
+    if( src.type() == CV_8U )
+    {
+        runPasses( src, OUTPUT_REGIONS );
+        msers.resize(passbuf[0].msers.size() + passbuf[1].msers.size());
+        for( int k = 0, n = 0; k < 2; k++ )
+        {
+            PassBuffers& buf = passbuf[k];
+            for( size_t i = 0; i < buf.msers.size(); i++ )
+                msers[n++].swap(buf.msers[i]);
+            bboxes.insert(bboxes.end(), buf.bboxes.begin(), buf.bboxes.end());
+        }
+    }
+    else
+    {
+        extractMSER_8uC3( src, msers, bboxes, params );
+    }
+}
 
-    Size size = src.size();
+void MSER_Impl::findRegionPoints( InputArray _src, vector<Point>& points, vector<int>& offsets, vector<Rect>& bboxes )
+{
+    CV_INSTRUMENT_REGION()
+
+    Mat src = getInput(_src);
+
+    points.clear();
+    bboxes.clear();
+    offsets.assign(1, 0);
 
     if( src.type() == CV_8U )
     {
-        int level_size[256];
-        if( !src.isContinuous() )
+        runPasses( src, OUTPUT_POINTS );
+        // the arena of the first pass is exchanged with the output, the caller's vector is reused for the next image
+        points.swap(passbuf[0].points);
+        for( int k = 0; k < 2; k++ )
+        {
+            const PassBuffers& buf = passbuf[k];
+            if( k > 0 )
+                points.insert(points.end(), buf.points.begin(), buf.points.end());
+            bboxes.insert(bboxes.end(), buf.bboxes.begin(), buf.bboxes.end());
+            for( size_t i = 0; i < buf.areas.size(); i++ )
+                offsets.push_back(offsets.back() + buf.areas[i]);
+        }
+    }
+    else
+    {
+        vector<vector<Point> > msers;
+        extractMSER_8uC3( src, msers, bboxes, params );
+        for( size_t i = 0; i < msers.size(); i++ )
         {
-            src.copyTo(tempsrc);
-            src = tempsrc;
+            points.insert(points.end(), msers[i].begin(), msers[i].end());
+            offsets.push_back((int)points.size());
         }
+    }
+}
+
+void MSER_Impl::findRegionStats( InputArray _src, vector<Rect>& bboxes, vector<int>& areas )
+{
+    CV_INSTRUMENT_REGION()
+
+    Mat src = getInput(_src);
 
-        // darker to brighter (MSER+)
-        preprocess1( src, level_size );
-        if( !params.pass2Only )
-            pass( src, msers, bboxes, size, level_size, 0 );
-        // brighter to darker (MSER-)
-        preprocess2( src, level_size );
-        pass( src, msers, bboxes, size, level_size, 255 );
+    bboxes.clear();
+    areas.clear();
+
+    if( src.type() == CV_8U )
+    {
+        // the points of the regions are not stored, only the bounding boxes are computed from them
+        runPasses( src, OUTPUT_STATS );
+        for( int k = 0; k < 2; k++ )
+        {
+            const PassBuffers& buf = passbuf[k];
+            bboxes.insert(bboxes.end(), buf.bboxes.begin(), buf.bboxes.end());
+            areas.insert(areas.end(), buf.areas.begin(), buf.areas.end());
+        }
     }
     else
     {
-        CV_Assert( src.type() == CV_8UC3 || src.type() == CV_8UC4 );
+        vector<vector<Point> > msers;
         extractMSER_8uC3( src, msers, bboxes, params );
+        for( size_t i = 0; i < msers.size(); i++ )
+            areas.push_back((int)msers[i].size());
     }
 }
 
@@ -1077,18 +1243,19 @@ void MSER_Impl::detect( InputArray _image, vector<KeyPoint>& keypoints, InputArr
     CV_INSTRUMENT_REGION()
 
     vector<Rect> bboxes;
-    vector<vector<Point> > msers;
+    vector<Point> points;
+    vector<int> offsets;
     Mat mask = _mask.getMat();
 
-    detectRegions(_image, msers, bboxes);
-    int i, ncomps = (int)msers.size();
+    findRegionPoints(_image, points, offsets, bboxes);
+    int i, ncomps = (int)bboxes.size();
 
     keypoints.clear();
     for( i = 0; i < ncomps; i++ )
     {
         Rect r = bboxes[i];
         // TODO check transformation from MSER region to KeyPoint
-        RotatedRect rect = fitEllipse(Mat(msers[i]));
+        RotatedRect rect = fitEllipse(Mat(offsets[i+1] - offsets[i], 1, CV_32SC2, &points[offsets[i]]));
         float diam = std::sqrt(rect.size.height*rect.size.width);
 
         if( diam > std::numeric_limits<float>::epsilon() && r.contains(rect.center) &&
@@ -1109,6 +1276,40 @@ Ptr<MSER> MSER::create( int _delta, int _min_area, int _max_area,
                           _min_margin, _edge_blur_size));
 }
 
+// The implementation is reached through dynamic_cast, so the flat and the statistics outputs don't add virtual methods
+// to MSER. The other implementations give the regions as vectors which are converted.
+void MSER::detectRegions( InputArray image, vector<Point>& points, vector<int>& offsets, vector<Rect>& bboxes )
+{
+    if( MSER_Impl* impl = dynamic_cast<MSER_Impl*>(this) )
+    {
+        impl->findRegionPoints( image, points, offsets, bboxes );
+        return;
+    }
+    vector<vector<Point> > msers;
+    detectRegions( image, msers, bboxes );
+    points.clear();
+    offsets.assign(1, 0);
+    for( size_t i = 0; i < msers.size(); i++ )
+    {
+        points.insert(points.end(), msers[i].begin(), msers[i].end());
+        offsets.push_back((int)points.size());
+    }
+}
+
+void MSER::detectRegionStats( InputArray image, vector<Rect>& bboxes, vector<int>& areas )
+{
+    if( MSER_Impl* impl = dynamic_cast<MSER_Impl*>(this) )
+    {
+        impl->findRegionStats( image, bboxes, areas );
+        return;
+    }
+    vector<vector<Point> > msers;
+    detectRegions( image, msers, bboxes );
+    areas.resize(msers.size());
+    for( size_t i = 0; i < msers.size(); i++ )
+        areas[i] = (int)msers[i].size();
+}
+
 String MSER::getDefaultName() const
 {
     return (Feature2D::getDefaultName() + ".MSER");
@@ -36,6 +36,7 @@
 
 #include "precomp.hpp"
 #include "opencl_kernels_features2d.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <iterator>
 
 #ifndef CV_IMPL_ADD
@@ -123,6 +124,120 @@ ocl_computeOrbDescriptors(const UMat& imgbuf, const UMat& layerInfo,
 }
 #endif
 
+// Keypoints are processed by parallel chunks of this size.
+static const int ORB_KEYPOINTS_CHUNK = 64;
+
+static inline double getKeypointsStripes(size_t nkeypoints)
+{
+    return (double)nkeypoints / ORB_KEYPOINTS_CHUNK;
+}
+
+class HarrisResponsesInvoker : public ParallelLoopBody
+{
+public:
+    HarrisResponsesInvoker(const Mat& img, const std::vector<Rect>& layerinfo,
+                           std::vector<KeyPoint>& pts, int blockSize, float harris_k)
+        : img_(&img), layerinfo_(&layerinfo), pts_(&pts), blockSize_(blockSize), harris_k_(harris_k)
+    {
+        int step = (int)(img.step/img.elemSize1());
+        ofsbuf_.resize(blockSize*blockSize);
+        for( int i = 0; i < blockSize; i++ )
+            for( int j = 0; j < blockSize; j++ )
+                ofsbuf_[i*blockSize + j] = (int)(i*step + j);
+    }
+
+    void operator()(const Range& range) const
+    {
+        const Mat& img = *img_;
+        const std::vector<Rect>& layerinfo = *layerinfo_;
+        std::vector<KeyPoint>& pts = *pts_;
+        const int blockSize = blockSize_;
+        const float harris_k = harris_k_;
+
+        size_t ptidx, ptsize = pts.size();
+        size_t ptstart = range.start*(size_t)ORB_KEYPOINTS_CHUNK;
+        size_t ptend = std::min(range.end*(size_t)ORB_KEYPOINTS_CHUNK, ptsize);
+
+        const uchar* ptr00 = img.ptr<uchar>();
+        int step = (int)(img.step/img.elemSize1());
+        int r = blockSize/2;
+
+        float scale = 1.f/((1 << 2) * blockSize * 255.f);
+        float scale_sq_sq = scale * scale * scale * scale;
+
+        const int* ofs = &ofsbuf_[0];
+
+#if CV_SIMD128
+        // All the sums are integer so the vectorized branch gives exactly the same responses.
+        const bool useSIMD = blockSize <= 8 && hasSIMD128();
+        short maskbuf[8];
+        for( int k = 0; k < 8; k++ )
+            maskbuf[k] = k < blockSize ? (short)-1 : (short)0;
+        v_int16x8 lanesMask = v_load(maskbuf);
+#endif
+
+        for( ptidx = ptstart; ptidx < ptend; ptidx++ )
+        {
+            int x0 = cvRound(pts[ptidx].pt.x);
+            int y0 = cvRound(pts[ptidx].pt.y);
+            int z = pts[ptidx].octave;
+
+            const uchar* ptr0 = ptr00 + (y0 - r + layerinfo[z].y)*step + x0 - r + layerinfo[z].x;
+            int a = 0, b = 0, c = 0;
+
+#if CV_SIMD128
+            if( useSIMD )
+            {
+                v_int32x4 va = v_setzero_s32(), vb = v_setzero_s32(), vc = v_setzero_s32();
+                for( int i = 0; i < blockSize; i++ )
+                {
+                    const uchar* ptr = ptr0 + i*step;
+                    v_int16x8 l = v_reinterpret_as_s16(v_load_expand(ptr - 1));
+                    v_int16x8 rt = v_reinterpret_as_s16(v_load_expand(ptr + 1));
+                    v_int16x8 t = v_reinterpret_as_s16(v_load_expand(ptr - step));
+                    v_int16x8 bt = v_reinterpret_as_s16(v_load_expand(ptr + step));
+                    v_int16x8 tl = v_reinterpret_as_s16(v_load_expand(ptr - step - 1));
+                    v_int16x8 tr = v_reinterpret_as_s16(v_load_expand(ptr - step + 1));
+                    v_int16x8 bl = v_reinterpret_as_s16(v_load_expand(ptr + step - 1));
+                    v_int16x8 br = v_reinterpret_as_s16(v_load_expand(ptr + step + 1));
+                    v_int16x8 dx = rt - l, dy = bt - t;
+                    v_int16x8 Ix = ((dx + dx) + (tr - tl) + (br - bl)) & lanesMask;
+                    v_int16x8 Iy = ((dy + dy) + (bl - tl) + (br - tr)) & lanesMask;
+                    va += v_dotprod(Ix, Ix);
+                    vb += v_dotprod(Iy, Iy);
+                    vc += v_dotprod(Ix, Iy);
+                }
+                a = v_reduce_sum(va);
+                b = v_reduce_sum(vb);
+                c = v_reduce_sum(vc);
+            }
+            else
+#endif
+            {
+                for( int k = 0; k < blockSize*blockSize; k++ )
+                {
+                    const uchar* ptr = ptr0 + ofs[k];
+                    int Ix = (ptr[1] - ptr[-1])*2 + (ptr[-step+1] - ptr[-step-1]) + (ptr[step+1] - ptr[step-1]);
+                    int Iy = (ptr[step] - ptr[-step])*2 + (ptr[step-1] - ptr[-step-1]) + (ptr[step+1] - ptr[-step+1]);
+                    a += Ix*Ix;
+                    b += Iy*Iy;
+                    c += Ix*Iy;
+                }
+            }
+            pts[ptidx].response = ((float)a * b - (float)c * c -
+                                   harris_k * ((float)a + b) * ((float)a + b))*scale_sq_sq;
+        }
+    }
+
+private:
+    const Mat* img_;
+    const std::vector<Rect>* layerinfo_;
+    std::vector<KeyPoint>* pts_;
+    int blockSize_;
+    float harris_k_;
+    std::vector<int> ofsbuf_;
+};
+
 /**
  * Function that computes the Harris responses in a
  * blockSize x blockSize patch at given points in the image
@@ -133,215 +248,276 @@ HarrisResponses(const Mat& img, const std::vector<Rect>& layerinfo,
 {
     CV_Assert( img.type() == CV_8UC1 && blockSize*blockSize <= 2048 );
 
-    size_t ptidx, ptsize = pts.size();
-
-    const uchar* ptr00 = img.ptr<uchar>();
-    int step = (int)(img.step/img.elemSize1());
-    int r = blockSize/2;
-
-    float scale = 1.f/((1 << 2) * blockSize * 255.f);
-    float scale_sq_sq = scale * scale * scale * scale;
-
-    AutoBuffer<int> ofsbuf(blockSize*blockSize);
-    int* ofs = ofsbuf;
-    for( int i = 0; i < blockSize; i++ )
-        for( int j = 0; j < blockSize; j++ )
-            ofs[i*blockSize + j] = (int)(i*step + j);
-
-    for( ptidx = 0; ptidx < ptsize; ptidx++ )
-    {
-        int x0 = cvRound(pts[ptidx].pt.x);
-        int y0 = cvRound(pts[ptidx].pt.y);
-        int z = pts[ptidx].octave;
-
-        const uchar* ptr0 = ptr00 + (y0 - r + layerinfo[z].y)*step + x0 - r + layerinfo[z].x;
-        int a = 0, b = 0, c = 0;
-
-        for( int k = 0; k < blockSize*blockSize; k++ )
-        {
-            const uchar* ptr = ptr0 + ofs[k];
-            int Ix = (ptr[1] - ptr[-1])*2 + (ptr[-step+1] - ptr[-step-1]) + (ptr[step+1] - ptr[step-1]);
-            int Iy = (ptr[step] - ptr[-step])*2 + (ptr[step-1] - ptr[-step-1]) + (ptr[step+1] - ptr[-step+1]);
-            a += Ix*Ix;
-            b += Iy*Iy;
-            c += Ix*Iy;
-        }
-        pts[ptidx].response = ((float)a * b - (float)c * c -
-                               harris_k * ((float)a + b) * ((float)a + b))*scale_sq_sq;
-    }
+    HarrisResponsesInvoker invoker(img, layerinfo, pts, blockSize, harris_k);
+    parallel_for_(Range(0, (int)((pts.size() + ORB_KEYPOINTS_CHUNK - 1) / ORB_KEYPOINTS_CHUNK)),
+                  invoker, getKeypointsStripes(pts.size()));
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static void ICAngles(const Mat& img, const std::vector<Rect>& layerinfo,
-                     std::vector<KeyPoint>& pts, const std::vector<int> & u_max, int half_k)
+class ICAnglesInvoker : public ParallelLoopBody
 {
-    int step = (int)img.step1();
-    size_t ptidx, ptsize = pts.size();
+public:
+    ICAnglesInvoker(const Mat& img, const std::vector<Rect>& layerinfo,
+                    std::vector<KeyPoint>& pts, const std::vector<int>& u_max, int half_k)
+        : img_(&img), layerinfo_(&layerinfo), pts_(&pts), u_max_(&u_max), half_k_(half_k)
+    {}
 
-    for( ptidx = 0; ptidx < ptsize; ptidx++ )
+    void operator()(const Range& range) const
     {
-        const Rect& layer = layerinfo[pts[ptidx].octave];
-        const uchar* center = &img.at<uchar>(cvRound(pts[ptidx].pt.y) + layer.y, cvRound(pts[ptidx].pt.x) + layer.x);
+        const Mat& img = *img_;
+        const std::vector<Rect>& layerinfo = *layerinfo_;
+        std::vector<KeyPoint>& pts = *pts_;
+        const std::vector<int>& u_max = *u_max_;
+        const int half_k = half_k_;
+
+        int step = (int)img.step1();
+        size_t ptidx, ptsize = pts.size();
+        size_t ptstart = range.start*(size_t)ORB_KEYPOINTS_CHUNK;
+        size_t ptend = std::min(range.end*(size_t)ORB_KEYPOINTS_CHUNK, ptsize);
+
+        for( ptidx = ptstart; ptidx < ptend; ptidx++ )
+        {
+            const Rect& layer = layerinfo[pts[ptidx].octave];
+            const uchar* center = &img.at<uchar>(cvRound(pts[ptidx].pt.y) + layer.y, cvRound(pts[ptidx].pt.x) + layer.x);
 
-        int m_01 = 0, m_10 = 0;
+            int m_01 = 0, m_10 = 0;
 
-        // Treat the center line differently, v=0
-        for (int u = -half_k; u <= half_k; ++u)
-            m_10 += u * center[u];
+            // Treat the center line differently, v=0
+            for (int u = -half_k; u <= half_k; ++u)
+                m_10 += u * center[u];
 
-        // Go line by line in the circular patch
-        for (int v = 1; v <= half_k; ++v)
-        {
-            // Proceed over the two lines
-            int v_sum = 0;
-            int d = u_max[v];
-            for (int u = -d; u <= d; ++u)
+            // Go line by line in the circular patch
+            for (int v = 1; v <= half_k; ++v)
             {
-                int val_plus = center[u + v*step], val_minus = center[u - v*step];
-                v_sum += (val_plus - val_minus);
-                m_10 += u * (val_plus + val_minus);
+                // Proceed over the two lines
+                int v_sum = 0;
+                int d = u_max[v];
+                for (int u = -d; u <= d; ++u)
+                {
+                    int val_plus = center[u + v*step], val_minus = center[u - v*step];
+                    v_sum += (val_plus - val_minus);
+                    m_10 += u * (val_plus + val_minus);
+                }
+                m_01 += v * v_sum;
             }
-            m_01 += v * v_sum;
-        }
 
-        pts[ptidx].angle = fastAtan2((float)m_01, (float)m_10);
+            pts[ptidx].angle = fastAtan2((float)m_01, (float)m_10);
+        }
     }
+
+private:
+    const Mat* img_;
+    const std::vector<Rect>* layerinfo_;
+    std::vector<KeyPoint>* pts_;
+    const std::vector<int>* u_max_;
+    int half_k_;
+};
+
+static void ICAngles(const Mat& img, const std::vector<Rect>& layerinfo,
+                     std::vector<KeyPoint>& pts, const std::vector<int> & u_max, int half_k)
+{
+    ICAnglesInvoker invoker(img, layerinfo, pts, u_max, half_k);
+    parallel_for_(Range(0, (int)((pts.size() + ORB_KEYPOINTS_CHUNK - 1) / ORB_KEYPOINTS_CHUNK)),
+                  invoker, getKeypointsStripes(pts.size()));
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static void
-computeOrbDescriptors( const Mat& imagePyramid, const std::vector<Rect>& layerInfo,
-                       const std::vector<float>& layerScale, std::vector<KeyPoint>& keypoints,
-                       Mat& descriptors, const std::vector<Point>& _pattern, int dsize, int wta_k )
+class OrbDescriptorsInvoker : public ParallelLoopBody
 {
-    int step = (int)imagePyramid.step;
-    int j, i, nkeypoints = (int)keypoints.size();
-
-    for( j = 0; j < nkeypoints; j++ )
+public:
+    OrbDescriptorsInvoker(const Mat& imagePyramid, const std::vector<Rect>& layerInfo,
+                          const std::vector<float>& layerScale, const std::vector<KeyPoint>& keypoints,
+                          Mat& descriptors, const std::vector<Point>& _pattern, int dsize, int wta_k)
+        : imagePyramid_(&imagePyramid), layerInfo_(&layerInfo), layerScale_(&layerScale),
+          keypoints_(&keypoints), descriptors_(&descriptors), dsize_(dsize), wta_k_(wta_k)
     {
-        const KeyPoint& kpt = keypoints[j];
-        const Rect& layer = layerInfo[kpt.octave];
-        float scale = 1.f/layerScale[kpt.octave];
-        float angle = kpt.angle;
-
-        angle *= (float)(CV_PI/180.f);
-        float a = (float)cos(angle), b = (float)sin(angle);
-
-        const uchar* center = &imagePyramid.at<uchar>(cvRound(kpt.pt.y*scale) + layer.y,
-                                                      cvRound(kpt.pt.x*scale) + layer.x);
-        float x, y;
-        int ix, iy;
-        const Point* pattern = &_pattern[0];
-        uchar* desc = descriptors.ptr<uchar>(j);
-
-    #if 1
-        #define GET_VALUE(idx) \
-               (x = pattern[idx].x*a - pattern[idx].y*b, \
-                y = pattern[idx].x*b + pattern[idx].y*a, \
-                ix = cvRound(x), \
-                iy = cvRound(y), \
-                *(center + iy*step + ix) )
-    #else
-        #define GET_VALUE(idx) \
-            (x = pattern[idx].x*a - pattern[idx].y*b, \
-            y = pattern[idx].x*b + pattern[idx].y*a, \
-            ix = cvFloor(x), iy = cvFloor(y), \
-            x -= ix, y -= iy, \
-            cvRound(center[iy*step + ix]*(1-x)*(1-y) + center[(iy+1)*step + ix]*(1-x)*y + \
-                    center[iy*step + ix+1]*x*(1-y) + center[(iy+1)*step + ix+1]*x*y))
-    #endif
+        // The pattern is rotated for every keypoint so keep it in the form ready for vector loads.
+        npoints_ = dsize*(wta_k == 3 ? 12 : 16);
+        CV_Assert( (int)_pattern.size() >= npoints_ );
+        int n = alignSize(npoints_, 4);
+        patternX_.resize(n, 0.f);
+        patternY_.resize(n, 0.f);
+        for( int i = 0; i < npoints_; i++ )
+        {
+            patternX_[i] = (float)_pattern[i].x;
+            patternY_[i] = (float)_pattern[i].y;
+        }
+    }
 
-        if( wta_k == 2 )
+    void operator()(const Range& range) const
+    {
+        const Mat& imagePyramid = *imagePyramid_;
+        const std::vector<Rect>& layerInfo = *layerInfo_;
+        const std::vector<float>& layerScale = *layerScale_;
+        const std::vector<KeyPoint>& keypoints = *keypoints_;
+        Mat& descriptors = *descriptors_;
+        const int dsize = dsize_, wta_k = wta_k_;
+
+        int step = (int)imagePyramid.step;
+        int j, i, p;
+        int nkeypoints = (int)keypoints.size();
+        int jstart = range.start*ORB_KEYPOINTS_CHUNK;
+        int jend = std::min(range.end*ORB_KEYPOINTS_CHUNK, nkeypoints);
+
+        const int npoints = (int)patternX_.size();
+        const float* patternX = &patternX_[0];
+        const float* patternY = &patternY_[0];
+        AutoBuffer<int> ofsbuf(npoints);
+        int* ofs0 = ofsbuf;
+
+        for( j = jstart; j < jend; j++ )
         {
-            for (i = 0; i < dsize; ++i, pattern += 16)
+            const KeyPoint& kpt = keypoints[j];
+            const Rect& layer = layerInfo[kpt.octave];
+            float scale = 1.f/layerScale[kpt.octave];
+            float angle = kpt.angle;
+
+            angle *= (float)(CV_PI/180.f);
+            float a = (float)cos(angle), b = (float)sin(angle);
+
+            const uchar* center = &imagePyramid.at<uchar>(cvRound(kpt.pt.y*scale) + layer.y,
+                                                          cvRound(kpt.pt.x*scale) + layer.x);
+            uchar* desc = descriptors.ptr<uchar>(j);
+
+            // Offsets of all the rotated sampling points relative to the center.
+            p = 0;
+#if CV_SIMD128
+            if( hasSIMD128() )
             {
-                int t0, t1, val;
-                t0 = GET_VALUE(0); t1 = GET_VALUE(1);
-                val = t0 < t1;
-                t0 = GET_VALUE(2); t1 = GET_VALUE(3);
-                val |= (t0 < t1) << 1;
-                t0 = GET_VALUE(4); t1 = GET_VALUE(5);
-                val |= (t0 < t1) << 2;
-                t0 = GET_VALUE(6); t1 = GET_VALUE(7);
-                val |= (t0 < t1) << 3;
-                t0 = GET_VALUE(8); t1 = GET_VALUE(9);
-                val |= (t0 < t1) << 4;
-                t0 = GET_VALUE(10); t1 = GET_VALUE(11);
-                val |= (t0 < t1) << 5;
-                t0 = GET_VALUE(12); t1 = GET_VALUE(13);
-                val |= (t0 < t1) << 6;
-                t0 = GET_VALUE(14); t1 = GET_VALUE(15);
-                val |= (t0 < t1) << 7;
-
-                desc[i] = (uchar)val;
+                v_float32x4 va = v_setall_f32(a), vb = v_setall_f32(b);
+                v_int32x4 vstep = v_setall_s32(step);
+                for( ; p <= npoints - 4; p += 4 )
+                {
+                    v_float32x4 px = v_load(patternX + p), py = v_load(patternY + p);
+                    v_int32x4 ix = v_round(px*va - py*vb);
+                    v_int32x4 iy = v_round(px*vb + py*va);
+                    v_store(ofs0 + p, iy*vstep + ix);
+                }
             }
-        }
-        else if( wta_k == 3 )
-        {
-            for (i = 0; i < dsize; ++i, pattern += 12)
+#endif
+            for( ; p < npoints; p++ )
             {
-                int t0, t1, t2, val;
-                t0 = GET_VALUE(0); t1 = GET_VALUE(1); t2 = GET_VALUE(2);
-                val = t2 > t1 ? (t2 > t0 ? 2 : 0) : (t1 > t0);
+                float x = patternX[p]*a - patternY[p]*b;
+                float y = patternX[p]*b + patternY[p]*a;
+                ofs0[p] = cvRound(y)*step + cvRound(x);
+            }
 
-                t0 = GET_VALUE(3); t1 = GET_VALUE(4); t2 = GET_VALUE(5);
-                val |= (t2 > t1 ? (t2 > t0 ? 2 : 0) : (t1 > t0)) << 2;
+            const int* ofs = ofs0;
+            #define GET_VALUE(idx) center[ofs[idx]]
+
+            if( wta_k == 2 )
+            {
+                for (i = 0; i < dsize; ++i, ofs += 16)
+                {
+                    int t0, t1, val;
+                    t0 = GET_VALUE(0); t1 = GET_VALUE(1);
+                    val = t0 < t1;
+                    t0 = GET_VALUE(2); t1 = GET_VALUE(3);
+                    val |= (t0 < t1) << 1;
+                    t0 = GET_VALUE(4); t1 = GET_VALUE(5);
+                    val |= (t0 < t1) << 2;
+                    t0 = GET_VALUE(6); t1 = GET_VALUE(7);
+                    val |= (t0 < t1) << 3;
+                    t0 = GET_VALUE(8); t1 = GET_VALUE(9);
+                    val |= (t0 < t1) << 4;
+                    t0 = GET_VALUE(10); t1 = GET_VALUE(11);
+                    val |= (t0 < t1) << 5;
+                    t0 = GET_VALUE(12); t1 = GET_VALUE(13);
+                    val |= (t0 < t1) << 6;
+                    t0 = GET_VALUE(14); t1 = GET_VALUE(15);
+                    val |= (t0 < t1) << 7;
+
+                    desc[i] = (uchar)val;
+                }
+            }
+            else if( wta_k == 3 )
+            {
+                for (i = 0; i < dsize; ++i, ofs += 12)
+                {
+                    int t0, t1, t2, val;
+                    t0 = GET_VALUE(0); t1 = GET_VALUE(1); t2 = GET_VALUE(2);
+                    val = t2 > t1 ? (t2 > t0 ? 2 : 0) : (t1 > t0);
 
-                t0 = GET_VALUE(6); t1 = GET_VALUE(7); t2 = GET_VALUE(8);
-                val |= (t2 > t1 ? (t2 > t0 ? 2 : 0) : (t1 > t0)) << 4;
+                    t0 = GET_VALUE(3); t1 = GET_VALUE(4); t2 = GET_VALUE(5);
+                    val |= (t2 > t1 ? (t2 > t0 ? 2 : 0) : (t1 > t0)) << 2;
 
-                t0 = GET_VALUE(9); t1 = GET_VALUE(10); t2 = GET_VALUE(11);
-                val |= (t2 > t1 ? (t2 > t0 ? 2 : 0) : (t1 > t0)) << 6;
+                    t0 = GET_VALUE(6); t1 = GET_VALUE(7); t2 = GET_VALUE(8);
+                    val |= (t2 > t1 ? (t2 > t0 ? 2 : 0) : (t1 > t0)) << 4;
 
-                desc[i] = (uchar)val;
+                    t0 = GET_VALUE(9); t1 = GET_VALUE(10); t2 = GET_VALUE(11);
+                    val |= (t2 > t1 ? (t2 > t0 ? 2 : 0) : (t1 > t0)) << 6;
+
+                    desc[i] = (uchar)val;
+                }
             }
-        }
-        else if( wta_k == 4 )
-        {
-            for (i = 0; i < dsize; ++i, pattern += 16)
+            else if( wta_k == 4 )
             {
-                int t0, t1, t2, t3, u, v, k, val;
-                t0 = GET_VALUE(0); t1 = GET_VALUE(1);
-                t2 = GET_VALUE(2); t3 = GET_VALUE(3);
-                u = 0, v = 2;
-                if( t1 > t0 ) t0 = t1, u = 1;
-                if( t3 > t2 ) t2 = t3, v = 3;
-                k = t0 > t2 ? u : v;
-                val = k;
-
-                t0 = GET_VALUE(4); t1 = GET_VALUE(5);
-                t2 = GET_VALUE(6); t3 = GET_VALUE(7);
-                u = 0, v = 2;
-                if( t1 > t0 ) t0 = t1, u = 1;
-                if( t3 > t2 ) t2 = t3, v = 3;
-                k = t0 > t2 ? u : v;
-                val |= k << 2;
-
-                t0 = GET_VALUE(8); t1 = GET_VALUE(9);
-                t2 = GET_VALUE(10); t3 = GET_VALUE(11);
-                u = 0, v = 2;
-                if( t1 > t0 ) t0 = t1, u = 1;
-                if( t3 > t2 ) t2 = t3, v = 3;
-                k = t0 > t2 ? u : v;
-                val |= k << 4;
-
-                t0 = GET_VALUE(12); t1 = GET_VALUE(13);
-                t2 = GET_VALUE(14); t3 = GET_VALUE(15);
-                u = 0, v = 2;
-                if( t1 > t0 ) t0 = t1, u = 1;
-                if( t3 > t2 ) t2 = t3, v = 3;
-                k = t0 > t2 ? u : v;
-                val |= k << 6;
-
-                desc[i] = (uchar)val;
+                for (i = 0; i < dsize; ++i, ofs += 16)
+                {
+                    int t0, t1, t2, t3, u, v, k, val;
+                    t0 = GET_VALUE(0); t1 = GET_VALUE(1);
+                    t2 = GET_VALUE(2); t3 = GET_VALUE(3);
+                    u = 0, v = 2;
+                    if( t1 > t0 ) t0 = t1, u = 1;
+                    if( t3 > t2 ) t2 = t3, v = 3;
+                    k = t0 > t2 ? u : v;
+                    val = k;
+
+                    t0 = GET_VALUE(4); t1 = GET_VALUE(5);
+                    t2 = GET_VALUE(6); t3 = GET_VALUE(7);
+                    u = 0, v = 2;
+                    if( t1 > t0 ) t0 = t1, u = 1;
+                    if( t3 > t2 ) t2 = t3, v = 3;
+                    k = t0 > t2 ? u : v;
+                    val |= k << 2;
+
+                    t0 = GET_VALUE(8); t1 = GET_VALUE(9);
+                    t2 = GET_VALUE(10); t3 = GET_VALUE(11);
+                    u = 0, v = 2;
+                    if( t1 > t0 ) t0 = t1, u = 1;
+                    if( t3 > t2 ) t2 = t3, v = 3;
+                    k = t0 > t2 ? u : v;
+                    val |= k << 4;
+
+                    t0 = GET_VALUE(12); t1 = GET_VALUE(13);
+                    t2 = GET_VALUE(14); t3 = GET_VALUE(15);
+                    u = 0, v = 2;
+                    if( t1 > t0 ) t0 = t1, u = 1;
+                    if( t3 > t2 ) t2 = t3, v = 3;
+                    k = t0 > t2 ? u : v;
+                    val |= k << 6;
+
+                    desc[i] = (uchar)val;
+                }
             }
+            #undef GET_VALUE
         }
-        else
-            CV_Error( Error::StsBadSize, "Wrong wta_k. It can be only 2, 3 or 4." );
-        #undef GET_VALUE
     }
+
+private:
+    const Mat* imagePyramid_;
+    const std::vector<Rect>* layerInfo_;
+    const std::vector<float>* layerScale_;
+    const std::vector<KeyPoint>* keypoints_;
+    Mat* descriptors_;
+    int dsize_, wta_k_, npoints_;
+    std::vector<float> patternX_, patternY_;
+};
+
+static void
+computeOrbDescriptors( const Mat& imagePyramid, const std::vector<Rect>& layerInfo,
+                       const std::vector<float>& layerScale, std::vector<KeyPoint>& keypoints,
+                       Mat& descriptors, const std::vector<Point>& _pattern, int dsize, int wta_k )
+{
+    if( wta_k != 2 && wta_k != 3 && wta_k != 4 )
+        CV_Error( Error::StsBadSize, "Wrong wta_k. It can be only 2, 3 or 4." );
+
+    OrbDescriptorsInvoker invoker(imagePyramid, layerInfo, layerScale, keypoints,
+                                  descriptors, _pattern, dsize, wta_k);
+    parallel_for_(Range(0, (int)((keypoints.size() + ORB_KEYPOINTS_CHUNK - 1) / ORB_KEYPOINTS_CHUNK)),
+                  invoker, getKeypointsStripes(keypoints.size()));
 }
 
 
@@ -767,6 +943,76 @@ static void uploadORBKeypoints(const std::vector<KeyPoint>& src,
  * @param mask_pyramid the masks to apply at every level
  * @param keypoints the resulting keypoints, clustered per level
  */
+class OrbFastLevelsInvoker : public ParallelLoopBody
+{
+public:
+    OrbFastLevelsInvoker(const Mat& imagePyramid, const Mat& maskPyramid,
+                         const std::vector<Rect>& layerInfo, const std::vector<float>& layerScale,
+                         const std::vector<int>& nfeaturesPerLevel, std::vector<std::vector<KeyPoint> >& levelKeypoints,
+                         int edgeThreshold, int patchSize, int scoreType, int fastThreshold)
+        : imagePyramid_(&imagePyramid), maskPyramid_(&maskPyramid), layerInfo_(&layerInfo),
+          layerScale_(&layerScale), nfeaturesPerLevel_(&nfeaturesPerLevel), levelKeypoints_(&levelKeypoints),
+          edgeThreshold_(edgeThreshold), patchSize_(patchSize), scoreType_(scoreType), fastThreshold_(fastThreshold)
+    {}
+
+    void operator()(const Range& range) const
+    {
+        for( int level = range.start; level < range.end; level++ )
+        {
+            int featuresNum = (*nfeaturesPerLevel_)[level];
+            Mat img = (*imagePyramid_)((*layerInfo_)[level]);
+            Mat mask = maskPyramid_->empty() ? Mat() : (*maskPyramid_)((*layerInfo_)[level]);
+            std::vector<KeyPoint>& keypoints = (*levelKeypoints_)[level];
+
+            // Detect FAST features, 20 is a good threshold
+            {
+            Ptr<FastFeatureDetector> fd = FastFeatureDetector::create(fastThreshold_, true);
+            fd->detect(img, keypoints, mask);
+            }
+
+            // Remove keypoints very close to the border
+            KeyPointsFilter::runByImageBorder(keypoints, img.size(), edgeThreshold_);
+
+            // Keep more points than necessary as FAST does not give amazing corners
+            KeyPointsFilter::retainBest(keypoints, scoreType_ == ORB_Impl::HARRIS_SCORE ? 2 * featuresNum : featuresNum);
+
+            float sf = (*layerScale_)[level];
+            for( size_t i = 0; i < keypoints.size(); i++ )
+            {
+                keypoints[i].octave = level;
+                keypoints[i].size = patchSize_*sf;
+            }
+        }
+    }
+
+private:
+    const Mat* imagePyramid_;
+    const Mat* maskPyramid_;
+    const std::vector<Rect>* layerInfo_;
+    const std::vector<float>* layerScale_;
+    const std::vector<int>* nfeaturesPerLevel_;
+    std::vector<std::vector<KeyPoint> >* levelKeypoints_;
+    int edgeThreshold_, patchSize_, scoreType_, fastThreshold_;
+};
+
+class OrbRetainBestInvoker : public ParallelLoopBody
+{
+public:
+    OrbRetainBestInvoker(std::vector<std::vector<KeyPoint> >& levelKeypoints, const std::vector<int>& nfeaturesPerLevel)
+        : levelKeypoints_(&levelKeypoints), nfeaturesPerLevel_(&nfeaturesPerLevel)
+    {}
+
+    void operator()(const Range& range) const
+    {
+        for( int level = range.start; level < range.end; level++ )
+            KeyPointsFilter::retainBest((*levelKeypoints_)[level], (*nfeaturesPerLevel_)[level]);
+    }
+
+private:
+    std::vector<std::vector<KeyPoint> >* levelKeypoints_;
+    const std::vector<int>* nfeaturesPerLevel_;
+};
+
 static void computeKeyPoints(const Mat& imagePyramid,
                              const UMat& uimagePyramid,
                              const Mat& maskPyramid,
@@ -819,40 +1065,18 @@ static void computeKeyPoints(const Mat& imagePyramid,
         ++v0;
     }
 
+    // Levels are independent, detect them in parallel and merge in the level order
+    std::vector<std::vector<KeyPoint> > levelKeypoints(nlevels);
+    parallel_for_(Range(0, nlevels),
+                  OrbFastLevelsInvoker(imagePyramid, maskPyramid, layerInfo, layerScale, nfeaturesPerLevel,
+                                       levelKeypoints, edgeThreshold, patchSize, scoreType, fastThreshold));
+
     allKeypoints.clear();
-    std::vector<KeyPoint> keypoints;
     std::vector<int> counters(nlevels);
-    keypoints.reserve(nfeaturesPerLevel[0]*2);
-
     for( level = 0; level < nlevels; level++ )
     {
-        int featuresNum = nfeaturesPerLevel[level];
-        Mat img = imagePyramid(layerInfo[level]);
-        Mat mask = maskPyramid.empty() ? Mat() : maskPyramid(layerInfo[level]);
-
-        // Detect FAST features, 20 is a good threshold
-        {
-        Ptr<FastFeatureDetector> fd = FastFeatureDetector::create(fastThreshold, true);
-        fd->detect(img, keypoints, mask);
-        }
-
-        // Remove keypoints very close to the border
-        KeyPointsFilter::runByImageBorder(keypoints, img.size(), edgeThreshold);
-
-        // Keep more points than necessary as FAST does not give amazing corners
-        KeyPointsFilter::retainBest(keypoints, scoreType == ORB_Impl::HARRIS_SCORE ? 2 * featuresNum : featuresNum);
-
-        nkeypoints = (int)keypoints.size();
-        counters[level] = nkeypoints;
-
-        float sf = layerScale[level];
-        for( i = 0; i < nkeypoints; i++ )
-        {
-            keypoints[i].octave = level;
-            keypoints[i].size = patchSize*sf;
-        }
-
-        std::copy(keypoints.begin(), keypoints.end(), std::back_inserter(allKeypoints));
+        counters[level] = (int)levelKeypoints[level].size();
+        std::copy(levelKeypoints[level].begin(), levelKeypoints[level].end(), std::back_inserter(allKeypoints));
     }
 
     std::vector<Vec3i> ukeypoints_buf;
@@ -893,19 +1117,17 @@ static void computeKeyPoints(const Mat& imagePyramid,
         int offset = 0;
         for( level = 0; level < nlevels; level++ )
         {
-            int featuresNum = nfeaturesPerLevel[level];
             nkeypoints = counters[level];
-            keypoints.resize(nkeypoints);
-            std::copy(allKeypoints.begin() + offset,
-                      allKeypoints.begin() + offset + nkeypoints,
-                      keypoints.begin());
+            levelKeypoints[level].assign(allKeypoints.begin() + offset,
+                                         allKeypoints.begin() + offset + nkeypoints);
             offset += nkeypoints;
+        }
 
-            //cull to the final desired level, using the new Harris scores.
-            KeyPointsFilter::retainBest(keypoints, featuresNum);
+        //cull to the final desired level, using the new Harris scores.
+        parallel_for_(Range(0, nlevels), OrbRetainBestInvoker(levelKeypoints, nfeaturesPerLevel));
 
-            std::copy(keypoints.begin(), keypoints.end(), std::back_inserter(newAllKeypoints));
-        }
+        for( level = 0; level < nlevels; level++ )
+            std::copy(levelKeypoints[level].begin(), levelKeypoints[level].end(), std::back_inserter(newAllKeypoints));
         std::swap(allKeypoints, newAllKeypoints);
     }
 
@@ -945,6 +1167,29 @@ static void computeKeyPoints(const Mat& imagePyramid,
 }
 
 
+class OrbBlurLevelsInvoker : public ParallelLoopBody
+{
+public:
+    OrbBlurLevelsInvoker(Mat& imagePyramid, const std::vector<Rect>& layerInfo)
+        : imagePyramid_(&imagePyramid), layerInfo_(&layerInfo)
+    {}
+
+    void operator()(const Range& range) const
+    {
+        for( int level = range.start; level < range.end; level++ )
+        {
+            Mat workingMat = (*imagePyramid_)((*layerInfo_)[level]);
+
+            //boxFilter(working_mat, working_mat, working_mat.depth(), Size(5,5), Point(-1,-1), true, BORDER_REFLECT_101);
+            GaussianBlur(workingMat, workingMat, Size(7, 7), 2, 2, BORDER_REFLECT_101);
+        }
+    }
+
+private:
+    Mat* imagePyramid_;
+    const std::vector<Rect>* layerInfo_;
+};
+
 /** Compute the ORB_Impl features and descriptors on an image
  * @param img the image to compute the features and descriptors on
  * @param mask the mask to apply
@@ -1153,14 +1398,8 @@ void ORB_Impl::detectAndCompute( InputArray _image, InputArray _mask,
             initializeOrbPattern(pattern0, pattern, ntuples, wta_k, npoints);
         }
 
-        for( level = 0; level < nLevels; level++ )
-        {
-            // preprocess the resized image
-            Mat workingMat = imagePyramid(layerInfo[level]);
-
-            //boxFilter(working_mat, working_mat, working_mat.depth(), Size(5,5), Point(-1,-1), true, BORDER_REFLECT_101);
-            GaussianBlur(workingMat, workingMat, Size(7, 7), 2, 2, BORDER_REFLECT_101);
-        }
+        // preprocess the resized images, the levels are separated by borders so they can be blurred in parallel
+        parallel_for_(Range(0, nLevels), OrbBlurLevelsInvoker(imagePyramid, layerInfo));
 
 #ifdef HAVE_OPENCL
         if( useOCL )
@@ -45,3 +45,31 @@ TEST(Features2d_AKAZE, uninitialized_and_nans)
     Ptr<Feature2D> akaze = AKAZE::create();
     akaze->detectAndCompute(b1, noArray(), keypoints, desc);
 }
+
+TEST(Features2d_AKAZE, threads_and_odd_sizes)
+{
+    // the scale space is evolved in bands of rows, the result must not depend on the splitting
+    Mat testImg(317, 203, CV_8U, Scalar(128));
+    RNG rng(1234);
+    for (int i = 0; i < 100; i++)
+        circle(testImg, Point(rng.uniform(0, testImg.cols), rng.uniform(0, testImg.rows)),
+               rng.uniform(2, 20), Scalar(rng.uniform(0, 256)), FILLED);
+
+    const int diffusivities[] = { KAZE::DIFF_PM_G1, KAZE::DIFF_PM_G2, KAZE::DIFF_WEICKERT, KAZE::DIFF_CHARBONNIER };
+    for (size_t d = 0; d < sizeof(diffusivities) / sizeof(diffusivities[0]); d++)
+    {
+        Ptr<Feature2D> akaze = AKAZE::create(AKAZE::DESCRIPTOR_MLDB, 0, 3, 0.001f, 4, 4, diffusivities[d]);
+        vector<KeyPoint> keypoints, keypoints1;
+        akaze->detect(testImg, keypoints);
+        ASSERT_FALSE(keypoints.empty());
+
+        int nthreads = getNumThreads();
+        setNumThreads(1);
+        akaze->detect(testImg, keypoints1);
+        setNumThreads(nthreads);
+
+        ASSERT_EQ(keypoints.size(), keypoints1.size());
+        for (size_t i = 0; i < keypoints.size(); i++)
+            ASSERT_EQ(keypoints[i].hash(), keypoints1[i].hash());
+    }
+}
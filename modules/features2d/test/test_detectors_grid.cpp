@@ -0,0 +1,174 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+using namespace cv;
+
+static Mat makeTexturedImage(int contrast)
+{
+    RNG& rng = theRNG();
+    Mat img(240, 320, CV_8U, Scalar(128));
+    for (int i = 0; i < 300; i++)
+    {
+        Point center(rng.uniform(0, img.cols), rng.uniform(0, img.rows));
+        Point triangle[3];
+        for (int k = 0; k < 3; k++)
+            triangle[k] = center + Point(rng.uniform(-15, 15), rng.uniform(-15, 15));
+        fillConvexPoly(img, triangle, 3, Scalar(128 + rng.uniform(-contrast, contrast)));
+    }
+    // the small blobs are corners for all the circle sizes
+    for (int i = 0; i < 500; i++)
+    {
+        Point p(rng.uniform(0, img.cols - 1), rng.uniform(0, img.rows - 1));
+        img(Rect(p, Size(rng.uniform(1, 3), rng.uniform(1, 3))) & Rect(0, 0, img.cols, img.rows)) =
+            Scalar(128 + rng.uniform(-contrast, contrast));
+    }
+    return img;
+}
+
+struct PositionLess
+{
+    bool operator()(const KeyPoint& a, const KeyPoint& b) const
+    {
+        return a.pt.y < b.pt.y || (a.pt.y == b.pt.y && a.pt.x < b.pt.x);
+    }
+};
+
+static std::vector<KeyPoint> sortedByPosition(std::vector<KeyPoint> keypoints)
+{
+    std::sort(keypoints.begin(), keypoints.end(), PositionLess());
+    return keypoints;
+}
+
+static void expectSameKeypoints(const std::vector<KeyPoint>& expected, const std::vector<KeyPoint>& actual)
+{
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        EXPECT_EQ(expected[i].pt, actual[i].pt) << i;
+        EXPECT_EQ(expected[i].response, actual[i].response) << i;
+    }
+}
+
+// detector type: FAST types and AGAST types + 100
+typedef testing::TestWithParam<int> Features2d_GridDetection;
+
+static Ptr<Feature2D> createDetector(int type, int threshold, bool nonmaxSuppression = true)
+{
+    if (type >= 100)
+        return AgastFeatureDetector::create(threshold, nonmaxSuppression, type - 100);
+    return FastFeatureDetector::create(threshold, nonmaxSuppression, type);
+}
+
+static Ptr<Feature2D> createGridDetector(int type, int threshold, Size gridSize, int maxPerCell, int minThreshold,
+                                         bool nonmaxSuppression = true)
+{
+    if (type >= 100)
+        return AgastFeatureDetector::create(threshold, nonmaxSuppression, type - 100, gridSize, maxPerCell, minThreshold);
+    return FastFeatureDetector::create(threshold, nonmaxSuppression, type, gridSize, maxPerCell, minThreshold);
+}
+
+TEST_P(Features2d_GridDetection, sameAsWholeImage)
+{
+    const int threshold = 20;
+    Mat img = makeTexturedImage(60);
+    // the non-maximum suppression of AGAST is not local, it is checked by the other tests
+    Ptr<Feature2D> detector = createDetector(GetParam(), threshold, GetParam() < 100);
+    std::vector<KeyPoint> expected;
+    detector->detect(img, expected);
+    ASSERT_GT(expected.size(), 50u);
+
+    // the cells don't limit the number of keypoints, the borders of the cells don't change them
+    detector = createGridDetector(GetParam(), threshold, Size(7, 5), (int)img.total(), threshold, GetParam() < 100);
+    std::vector<KeyPoint> keypoints;
+    detector->detect(img, keypoints);
+    expectSameKeypoints(sortedByPosition(expected), sortedByPosition(keypoints));
+}
+
+TEST_P(Features2d_GridDetection, strongestPerCell)
+{
+    const int threshold = 20, maxPerCell = 8;
+    const Size gridSize(4, 3);
+    Mat img = makeTexturedImage(60);
+    Ptr<Feature2D> detector = createDetector(GetParam(), threshold);
+    std::vector<KeyPoint> all;
+    detector->detect(img, all);
+
+    detector = createGridDetector(GetParam(), threshold, gridSize, maxPerCell, threshold);
+    std::vector<KeyPoint> keypoints;
+    detector->detect(img, keypoints);
+
+    size_t next = 0;
+    for (int gy = 0; gy < gridSize.height; gy++)
+    {
+        for (int gx = 0; gx < gridSize.width; gx++)
+        {
+            Rect cell(gx * img.cols / gridSize.width, gy * img.rows / gridSize.height, 0, 0);
+            cell.width = (gx + 1) * img.cols / gridSize.width - cell.x;
+            cell.height = (gy + 1) * img.rows / gridSize.height - cell.y;
+            std::vector<float> responses;
+            for (size_t i = 0; i < all.size(); i++)
+            {
+                if (cell.contains(Point(all[i].pt)))
+                    responses.push_back(all[i].response);
+            }
+            std::sort(responses.rbegin(), responses.rend());
+            size_t count = std::min(responses.size(), (size_t)maxPerCell);
+            ASSERT_LE(next + count, keypoints.size());
+            for (size_t k = 0; k < count; k++, next++)
+            {
+                EXPECT_TRUE(cell.contains(Point(keypoints[next].pt)));
+                EXPECT_EQ(responses[k], keypoints[next].response);
+            }
+        }
+    }
+    EXPECT_EQ(next, keypoints.size());
+}
+
+TEST_P(Features2d_GridDetection, adaptiveThreshold)
+{
+    // the left half has only weak corners
+    Mat img = makeTexturedImage(60);
+    Mat left = img.colRange(0, img.cols / 2);
+    left = (left - 128) / 8 + 128;
+
+    Ptr<Feature2D> detector = createGridDetector(GetParam(), 30, Size(2, 1), 20, 30);
+    std::vector<KeyPoint> keypoints;
+    detector->detect(img, keypoints);
+    int leftCount = 0;
+    for (size_t i = 0; i < keypoints.size(); i++)
+        leftCount += keypoints[i].pt.x < img.cols / 2;
+    EXPECT_EQ(0, leftCount);
+
+    detector = createGridDetector(GetParam(), 30, Size(2, 1), 20, 3);
+    detector->detect(img, keypoints);
+    leftCount = 0;
+    for (size_t i = 0; i < keypoints.size(); i++)
+        leftCount += keypoints[i].pt.x < img.cols / 2;
+    EXPECT_EQ(20, leftCount);
+    EXPECT_EQ(40u, keypoints.size());
+}
+
+TEST_P(Features2d_GridDetection, mask)
+{
+    Mat img = makeTexturedImage(60);
+    Mat mask = Mat::zeros(img.size(), CV_8U);
+    mask(Rect(40, 30, 200, 150)).setTo(255);
+
+    Ptr<Feature2D> detector = createGridDetector(GetParam(), 20, Size(4, 4), 5, 20);
+    std::vector<KeyPoint> keypoints;
+    detector->detect(img, keypoints, mask);
+    ASSERT_FALSE(keypoints.empty());
+    for (size_t i = 0; i < keypoints.size(); i++)
+        EXPECT_NE(0, mask.at<uchar>(Point(keypoints[i].pt)));
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, Features2d_GridDetection, testing::Values(
+    (int)FastFeatureDetector::TYPE_5_8, (int)FastFeatureDetector::TYPE_7_12, (int)FastFeatureDetector::TYPE_9_16,
+    100 + (int)AgastFeatureDetector::AGAST_5_8, 100 + (int)AgastFeatureDetector::OAST_9_16));
+
+}} // namespace
@@ -554,3 +554,230 @@ TEST( Features2d_DMatch, read_write )
     String str = fs.releaseAndGetString();
     ASSERT_NE( strstr(str.c_str(), "4.5"), (char*)0 );
 }
+
+typedef testing::TestWithParam<tuple<int, int, int> > Features2d_BFMatcher_Tiled;
+
+// Tiled search must give the same neighbours as the plain batchDistance()
+TEST_P(Features2d_BFMatcher_Tiled, knnMatch)
+{
+    const int normType = get<0>(GetParam());
+    const int knn = get<1>(GetParam());
+    const int len = get<2>(GetParam());
+    const int type = normType == NORM_HAMMING || normType == NORM_HAMMING2 ? CV_8U : CV_32F;
+    const bool isFloat = type == CV_32F;
+
+    RNG& rng = theRNG();
+    Mat query(333, len, type), train0(700, len, type), train1(129, len, type);
+    rng.fill(query, RNG::UNIFORM, 0, isFloat ? 1 : 256);
+    rng.fill(train0, RNG::UNIFORM, 0, isFloat ? 1 : 256);
+    rng.fill(train1, RNG::UNIFORM, 0, isFloat ? 1 : 256);
+    Mat mask0(query.rows, train0.rows, CV_8U), mask1(query.rows, train1.rows, CV_8U);
+    rng.fill(mask0, RNG::UNIFORM, 0, 2);
+    rng.fill(mask1, RNG::UNIFORM, 0, 2);
+
+    std::vector<Mat> trains, masks;
+    trains.push_back(train0);
+    trains.push_back(train1);
+    masks.push_back(mask0);
+    masks.push_back(mask1);
+
+    Ptr<BFMatcher> matcher = BFMatcher::create(normType);
+    matcher->add(trains);
+
+    for (int useMask = 0; useMask < 2; useMask++)
+    {
+        std::vector<std::vector<DMatch> > matches;
+        matcher->knnMatch(query, matches, knn, useMask ? masks : std::vector<Mat>());
+        ASSERT_EQ((size_t)query.rows, matches.size());
+
+        const int dtype = isFloat ? CV_32F : CV_32S;
+        Mat dist0, nidx0, dist1, nidx1;
+        batchDistance(query, train0, dist0, dtype, nidx0, normType, knn, useMask ? mask0 : Mat());
+        batchDistance(query, train1, dist1, dtype, nidx1, normType, knn, useMask ? mask1 : Mat());
+        dist0.convertTo(dist0, CV_32F);
+        dist1.convertTo(dist1, CV_32F);
+
+        for (int i = 0; i < query.rows; i++)
+        {
+            // merge the results for two images, the first image wins the ties
+            std::vector<DMatch> ref;
+            for (int k = 0; k < knn; k++)
+            {
+                if (nidx0.at<int>(i, k) >= 0)
+                    ref.push_back(DMatch(i, nidx0.at<int>(i, k), 0, dist0.at<float>(i, k)));
+            }
+            for (int k = 0; k < knn; k++)
+            {
+                if (nidx1.at<int>(i, k) >= 0)
+                    ref.push_back(DMatch(i, nidx1.at<int>(i, k), 1, dist1.at<float>(i, k)));
+            }
+            std::stable_sort(ref.begin(), ref.end());
+            if ((int)ref.size() > knn)
+                ref.resize(knn);
+
+            ASSERT_EQ(ref.size(), matches[i].size()) << i;
+            for (size_t k = 0; k < ref.size(); k++)
+            {
+                EXPECT_NEAR(ref[k].distance, matches[i][k].distance, 1e-4 * std::max(1.f, ref[k].distance));
+                EXPECT_EQ(i, matches[i][k].queryIdx);
+                if (!isFloat)
+                {
+                    EXPECT_EQ(ref[k].imgIdx, matches[i][k].imgIdx);
+                    EXPECT_EQ(ref[k].trainIdx, matches[i][k].trainIdx);
+                }
+            }
+        }
+    }
+}
+
+TEST_P(Features2d_BFMatcher_Tiled, crossCheck)
+{
+    const int normType = get<0>(GetParam());
+    const int len = get<2>(GetParam());
+    const int type = normType == NORM_HAMMING || normType == NORM_HAMMING2 ? CV_8U : CV_32F;
+    const bool isFloat = type == CV_32F;
+
+    RNG& rng = theRNG();
+    Mat query(1000, len, type), train(517, len, type);
+    rng.fill(query, RNG::UNIFORM, 0, isFloat ? 1 : 256);
+    rng.fill(train, RNG::UNIFORM, 0, isFloat ? 1 : 256);
+
+    std::vector<DMatch> matches;
+    BFMatcher::create(normType, true)->match(query, train, matches);
+
+    Mat dist, nidx;
+    batchDistance(query, train, dist, isFloat ? CV_32F : CV_32S, nidx, normType, 1, noArray(), 0, true);
+    dist.convertTo(dist, CV_32F);
+
+    size_t j = 0;
+    for (int i = 0; i < query.rows; i++)
+    {
+        if (nidx.at<int>(i) < 0)
+            continue;
+        ASSERT_LT(j, matches.size());
+        EXPECT_EQ(i, matches[j].queryIdx);
+        EXPECT_EQ(nidx.at<int>(i), matches[j].trainIdx);
+        EXPECT_NEAR(dist.at<float>(i), matches[j].distance, 1e-4 * std::max(1.f, dist.at<float>(i)));
+        j++;
+    }
+    EXPECT_EQ(j, matches.size());
+}
+
+TEST_P(Features2d_BFMatcher_Tiled, ratioMatch)
+{
+    const int normType = get<0>(GetParam());
+    const int len = get<2>(GetParam());
+    const int type = normType == NORM_HAMMING || normType == NORM_HAMMING2 ? CV_8U : CV_32F;
+    const bool isFloat = type == CV_32F;
+    const float ratio = 0.9f;
+
+    RNG& rng = theRNG();
+    Mat query(300, len, type), train(800, len, type);
+    rng.fill(train, RNG::UNIFORM, 0, isFloat ? 1 : 256);
+    rng.fill(query, RNG::UNIFORM, 0, isFloat ? 1 : 256);
+    // make a half of the queries to be close to some train descriptors
+    for (int i = 0; i < query.rows; i += 2)
+    {
+        Mat row = query.row(i);
+        train.row(rng.uniform(0, train.rows)).copyTo(row);
+        if (isFloat)
+            row.at<float>(0) += 0.01f;
+        else
+            row.at<uchar>(0) ^= 1;
+    }
+
+    Ptr<BFMatcher> matcher = BFMatcher::create(normType);
+    std::vector<std::vector<DMatch> > knnMatches;
+    matcher->knnMatch(query, train, knnMatches, 2);
+    std::vector<DMatch> ref;
+    for (size_t i = 0; i < knnMatches.size(); i++)
+    {
+        if (knnMatches[i].size() == 2 && knnMatches[i][0].distance < ratio * knnMatches[i][1].distance)
+            ref.push_back(knnMatches[i][0]);
+    }
+
+    std::vector<DMatch> matches;
+    matcher->ratioMatch(query, train, matches, ratio);
+
+    EXPECT_GE(ref.size(), (size_t)query.rows / 2);
+    ASSERT_EQ(ref.size(), matches.size());
+    for (size_t i = 0; i < ref.size(); i++)
+    {
+        EXPECT_EQ(ref[i].queryIdx, matches[i].queryIdx);
+        EXPECT_EQ(ref[i].trainIdx, matches[i].trainIdx);
+        EXPECT_EQ(ref[i].distance, matches[i].distance);
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, Features2d_BFMatcher_Tiled, testing::Combine(
+    testing::Values((int)NORM_L2, (int)NORM_L2SQR, (int)NORM_L1, (int)NORM_HAMMING, (int)NORM_HAMMING2),
+    testing::Values(1, 2, 5),   // knn
+    testing::Values(32, 61)     // descriptor length
+));
+
+TEST( Features2d_FlannBasedMatcher, incrementalTrain )
+{
+    const int dims = 16;
+    RNG& rng = theRNG();
+    Mat query(40, dims, CV_32F);
+    rng.fill(query, RNG::UNIFORM, 0, 10);
+
+    Ptr<FlannBasedMatcher> incremental = makePtr<FlannBasedMatcher>(makePtr<flann::KDTreeIndexParams>(1),
+                                                                    makePtr<flann::SearchParams>(-1));
+    std::vector<Mat> images;
+    for (int i = 0; i < 6; i++)
+    {
+        Mat train(50 + 10 * i, dims, CV_32F);
+        rng.fill(train, RNG::UNIFORM, 0, 10);
+        images.push_back(train);
+        incremental->add(std::vector<Mat>(1, train));
+        incremental->train();
+
+        Ptr<FlannBasedMatcher> fresh = makePtr<FlannBasedMatcher>(makePtr<flann::KDTreeIndexParams>(1),
+                                                                  makePtr<flann::SearchParams>(-1));
+        fresh->add(images);
+        fresh->train();
+
+        std::vector<std::vector<DMatch> > ref, matches;
+        fresh->knnMatch(query, ref, 2);
+        incremental->knnMatch(query, matches, 2);
+        ASSERT_EQ(ref.size(), matches.size());
+        for (size_t q = 0; q < ref.size(); q++)
+        {
+            ASSERT_EQ(ref[q].size(), matches[q].size());
+            for (size_t k = 0; k < ref[q].size(); k++)
+            {
+                EXPECT_EQ(ref[q][k].imgIdx, matches[q][k].imgIdx);
+                EXPECT_EQ(ref[q][k].trainIdx, matches[q][k].trainIdx);
+                EXPECT_FLOAT_EQ(ref[q][k].distance, matches[q][k].distance);
+            }
+        }
+    }
+}
+
+TEST( Features2d_FlannBasedMatcher, ivfPq )
+{
+    const int dims = 32;
+    RNG& rng = theRNG();
+    Mat train(2000, dims, CV_32F);
+    rng.fill(train, RNG::UNIFORM, 0, 100);
+    Mat query = train.rowRange(0, 100).clone();
+
+    Ptr<flann::SearchParams> searchParams = makePtr<flann::SearchParams>();
+    searchParams->setInt("probes", 4);
+    FlannBasedMatcher matcher(makePtr<flann::IvfPqIndexParams>(16, 8, 8, 0), searchParams);
+    matcher.add(std::vector<Mat>(1, train));
+    matcher.train();
+
+    std::vector<std::vector<DMatch> > matches;
+    matcher.knnMatch(query, matches, 5);
+    ASSERT_EQ((size_t)query.rows, matches.size());
+    int found = 0;
+    for (size_t q = 0; q < matches.size(); q++)
+    {
+        for (size_t k = 0; k < matches[q].size(); k++)
+            found += matches[q][k].trainIdx == (int)q;
+    }
+    // the codes are lossy, but the feature itself is among the nearest candidates
+    EXPECT_GE(found, 90);
+}
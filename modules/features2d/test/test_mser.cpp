@@ -182,3 +182,50 @@ TEST(Features2d_MSER, history_update_regression)
         }
     }
 }
+
+TEST(Features2d_MSER, flat_and_stats_output)
+{
+    Mat color(240, 320, CV_8UC3, Scalar::all(100));
+    RNG rng(12345);
+    for (int i = 0; i < 60; i++)
+        circle(color, Point(rng.uniform(0, color.cols), rng.uniform(0, color.rows)), rng.uniform(3, 25),
+               Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256)), FILLED);
+    Mat gray;
+    cvtColor(color, gray, COLOR_BGR2GRAY);
+
+    for (int k = 0; k < 3; k++)
+    {
+        const Mat& img = k == 2 ? color : gray;
+        Ptr<MSER> mser = MSER::create(5, 20, 10000);
+        mser->setPass2Only(k == 1);
+
+        vector<vector<Point> > msers;
+        vector<Rect> bboxes;
+        mser->detectRegions(img, msers, bboxes);
+        ASSERT_FALSE(msers.empty());
+
+        // the buffers are reused for the next image
+        for (int iter = 0; iter < 2; iter++)
+        {
+            vector<Point> points;
+            vector<int> offsets;
+            vector<Rect> flatBboxes;
+            mser->detectRegions(img, points, offsets, flatBboxes);
+            ASSERT_EQ(msers.size() + 1, offsets.size());
+            ASSERT_EQ((size_t)offsets.back(), points.size());
+            for (size_t i = 0; i < msers.size(); i++)
+            {
+                ASSERT_EQ(bboxes[i], flatBboxes[i]);
+                ASSERT_EQ(msers[i], vector<Point>(points.begin() + offsets[i], points.begin() + offsets[i + 1]));
+            }
+
+            vector<Rect> statBboxes;
+            vector<int> areas;
+            mser->detectRegionStats(img, statBboxes, areas);
+            ASSERT_EQ(bboxes, statBboxes);
+            ASSERT_EQ(msers.size(), areas.size());
+            for (size_t i = 0; i < msers.size(); i++)
+                ASSERT_EQ((int)msers[i].size(), areas[i]);
+        }
+    }
+}
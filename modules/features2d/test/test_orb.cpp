@@ -123,3 +123,62 @@ TEST(Features2D_ORB, crash)
 
     ASSERT_NO_THROW(orb->compute(image, keypoints, descriptors));
 }
+
+typedef testing::TestWithParam<tuple<int, int, bool> > Features2D_ORB_Threads;
+
+// Parallel implementation must give exactly the same result as the single threaded one
+TEST_P(Features2D_ORB_Threads, regression)
+{
+    const int scoreType = get<0>(GetParam());
+    const int wta_k = get<1>(GetParam());
+    const bool useMask = get<2>(GetParam());
+
+    RNG rng(0x12345);
+    Mat image(480, 640, CV_8UC1);
+    rng.fill(image, RNG::UNIFORM, 0, 32);
+    for (int i = 0; i < 150; i++)
+    {
+        Point center(rng.uniform(0, image.cols), rng.uniform(0, image.rows));
+        Scalar color(rng.uniform(64, 256));
+        if (i % 2)
+            circle(image, center, rng.uniform(3, 40), color, -1);
+        else
+            rectangle(image, center, center + Point(rng.uniform(5, 60), rng.uniform(5, 60)), color, -1);
+    }
+
+    Mat mask;
+    if (useMask)
+    {
+        mask = Mat::zeros(image.size(), CV_8UC1);
+        Point poly[] = {Point(100, 20), Point(600, 50), Point(500, 400), Point(10, 450)};
+        fillConvexPoly(mask, poly, int(sizeof(poly) / sizeof(poly[0])), Scalar(255));
+    }
+
+    Ptr<ORB> orb = ORB::create(2000, 1.2f, 8, 31, 0, wta_k, scoreType);
+
+    const int numThreads = getNumThreads();
+    std::vector<KeyPoint> refKeypoints, keypoints;
+    Mat refDescriptors, descriptors;
+
+    setNumThreads(1);
+    orb->detectAndCompute(image, mask, refKeypoints, refDescriptors);
+    setNumThreads(numThreads);
+    orb->detectAndCompute(image, mask, keypoints, descriptors);
+
+    ASSERT_FALSE(refKeypoints.empty());
+    ASSERT_EQ(refKeypoints.size(), keypoints.size());
+    for (size_t i = 0; i < keypoints.size(); i++)
+    {
+        ASSERT_EQ(refKeypoints[i].pt, keypoints[i].pt) << i;
+        ASSERT_EQ(refKeypoints[i].angle, keypoints[i].angle) << i;
+        ASSERT_EQ(refKeypoints[i].response, keypoints[i].response) << i;
+        ASSERT_EQ(refKeypoints[i].octave, keypoints[i].octave) << i;
+    }
+    ASSERT_EQ(0, cvtest::norm(refDescriptors, descriptors, NORM_INF));
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, Features2D_ORB_Threads, testing::Combine(
+    testing::Values((int)ORB::HARRIS_SCORE, (int)ORB::FAST_SCORE),
+    testing::Values(2, 3, 4),
+    testing::Bool()
+));
@@ -177,6 +177,21 @@ public:
                 unsigned int multi_probe_level );
         };
         @endcode
+        - **IvfPqIndexParams** When using a parameters object of this type the index created is an
+        inverted file with product quantization (Product quantization for nearest neighbor search by
+        Herve Jegou, Matthijs Douze, Cordelia Schmid, IEEE TPAMI 2011). The features are encoded by
+        subquantizers bytes, the distances returned by the searches are approximations:
+        @code
+        struct IvfPqIndexParams : public IndexParams
+        {
+            IvfPqIndexParams(
+                int lists = 256,
+                int subquantizers = 8,
+                int bits = 8,
+                int train_size = 65536,
+                int iterations = 10 );
+        };
+        @endcode
         - **AutotunedIndexParams** When passing an object of this type the index created is
         automatically tuned to offer the best performance, by choosing the optimal index type
         (randomized kd-trees, hierarchical kmeans, linear) and parameters for the dataset provided. :
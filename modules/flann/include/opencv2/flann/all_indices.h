@@ -40,6 +40,7 @@
 #include "linear_index.h"
 #include "hierarchical_clustering_index.h"
 #include "lsh_index.h"
+#include "ivfpq_index.h"
 #include "autotuned_index.h"
 
 
@@ -79,6 +80,9 @@ struct index_creator
         case FLANN_INDEX_LSH:
             nnIndex = new LshIndex<Distance>(dataset, params, distance);
             break;
+        case FLANN_INDEX_IVF_PQ:
+            nnIndex = new IvfPqIndex<Distance>(dataset, params, distance);
+            break;
         default:
             throw FLANNException("Unknown index type");
         }
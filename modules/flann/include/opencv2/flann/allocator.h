@@ -107,6 +107,14 @@ public:
      * Destructor. Frees all the memory allocated in this pool.
      */
     ~PooledAllocator()
+    {
+        free();
+    }
+
+    /**
+     * Frees all the allocated memory, the pool can be used again after that.
+     */
+    void free()
     {
         void* prev;
 
@@ -115,6 +123,10 @@ public:
             ::free(base);
             base = prev;
         }
+        remaining = 0;
+        loc = NULL;
+        usedMemory = 0;
+        wastedMemory = 0;
     }
 
     /**
@@ -41,6 +41,7 @@
 #include "saving.h"
 
 #include "all_indices.h"
+#include "mapped_index.h"
 
 namespace cvflann
 {
@@ -120,6 +121,14 @@ public:
         }
     }
 
+    /**
+     * Wraps the index which is created already, e.g. mapped from a file. The wrapper owns the index.
+     */
+    explicit Index(NNIndex<Distance>* index)
+        : nnIndex_(index), loaded_(true), index_params_(index->getParameters())
+    {
+    }
+
     ~Index()
     {
         delete nnIndex_;
@@ -135,6 +144,25 @@ public:
         }
     }
 
+    /**
+     * \brief Incrementally adds points to the index.
+     * \param points Matrix with the points to add, the data is not copied
+     * \param rebuild_threshold The index is rebuilt when its size grows by this factor
+     */
+    void addPoints(const Matrix<ElementType>& points, float rebuild_threshold = 2)
+    {
+        nnIndex_->addPoints(points, rebuild_threshold);
+    }
+
+    /**
+     * \brief Removes a point from the index.
+     * \param id The id of the point to remove
+     */
+    void removePoint(size_t id)
+    {
+        nnIndex_->removePoint(id);
+    }
+
     void save(cv::String filename)
     {
         FILE* fout = fopen(filename.c_str(), "wb");
@@ -146,6 +174,16 @@ public:
         fclose(fout);
     }
 
+    /**
+     * \brief Saves the kd-tree or linear index with the features in the format used by MappedIndex
+     * \param stream The stream to save the index to
+     * \param distance_type The distance type stored in the header
+     */
+    void saveMapped(FILE* stream, int distance_type)
+    {
+        MappedIndex<Distance>::save(stream, *nnIndex_, distance_type);
+    }
+
     /**
      * \brief Saves the index to a stream
      * \param stream The stream to save the index to
@@ -0,0 +1,435 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#ifndef OPENCV_FLANN_IVFPQ_INDEX_H_
+#define OPENCV_FLANN_IVFPQ_INDEX_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "general.h"
+#include "nn_index.h"
+#include "dynamic_bitset.h"
+#include "random.h"
+#include "saving.h"
+
+namespace cvflann
+{
+
+struct IvfPqIndexParams : public IndexParams
+{
+    IvfPqIndexParams(int lists = 256, int subquantizers = 8, int bits = 8, int train_size = 65536, int iterations = 10)
+    {
+        (*this)["algorithm"] = FLANN_INDEX_IVF_PQ;
+        // number of the inverted lists, i.e. clusters of the coarse quantizer
+        (*this)["lists"] = lists;
+        // number of the sub-vectors every feature is split into, each one is encoded by one byte
+        (*this)["subquantizers"] = subquantizers;
+        // number of bits of the sub-vector codes, up to 8
+        (*this)["bits"] = bits;
+        // number of the features sampled to train the quantizers, 0 uses all of them
+        (*this)["train_size"] = train_size;
+        // max iterations of the k-means clustering used to train the quantizers
+        (*this)["iterations"] = iterations;
+    }
+};
+
+
+/**
+ * Inverted file index with product quantization (IVF-PQ).
+ *
+ * The features are assigned to the nearest center of the coarse quantizer and only the residual
+ * to that center is stored, split into sub-vectors which are replaced by the index of the nearest
+ * codeword. A feature takes one byte per sub-vector and its id, the dataset is not used after the
+ * index is built. The search scans the inverted lists of the nearest coarse centers and computes
+ * the distances from tables of the distances between the query sub-vectors and the codewords, so
+ * the returned distances are approximations. The distance has to be a sum over the dimensions.
+ */
+template <typename Distance>
+class IvfPqIndex : public NNIndex<Distance>
+{
+public:
+    typedef typename Distance::ElementType ElementType;
+    typedef typename Distance::ResultType DistanceType;
+
+    IvfPqIndex(const Matrix<ElementType>& inputData, const IndexParams& params = IvfPqIndexParams(),
+               Distance d = Distance()) :
+        dataset_(inputData), index_params_(params), distance_(d), size_(inputData.rows),
+        veclen_(inputData.cols), codewords_(0), removed_count_(0)
+    {
+        lists_ = get_param(params,"lists",256);
+        subquantizers_ = get_param(params,"subquantizers",8);
+        bits_ = get_param(params,"bits",8);
+        train_size_ = get_param(params,"train_size",65536);
+        iterations_ = get_param(params,"iterations",10);
+        // number of the feature batches encoded in parallel, 0 lets OpenCV choose it
+        cores_ = get_param(params,"cores",1);
+        if (lists_ < 1 || subquantizers_ < 1 || subquantizers_ > (int)veclen_ || bits_ < 1 || bits_ > 8) {
+            throw FLANNException("Invalid IVF-PQ index parameters");
+        }
+        removed_points_.resize(size_);
+    }
+
+    IvfPqIndex(const IvfPqIndex&);
+    IvfPqIndex& operator=(const IvfPqIndex&);
+
+    flann_algorithm_t getType() const
+    {
+        return FLANN_INDEX_IVF_PQ;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    size_t veclen() const
+    {
+        return veclen_;
+    }
+
+    int usedMemory() const
+    {
+        size_t mem = (centers_.size() + codebook_.size())*sizeof(DistanceType);
+        for (size_t i = 0; i < list_ids_.size(); ++i) {
+            mem += list_ids_[i].size()*sizeof(int) + list_codes_[i].size();
+        }
+        return (int)(mem + removed_points_.size()/8);
+    }
+
+    /**
+     * Trains the quantizers on a sample of the dataset and encodes the whole dataset.
+     */
+    void buildIndex()
+    {
+        if (dataset_.rows == 0) {
+            throw FLANNException("Can't build the IVF-PQ index on an empty dataset");
+        }
+        train();
+
+        size_ = dataset_.rows;
+        removed_points_.reset();
+        removed_points_.resize(size_);
+        removed_count_ = 0;
+        list_ids_.assign(lists_, std::vector<int>());
+        list_codes_.assign(lists_, std::vector<uchar>());
+        encodePoints(dataset_, 0);
+    }
+
+    /**
+     * The new points are encoded with the quantizers trained by buildIndex(), they are not retrained.
+     */
+    void addPoints(const Matrix<ElementType>& points, float /*rebuild_threshold*/ = 2)
+    {
+        assert(points.cols == veclen_);
+        size_t first = size_;
+        size_ += points.rows;
+        removed_points_.resize(size_);
+        encodePoints(points, first);
+    }
+
+    void removePoint(size_t id)
+    {
+        if (id >= size_) {
+            throw FLANNException("Invalid index of the point to remove");
+        }
+        if (!removed_points_.test(id)) {
+            removed_points_.set(id);
+            removed_count_++;
+        }
+    }
+
+    void saveIndex(FILE* stream)
+    {
+        save_value(stream, lists_);
+        save_value(stream, subquantizers_);
+        save_value(stream, bits_);
+        save_value(stream, codewords_);
+        save_value(stream, size_);
+        save_value(stream, centers_);
+        save_value(stream, codebook_);
+        save_value(stream, sub_begin_);
+        // the removed points are dropped, their ids stay reserved
+        for (int l = 0; l < lists_; ++l) {
+            std::vector<int> ids;
+            std::vector<uchar> codes;
+            for (size_t i = 0; i < list_ids_[l].size(); ++i) {
+                if (removed_count_ && removed_points_.test(list_ids_[l][i])) continue;
+                ids.push_back(list_ids_[l][i]);
+                codes.insert(codes.end(), list_codes_[l].begin() + i*subquantizers_,
+                             list_codes_[l].begin() + (i + 1)*subquantizers_);
+            }
+            size_t count = ids.size();
+            save_value(stream, count);
+            if (count > 0) {
+                save_value(stream, ids[0], count);
+                save_value(stream, codes[0], codes.size());
+            }
+        }
+    }
+
+    void loadIndex(FILE* stream)
+    {
+        load_value(stream, lists_);
+        load_value(stream, subquantizers_);
+        load_value(stream, bits_);
+        load_value(stream, codewords_);
+        load_value(stream, size_);
+        load_value(stream, centers_);
+        load_value(stream, codebook_);
+        load_value(stream, sub_begin_);
+        list_ids_.assign(lists_, std::vector<int>());
+        list_codes_.assign(lists_, std::vector<uchar>());
+        for (int l = 0; l < lists_; ++l) {
+            size_t count;
+            load_value(stream, count);
+            if (count > 0) {
+                list_ids_[l].resize(count);
+                list_codes_[l].resize(count*subquantizers_);
+                load_value(stream, list_ids_[l][0], count);
+                load_value(stream, list_codes_[l][0], list_codes_[l].size());
+            }
+        }
+        removed_points_.reset();
+        removed_points_.resize(size_);
+        removed_count_ = 0;
+
+        index_params_["algorithm"] = getType();
+        index_params_["lists"] = lists_;
+        index_params_["subquantizers"] = subquantizers_;
+        index_params_["bits"] = bits_;
+    }
+
+    /**
+     * Probes the "probes" nearest inverted lists. When the search parameter isn't set, enough lists
+     * are probed to check about "checks" features, FLANN_CHECKS_UNLIMITED probes all the lists.
+     */
+    void findNeighbors(ResultSet<DistanceType>& result, const ElementType* vec, const SearchParams& searchParams)
+    {
+        int probes = get_param(searchParams,"probes",0);
+        if (probes <= 0) {
+            int checks = get_param(searchParams,"checks",32);
+            size_t listSize = std::max(size_/lists_, (size_t)1);
+            probes = (checks == FLANN_CHECKS_UNLIMITED) ? lists_ : (int)((std::max(checks, 1) + listSize - 1)/listSize);
+        }
+        probes = std::min(probes, lists_);
+
+        std::vector<std::pair<DistanceType, int> > nearest(lists_);
+        for (int l = 0; l < lists_; ++l) {
+            nearest[l] = std::make_pair(distance_(vec, &centers_[l*veclen_], veclen_), l);
+        }
+        std::partial_sort(nearest.begin(), nearest.begin() + probes, nearest.end());
+
+        std::vector<DistanceType> residual(veclen_), table(subquantizers_*codewords_);
+        for (int p = 0; p < probes; ++p) {
+            int l = nearest[p].second;
+            if (list_ids_[l].empty()) continue;
+            computeTable(vec, l, &residual[0], &table[0]);
+            scanList(result, l, &table[0]);
+        }
+    }
+
+    IndexParams getParameters() const
+    {
+        return index_params_;
+    }
+
+private:
+    class EncodeInvoker : public cv::ParallelLoopBody
+    {
+    public:
+        EncodeInvoker(const IvfPqIndex* index, const Matrix<ElementType>& points, int* lists, uchar* codes)
+            : index_(index), points_(points), lists_(lists), codes_(codes)
+        {
+        }
+
+        void operator()(const cv::Range& range) const
+        {
+            std::vector<DistanceType> residual(index_->veclen_), table(index_->subquantizers_*index_->codewords_);
+            for (int i = range.start; i < range.end; i++) {
+                lists_[i] = index_->encode(points_[i], &residual[0], &table[0], codes_ + i*index_->subquantizers_);
+            }
+        }
+
+    private:
+        const IvfPqIndex* index_;
+        const Matrix<ElementType>& points_;
+        int* lists_;
+        uchar* codes_;
+    };
+
+    /**
+     * Trains the coarse quantizer on the sample and the codebooks on the residuals.
+     * The codebook is stored transposed, row j holds the dimension j of all the codewords,
+     * so the tables are computed by the loops over the contiguous codewords.
+     */
+    void train()
+    {
+        int count = (int)dataset_.rows;
+        if (train_size_ > 0) {
+            count = std::min(count, train_size_);
+        }
+        cv::Mat samples(count, (int)veclen_, CV_32F);
+        UniqueRandom random((int)dataset_.rows);
+        for (int i = 0; i < count; ++i) {
+            const ElementType* point = dataset_[count == (int)dataset_.rows ? i : random.next()];
+            float* sample = samples.ptr<float>(i);
+            for (size_t j = 0; j < veclen_; ++j) {
+                sample[j] = (float)point[j];
+            }
+        }
+
+        cv::TermCriteria criteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, iterations_, 1e-4);
+        cv::Mat labels, centers;
+        lists_ = std::min(lists_, count);
+        cv::kmeans(samples, lists_, labels, criteria, 1, cv::KMEANS_PP_CENTERS, centers);
+        centers_.resize(lists_*veclen_);
+        for (int l = 0; l < lists_; ++l) {
+            const float* center = centers.ptr<float>(l);
+            for (size_t j = 0; j < veclen_; ++j) {
+                centers_[l*veclen_ + j] = (DistanceType)center[j];
+            }
+        }
+        for (int i = 0; i < count; ++i) {
+            cv::subtract(samples.row(i), centers.row(labels.at<int>(i)), samples.row(i));
+        }
+
+        codewords_ = std::min(1 << bits_, count);
+        codebook_.resize(veclen_*codewords_);
+        sub_begin_.resize(subquantizers_ + 1);
+        for (int m = 0; m <= subquantizers_; ++m) {
+            sub_begin_[m] = (int)(m*veclen_/subquantizers_);
+        }
+        for (int m = 0; m < subquantizers_; ++m) {
+            cv::Mat residuals = samples.colRange(sub_begin_[m], sub_begin_[m + 1]).clone();
+            cv::kmeans(residuals, codewords_, labels, criteria, 1, cv::KMEANS_PP_CENTERS, centers);
+            for (int j = sub_begin_[m]; j < sub_begin_[m + 1]; ++j) {
+                for (int k = 0; k < codewords_; ++k) {
+                    codebook_[j*codewords_ + k] = (DistanceType)centers.at<float>(k, j - sub_begin_[m]);
+                }
+            }
+        }
+    }
+
+    void encodePoints(const Matrix<ElementType>& points, size_t first)
+    {
+        if (points.rows == 0) return;
+        std::vector<int> lists(points.rows);
+        std::vector<uchar> codes(points.rows*subquantizers_);
+        EncodeInvoker invoker(this, points, &lists[0], &codes[0]);
+        if (cores_ == 1 || points.rows < 2) {
+            invoker(cv::Range(0, (int)points.rows));
+        }
+        else {
+            cv::parallel_for_(cv::Range(0, (int)points.rows), invoker, cores_ > 0 ? cores_ : -1);
+        }
+        for (size_t i = 0; i < points.rows; ++i) {
+            list_ids_[lists[i]].push_back((int)(first + i));
+            list_codes_[lists[i]].insert(list_codes_[lists[i]].end(), codes.begin() + i*subquantizers_,
+                                         codes.begin() + (i + 1)*subquantizers_);
+        }
+    }
+
+    /**
+     * Finds the inverted list of the point and the codewords nearest to its residual sub-vectors.
+     * @return the inverted list
+     */
+    int encode(const ElementType* vec, DistanceType* residual, DistanceType* table, uchar* code) const
+    {
+        int list = 0;
+        DistanceType best = distance_(vec, &centers_[0], veclen_);
+        for (int l = 1; l < lists_; ++l) {
+            DistanceType dist = distance_(vec, &centers_[l*veclen_], veclen_, best);
+            if (dist < best) {
+                best = dist;
+                list = l;
+            }
+        }
+        computeTable(vec, list, residual, table);
+        for (int m = 0; m < subquantizers_; ++m, table += codewords_) {
+            code[m] = (uchar)(std::min_element(table, table + codewords_) - table);
+        }
+        return list;
+    }
+
+    /**
+     * Computes the distances between the sub-vectors of the residual of vec to the center of the
+     * inverted list and all the codewords, table[m*codewords_ + k] is the distance to the codeword k
+     * of the sub-quantizer m.
+     */
+    void computeTable(const ElementType* vec, int list, DistanceType* residual, DistanceType* table) const
+    {
+        const DistanceType* center = &centers_[list*veclen_];
+        for (size_t j = 0; j < veclen_; ++j) {
+            residual[j] = (DistanceType)vec[j] - center[j];
+        }
+        std::fill(table, table + subquantizers_*codewords_, DistanceType());
+        for (int m = 0; m < subquantizers_; ++m, table += codewords_) {
+            for (int j = sub_begin_[m]; j < sub_begin_[m + 1]; ++j) {
+                const DistanceType* row = &codebook_[j*codewords_];
+                const DistanceType value = residual[j];
+                for (int k = 0; k < codewords_; ++k) {
+                    table[k] += distance_.accum_dist(value, row[k], j);
+                }
+            }
+        }
+    }
+
+    void scanList(ResultSet<DistanceType>& result, int list, const DistanceType* table) const
+    {
+        const std::vector<int>& ids = list_ids_[list];
+        const uchar* code = &list_codes_[list][0];
+        const int M = subquantizers_, K = codewords_;
+        for (size_t i = 0; i < ids.size(); ++i, code += M) {
+            if (removed_count_ && removed_points_.test(ids[i])) continue;
+            const DistanceType* t = table;
+            DistanceType dist = DistanceType();
+            int m = 0;
+            for (; m <= M - 4; m += 4, t += 4*K) {
+                dist += t[code[m]] + t[K + code[m + 1]] + t[2*K + code[m + 2]] + t[3*K + code[m + 3]];
+            }
+            for (; m < M; ++m, t += K) {
+                dist += t[code[m]];
+            }
+            result.addPoint(dist, ids[i]);
+        }
+    }
+
+private:
+    /** The dataset, only used to build the index */
+    const Matrix<ElementType> dataset_;
+    /** Index parameters */
+    IndexParams index_params_;
+    /** Index distance */
+    Distance distance_;
+
+    size_t size_;
+    size_t veclen_;
+    int lists_;
+    int subquantizers_;
+    int bits_;
+    int train_size_;
+    int iterations_;
+    int cores_;
+    /** Number of the codewords of every sub-quantizer, up to 2^bits_ */
+    int codewords_;
+
+    /** Centers of the coarse quantizer, lists_ x veclen_ */
+    std::vector<DistanceType> centers_;
+    /** Transposed codebooks, veclen_ x codewords_ */
+    std::vector<DistanceType> codebook_;
+    /** First dimension of every sub-vector and veclen_ */
+    std::vector<int> sub_begin_;
+    /** Ids and subquantizers_ byte codes of the features in every inverted list */
+    std::vector<std::vector<int> > list_ids_;
+    std::vector<std::vector<uchar> > list_codes_;
+
+    DynamicBitset removed_points_;
+    size_t removed_count_;
+};
+
+}
+
+#endif // OPENCV_FLANN_IVFPQ_INDEX_H_
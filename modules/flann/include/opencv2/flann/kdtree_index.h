@@ -66,9 +66,13 @@ struct KDTreeIndexParams : public IndexParams
  * Contains the k-d trees and other information for indexing a set of points
  * for nearest-neighbor matching.
  */
+template <typename Distance> class MappedIndex;
+
 template <typename Distance>
 class KDTreeIndex : public NNIndex<Distance>
 {
+    friend class MappedIndex<Distance>;
+
 public:
     typedef typename Distance::ElementType ElementType;
     typedef typename Distance::ResultType DistanceType;
@@ -83,22 +87,22 @@ public:
      */
     KDTreeIndex(const Matrix<ElementType>& inputData, const IndexParams& params = KDTreeIndexParams(),
                 Distance d = Distance() ) :
-        dataset_(inputData), index_params_(params), distance_(d)
+        index_params_(params), distance_(d)
     {
-        size_ = dataset_.rows;
-        veclen_ = dataset_.cols;
-
-        trees_ = get_param(index_params_,"trees",4);
-        tree_roots_ = new NodePtr[trees_];
+        size_ = inputData.rows;
+        veclen_ = inputData.cols;
 
-        // Create a permutable array of indices to the input vectors.
-        vind_.resize(size_);
+        points_.resize(size_);
         for (size_t i = 0; i < size_; ++i) {
-            vind_[i] = int(i);
+            points_[i] = inputData[i];
         }
+        removed_points_.resize(size_);
+        removed_count_ = 0;
+        size_at_build_ = 0;
 
-        mean_ = new DistanceType[veclen_];
-        var_ = new DistanceType[veclen_];
+        trees_ = get_param(index_params_,"trees",4);
+        tree_roots_ = new NodePtr[trees_];
+        std::fill(tree_roots_, tree_roots_ + trees_, NodePtr(NULL));
     }
 
 
@@ -113,8 +117,6 @@ public:
         if (tree_roots_!=NULL) {
             delete[] tree_roots_;
         }
-        delete[] mean_;
-        delete[] var_;
     }
 
     /**
@@ -122,16 +124,45 @@ public:
      */
     void buildIndex()
     {
+        // Create a permutable array of indices to the input vectors.
+        vind_.clear();
+        vind_.reserve(size_ - removed_count_);
+        for (size_t i = 0; i < size_; ++i) {
+            if (!removed_points_.test(i)) {
+                vind_.push_back(int(i));
+            }
+        }
+
+        pool_.free();
+        size_at_build_ = size_;
+
+        if (vind_.empty()) {
+            std::fill(tree_roots_, tree_roots_ + trees_, NodePtr(NULL));
+            return;
+        }
+
+        // "cores" is the number of trees built in parallel, 0 lets OpenCV choose it
+        int cores = get_param(index_params_,"cores",1);
+        if (cores != 1 && trees_ > 1) {
+            /* The shuffling and the seeds of the trees draw from the calling thread random generator,
+               so they are done up front and the trees don't depend on the threads building them. */
+            std::vector<std::vector<int> > vinds(trees_);
+            std::vector<unsigned int> seeds(trees_);
+            for (int i = 0; i < trees_; i++) {
+                shuffleIndices();
+                vinds[i] = vind_;
+                seeds[i] = (unsigned int)rand();
+            }
+            BuildTreesInvoker invoker(this, vinds, seeds);
+            cv::parallel_for_(cv::Range(0, trees_), invoker, cores > 0 ? cores : -1);
+            return;
+        }
+
         /* Construct the randomized trees. */
+        std::vector<DistanceType> mean(veclen_), var(veclen_);
         for (int i = 0; i < trees_; i++) {
-            /* Randomize the order of vectors to allow for unbiased sampling. */
-#ifndef OPENCV_FLANN_USE_STD_RAND
-            cv::randShuffle(vind_);
-#else
-            std::random_shuffle(vind_.begin(), vind_.end());
-#endif
-
-            tree_roots_[i] = divideTree(&vind_[0], int(size_) );
+            shuffleIndices();
+            tree_roots_[i] = divideTree(&vind_[0], int(vind_.size()), &mean[0], &var[0]);
         }
     }
 
@@ -142,8 +173,48 @@ public:
     }
 
 
+    /**
+     * Inserts the points into the existing trees, every point splits a leaf of each tree.
+     * The trees are rebuilt when the index grows by rebuild_threshold times.
+     */
+    void addPoints(const Matrix<ElementType>& points, float rebuild_threshold = 2)
+    {
+        assert(points.cols == veclen_);
+        size_t old_size = size_;
+        for (size_t i = 0; i < points.rows; ++i) {
+            points_.push_back(points[i]);
+        }
+        size_ = points_.size();
+        removed_points_.resize(size_);
+
+        if ((rebuild_threshold > 1) && (size_at_build_*rebuild_threshold < size_)) {
+            buildIndex();
+        }
+        else {
+            for (size_t i = old_size; i < size_; ++i) {
+                for (int j = 0; j < trees_; ++j) {
+                    addPointToTree(tree_roots_[j], int(i));
+                }
+            }
+        }
+    }
+
+    void removePoint(size_t id)
+    {
+        if (id >= size_) {
+            throw FLANNException("Invalid index of the point to remove");
+        }
+        if (!removed_points_.test(id)) {
+            removed_points_.set(id);
+            removed_count_++;
+        }
+    }
+
     void saveIndex(FILE* stream)
     {
+        if (removed_count_ > 0) {
+            throw FLANNException("Index with removed points can't be saved, rebuild it first");
+        }
         save_value(stream, trees_);
         for (int i=0; i<trees_; ++i) {
             save_tree(stream, tree_roots_[i]);
@@ -162,6 +233,7 @@ public:
         for (int i=0; i<trees_; ++i) {
             load_tree(stream,tree_roots_[i]);
         }
+        size_at_build_ = size_;
 
         index_params_["algorithm"] = getType();
         index_params_["trees"] = tree_roots_;
@@ -189,7 +261,7 @@ public:
      */
     int usedMemory() const
     {
-        return int(pool_.usedMemory+pool_.wastedMemory+dataset_.rows*sizeof(int));  // pool memory and vind array memory
+        return int(pool_.usedMemory+pool_.wastedMemory+size_*sizeof(int));  // pool memory and vind array memory
     }
 
     /**
@@ -269,6 +341,48 @@ private:
     }
 
 
+    /**
+     * Randomizes the order of vectors to allow for unbiased sampling.
+     */
+    void shuffleIndices()
+    {
+#ifndef OPENCV_FLANN_USE_STD_RAND
+        cv::randShuffle(vind_);
+#else
+        std::random_shuffle(vind_.begin(), vind_.end());
+#endif
+    }
+
+    /**
+     * Builds a range of the trees, each one from its own shuffled copy of the indices and with its own seed.
+     */
+    class BuildTreesInvoker : public cv::ParallelLoopBody
+    {
+    public:
+        BuildTreesInvoker(KDTreeIndex* index, std::vector<std::vector<int> >& vinds, const std::vector<unsigned int>& seeds)
+            : index_(index), vinds_(vinds), seeds_(seeds)
+        {
+        }
+
+        void operator()(const cv::Range& range) const
+        {
+            cv::RNG rng = cv::theRNG();
+            std::vector<DistanceType> mean(index_->veclen_), var(index_->veclen_);
+            for (int i = range.start; i < range.end; i++) {
+                std::vector<int>& ind = vinds_[i];
+                seed_random(seeds_[i]);
+                index_->tree_roots_[i] = index_->divideTree(&ind[0], int(ind.size()), &mean[0], &var[0]);
+            }
+            cv::theRNG() = rng;
+        }
+
+    private:
+        KDTreeIndex* index_;
+        std::vector<std::vector<int> >& vinds_;
+        const std::vector<unsigned int>& seeds_;
+    };
+
+
     /**
      * Create a tree node that subdivides the list of vecs from vind[first]
      * to vind[last].  The routine is called recursively on each sublist.
@@ -278,9 +392,14 @@ private:
      *                  first = index of the first vector
      *                  last = index of the last vector
      */
-    NodePtr divideTree(int* ind, int count)
+    NodePtr divideTree(int* ind, int count, DistanceType* mean, DistanceType* var)
     {
-        NodePtr node = pool_.allocate<Node>(); // allocate memory
+        NodePtr node;
+        {
+            // the trees can be built in parallel
+            cv::AutoLock lock(pool_mutex_);
+            node = pool_.allocate<Node>(); // allocate memory
+        }
 
         /* If too few exemplars remain, then make this a leaf node. */
         if ( count == 1) {
@@ -291,12 +410,12 @@ private:
             int idx;
             int cutfeat;
             DistanceType cutval;
-            meanSplit(ind, count, idx, cutfeat, cutval);
+            meanSplit(ind, count, idx, cutfeat, cutval, mean, var);
 
             node->divfeat = cutfeat;
             node->divval = cutval;
-            node->child1 = divideTree(ind, idx);
-            node->child2 = divideTree(ind+idx, count-idx);
+            node->child1 = divideTree(ind, idx, mean, var);
+            node->child2 = divideTree(ind+idx, count-idx, mean, var);
         }
 
         return node;
@@ -308,36 +427,37 @@ private:
      * Make a random choice among those with the highest variance, and use
      * its variance as the threshold value.
      */
-    void meanSplit(int* ind, int count, int& index, int& cutfeat, DistanceType& cutval)
+    void meanSplit(int* ind, int count, int& index, int& cutfeat, DistanceType& cutval,
+                   DistanceType* mean, DistanceType* var)
     {
-        memset(mean_,0,veclen_*sizeof(DistanceType));
-        memset(var_,0,veclen_*sizeof(DistanceType));
+        memset(mean,0,veclen_*sizeof(DistanceType));
+        memset(var,0,veclen_*sizeof(DistanceType));
 
         /* Compute mean values.  Only the first SAMPLE_MEAN values need to be
             sampled to get a good estimate.
          */
         int cnt = std::min((int)SAMPLE_MEAN+1, count);
         for (int j = 0; j < cnt; ++j) {
-            ElementType* v = dataset_[ind[j]];
+            ElementType* v = points_[ind[j]];
             for (size_t k=0; k<veclen_; ++k) {
-                mean_[k] += v[k];
+                mean[k] += v[k];
             }
         }
         for (size_t k=0; k<veclen_; ++k) {
-            mean_[k] /= cnt;
+            mean[k] /= cnt;
         }
 
         /* Compute variances (no need to divide by count). */
         for (int j = 0; j < cnt; ++j) {
-            ElementType* v = dataset_[ind[j]];
+            ElementType* v = points_[ind[j]];
             for (size_t k=0; k<veclen_; ++k) {
-                DistanceType dist = v[k] - mean_[k];
-                var_[k] += dist * dist;
+                DistanceType dist = v[k] - mean[k];
+                var[k] += dist * dist;
             }
         }
         /* Select one of the highest variance indices at random. */
-        cutfeat = selectDivision(var_);
-        cutval = mean_[cutfeat];
+        cutfeat = selectDivision(var);
+        cutval = mean[cutfeat];
 
         int lim1, lim2;
         planeSplit(ind, count, cutfeat, cutval, lim1, lim2);
@@ -401,22 +521,68 @@ private:
         int left = 0;
         int right = count-1;
         for (;; ) {
-            while (left<=right && dataset_[ind[left]][cutfeat]<cutval) ++left;
-            while (left<=right && dataset_[ind[right]][cutfeat]>=cutval) --right;
+            while (left<=right && points_[ind[left]][cutfeat]<cutval) ++left;
+            while (left<=right && points_[ind[right]][cutfeat]>=cutval) --right;
             if (left>right) break;
             std::swap(ind[left], ind[right]); ++left; --right;
         }
         lim1 = left;
         right = count-1;
         for (;; ) {
-            while (left<=right && dataset_[ind[left]][cutfeat]<=cutval) ++left;
-            while (left<=right && dataset_[ind[right]][cutfeat]>cutval) --right;
+            while (left<=right && points_[ind[left]][cutfeat]<=cutval) ++left;
+            while (left<=right && points_[ind[right]][cutfeat]>cutval) --right;
             if (left>right) break;
             std::swap(ind[left], ind[right]); ++left; --right;
         }
         lim2 = left;
     }
 
+    /**
+     * Inserts a point into the tree. The leaf where the point falls is split by the dimension
+     * in which the point and the leaf point differ the most.
+     */
+    void addPointToTree(NodePtr& root, int ind)
+    {
+        NodePtr leaf = pool_.allocate<Node>();
+        leaf->child1 = leaf->child2 = NULL;
+        leaf->divfeat = ind;
+        if (root==NULL) {
+            root = leaf;
+            return;
+        }
+
+        ElementType* point = points_[ind];
+        NodePtr node = root;
+        while ((node->child1!=NULL)||(node->child2!=NULL)) {
+            node = (point[node->divfeat] < node->divval) ? node->child1 : node->child2;
+        }
+
+        ElementType* leaf_point = points_[node->divfeat];
+        DistanceType max_span = 0;
+        int div_feat = 0;
+        for (size_t i = 0; i < veclen_; ++i) {
+            DistanceType span = std::abs(DistanceType(point[i]) - DistanceType(leaf_point[i]));
+            if (span > max_span) {
+                max_span = span;
+                div_feat = int(i);
+            }
+        }
+
+        NodePtr other = pool_.allocate<Node>();
+        other->child1 = other->child2 = NULL;
+        other->divfeat = node->divfeat;
+        if (point[div_feat] < leaf_point[div_feat]) {
+            node->child1 = leaf;
+            node->child2 = other;
+        }
+        else {
+            node->child1 = other;
+            node->child2 = leaf;
+        }
+        node->divfeat = div_feat;
+        node->divval = (DistanceType(point[div_feat]) + DistanceType(leaf_point[div_feat]))/2;
+    }
+
     /**
      * Performs an exact nearest neighbor search. The exact search performs a full
      * traversal of the tree.
@@ -428,7 +594,7 @@ private:
         if (trees_ > 1) {
             fprintf(stderr,"It doesn't make any sense to use more than one tree for exact search");
         }
-        if (trees_>0) {
+        if (trees_>0 && tree_roots_[0]!=NULL) {
             searchLevelExact(result, vec, tree_roots_[0], 0.0, epsError);
         }
         assert(result.full());
@@ -450,7 +616,9 @@ private:
 
         /* Search once through each tree down to root. */
         for (i = 0; i < trees_; ++i) {
-            searchLevel(result, vec, tree_roots_[i], 0, checkCount, maxCheck, epsError, heap, checked);
+            if (tree_roots_[i]!=NULL) {
+                searchLevel(result, vec, tree_roots_[i], 0, checkCount, maxCheck, epsError, heap, checked);
+            }
         }
 
         /* Keep searching other branches from heap until finished. */
@@ -486,9 +654,10 @@ private:
             int index = node->divfeat;
             if ( checked.test(index) || ((checkCount>=maxCheck)&& result_set.full()) ) return;
             checked.set(index);
+            if (removed_count_ && removed_points_.test(index)) return;
             checkCount++;
 
-            DistanceType dist = distance_(dataset_[index], vec, veclen_);
+            DistanceType dist = distance_(points_[index], vec, veclen_);
             result_set.addPoint(dist,index);
 
             return;
@@ -526,7 +695,8 @@ private:
         /* If this is a leaf node, then do check and return. */
         if ((node->child1 == NULL)&&(node->child2 == NULL)) {
             int index = node->divfeat;
-            DistanceType dist = distance_(dataset_[index], vec, veclen_);
+            if (removed_count_ && removed_points_.test(index)) return;
+            DistanceType dist = distance_(points_[index], vec, veclen_);
             result_set.addPoint(dist,index);
             return;
         }
@@ -588,9 +758,20 @@ private:
     std::vector<int> vind_;
 
     /**
-     * The dataset used by this index
+     * Pointers to the indexed points, the points inserted with addPoints() follow the dataset ones
+     */
+    std::vector<ElementType*> points_;
+
+    /**
+     * Points removed from the index and their number
      */
-    const Matrix<ElementType> dataset_;
+    DynamicBitset removed_points_;
+    size_t removed_count_;
+
+    /**
+     * Number of points when the trees were built
+     */
+    size_t size_at_build_;
 
     IndexParams index_params_;
 
@@ -598,10 +779,6 @@ private:
     size_t veclen_;
 
 
-    DistanceType* mean_;
-    DistanceType* var_;
-
-
     /**
      * Array of k-d trees used to find neighbours.
      */
@@ -615,6 +792,7 @@ private:
      * number small of memory allocations.
      */
     PooledAllocator pool_;
+    cv::Mutex pool_mutex_;
 
     Distance distance_;
 
@@ -47,6 +47,7 @@
 #include "random.h"
 #include "saving.h"
 #include "logger.h"
+#include "dynamic_bitset.h"
 
 
 namespace cvflann
@@ -123,7 +124,7 @@ public:
                 centers[index] = indices[rnd];
 
                 for (int j=0; j<index; ++j) {
-                    DistanceType sq = distance_(dataset_[centers[index]], dataset_[centers[j]], dataset_.cols);
+                    DistanceType sq = distance_(points_[centers[index]], points_[centers[j]], veclen_);
                     if (sq<1e-16) {
                         duplicate = true;
                     }
@@ -160,9 +161,9 @@ public:
             int best_index = -1;
             DistanceType best_val = 0;
             for (int j=0; j<n; ++j) {
-                DistanceType dist = distance_(dataset_[centers[0]],dataset_[indices[j]],dataset_.cols);
+                DistanceType dist = distance_(points_[centers[0]],points_[indices[j]],veclen_);
                 for (int i=1; i<index; ++i) {
-                    DistanceType tmp_dist = distance_(dataset_[centers[i]],dataset_[indices[j]],dataset_.cols);
+                    DistanceType tmp_dist = distance_(points_[centers[i]],points_[indices[j]],veclen_);
                     if (tmp_dist<dist) {
                         dist = tmp_dist;
                     }
@@ -209,7 +210,7 @@ public:
         centers[0] = indices[index];
 
         for (int i = 0; i < n; i++) {
-            closestDistSq[i] = distance_(dataset_[indices[i]], dataset_[indices[index]], dataset_.cols);
+            closestDistSq[i] = distance_(points_[indices[i]], points_[indices[index]], veclen_);
             closestDistSq[i] = ensureSquareDistance<Distance>( closestDistSq[i] );
             currentPot += closestDistSq[i];
         }
@@ -237,7 +238,7 @@ public:
                 // Compute the new potential
                 double newPot = 0;
                 for (int i = 0; i < n; i++) {
-                    DistanceType dist = distance_(dataset_[indices[i]], dataset_[indices[index]], dataset_.cols);
+                    DistanceType dist = distance_(points_[indices[i]], points_[indices[index]], veclen_);
                     newPot += std::min( ensureSquareDistance<Distance>(dist), closestDistSq[i] );
                 }
 
@@ -252,7 +253,7 @@ public:
             centers[centerCount] = indices[bestNewIndex];
             currentPot = bestNewPot;
             for (int i = 0; i < n; i++) {
-                DistanceType dist = distance_(dataset_[indices[i]], dataset_[indices[bestNewIndex]], dataset_.cols);
+                DistanceType dist = distance_(points_[indices[i]], points_[indices[bestNewIndex]], veclen_);
                 closestDistSq[i] = std::min( ensureSquareDistance<Distance>(dist), closestDistSq[i] );
             }
         }
@@ -274,7 +275,7 @@ public:
     class KMeansDistanceComputer : public cv::ParallelLoopBody
     {
     public:
-        KMeansDistanceComputer(Distance _distance, const Matrix<ElementType>& _dataset,
+        KMeansDistanceComputer(Distance _distance, const std::vector<ElementType*>& _dataset,
             const int _branching, const int* _indices, const Matrix<double>& _dcenters, const size_t _veclen,
             int* _count, int* _belongs_to, std::vector<DistanceType>& _radiuses, bool& _converged, cv::Mutex& _mtx)
             : distance(_distance)
@@ -323,7 +324,7 @@ public:
 
     private:
         Distance distance;
-        const Matrix<ElementType>& dataset;
+        const std::vector<ElementType*>& dataset;
         const int branching;
         const int* indices;
         const Matrix<double>& dcenters;
@@ -345,12 +346,20 @@ public:
      */
     KMeansIndex(const Matrix<ElementType>& inputData, const IndexParams& params = KMeansIndexParams(),
                 Distance d = Distance())
-        : dataset_(inputData), index_params_(params), root_(NULL), indices_(NULL), distance_(d)
+        : index_params_(params), root_(NULL), indices_(NULL), distance_(d)
     {
         memoryCounter_ = 0;
 
-        size_ = dataset_.rows;
-        veclen_ = dataset_.cols;
+        size_ = inputData.rows;
+        veclen_ = inputData.cols;
+
+        points_.resize(size_);
+        for (size_t i = 0; i < size_; ++i) {
+            points_[i] = inputData[i];
+        }
+        removed_points_.resize(size_);
+        removed_count_ = 0;
+        size_at_build_ = 0;
 
         branching_ = get_param(params,"branching",32);
         iterations_ = get_param(params,"iterations",11);
@@ -358,6 +367,8 @@ public:
             iterations_ = (std::numeric_limits<int>::max)();
         }
         centers_init_  = get_param(params,"centers_init",FLANN_CENTERS_RANDOM);
+        // number of the top level clusters processed in parallel, 0 lets OpenCV choose it
+        cores_ = get_param(params,"cores",1);
 
         if (centers_init_==FLANN_CENTERS_RANDOM) {
             chooseCenters = &KMeansIndex::chooseCentersRandom;
@@ -435,21 +446,79 @@ public:
             throw FLANNException("Branching factor must be at least 2");
         }
 
+        if (root_ != NULL) {
+            free_centers(root_);
+            root_ = NULL;
+        }
+        if (indices_ != NULL) {
+            delete[] indices_;
+        }
+        leaf_points_.clear();
+        pool_.free();
+        memoryCounter_ = 0;
+
+        int count = 0;
         indices_ = new int[size_];
         for (size_t i=0; i<size_; ++i) {
-            indices_[i] = int(i);
+            if (!removed_points_.test(i)) {
+                indices_[count++] = int(i);
+            }
         }
+        size_at_build_ = size_;
 
         root_ = pool_.allocate<KMeansNode>();
         std::memset(root_, 0, sizeof(KMeansNode));
 
-        computeNodeStatistics(root_, indices_, (int)size_);
-        computeClustering(root_, indices_, (int)size_, branching_,0);
+        computeNodeStatistics(root_, indices_, count);
+        computeClustering(root_, indices_, count, branching_,0);
+    }
+
+    /**
+     * Inserts the points into the tree. Each point goes down to the leaf with the closest
+     * centers updating the radiuses on its way, the leaves which get too large are clustered.
+     * The tree is rebuilt when the index grows by rebuild_threshold times.
+     */
+    void addPoints(const Matrix<ElementType>& points, float rebuild_threshold = 2)
+    {
+        assert(points.cols == veclen_);
+        size_t old_size = size_;
+        for (size_t i = 0; i < points.rows; ++i) {
+            points_.push_back(points[i]);
+        }
+        size_ = points_.size();
+        removed_points_.resize(size_);
+
+        if ((rebuild_threshold > 1) && (size_at_build_*rebuild_threshold < size_)) {
+            buildIndex();
+        }
+        else {
+            for (size_t i = old_size; i < size_; ++i) {
+                addPointToTree(root_, int(i));
+            }
+        }
+    }
+
+    void removePoint(size_t id)
+    {
+        if (id >= size_) {
+            throw FLANNException("Invalid index of the point to remove");
+        }
+        if (!removed_points_.test(id)) {
+            removed_points_.set(id);
+            removed_count_++;
+        }
     }
 
 
     void saveIndex(FILE* stream)
     {
+        if (removed_count_ > 0) {
+            throw FLANNException("Index with removed points can't be saved, rebuild it first");
+        }
+        // the leaves extended by addPoints() are not stored in indices_
+        if (size_at_build_ != size_) {
+            buildIndex();
+        }
         save_value(stream, branching_);
         save_value(stream, iterations_);
         save_value(stream, memoryCounter_);
@@ -475,7 +544,9 @@ public:
         if (root_!=NULL) {
             free_centers(root_);
         }
+        leaf_points_.clear();
         load_tree(stream, root_);
+        size_at_build_ = size_;
 
         index_params_["algorithm"] = getType();
         index_params_["branching"] = branching_;
@@ -606,6 +677,42 @@ private:
      */
     typedef BranchStruct<KMeansNodePtr, DistanceType> BranchSt;
 
+    /**
+     * Clusters a range of the children of a node, the points of child c are indices[starts[c]..starts[c+1]).
+     * When seeds are given, child c draws its centers from a generator seeded with seeds[c], so the result
+     * doesn't depend on the thread which clusters it.
+     */
+    class ClusteringInvoker : public cv::ParallelLoopBody
+    {
+    public:
+        ClusteringInvoker(KMeansIndex* index, KMeansNodePtr node, int* indices, const int* starts, int branching,
+                          const unsigned int* seeds = NULL)
+            : index_(index), node_(node), indices_(indices), starts_(starts), branching_(branching), seeds_(seeds)
+        {
+        }
+
+        void operator()(const cv::Range& range) const
+        {
+            cv::RNG rng = cv::theRNG();
+            for (int c = range.start; c < range.end; c++) {
+                if (seeds_ != NULL) {
+                    seed_random(seeds_[c]);
+                }
+                index_->computeClustering(node_->childs[c], indices_ + starts_[c], starts_[c+1] - starts_[c],
+                                          branching_, node_->level + 1);
+            }
+            cv::theRNG() = rng;
+        }
+
+    private:
+        KMeansIndex* index_;
+        KMeansNodePtr node_;
+        int* indices_;
+        const int* starts_;
+        int branching_;
+        const unsigned int* seeds_;
+    };
+
 
 
 
@@ -675,22 +782,22 @@ private:
 
         memset(mean,0,veclen_*sizeof(DistanceType));
 
-        for (size_t i=0; i<size_; ++i) {
-            ElementType* vec = dataset_[indices[i]];
+        for (int i=0; i<indices_length; ++i) {
+            ElementType* vec = points_[indices[i]];
             for (size_t j=0; j<veclen_; ++j) {
                 mean[j] += vec[j];
             }
             variance += distance_(vec, ZeroIterator<ElementType>(), veclen_);
         }
         for (size_t j=0; j<veclen_; ++j) {
-            mean[j] /= size_;
+            mean[j] /= indices_length;
         }
-        variance /= size_;
+        variance /= indices_length;
         variance -= distance_(mean, ZeroIterator<ElementType>(), veclen_);
 
         DistanceType tmp = 0;
         for (int i=0; i<indices_length; ++i) {
-            tmp = distance_(mean, dataset_[indices[i]], veclen_);
+            tmp = distance_(mean, points_[indices[i]], veclen_);
             if (tmp>radius) {
                 radius = tmp;
             }
@@ -741,7 +848,7 @@ private:
         cv::AutoBuffer<double> dcenters_buf(branching*veclen_);
         Matrix<double> dcenters((double*)dcenters_buf,branching,veclen_);
         for (int i=0; i<centers_length; ++i) {
-            ElementType* vec = dataset_[centers_idx[i]];
+            ElementType* vec = points_[centers_idx[i]];
             for (size_t k=0; k<veclen_; ++k) {
                 dcenters[i][k] = double(vec[k]);
             }
@@ -760,10 +867,10 @@ private:
         int* belongs_to = (int*)belongs_to_buf;
         for (int i=0; i<indices_length; ++i) {
 
-            DistanceType sq_dist = distance_(dataset_[indices[i]], dcenters[0], veclen_);
+            DistanceType sq_dist = distance_(points_[indices[i]], dcenters[0], veclen_);
             belongs_to[i] = 0;
             for (int j=1; j<branching; ++j) {
-                DistanceType new_sq_dist = distance_(dataset_[indices[i]], dcenters[j], veclen_);
+                DistanceType new_sq_dist = distance_(points_[indices[i]], dcenters[j], veclen_);
                 if (sq_dist>new_sq_dist) {
                     belongs_to[i] = j;
                     sq_dist = new_sq_dist;
@@ -787,7 +894,7 @@ private:
                 radiuses[i] = 0;
             }
             for (int i=0; i<indices_length; ++i) {
-                ElementType* vec = dataset_[indices[i]];
+                ElementType* vec = points_[indices[i]];
                 double* center = dcenters[belongs_to[i]];
                 for (size_t k=0; k<veclen_; ++k) {
                     center[k] += vec[k];
@@ -802,7 +909,7 @@ private:
 
             // reassign points to clusters
             cv::Mutex mtx;
-            KMeansDistanceComputer invoker(distance_, dataset_, branching, indices, dcenters, veclen_, count, belongs_to, radiuses, converged, mtx);
+            KMeansDistanceComputer invoker(distance_, points_, branching, indices, dcenters, veclen_, count, belongs_to, radiuses, converged, mtx);
             parallel_for_(cv::Range(0, (int)indices_length), invoker);
 
             for (int i=0; i<branching; ++i) {
@@ -817,7 +924,7 @@ private:
                     for (int k=0; k<indices_length; ++k) {
                         if (belongs_to[k]==j) {
                             // for cluster j, we move the furthest element from the center to the empty cluster i
-                            if ( distance_(dataset_[indices[k]], dcenters[j], veclen_) == radiuses[j] ) {
+                            if ( distance_(points_[indices[k]], dcenters[j], veclen_) == radiuses[j] ) {
                                 belongs_to[k] = i;
                                 count[j]--;
                                 count[i]++;
@@ -835,15 +942,24 @@ private:
 
         for (int i=0; i<branching; ++i) {
             centers[i] = new DistanceType[veclen_];
-            memoryCounter_ += (int)(veclen_*sizeof(DistanceType));
             for (size_t k=0; k<veclen_; ++k) {
                 centers[i][k] = (DistanceType)dcenters[i][k];
             }
         }
 
+        {
+            // the top level clusters can be processed in parallel
+            cv::AutoLock lock(pool_mutex_);
+            memoryCounter_ += (int)(branching*veclen_*sizeof(DistanceType));
+            node->childs = pool_.allocate<KMeansNodePtr>(branching);
+            for (int c=0; c<branching; ++c) {
+                node->childs[c] = pool_.allocate<KMeansNode>();
+            }
+        }
 
-        // compute kmeans clustering for each of the resulting clusters
-        node->childs = pool_.allocate<KMeansNodePtr>(branching);
+        // split the points by the clusters
+        cv::AutoBuffer<int> starts_buf(branching+1);
+        int* starts = (int*)starts_buf;
         int start = 0;
         int end = start;
         for (int c=0; c<branching; ++c) {
@@ -853,7 +969,7 @@ private:
             DistanceType mean_radius =0;
             for (int i=0; i<indices_length; ++i) {
                 if (belongs_to[i]==c) {
-                    DistanceType d = distance_(dataset_[indices[i]], ZeroIterator<ElementType>(), veclen_);
+                    DistanceType d = distance_(points_[indices[i]], ZeroIterator<ElementType>(), veclen_);
                     variance += d;
                     mean_radius += sqrt(d);
                     std::swap(indices[i],indices[end]);
@@ -865,21 +981,78 @@ private:
             mean_radius /= s;
             variance -= distance_(centers[c], ZeroIterator<ElementType>(), veclen_);
 
-            node->childs[c] = pool_.allocate<KMeansNode>();
             std::memset(node->childs[c], 0, sizeof(KMeansNode));
             node->childs[c]->radius = radiuses[c];
             node->childs[c]->pivot = centers[c];
             node->childs[c]->variance = variance;
             node->childs[c]->mean_radius = mean_radius;
-            computeClustering(node->childs[c],indices+start, end-start, branching, level+1);
+            starts[c] = start;
             start=end;
         }
-
+        starts[branching] = end;
         delete[] centers;
+
+        // compute kmeans clustering for each of the resulting clusters
+        if (level == 0 && cores_ != 1) {
+            // the seeds are drawn on the calling thread, the thread local generators of the workers are not used
+            std::vector<unsigned int> seeds(branching);
+            for (int c=0; c<branching; ++c) {
+                seeds[c] = (unsigned int)rand();
+            }
+            ClusteringInvoker invoker(this, node, indices, starts, branching, &seeds[0]);
+            cv::parallel_for_(cv::Range(0, branching), invoker, cores_ > 0 ? cores_ : -1);
+        }
+        else {
+            ClusteringInvoker invoker(this, node, indices, starts, branching);
+            invoker(cv::Range(0, branching));
+        }
     }
 
 
 
+    /**
+     * Inserts a point into the subtree of the given node.
+     */
+    void addPointToTree(KMeansNodePtr node, int index)
+    {
+        ElementType* point = points_[index];
+        for (;;) {
+            DistanceType dist = distance_(point, node->pivot, veclen_);
+            if (dist > node->radius) {
+                node->radius = dist;
+            }
+            if (node->childs == NULL) {
+                break;
+            }
+            node->size++;
+
+            int closest = 0;
+            DistanceType closest_dist = distance_(point, node->childs[0]->pivot, veclen_);
+            for (int i = 1; i < branching_; ++i) {
+                DistanceType d = distance_(point, node->childs[i]->pivot, veclen_);
+                if (d < closest_dist) {
+                    closest = i;
+                    closest_dist = d;
+                }
+            }
+            node = node->childs[closest];
+        }
+
+        // The leaf points are moved to a separate growing array at the first insertion,
+        // the array is kept after the leaf is split as the new leaves refer to its parts.
+        std::vector<int>& leaf = leaf_points_[node];
+        if (leaf.empty()) {
+            leaf.assign(node->indices, node->indices + node->size);
+        }
+        leaf.push_back(index);
+        node->indices = &leaf[0];
+        node->size = (int)leaf.size();
+
+        if (node->size >= branching_) {
+            computeClustering(node, node->indices, node->size, branching_, node->level);
+        }
+    }
+
     /**
      * Performs one descent in the hierarchical k-means tree. The branches not
      * visited are stored in a priority queue.
@@ -918,7 +1091,8 @@ private:
             checks += node->size;
             for (int i=0; i<node->size; ++i) {
                 int index = node->indices[i];
-                DistanceType dist = distance_(dataset_[index], vec, veclen_);
+                if (removed_count_ && removed_points_.test(index)) continue;
+                DistanceType dist = distance_(points_[index], vec, veclen_);
                 result.addPoint(dist, index);
             }
         }
@@ -991,7 +1165,8 @@ private:
         if (node->childs==NULL) {
             for (int i=0; i<node->size; ++i) {
                 int index = node->indices[i];
-                DistanceType dist = distance_(dataset_[index], vec, veclen_);
+                if (removed_count_ && removed_points_.test(index)) continue;
+                DistanceType dist = distance_(points_[index], vec, veclen_);
                 result.addPoint(dist, index);
             }
         }
@@ -1114,6 +1289,9 @@ private:
     /** Algorithm for choosing the cluster centers */
     flann_centers_init_t centers_init_;
 
+    /** Number of the top level clusters built in parallel */
+    int cores_;
+
     /**
      * Cluster border index. This is used in the tree search phase when determining
      * the closest cluster to explore next. A zero value takes into account only
@@ -1123,9 +1301,25 @@ private:
     float cb_index_;
 
     /**
-     * The dataset used by this index
+     * Pointers to the indexed points, the points inserted with addPoints() follow the dataset ones
+     */
+    std::vector<ElementType*> points_;
+
+    /**
+     * Points removed from the index and their number
+     */
+    DynamicBitset removed_points_;
+    size_t removed_count_;
+
+    /**
+     * Number of points when the tree was built
+     */
+    size_t size_at_build_;
+
+    /**
+     * Indices of the leaves which got new points after the tree was built
      */
-    const Matrix<ElementType> dataset_;
+    std::map<KMeansNodePtr, std::vector<int> > leaf_points_;
 
     /** Index parameters */
     IndexParams index_params_;
@@ -1159,6 +1353,7 @@ private:
      * Pooled memory allocator.
      */
     PooledAllocator pool_;
+    cv::Mutex pool_mutex_;
 
     /**
      * Memory occupied by the index.
@@ -45,9 +45,13 @@ struct LinearIndexParams : public IndexParams
     }
 };
 
+template <typename Distance> class MappedIndex;
+
 template <typename Distance>
 class LinearIndex : public NNIndex<Distance>
 {
+    friend class MappedIndex<Distance>;
+
 public:
 
     typedef typename Distance::ElementType ElementType;
@@ -56,7 +60,7 @@ public:
 
     LinearIndex(const Matrix<ElementType>& inputData, const IndexParams& params = LinearIndexParams(),
                 Distance d = Distance()) :
-        dataset_(inputData), index_params_(params), distance_(d)
+        dataset_(inputData), index_params_(params), distance_(d), removed_count_(0)
     {
     }
 
@@ -71,7 +75,7 @@ public:
 
     size_t size() const
     {
-        return dataset_.rows;
+        return dataset_.rows + added_points_.size();
     }
 
     size_t veclen() const
@@ -90,6 +94,27 @@ public:
         /* nothing to do here for linear search */
     }
 
+    void addPoints(const Matrix<ElementType>& points, float /*rebuild_threshold*/ = 2)
+    {
+        assert(points.cols == dataset_.cols);
+        for (size_t i = 0; i < points.rows; ++i) {
+            added_points_.push_back(points[i]);
+        }
+        removed_points_.resize(size());
+    }
+
+    void removePoint(size_t id)
+    {
+        if (id >= size()) {
+            throw FLANNException("Invalid index of the point to remove");
+        }
+        removed_points_.resize(size());
+        if (!removed_points_.test(id)) {
+            removed_points_.set(id);
+            removed_count_++;
+        }
+    }
+
     void saveIndex(FILE*)
     {
         /* nothing to do here for linear search */
@@ -107,9 +132,16 @@ public:
     {
         ElementType* data = dataset_.data;
         for (size_t i = 0; i < dataset_.rows; ++i, data += dataset_.cols) {
+            if (removed_count_ && removed_points_.test(i)) continue;
             DistanceType dist = distance_(data, vec, dataset_.cols);
             resultSet.addPoint(dist, (int)i);
         }
+        for (size_t i = 0; i < added_points_.size(); ++i) {
+            size_t id = dataset_.rows + i;
+            if (removed_count_ && removed_points_.test(id)) continue;
+            DistanceType dist = distance_(added_points_[i], vec, dataset_.cols);
+            resultSet.addPoint(dist, (int)id);
+        }
     }
 
     IndexParams getParameters() const
@@ -124,6 +156,11 @@ private:
     IndexParams index_params_;
     /** Index distance */
     Distance distance_;
+    /** Points inserted with addPoints() */
+    std::vector<ElementType*> added_points_;
+    /** Removed points and their number */
+    DynamicBitset removed_points_;
+    size_t removed_count_;
 
 };
 
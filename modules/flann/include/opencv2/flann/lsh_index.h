@@ -41,7 +41,9 @@
 #include <map>
 #include <vector>
 
+#include "opencv2/core/hal/hal.hpp"
 #include "general.h"
+#include "dist.h"
 #include "nn_index.h"
 #include "matrix.h"
 #include "result_set.h"
@@ -54,6 +56,26 @@
 namespace cvflann
 {
 
+namespace lsh
+{
+
+/** Distance between the query and a candidate feature. The byte lookup table of HammingLUT is replaced by
+ * the vectorized popcount of the core module, which is dispatched to the best instructions of the CPU.
+ */
+template<typename Distance>
+inline typename Distance::ResultType candidateDistance(const Distance& distance, const typename Distance::ElementType* a,
+                                                       const typename Distance::ElementType* b, size_t size)
+{
+    return distance(a, b, size);
+}
+
+inline HammingLUT::ResultType candidateDistance(const HammingLUT&, const unsigned char* a, const unsigned char* b, size_t size)
+{
+    return cv::hal::normHamming(a, b, (int)size);
+}
+
+}
+
 struct LshIndexParams : public IndexParams
 {
     LshIndexParams(unsigned int table_number = 12, unsigned int key_size = 20, unsigned int multi_probe_level = 2)
@@ -98,6 +120,7 @@ public:
 
         feature_size_ = (unsigned)dataset_.cols;
         fill_xor_mask(0, key_size_, multi_probe_level_, xor_masks_);
+        initPoints();
     }
 
 
@@ -115,7 +138,34 @@ public:
             table = lsh::LshTable<ElementType>(feature_size_, key_size_);
 
             // Add the features to the table
-            table.add(dataset_);
+            table.add(points_);
+        }
+    }
+
+    /**
+     * Adds the points to the hash tables, LSH doesn't need rebuilding so rebuild_threshold is ignored
+     */
+    void addPoints(const Matrix<ElementType>& points, float /*rebuild_threshold*/ = 2)
+    {
+        assert(points.cols == feature_size_);
+        size_t old_size = points_.size();
+        for (size_t i = 0; i < points.rows; ++i) {
+            points_.push_back(points[i]);
+        }
+        removed_points_.resize(points_.size());
+        for (unsigned int i = 0; i < tables_.size(); ++i) {
+            tables_[i].add(points_, old_size);
+        }
+    }
+
+    void removePoint(size_t id)
+    {
+        if (id >= points_.size()) {
+            throw FLANNException("Invalid index of the point to remove");
+        }
+        if (!removed_points_.test(id)) {
+            removed_points_.set(id);
+            removed_count_++;
         }
     }
 
@@ -127,6 +177,9 @@ public:
 
     void saveIndex(FILE* stream)
     {
+        if (removed_count_ > 0 || points_.size() != dataset_.rows) {
+            throw FLANNException("Index with added or removed points can't be saved");
+        }
         save_value(stream,table_number_);
         save_value(stream,key_size_);
         save_value(stream,multi_probe_level_);
@@ -139,6 +192,7 @@ public:
         load_value(stream, key_size_);
         load_value(stream, multi_probe_level_);
         load_value(stream, dataset_);
+        initPoints();
         // Building the index is so fast we can afford not storing it
         buildIndex();
 
@@ -153,7 +207,7 @@ public:
      */
     size_t size() const
     {
-        return dataset_.rows;
+        return points_.size();
     }
 
     /**
@@ -170,7 +224,7 @@ public:
      */
     int usedMemory() const
     {
-        return (int)(dataset_.rows * sizeof(int));
+        return (int)(points_.size() * sizeof(int));
     }
 
 
@@ -179,35 +233,6 @@ public:
         return index_params_;
     }
 
-    /**
-     * \brief Perform k-nearest neighbor search
-     * \param[in] queries The query points for which to find the nearest neighbors
-     * \param[out] indices The indices of the nearest neighbors found
-     * \param[out] dists Distances to the nearest neighbors found
-     * \param[in] knn Number of nearest neighbors to return
-     * \param[in] params Search parameters
-     */
-    virtual void knnSearch(const Matrix<ElementType>& queries, Matrix<int>& indices, Matrix<DistanceType>& dists, int knn, const SearchParams& params)
-    {
-        assert(queries.cols == veclen());
-        assert(indices.rows >= queries.rows);
-        assert(dists.rows >= queries.rows);
-        assert(int(indices.cols) >= knn);
-        assert(int(dists.cols) >= knn);
-
-
-        KNNUniqueResultSet<DistanceType> resultSet(knn);
-        for (size_t i = 0; i < queries.rows; i++) {
-            resultSet.clear();
-            std::fill_n(indices[i], knn, -1);
-            std::fill_n(dists[i], knn, std::numeric_limits<DistanceType>::max());
-            findNeighbors(resultSet, queries[i], params);
-            if (get_param(params,"sorted",true)) resultSet.sortAndCopy(indices[i], dists[i], knn);
-            else resultSet.copy(indices[i], dists[i], knn);
-        }
-    }
-
-
     /**
      * Find set of nearest neighbors to vec. Their indices are stored inside
      * the result object.
@@ -275,21 +300,22 @@ private:
                 std::vector<lsh::BucketKey>::const_iterator xor_mask_end = xor_masks_.end();
                 for (; xor_mask != xor_mask_end; ++xor_mask) {
                     size_t sub_key = key ^ (*xor_mask);
-                    const lsh::Bucket* bucket = table->getBucketFromKey(sub_key);
-                    if (bucket == 0) continue;
+                    size_t bucket_size = 0;
+                    const lsh::FeatureIndex* training_index = table->getBucketFromKey((lsh::BucketKey)sub_key, bucket_size);
+                    if (training_index == 0) continue;
 
                     // Go over each descriptor index
-                    std::vector<lsh::FeatureIndex>::const_iterator training_index = bucket->begin();
-                    std::vector<lsh::FeatureIndex>::const_iterator last_training_index = bucket->end();
+                    const lsh::FeatureIndex* last_training_index = training_index + bucket_size;
                     DistanceType hamming_distance;
 
                     // Process the rest of the candidates
                     for (; training_index < last_training_index; ++training_index) {
-                        hamming_distance = distance_(vec, dataset_[*training_index], dataset_.cols);
+                        if (removed_count_ && removed_points_.test(*training_index)) continue;
+                        hamming_distance = lsh::candidateDistance(distance_, vec, points_[*training_index], feature_size_);
 
                         if (hamming_distance < worst_score) {
                             // Insert the new element
-                            score_index_heap.push_back(ScoreIndexPair(hamming_distance, training_index));
+                            score_index_heap.push_back(ScoreIndexPair(hamming_distance, *training_index));
                             std::push_heap(score_index_heap.begin(), score_index_heap.end());
 
                             if (score_index_heap.size() > (unsigned int)k_nn) {
@@ -313,25 +339,39 @@ private:
                 std::vector<lsh::BucketKey>::const_iterator xor_mask_end = xor_masks_.end();
                 for (; xor_mask != xor_mask_end; ++xor_mask) {
                     size_t sub_key = key ^ (*xor_mask);
-                    const lsh::Bucket* bucket = table->getBucketFromKey(sub_key);
-                    if (bucket == 0) continue;
+                    size_t bucket_size = 0;
+                    const lsh::FeatureIndex* training_index = table->getBucketFromKey((lsh::BucketKey)sub_key, bucket_size);
+                    if (training_index == 0) continue;
 
                     // Go over each descriptor index
-                    std::vector<lsh::FeatureIndex>::const_iterator training_index = bucket->begin();
-                    std::vector<lsh::FeatureIndex>::const_iterator last_training_index = bucket->end();
+                    const lsh::FeatureIndex* last_training_index = training_index + bucket_size;
                     DistanceType hamming_distance;
 
                     // Process the rest of the candidates
                     for (; training_index < last_training_index; ++training_index) {
                         // Compute the Hamming distance
-                        hamming_distance = distance_(vec, dataset_[*training_index], dataset_.cols);
-                        if (hamming_distance < radius) score_index_heap.push_back(ScoreIndexPair(hamming_distance, training_index));
+                        if (removed_count_ && removed_points_.test(*training_index)) continue;
+                        hamming_distance = lsh::candidateDistance(distance_, vec, points_[*training_index], feature_size_);
+                        if (hamming_distance < radius) score_index_heap.push_back(ScoreIndexPair(hamming_distance, *training_index));
                     }
                 }
             }
         }
     }
 
+    /** Fills the point pointers from the dataset
+     */
+    void initPoints()
+    {
+        points_.resize(dataset_.rows);
+        for (size_t i = 0; i < dataset_.rows; ++i) {
+            points_[i] = dataset_[i];
+        }
+        removed_points_.clear();
+        removed_points_.resize(points_.size());
+        removed_count_ = 0;
+    }
+
     /** Performs the approximate nearest-neighbor search.
      * This is a slower version than the above as it uses the ResultSet
      * @param vec the feature to analyze
@@ -346,18 +386,19 @@ private:
             std::vector<lsh::BucketKey>::const_iterator xor_mask_end = xor_masks_.end();
             for (; xor_mask != xor_mask_end; ++xor_mask) {
                 size_t sub_key = key ^ (*xor_mask);
-                const lsh::Bucket* bucket = table->getBucketFromKey((lsh::BucketKey)sub_key);
-                if (bucket == 0) continue;
+                size_t bucket_size = 0;
+                const lsh::FeatureIndex* training_index = table->getBucketFromKey((lsh::BucketKey)sub_key, bucket_size);
+                if (training_index == 0) continue;
 
                 // Go over each descriptor index
-                std::vector<lsh::FeatureIndex>::const_iterator training_index = bucket->begin();
-                std::vector<lsh::FeatureIndex>::const_iterator last_training_index = bucket->end();
+                const lsh::FeatureIndex* last_training_index = training_index + bucket_size;
                 DistanceType hamming_distance;
 
                 // Process the rest of the candidates
                 for (; training_index < last_training_index; ++training_index) {
                     // Compute the Hamming distance
-                    hamming_distance = distance_(vec, dataset_[*training_index], (int)dataset_.cols);
+                    if (removed_count_ && removed_points_.test(*training_index)) continue;
+                    hamming_distance = lsh::candidateDistance(distance_, vec, points_[*training_index], feature_size_);
                     result.addPoint(hamming_distance, *training_index);
                 }
             }
@@ -370,6 +411,13 @@ private:
     /** The data the LSH tables where built from */
     Matrix<ElementType> dataset_;
 
+    /** Pointers to the indexed features, the features inserted with addPoints() follow the dataset ones */
+    std::vector<ElementType*> points_;
+
+    /** Features removed from the index and their number */
+    DynamicBitset removed_points_;
+    size_t removed_count_;
+
     /** The size of the features (as ElementType[]) */
     unsigned int feature_size_;
 
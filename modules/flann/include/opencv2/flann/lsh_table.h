@@ -52,6 +52,8 @@
 #endif
 #include <math.h>
 #include <stddef.h>
+#include <utility>
+#include <vector>
 
 #include "dynamic_bitset.h"
 #include "matrix.h"
@@ -125,23 +127,23 @@ inline std::ostream& operator <<(std::ostream& out, const LshStats& stats)
  * the size of it is pretty small, we keep it as a continuous memory array.
  * The value is an index in the corpus of features (we keep it as an unsigned
  * int for pure memory reasons, it could be a size_t)
+ *
+ * The feature indices of all the buckets are stored contiguously, grouped by bucket, so the
+ * search reads every bucket as one range. The key is gathered with a table per feature byte
+ * containing bits of the key.
  */
 template<typename ElementType>
 class LshTable
 {
 public:
-    /** A container of all the feature indices. Optimized for space
+    /** Map from the keys to the bucket numbers when there are too few buckets for an array
      */
 #if USE_UNORDERED_MAP
-    typedef std::unordered_map<BucketKey, Bucket> BucketsSpace;
+    typedef std::unordered_map<BucketKey, FeatureIndex> BucketsSpace;
 #else
-    typedef std::map<BucketKey, Bucket> BucketsSpace;
+    typedef std::map<BucketKey, FeatureIndex> BucketsSpace;
 #endif
 
-    /** A container of all the feature indices. Optimized for speed
-     */
-    typedef std::vector<Bucket> BucketsSpeed;
-
     /** Default constructor
      */
     LshTable()
@@ -164,77 +166,60 @@ public:
         assert(0);
     }
 
-    /** Add a feature to the table
-     * @param value the value to store for that feature
-     * @param feature the feature itself
+    /** Add a set of features to the table
+     * @param dataset the values to store
      */
-    void add(unsigned int value, const ElementType* feature)
+    void add(Matrix<ElementType> dataset)
     {
-        // Add the value to the corresponding bucket
-        BucketKey key = (lsh::BucketKey)getKey(feature);
-
-        switch (speed_level_) {
-        case kArray:
-            // That means we get the buckets from an array
-            buckets_speed_[key].push_back(value);
-            break;
-        case kBitsetHash:
-            // That means we can check the bitset for the presence of a key
-            key_bitset_.set(key);
-            buckets_space_[key].push_back(value);
-            break;
-        case kHash:
-        {
-            // That means we have to check for the hash table for the presence of a key
-            buckets_space_[key].push_back(value);
-            break;
-        }
-        }
+        pending_.reserve(pending_.size() + dataset.rows);
+        for (unsigned int i = 0; i < dataset.rows; ++i) push(i, dataset[i]);
+        optimize();
     }
 
-    /** Add a set of features to the table
-     * @param dataset the values to store
+    /** Add a set of features given by pointers to the table
+     * @param features the values to store, the value of a feature is its position in the vector
+     * @param first the position of the first feature to add, the previous ones are already in the table
      */
-    void add(Matrix<ElementType> dataset)
+    void add(const std::vector<ElementType*>& features, size_t first = 0)
     {
-#if USE_UNORDERED_MAP
-        buckets_space_.rehash((buckets_space_.size() + dataset.rows) * 1.2);
-#endif
-        // Add the features to the table
-        for (unsigned int i = 0; i < dataset.rows; ++i) add(i, dataset[i]);
-        // Now that the table is full, optimize it for speed/space
+        pending_.reserve(pending_.size() + features.size() - first);
+        for (size_t i = first; i < features.size(); ++i) push((unsigned int)i, features[i]);
         optimize();
     }
 
     /** Get a bucket given the key
      * @param key
-     * @return
+     * @param size the number of the features in the bucket
+     * @return the features of the bucket or NULL if it is empty
      */
-    inline const Bucket* getBucketFromKey(BucketKey key) const
+    inline const FeatureIndex* getBucketFromKey(BucketKey key, size_t& size) const
     {
-        // Generate other buckets
+        FeatureIndex bucket;
         switch (speed_level_) {
         case kArray:
             // That means we get the buckets from an array
-            return &buckets_speed_[key];
+            bucket = key;
             break;
         case kBitsetHash:
             // That means we can check the bitset for the presence of a key
-            if (key_bitset_.test(key)) return &buckets_space_.find(key)->second;
-            else return 0;
+            if (!key_bitset_.test(key)) return 0;
+            bucket = buckets_space_.find(key)->second;
             break;
         case kHash:
+        default:
         {
             // That means we have to check for the hash table for the presence of a key
-            BucketsSpace::const_iterator bucket_it, bucket_end = buckets_space_.end();
-            bucket_it = buckets_space_.find(key);
+            BucketsSpace::const_iterator bucket_it = buckets_space_.find(key);
             // Stop here if that bucket does not exist
-            if (bucket_it == bucket_end) return 0;
-            else return &bucket_it->second;
+            if (bucket_it == buckets_space_.end()) return 0;
+            bucket = bucket_it->second;
             break;
         }
         }
-        return 0;
+        if (bucket + 1 >= bucket_offsets_.size()) return 0;
+        FeatureIndex begin = bucket_offsets_[bucket];
+        size = bucket_offsets_[bucket + 1] - begin;
+        return size ? &bucket_ids_[begin] : 0;
     }
 
     /** Compute the sub-signature of a feature
@@ -253,7 +238,7 @@ public:
 
 private:
     /** defines the speed fo the implementation
-     * kArray uses a vector for storing data
+     * kArray indexes the buckets by the key
      * kBitsetHash uses a hash map but checks for the validity of a key with a bitset
      * kHash uses a hash map only
      */
@@ -278,49 +263,106 @@ private:
         key_size_ = (unsigned)key_size;
     }
 
-    /** Optimize the table for speed/space
+    /** Queue a feature for the table, it is stored by the next optimize()
+     * @param value the value to store for that feature
+     * @param feature the feature itself
+     */
+    void push(unsigned int value, const ElementType* feature)
+    {
+        pending_.push_back(std::make_pair((BucketKey)getKey(feature), (FeatureIndex)value));
+    }
+
+    /** Store the queued features and optimize the table for speed/space
      */
     void optimize()
     {
-        // If we are already using the fast storage, no need to do anything
-        if (speed_level_ == kArray) return;
+        // Only the new features are sorted, the stored ones are already ordered by key and the two are merged
+        std::sort(pending_.begin(), pending_.end());
+        std::vector<std::pair<BucketKey, FeatureIndex> > entries;
+        entries.reserve(bucket_ids_.size() + pending_.size());
+        if (speed_level_ == kArray) {
+            for (size_t key = 0; key + 1 < bucket_offsets_.size(); ++key) {
+                for (FeatureIndex i = bucket_offsets_[key]; i < bucket_offsets_[key + 1]; ++i)
+                    entries.push_back(std::make_pair((BucketKey)key, bucket_ids_[i]));
+            }
+        }
+        else {
+            // The buckets are numbered in the order of their keys
+            std::vector<BucketKey> keys(buckets_space_.size());
+            for (BucketsSpace::const_iterator key_bucket = buckets_space_.begin(); key_bucket != buckets_space_.end(); ++key_bucket)
+                keys[key_bucket->second] = key_bucket->first;
+            for (size_t bucket = 0; bucket < keys.size(); ++bucket) {
+                for (FeatureIndex i = bucket_offsets_[bucket]; i < bucket_offsets_[bucket + 1]; ++i)
+                    entries.push_back(std::make_pair(keys[bucket], bucket_ids_[i]));
+            }
+        }
+        size_t n_stored = entries.size();
+        entries.insert(entries.end(), pending_.begin(), pending_.end());
+        std::vector<std::pair<BucketKey, FeatureIndex> >().swap(pending_);
+        std::inplace_merge(entries.begin(), entries.begin() + n_stored, entries.end());
+
+        size_t n_buckets = 0;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (i == 0 || entries[i].first != entries[i - 1].first) ++n_buckets;
+        }
+
+        bucket_ids_.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) bucket_ids_[i] = entries[i].second;
+        buckets_space_.clear();
+        key_bitset_.clear();
 
         // Use an array if it will be more than half full
-        if (buckets_space_.size() > ((size_t(1) << key_size_) / 2)) {
+        if (n_buckets > ((size_t(1) << key_size_) / 2)) {
             speed_level_ = kArray;
-            // Fill the array version of it
-            buckets_speed_.resize(size_t(1) << key_size_);
-            for (BucketsSpace::const_iterator key_bucket = buckets_space_.begin(); key_bucket != buckets_space_.end(); ++key_bucket) buckets_speed_[key_bucket->first] = key_bucket->second;
-
-            // Empty the hash table
-            buckets_space_.clear();
+            bucket_offsets_.assign((size_t(1) << key_size_) + 1, 0);
+            for (size_t i = 0; i < entries.size(); ++i) ++bucket_offsets_[entries[i].first + 1];
+            for (size_t key = 1; key < bucket_offsets_.size(); ++key) bucket_offsets_[key] += bucket_offsets_[key - 1];
             return;
         }
 
+        bucket_offsets_.resize(n_buckets + 1);
+#if USE_UNORDERED_MAP
+        buckets_space_.rehash((size_t)(n_buckets * 1.2));
+#endif
+        FeatureIndex bucket = 0;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (i == 0 || entries[i].first != entries[i - 1].first) {
+                bucket_offsets_[bucket] = (FeatureIndex)i;
+                buckets_space_[entries[i].first] = bucket++;
+            }
+        }
+        bucket_offsets_[n_buckets] = (FeatureIndex)entries.size();
+
         // If the bitset is going to use less than 10% of the RAM of the hash map (at least 1 size_t for the key and two
         // for the vector) or less than 512MB (key_size_ <= 30)
-        if (((std::max(buckets_space_.size(), buckets_speed_.size()) * CHAR_BIT * 3 * sizeof(BucketKey)) / 10
-             >= (size_t(1) << key_size_)) || (key_size_ <= 32)) {
+        if (((n_buckets * CHAR_BIT * 3 * sizeof(BucketKey)) / 10 >= (size_t(1) << key_size_)) || (key_size_ <= 32)) {
             speed_level_ = kBitsetHash;
             key_bitset_.resize(size_t(1) << key_size_);
             key_bitset_.reset();
-            // Try with the BucketsSpace
             for (BucketsSpace::const_iterator key_bucket = buckets_space_.begin(); key_bucket != buckets_space_.end(); ++key_bucket) key_bitset_.set(key_bucket->first);
         }
         else {
             speed_level_ = kHash;
-            key_bitset_.clear();
         }
     }
 
-    /** The vector of all the buckets if they are held for speed
+    /** The feature indices of all the buckets, ordered by key
+     */
+    std::vector<FeatureIndex> bucket_ids_;
+
+    /** Offsets of the buckets in bucket_ids_ followed by its size, indexed by the key in the kArray mode
+     * and by the bucket number from buckets_space_ otherwise
      */
-    BucketsSpeed buckets_speed_;
+    std::vector<FeatureIndex> bucket_offsets_;
 
-    /** The hash table of all the buckets in case we cannot use the speed version
+    /** The bucket numbers of the keys in case we cannot use the array
      */
     BucketsSpace buckets_space_;
 
+    /** The keys and values of the features added since the last optimize()
+     */
+    std::vector<std::pair<BucketKey, FeatureIndex> > pending_;
+
     /** What is used to store the data */
     SpeedLevel speed_level_;
 
@@ -336,10 +378,13 @@ private:
     unsigned int feature_size_;
 
     // Members only used for the unsigned char specialization
-    /** The mask to apply to a feature to get the hash key
-     * Only used in the unsigned char case
+    /** The feature bytes which contain the bits of the key, in increasing order
+     */
+    std::vector<unsigned int> key_bytes_;
+
+    /** For every byte from key_bytes_, the bits of the key given by the 256 values of the byte
      */
-    std::vector<size_t> mask_;
+    std::vector<BucketKey> key_luts_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -350,8 +395,6 @@ inline LshTable<unsigned char>::LshTable(unsigned int feature_size, unsigned int
 {
     feature_size_ = feature_size;
     initialize(subsignature_size);
-    // Allocate the mask
-    mask_ = std::vector<size_t>((feature_size * sizeof(char) + sizeof(size_t) - 1) / sizeof(size_t), 0);
 
     // A bit brutal but fast to code
     std::vector<int> indices(feature_size * CHAR_BIT);
@@ -362,30 +405,24 @@ inline LshTable<unsigned char>::LshTable(unsigned int feature_size, unsigned int
     std::random_shuffle(indices.begin(), indices.end());
 #endif
 
-    // Generate a random set of order of subsignature_size_ bits
-    for (unsigned int i = 0; i < key_size_; ++i) {
-        size_t index = indices[i];
-
-        // Set that bit in the mask
-        size_t divisor = CHAR_BIT * sizeof(size_t);
-        size_t idx = index / divisor; //pick the right size_t index
-        mask_[idx] |= size_t(1) << (index % divisor); //use modulo to find the bit offset
-    }
+    // Generate a random set of order of subsignature_size_ bits, the bits of the key follow the bits
+    // of the feature (bit b of byte i is the bit 8*i + b)
+    std::vector<int> key_bits(indices.begin(), indices.begin() + key_size_);
+    std::sort(key_bits.begin(), key_bits.end());
 
-    // Set to 1 if you want to display the mask for debug
-#if 0
-    {
-        size_t bcount = 0;
-        BOOST_FOREACH(size_t mask_block, mask_){
-            out << std::setw(sizeof(size_t) * CHAR_BIT / 4) << std::setfill('0') << std::hex << mask_block
-                << std::endl;
-            bcount += __builtin_popcountll(mask_block);
+    for (unsigned int i = 0; i < key_size_; ++i) {
+        unsigned int byte = key_bits[i] / CHAR_BIT;
+        if (key_bytes_.empty() || key_bytes_.back() != byte) {
+            key_bytes_.push_back(byte);
+            key_luts_.resize(key_luts_.size() + 256, 0);
+        }
+        // Every value of the byte with that bit set gets the key bit
+        BucketKey* lut = &key_luts_[key_luts_.size() - 256];
+        int bit = key_bits[i] % CHAR_BIT;
+        for (int value = 0; value < 256; ++value) {
+            if (value & (1 << bit)) lut[value] |= BucketKey(1) << i;
         }
-        out << "bit count : " << std::dec << bcount << std::endl;
-        out << "mask size : " << mask_.size() << std::endl;
-        return out;
     }
-#endif
 }
 
 /** Return the Subsignature of a feature
@@ -394,43 +431,12 @@ inline LshTable<unsigned char>::LshTable(unsigned int feature_size, unsigned int
 template<>
 inline size_t LshTable<unsigned char>::getKey(const unsigned char* feature) const
 {
-    // no need to check if T is dividable by sizeof(size_t) like in the Hamming
-    // distance computation as we have a mask
-    // FIXIT: This is bad assumption, because we reading tail bytes after of the allocated features buffer
-    const size_t* feature_block_ptr = reinterpret_cast<const size_t*> ((const void*)feature);
-
-    // Figure out the subsignature of the feature
     // Given the feature ABCDEF, and the mask 001011, the output will be
     // 000CEF
-    size_t subsignature = 0;
-    size_t bit_index = 1;
-
-    for (unsigned i = 0; i < feature_size_; i += sizeof(size_t)) {
-        // get the mask and signature blocks
-        size_t feature_block;
-        if (i <= feature_size_ - sizeof(size_t))
-        {
-            feature_block = *feature_block_ptr;
-        }
-        else
-        {
-            size_t tmp = 0;
-            memcpy(&tmp, feature_block_ptr, feature_size_ - i); // preserve bytes order
-            feature_block = tmp;
-        }
-        size_t mask_block = mask_[i / sizeof(size_t)];
-        while (mask_block) {
-            // Get the lowest set bit in the mask block
-            size_t lowest_bit = mask_block & (-(ptrdiff_t)mask_block);
-            // Add it to the current subsignature if necessary
-            subsignature += (feature_block & lowest_bit) ? bit_index : 0;
-            // Reset the bit in the mask block
-            mask_block ^= lowest_bit;
-            // increment the bit index for the subsignature
-            bit_index <<= 1;
-        }
-        // Check the next feature block
-        ++feature_block_ptr;
+    BucketKey subsignature = 0;
+    const BucketKey* lut = key_luts_.empty() ? 0 : &key_luts_[0];
+    for (size_t i = 0; i < key_bytes_.size(); ++i, lut += 256) {
+        subsignature |= lut[feature[key_bytes_[i]]];
     }
     return subsignature;
 }
@@ -440,7 +446,7 @@ inline LshStats LshTable<unsigned char>::getStats() const
 {
     LshStats stats;
     stats.bucket_size_mean_ = 0;
-    if ((buckets_speed_.empty()) && (buckets_space_.empty())) {
+    if (bucket_offsets_.size() < 2) {
         stats.n_buckets_ = 0;
         stats.bucket_size_median_ = 0;
         stats.bucket_size_min_ = 0;
@@ -448,22 +454,13 @@ inline LshStats LshTable<unsigned char>::getStats() const
         return stats;
     }
 
-    if (!buckets_speed_.empty()) {
-        for (BucketsSpeed::const_iterator pbucket = buckets_speed_.begin(); pbucket != buckets_speed_.end(); ++pbucket) {
-            stats.bucket_sizes_.push_back((lsh::FeatureIndex)pbucket->size());
-            stats.bucket_size_mean_ += pbucket->size();
-        }
-        stats.bucket_size_mean_ /= buckets_speed_.size();
-        stats.n_buckets_ = buckets_speed_.size();
-    }
-    else {
-        for (BucketsSpace::const_iterator x = buckets_space_.begin(); x != buckets_space_.end(); ++x) {
-            stats.bucket_sizes_.push_back((lsh::FeatureIndex)x->second.size());
-            stats.bucket_size_mean_ += x->second.size();
-        }
-        stats.bucket_size_mean_ /= buckets_space_.size();
-        stats.n_buckets_ = buckets_space_.size();
+    for (size_t bucket = 0; bucket + 1 < bucket_offsets_.size(); ++bucket) {
+        unsigned int size = bucket_offsets_[bucket + 1] - bucket_offsets_[bucket];
+        stats.bucket_sizes_.push_back(size);
+        stats.bucket_size_mean_ += size;
     }
+    stats.n_buckets_ = bucket_offsets_.size() - 1;
+    stats.bucket_size_mean_ /= stats.n_buckets_;
 
     std::sort(stats.bucket_sizes_.begin(), stats.bucket_sizes_.end());
 
@@ -0,0 +1,514 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#ifndef OPENCV_FLANN_MAPPED_INDEX_H_
+#define OPENCV_FLANN_MAPPED_INDEX_H_
+
+#include <climits>
+#include <cstring>
+#include <vector>
+
+#include "general.h"
+#include "dist.h"
+#include "nn_index.h"
+#include "kdtree_index.h"
+#include "linear_index.h"
+#include "dynamic_bitset.h"
+#include "heap.h"
+#include "result_set.h"
+#include "saving.h"
+
+#ifdef FLANN_MAPPED_SIGNATURE_
+#undef FLANN_MAPPED_SIGNATURE_
+#endif
+#define FLANN_MAPPED_SIGNATURE_ "FLANN_MAPPED"
+
+namespace cvflann
+{
+
+/**
+ * Header of the mappable index file. The file has no pointers: the features, the tree roots
+ * and the tree nodes are stored in sections given by their offsets from the file start,
+ * which are aligned to MAPPED_INDEX_ALIGNMENT bytes. The values are in the native byte order.
+ */
+struct MappedIndexHeader
+{
+    char signature[16];
+    int version;
+    int data_type;      // flann_datatype_t of the features
+    int index_type;     // FLANN_INDEX_KDTREE or FLANN_INDEX_LINEAR
+    int distance_type;  // flann_distance_t the index was built for
+    int trees;          // number of kd-trees, 0 for the linear index
+    int node_size;      // size of a tree node, it depends on the distance type
+    uint64 rows;
+    uint64 cols;
+    uint64 data_offset;
+    uint64 roots_offset;
+    uint64 nodes_offset;
+    uint64 node_count;
+    uint64 file_size;
+};
+
+enum
+{
+    MAPPED_INDEX_VERSION = 1,
+    MAPPED_INDEX_ALIGNMENT = 64
+};
+
+/**
+ * Node of a kd-tree in the mappable index, the nodes of a tree are stored in depth-first order.
+ */
+template <typename DistanceType>
+struct MappedNode
+{
+    int child1;     // indices of the children in the node array, -1 for the leaves
+    int child2;
+    int divfeat;    // dimension used for subdivision, index of the point for the leaves
+    DistanceType divval;
+};
+
+/**
+ * Checks the header of the mappable index in memory.
+ * @return the header or NULL if the data is not a mappable index
+ */
+inline const MappedIndexHeader* get_mapped_header(const void* data, size_t size)
+{
+    const MappedIndexHeader* header = (const MappedIndexHeader*)data;
+    if (data == NULL || size < sizeof(MappedIndexHeader) ||
+        strncmp(header->signature, FLANN_MAPPED_SIGNATURE_, sizeof(header->signature)) != 0 ||
+        header->version != MAPPED_INDEX_VERSION || header->file_size != size) {
+        return NULL;
+    }
+    return header;
+}
+
+/**
+ * Distance accumulated along one dimension when the kd-tree search crosses a split. The Hamming
+ * distances don't define it and are never used with the kd-trees, zero keeps the bound valid.
+ */
+template <typename Distance, typename U, typename V>
+inline typename Distance::ResultType mapped_accum_dist(const Distance& distance, const U& a, const V& b, int dim)
+{
+    return distance.accum_dist(a, b, dim);
+}
+
+template <typename U, typename V>
+inline HammingLUT::ResultType mapped_accum_dist(const HammingLUT&, const U&, const V&, int)
+{
+    return 0;
+}
+
+template <typename T, typename U, typename V>
+inline typename Hamming<T>::ResultType mapped_accum_dist(const Hamming<T>&, const U&, const V&, int)
+{
+    return 0;
+}
+
+template <typename T, typename U, typename V>
+inline typename Hamming2<T>::ResultType mapped_accum_dist(const Hamming2<T>&, const U&, const V&, int)
+{
+    return 0;
+}
+
+/**
+ * Kd-tree or linear index which searches the features and the trees in place, e.g. in a memory
+ * mapped file, so the processes mapping the same file share its pages. The index can't be
+ * modified, it is created with MappedIndex::save() from a built kd-tree or linear index.
+ */
+template <typename Distance>
+class MappedIndex : public NNIndex<Distance>
+{
+public:
+    typedef typename Distance::ElementType ElementType;
+    typedef typename Distance::ResultType DistanceType;
+    typedef MappedNode<DistanceType> Node;
+
+    /**
+     * @param data the saved index, it is used in place
+     * @param size size of the saved index in bytes
+     * @param storage the owner of the data, it is kept while the index exists
+     */
+    MappedIndex(const void* data, size_t size, const cv::Ptr<void>& storage = cv::Ptr<void>(),
+                Distance d = Distance())
+        : storage_(storage), base_((const uchar*)data), distance_(d)
+    {
+        const MappedIndexHeader* header = get_mapped_header(data, size);
+        if (header == NULL) {
+            throw FLANNException("Invalid mapped index");
+        }
+        if (header->data_type != Datatype<ElementType>::type() || header->node_size != (int)sizeof(Node)) {
+            throw FLANNException("The mapped index was saved for another data or distance type");
+        }
+        if ((header->index_type != FLANN_INDEX_KDTREE && header->index_type != FLANN_INDEX_LINEAR) ||
+            header->trees < 0 || (header->index_type == FLANN_INDEX_LINEAR && header->trees != 0) ||
+            header->rows > (uint64)INT_MAX || header->node_count > (uint64)INT_MAX ||
+            (header->cols != 0 && header->rows > (uint64)-1/header->cols)) {
+            throw FLANNException("Invalid mapped index");
+        }
+        if (!fits(header->data_offset, header->rows*header->cols, sizeof(ElementType), size) ||
+            !fits(header->roots_offset, (uint64)header->trees, sizeof(int), size) ||
+            !fits(header->nodes_offset, header->node_count, sizeof(Node), size)) {
+            throw FLANNException("The mapped index is truncated");
+        }
+        size_ = (size_t)header->rows;
+        veclen_ = (size_t)header->cols;
+        trees_ = header->trees;
+        index_type_ = (flann_algorithm_t)header->index_type;
+        data_ = (const ElementType*)(base_ + header->data_offset);
+        roots_ = (const int*)(base_ + header->roots_offset);
+        nodes_ = (const Node*)(base_ + header->nodes_offset);
+        checkTrees((int)header->node_count);
+
+        index_params_["algorithm"] = index_type_;
+        if (index_type_ == FLANN_INDEX_KDTREE) {
+            index_params_["trees"] = trees_;
+        }
+    }
+
+    /**
+     * Saves the kd-tree or linear index with its features in the mappable format.
+     */
+    static void save(FILE* stream, NNIndex<Distance>& index, int distance_type)
+    {
+        if (MappedIndex* mapped = dynamic_cast<MappedIndex*>(&index)) {
+            const MappedIndexHeader* header = (const MappedIndexHeader*)mapped->base_;
+            uint64 pos = 0;
+            write(stream, pos, header, (size_t)header->file_size);
+            return;
+        }
+
+        std::vector<const ElementType*> points;
+        std::vector<std::vector<Node> > trees;
+        if (KDTreeIndex<Distance>* kdtree = dynamic_cast<KDTreeIndex<Distance>*>(&index)) {
+            if (kdtree->removed_count_ > 0) {
+                throw FLANNException("Index with removed points can't be saved, rebuild it first");
+            }
+            points.assign(kdtree->points_.begin(), kdtree->points_.end());
+            trees.resize(kdtree->trees_);
+            for (int i = 0; i < kdtree->trees_; ++i) {
+                if (kdtree->tree_roots_[i] != NULL) {
+                    flattenTree(trees[i], kdtree->tree_roots_[i]);
+                }
+            }
+        }
+        else if (LinearIndex<Distance>* linear = dynamic_cast<LinearIndex<Distance>*>(&index)) {
+            if (linear->removed_count_ > 0) {
+                throw FLANNException("Index with removed points can't be saved");
+            }
+            for (size_t i = 0; i < linear->dataset_.rows; ++i) {
+                points.push_back(linear->dataset_[i]);
+            }
+            points.insert(points.end(), linear->added_points_.begin(), linear->added_points_.end());
+        }
+        else {
+            throw FLANNException("Only kd-tree and linear indices can be saved in the mappable format");
+        }
+
+        MappedIndexHeader header;
+        memset(&header, 0, sizeof(header));
+        strcpy(header.signature, FLANN_MAPPED_SIGNATURE_);
+        header.version = MAPPED_INDEX_VERSION;
+        header.data_type = Datatype<ElementType>::type();
+        header.index_type = index.getType();
+        header.distance_type = distance_type;
+        header.trees = (int)trees.size();
+        header.node_size = (int)sizeof(Node);
+        header.rows = points.size();
+        header.cols = index.veclen();
+
+        std::vector<int> roots(trees.size());
+        for (size_t i = 0; i < trees.size(); ++i) {
+            roots[i] = trees[i].empty() ? -1 : (int)header.node_count;
+            header.node_count += trees[i].size();
+        }
+        header.data_offset = align(sizeof(header));
+        header.roots_offset = align(header.data_offset + header.rows*header.cols*sizeof(ElementType));
+        header.nodes_offset = align(header.roots_offset + roots.size()*sizeof(int));
+        header.file_size = header.nodes_offset + header.node_count*sizeof(Node);
+
+        uint64 pos = 0;
+        write(stream, pos, &header, sizeof(header));
+        pad(stream, pos, header.data_offset);
+        for (size_t i = 0; i < points.size(); ++i) {
+            write(stream, pos, points[i], (size_t)header.cols*sizeof(ElementType));
+        }
+        pad(stream, pos, header.roots_offset);
+        if (!roots.empty()) {
+            write(stream, pos, &roots[0], roots.size()*sizeof(int));
+        }
+        pad(stream, pos, header.nodes_offset);
+        // the children indices are relative to the tree start, they are made global
+        int first = 0;
+        for (size_t i = 0; i < trees.size(); ++i) {
+            std::vector<Node>& nodes = trees[i];
+            for (size_t j = 0; j < nodes.size(); ++j) {
+                if (nodes[j].child1 >= 0) {
+                    nodes[j].child1 += first;
+                    nodes[j].child2 += first;
+                }
+            }
+            if (!nodes.empty()) {
+                write(stream, pos, &nodes[0], nodes.size()*sizeof(Node));
+            }
+            first += (int)nodes.size();
+        }
+    }
+
+    flann_algorithm_t getType() const
+    {
+        return index_type_;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    size_t veclen() const
+    {
+        return veclen_;
+    }
+
+    /**
+     * The index data is not allocated by the index.
+     */
+    int usedMemory() const
+    {
+        return 0;
+    }
+
+    void buildIndex()
+    {
+        /* the index is built when it is saved */
+    }
+
+    void saveIndex(FILE*)
+    {
+        throw FLANNException("The mapped index can be saved in the mappable format only");
+    }
+
+    void loadIndex(FILE*)
+    {
+        throw FLANNException("The mapped index can't be loaded from a stream");
+    }
+
+    IndexParams getParameters() const
+    {
+        return index_params_;
+    }
+
+    void findNeighbors(ResultSet<DistanceType>& result, const ElementType* vec, const SearchParams& searchParams)
+    {
+        if (trees_ == 0) {
+            for (size_t i = 0; i < size_; ++i) {
+                DistanceType dist = distance_(data_ + i*veclen_, vec, veclen_);
+                result.addPoint(dist, (int)i);
+            }
+            return;
+        }
+
+        int maxChecks = get_param(searchParams,"checks", 32);
+        float epsError = 1+get_param(searchParams,"eps",0.0f);
+
+        if (maxChecks==FLANN_CHECKS_UNLIMITED) {
+            if (roots_[0] >= 0) {
+                searchLevelExact(result, vec, roots_[0], 0.0, epsError);
+            }
+        }
+        else {
+            getNeighbors(result, vec, maxChecks, epsError);
+        }
+    }
+
+private:
+    typedef BranchStruct<int, DistanceType> BranchSt;
+
+    MappedIndex(const MappedIndex&); // copy disabled
+    MappedIndex& operator=(const MappedIndex&); // assign disabled
+
+    /**
+     * Checks that count elements of elem_size bytes starting at offset lie in the data of the given size.
+     * The offsets are aligned by save(), so the sections can be accessed in place.
+     */
+    static bool fits(uint64 offset, uint64 count, size_t elem_size, size_t size)
+    {
+        return offset % MAPPED_INDEX_ALIGNMENT == 0 && offset <= size &&
+               count <= (size - offset)/elem_size;
+    }
+
+    /**
+     * Checks the roots and the nodes read from the file, so the searches stay in the mapped data.
+     * The nodes are in depth-first order, the children following their parent ensures the trees have no cycles.
+     */
+    void checkTrees(int node_count) const
+    {
+        for (int i = 0; i < trees_; ++i) {
+            if (roots_[i] < -1 || roots_[i] >= node_count) {
+                throw FLANNException("Invalid tree root in the mapped index");
+            }
+        }
+        for (int i = 0; i < node_count; ++i) {
+            const Node& node = nodes_[i];
+            bool valid;
+            if (node.child1 < 0) {
+                valid = node.child1 == -1 && node.child2 == -1 &&
+                        node.divfeat >= 0 && (size_t)node.divfeat < size_;
+            }
+            else {
+                valid = node.child1 > i && node.child1 < node_count &&
+                        node.child2 > i && node.child2 < node_count &&
+                        node.divfeat >= 0 && (size_t)node.divfeat < veclen_;
+            }
+            if (!valid) {
+                throw FLANNException("Invalid tree node in the mapped index");
+            }
+        }
+    }
+
+    static uint64 align(uint64 offset)
+    {
+        return (offset + MAPPED_INDEX_ALIGNMENT - 1) & ~(uint64)(MAPPED_INDEX_ALIGNMENT - 1);
+    }
+
+    static void write(FILE* stream, uint64& pos, const void* data, size_t size)
+    {
+        if (std::fwrite(data, 1, size, stream) != size) {
+            throw FLANNException("Cannot write the mapped index");
+        }
+        pos += size;
+    }
+
+    static void pad(FILE* stream, uint64& pos, uint64 offset)
+    {
+        static const char zeros[MAPPED_INDEX_ALIGNMENT] = {0};
+        assert(offset >= pos && offset - pos <= MAPPED_INDEX_ALIGNMENT);
+        write(stream, pos, zeros, (size_t)(offset - pos));
+    }
+
+    /**
+     * Appends the subtree to the node array in depth-first order.
+     * @return index of the subtree root in the array
+     */
+    static int flattenTree(std::vector<Node>& nodes, typename KDTreeIndex<Distance>::NodePtr tree)
+    {
+        int idx = (int)nodes.size();
+        nodes.push_back(Node());
+        nodes[idx].divfeat = tree->divfeat;
+        nodes[idx].divval = tree->divval;
+        if ((tree->child1 == NULL) && (tree->child2 == NULL)) {
+            nodes[idx].child1 = nodes[idx].child2 = -1;
+        }
+        else {
+            int child1 = flattenTree(nodes, tree->child1);
+            int child2 = flattenTree(nodes, tree->child2);
+            nodes[idx].child1 = child1;
+            nodes[idx].child2 = child2;
+        }
+        return idx;
+    }
+
+    /**
+     * Same search as in KDTreeIndex, the nodes are addressed by their indices.
+     */
+    void getNeighbors(ResultSet<DistanceType>& result, const ElementType* vec, int maxCheck, float epsError)
+    {
+        BranchSt branch;
+
+        int checkCount = 0;
+        Heap<BranchSt>* heap = new Heap<BranchSt>((int)size_);
+        DynamicBitset checked(size_);
+
+        /* Search once through each tree down to root. */
+        for (int i = 0; i < trees_; ++i) {
+            if (roots_[i] >= 0) {
+                searchLevel(result, vec, roots_[i], 0, checkCount, maxCheck, epsError, heap, checked);
+            }
+        }
+
+        /* Keep searching other branches from heap until finished. */
+        while ( heap->popMin(branch) && (checkCount < maxCheck || !result.full() )) {
+            searchLevel(result, vec, branch.node, branch.mindist, checkCount, maxCheck, epsError, heap, checked);
+        }
+
+        delete heap;
+    }
+
+    void searchLevel(ResultSet<DistanceType>& result_set, const ElementType* vec, int nodeIdx, DistanceType mindist,
+                     int& checkCount, int maxCheck, float epsError, Heap<BranchSt>* heap, DynamicBitset& checked)
+    {
+        if (result_set.worstDist()<mindist) {
+            return;
+        }
+
+        const Node& node = nodes_[nodeIdx];
+        if (node.child1 < 0) {
+            int index = node.divfeat;
+            if ( checked.test(index) || ((checkCount>=maxCheck)&& result_set.full()) ) return;
+            checked.set(index);
+            checkCount++;
+
+            DistanceType dist = distance_(data_ + index*veclen_, vec, veclen_);
+            result_set.addPoint(dist,index);
+            return;
+        }
+
+        ElementType val = vec[node.divfeat];
+        DistanceType diff = val - node.divval;
+        int bestChild = (diff < 0) ? node.child1 : node.child2;
+        int otherChild = (diff < 0) ? node.child2 : node.child1;
+
+        DistanceType new_distsq = mindist + mapped_accum_dist(distance_, val, node.divval, node.divfeat);
+        if ((new_distsq*epsError < result_set.worstDist())||  !result_set.full()) {
+            heap->insert( BranchSt(otherChild, new_distsq) );
+        }
+
+        searchLevel(result_set, vec, bestChild, mindist, checkCount, maxCheck, epsError, heap, checked);
+    }
+
+    void searchLevelExact(ResultSet<DistanceType>& result_set, const ElementType* vec, int nodeIdx, DistanceType mindist,
+                          const float epsError)
+    {
+        const Node& node = nodes_[nodeIdx];
+        if (node.child1 < 0) {
+            int index = node.divfeat;
+            DistanceType dist = distance_(data_ + index*veclen_, vec, veclen_);
+            result_set.addPoint(dist,index);
+            return;
+        }
+
+        ElementType val = vec[node.divfeat];
+        DistanceType diff = val - node.divval;
+        int bestChild = (diff < 0) ? node.child1 : node.child2;
+        int otherChild = (diff < 0) ? node.child2 : node.child1;
+
+        DistanceType new_distsq = mindist + mapped_accum_dist(distance_, val, node.divval, node.divfeat);
+
+        searchLevelExact(result_set, vec, bestChild, mindist, epsError);
+
+        if (new_distsq*epsError<=result_set.worstDist()) {
+            searchLevelExact(result_set, vec, otherChild, new_distsq, epsError);
+        }
+    }
+
+    /** Owner of the mapped data */
+    cv::Ptr<void> storage_;
+    /** The saved index, the header is followed by the sections */
+    const uchar* base_;
+
+    const ElementType* data_;
+    const int* roots_;
+    const Node* nodes_;
+
+    size_t size_;
+    size_t veclen_;
+    int trees_;
+    flann_algorithm_t index_type_;
+
+    IndexParams index_params_;
+    Distance distance_;
+};
+
+}
+
+#endif // OPENCV_FLANN_MAPPED_INDEX_H_
@@ -80,6 +80,9 @@ private:
     IndexParams& operator=(const IndexParams &); // assign disabled
 };
 
+// The integer "cores" parameter of the kd-tree and k-means index parameters sets how many trees
+// (kd-tree) or top level clusters (k-means) are built in parallel, 0 lets OpenCV choose it.
+// It is 1 by default, the index is built sequentially then.
 struct CV_EXPORTS KDTreeIndexParams : public IndexParams
 {
     KDTreeIndexParams(int trees=4);
@@ -119,11 +122,25 @@ struct CV_EXPORTS LshIndexParams : public IndexParams
     LshIndexParams(int table_number, int key_size, int multi_probe_level);
 };
 
+/** @brief Parameters of the inverted file index with product quantization.
+
+The features are stored as subquantizers bytes and an id, so the index takes a fraction of the memory
+of the features, which don't need to be kept after the index is built. The returned distances are
+approximations. The integer "probes" search parameter sets how many inverted lists are scanned.
+Supported by the L1 and L2 distances.
+*/
+struct CV_EXPORTS IvfPqIndexParams : public IndexParams
+{
+    IvfPqIndexParams(int lists = 256, int subquantizers = 8, int bits = 8, int train_size = 65536, int iterations = 10);
+};
+
 struct CV_EXPORTS SavedIndexParams : public IndexParams
 {
     SavedIndexParams(const String& filename);
 };
 
+// The integer "cores" search parameter sets how many query batches Index::knnSearch processes
+// in parallel, 0 lets OpenCV choose it. It is 1 by default.
 struct CV_EXPORTS SearchParams : public IndexParams
 {
     SearchParams( int checks = 32, float eps = 0, bool sorted = true );
@@ -144,8 +161,32 @@ public:
                              OutputArray dists, double radius, int maxResults,
                              const SearchParams& params=SearchParams());
 
+    /** @brief Incrementally adds the features to the built index.
+
+    The new features get the ids which follow the ones already in the index. As for build(), the data is
+    not copied so it must be kept alive while the index is used. The tree based indices are rebuilt when
+    their size grows by rebuildThreshold times. Supported by the linear, kd-tree, k-means, LSH and IVF-PQ
+    indices, the IVF-PQ quantizers are not retrained.
+    */
+    CV_WRAP void addPoints(InputArray features, float rebuildThreshold=2.f);
+    /** @brief Removes the feature from the index, it is not returned by the searches anymore.
+    */
+    CV_WRAP void removePoint(int id);
+
     CV_WRAP virtual void save(const String& filename) const;
     CV_WRAP virtual bool load(InputArray features, const String& filename);
+    /** @brief Saves the kd-tree or linear index together with the features in a pointer-free format.
+
+    The file is used in place by loadMapped(), so the features don't need to be passed when it is loaded.
+    */
+    CV_WRAP void saveMappable(const String& filename) const;
+    /** @brief Maps the index saved by saveMappable() into memory.
+
+    The trees and the features are searched directly in the mapped file, so the features are not read when
+    the index is loaded and the processes mapping the same file share its pages. Only the tree nodes are
+    checked, false is returned for a corrupted file. The index can't be modified.
+    */
+    CV_WRAP bool loadMapped(const String& filename);
     CV_WRAP virtual void release();
     CV_WRAP cvflann::flann_distance_t getDistance() const;
     CV_WRAP cvflann::flann_algorithm_t getAlgorithm() const;
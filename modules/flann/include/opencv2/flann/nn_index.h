@@ -36,6 +36,9 @@
 #include "result_set.h"
 #include "params.h"
 
+#include <algorithm>
+#include <limits>
+
 namespace cvflann
 {
 
@@ -57,6 +60,29 @@ public:
      */
     virtual void buildIndex() = 0;
 
+    /**
+     * \brief Incrementally adds points to the index
+     * \param[in] points Matrix with the new points. As with the dataset the index is built
+     *            from, the data is not copied and must stay valid while the index is used.
+     * \param[in] rebuild_threshold The index is rebuilt from scratch when the number of points
+     *            exceeds this factor of the number of points at the last build.
+     * The new points get the ids following the ids of the points already in the index.
+     */
+    virtual void addPoints(const Matrix<ElementType>& /*points*/, float /*rebuild_threshold*/ = 2)
+    {
+        throw FLANNException("Incremental insertion is not supported by this index type");
+    }
+
+    /**
+     * \brief Removes a point from the index
+     * \param[in] id The id of the point to remove
+     * The point is not returned by the searches anymore, the ids of other points are preserved.
+     */
+    virtual void removePoint(size_t /*id*/)
+    {
+        throw FLANNException("Removing points is not supported by this index type");
+    }
+
     /**
      * \brief Perform k-nearest neighbor search
      * \param[in] queries The query points for which to find the nearest neighbors
@@ -73,21 +99,15 @@ public:
         assert(int(indices.cols) >= knn);
         assert(int(dists.cols) >= knn);
 
-#if 0
-        KNNResultSet<DistanceType> resultSet(knn);
-        for (size_t i = 0; i < queries.rows; i++) {
-            resultSet.init(indices[i], dists[i]);
-            findNeighbors(resultSet, queries[i], params);
+        // "cores" is the number of query batches processed in parallel, 0 lets OpenCV choose it
+        int cores = get_param(params,"cores",1);
+        KnnSearchInvoker invoker(this, queries, indices, dists, knn, params);
+        if (cores == 1 || queries.rows < 2) {
+            invoker(cv::Range(0, (int)queries.rows));
         }
-#else
-        KNNUniqueResultSet<DistanceType> resultSet(knn);
-        for (size_t i = 0; i < queries.rows; i++) {
-            resultSet.clear();
-            findNeighbors(resultSet, queries[i], params);
-            if (get_param(params,"sorted",true)) resultSet.sortAndCopy(indices[i], dists[i], knn);
-            else resultSet.copy(indices[i], dists[i], knn);
+        else {
+            cv::parallel_for_(cv::Range(0, (int)queries.rows), invoker, cores > 0 ? cores : -1);
         }
-#endif
     }
 
     /**
@@ -170,6 +190,44 @@ public:
      * \brief Method that searches for nearest-neighbours
      */
     virtual void findNeighbors(ResultSet<DistanceType>& result, const ElementType* vec, const SearchParams& searchParams) = 0;
+
+protected:
+    /**
+     * Searches the range of queries with its own result set, so the ranges can be processed in parallel.
+     * The neighbors which are not found are filled with -1 indices.
+     */
+    class KnnSearchInvoker : public cv::ParallelLoopBody
+    {
+    public:
+        KnnSearchInvoker(NNIndex* index, const Matrix<ElementType>& queries, Matrix<int>& indices,
+                         Matrix<DistanceType>& dists, int knn, const SearchParams& params)
+            : index_(index), queries_(queries), indices_(indices), dists_(dists), knn_(knn), params_(params),
+              sorted_(get_param(params,"sorted",true))
+        {
+        }
+
+        void operator()(const cv::Range& range) const
+        {
+            KNNUniqueResultSet<DistanceType> resultSet(knn_);
+            for (int i = range.start; i < range.end; i++) {
+                resultSet.clear();
+                std::fill_n(indices_[i], knn_, -1);
+                std::fill_n(dists_[i], knn_, std::numeric_limits<DistanceType>::max());
+                index_->findNeighbors(resultSet, queries_[i], params_);
+                if (sorted_) resultSet.sortAndCopy(indices_[i], dists_[i], knn_);
+                else resultSet.copy(indices_[i], dists_[i], knn_);
+            }
+        }
+
+    private:
+        NNIndex* index_;
+        const Matrix<ElementType>& queries_;
+        Matrix<int>& indices_;
+        Matrix<DistanceType>& dists_;
+        int knn_;
+        const SearchParams& params_;
+        bool sorted_;
+    };
 };
 
 }
@@ -1,5 +1,14 @@
 #include "precomp.hpp"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #define MINIFLANN_SUPPORT_EXOTIC_DISTANCE_TYPES 0
 
 static cvflann::IndexParams& get_params(const cv::flann::IndexParams& p)
@@ -285,6 +294,22 @@ LshIndexParams::LshIndexParams(int table_number, int key_size, int multi_probe_l
     p["multi_probe_level"] = multi_probe_level;
 }
 
+IvfPqIndexParams::IvfPqIndexParams(int lists, int subquantizers, int bits, int train_size, int iterations)
+{
+    ::cvflann::IndexParams& p = get_params(*this);
+    p["algorithm"] = FLANN_INDEX_IVF_PQ;
+    // number of the inverted lists, i.e. clusters of the coarse quantizer
+    p["lists"] = lists;
+    // number of the sub-vectors every feature is split into, each one is encoded by one byte
+    p["subquantizers"] = subquantizers;
+    // number of bits of the sub-vector codes, up to 8
+    p["bits"] = bits;
+    // number of the features sampled to train the quantizers, 0 uses all of them
+    p["train_size"] = train_size;
+    // max iterations of the k-means clustering used to train the quantizers
+    p["iterations"] = iterations;
+}
+
 SavedIndexParams::SavedIndexParams(const String& _filename)
 {
     String filename = _filename;
@@ -607,6 +632,117 @@ void Index::knnSearch(InputArray _query, OutputArray _indices,
     }
 }
 
+template<typename Distance>
+void runAddPoints(void* index, const Mat& data, float rebuildThreshold)
+{
+    typedef typename Distance::ElementType ElementType;
+    if(DataType<ElementType>::type != data.type())
+        CV_Error_(Error::StsUnsupportedFormat, ("type=%d\n", data.type()));
+    if(!data.isContinuous())
+        CV_Error(Error::StsBadArg, "Only continuous arrays are supported");
+
+    ::cvflann::Matrix<ElementType> points((ElementType*)data.data, data.rows, data.cols);
+    ((::cvflann::Index<Distance>*)index)->addPoints(points, rebuildThreshold);
+}
+
+template<typename Distance>
+void runRemovePoint(void* index, int id)
+{
+    ((::cvflann::Index<Distance>*)index)->removePoint((size_t)id);
+}
+
+static bool isIncrementalAlgorithm(flann_algorithm_t algo)
+{
+    return algo == FLANN_INDEX_LINEAR || algo == FLANN_INDEX_KDTREE ||
+           algo == FLANN_INDEX_KMEANS || algo == FLANN_INDEX_LSH || algo == FLANN_INDEX_IVF_PQ;
+}
+
+void Index::addPoints(InputArray _features, float rebuildThreshold)
+{
+    CV_INSTRUMENT_REGION()
+
+    CV_Assert(index != 0);
+    if( !isIncrementalAlgorithm(algo) )
+        CV_Error( Error::StsNotImplemented, "The index type does not support adding points" );
+    Mat features = _features.getMat();
+    if( features.empty() )
+        return;
+    CV_Assert(features.type() == featureType);
+
+    switch( distType )
+    {
+    case FLANN_DIST_HAMMING:
+        runAddPoints<HammingDistance>(index, features, rebuildThreshold);
+        break;
+    case FLANN_DIST_L2:
+        runAddPoints< ::cvflann::L2<float> >(index, features, rebuildThreshold);
+        break;
+    case FLANN_DIST_L1:
+        runAddPoints< ::cvflann::L1<float> >(index, features, rebuildThreshold);
+        break;
+#if MINIFLANN_SUPPORT_EXOTIC_DISTANCE_TYPES
+    case FLANN_DIST_MAX:
+        runAddPoints< ::cvflann::MaxDistance<float> >(index, features, rebuildThreshold);
+        break;
+    case FLANN_DIST_HIST_INTERSECT:
+        runAddPoints< ::cvflann::HistIntersectionDistance<float> >(index, features, rebuildThreshold);
+        break;
+    case FLANN_DIST_HELLINGER:
+        runAddPoints< ::cvflann::HellingerDistance<float> >(index, features, rebuildThreshold);
+        break;
+    case FLANN_DIST_CHI_SQUARE:
+        runAddPoints< ::cvflann::ChiSquareDistance<float> >(index, features, rebuildThreshold);
+        break;
+    case FLANN_DIST_KL:
+        runAddPoints< ::cvflann::KL_Divergence<float> >(index, features, rebuildThreshold);
+        break;
+#endif
+    default:
+        CV_Error(Error::StsBadArg, "Unknown/unsupported distance type");
+    }
+}
+
+void Index::removePoint(int id)
+{
+    CV_INSTRUMENT_REGION()
+
+    CV_Assert(index != 0 && id >= 0);
+    if( !isIncrementalAlgorithm(algo) )
+        CV_Error( Error::StsNotImplemented, "The index type does not support removing points" );
+
+    switch( distType )
+    {
+    case FLANN_DIST_HAMMING:
+        runRemovePoint<HammingDistance>(index, id);
+        break;
+    case FLANN_DIST_L2:
+        runRemovePoint< ::cvflann::L2<float> >(index, id);
+        break;
+    case FLANN_DIST_L1:
+        runRemovePoint< ::cvflann::L1<float> >(index, id);
+        break;
+#if MINIFLANN_SUPPORT_EXOTIC_DISTANCE_TYPES
+    case FLANN_DIST_MAX:
+        runRemovePoint< ::cvflann::MaxDistance<float> >(index, id);
+        break;
+    case FLANN_DIST_HIST_INTERSECT:
+        runRemovePoint< ::cvflann::HistIntersectionDistance<float> >(index, id);
+        break;
+    case FLANN_DIST_HELLINGER:
+        runRemovePoint< ::cvflann::HellingerDistance<float> >(index, id);
+        break;
+    case FLANN_DIST_CHI_SQUARE:
+        runRemovePoint< ::cvflann::ChiSquareDistance<float> >(index, id);
+        break;
+    case FLANN_DIST_KL:
+        runRemovePoint< ::cvflann::KL_Divergence<float> >(index, id);
+        break;
+#endif
+    default:
+        CV_Error(Error::StsBadArg, "Unknown/unsupported distance type");
+    }
+}
+
 int Index::radiusSearch(InputArray _query, OutputArray _indices,
                         OutputArray _dists, double radius, int maxResults,
                         const SearchParams& params)
@@ -742,6 +878,17 @@ bool loadIndex(Index* index0, void*& index, const Mat& data, FILE* fin, const Di
     return loadIndex_<Distance, ::cvflann::Index<Distance> >(index0, index, data, fin, dist);
 }
 
+static int flannDatatypeToType(int dataType)
+{
+    return dataType == FLANN_UINT8 ? CV_8U :
+           dataType == FLANN_INT8 ? CV_8S :
+           dataType == FLANN_UINT16 ? CV_16U :
+           dataType == FLANN_INT16 ? CV_16S :
+           dataType == FLANN_INT32 ? CV_32S :
+           dataType == FLANN_FLOAT32 ? CV_32F :
+           dataType == FLANN_FLOAT64 ? CV_64F : -1;
+}
+
 bool Index::load(InputArray _data, const String& filename)
 {
     Mat data = _data.getMat();
@@ -753,13 +900,7 @@ bool Index::load(InputArray _data, const String& filename)
 
     ::cvflann::IndexHeader header = ::cvflann::load_header(fin);
     algo = header.index_type;
-    featureType = header.data_type == FLANN_UINT8 ? CV_8U :
-                  header.data_type == FLANN_INT8 ? CV_8S :
-                  header.data_type == FLANN_UINT16 ? CV_16U :
-                  header.data_type == FLANN_INT16 ? CV_16S :
-                  header.data_type == FLANN_INT32 ? CV_32S :
-                  header.data_type == FLANN_FLOAT32 ? CV_32F :
-                  header.data_type == FLANN_FLOAT64 ? CV_64F : -1;
+    featureType = flannDatatypeToType(header.data_type);
 
     if( (int)header.rows != data.rows || (int)header.cols != data.cols ||
         featureType != data.type() )
@@ -820,6 +961,173 @@ bool Index::load(InputArray _data, const String& filename)
     return ok;
 }
 
+template<typename Distance>
+void saveMappedIndex(const void* index, FILE* fout, flann_distance_t distType)
+{
+    ((::cvflann::Index<Distance>*)index)->saveMapped(fout, (int)distType);
+}
+
+void Index::saveMappable(const String& filename) const
+{
+    CV_INSTRUMENT_REGION()
+
+    CV_Assert(index != 0);
+    if( algo != FLANN_INDEX_KDTREE && algo != FLANN_INDEX_LINEAR )
+        CV_Error( Error::StsNotImplemented, "Only kd-tree and linear indices can be saved in the mappable format" );
+
+    FILE* fout = fopen(filename.c_str(), "wb");
+    if (fout == NULL)
+        CV_Error_( Error::StsError, ("Can not open file %s for writing FLANN index\n", filename.c_str()) );
+
+    try
+    {
+        switch( distType )
+        {
+        case FLANN_DIST_HAMMING:
+            saveMappedIndex< HammingDistance >(index, fout, distType);
+            break;
+        case FLANN_DIST_L2:
+            saveMappedIndex< ::cvflann::L2<float> >(index, fout, distType);
+            break;
+        case FLANN_DIST_L1:
+            saveMappedIndex< ::cvflann::L1<float> >(index, fout, distType);
+            break;
+        default:
+            CV_Error(Error::StsBadArg, "Unsupported distance type for the mappable index");
+        }
+    }
+    catch (...)
+    {
+        fclose(fout);
+        throw;
+    }
+    fclose(fout);
+}
+
+namespace
+{
+
+// Read-only mapping of a whole file, the pages are shared with other processes mapping it.
+struct MappedFile
+{
+    MappedFile() : data(0), size(0)
+#ifdef _WIN32
+        , file(INVALID_HANDLE_VALUE), mapping(NULL)
+#endif
+    {}
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+#else
+        if (data)
+            munmap(data, size);
+#endif
+    }
+
+    bool open(const String& filename)
+    {
+#ifdef _WIN32
+        file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+            return false;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping)
+            return false;
+        data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        size = (size_t)fileSize.QuadPart;
+        return data != NULL;
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED)
+            return false;
+        data = addr;
+        size = (size_t)st.st_size;
+        return true;
+#endif
+    }
+
+    void* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#endif
+};
+
+}
+
+template<typename Distance>
+void loadMappedIndex(void*& index, const Ptr<MappedFile>& file)
+{
+    ::cvflann::MappedIndex<Distance>* mapped =
+        new ::cvflann::MappedIndex<Distance>(file->data, file->size, file);
+    index = new ::cvflann::Index<Distance>(mapped);
+}
+
+bool Index::loadMapped(const String& filename)
+{
+    CV_INSTRUMENT_REGION()
+
+    release();
+    Ptr<MappedFile> file = makePtr<MappedFile>();
+    if (!file->open(filename))
+        return false;
+
+    const ::cvflann::MappedIndexHeader* header = ::cvflann::get_mapped_header(file->data, file->size);
+    if (!header)
+    {
+        fprintf(stderr, "Reading FLANN index error: %s is not a mappable index\n", filename.c_str());
+        return false;
+    }
+    algo = (flann_algorithm_t)header->index_type;
+    featureType = flannDatatypeToType(header->data_type);
+    distType = (flann_distance_t)header->distance_type;
+
+    try
+    {
+        switch( distType )
+        {
+        case FLANN_DIST_HAMMING:
+            loadMappedIndex< HammingDistance >(index, file);
+            break;
+        case FLANN_DIST_L2:
+            loadMappedIndex< ::cvflann::L2<float> >(index, file);
+            break;
+        case FLANN_DIST_L1:
+            loadMappedIndex< ::cvflann::L1<float> >(index, file);
+            break;
+        default:
+            fprintf(stderr, "Reading FLANN index error: unsupported distance type %d\n", distType);
+            return false;
+        }
+    }
+    catch (const ::cvflann::FLANNException& e)
+    {
+        fprintf(stderr, "Reading FLANN index error: %s: %s\n", filename.c_str(), e.what());
+        return false;
+    }
+    return true;
+}
+
 }
 
 }
@@ -0,0 +1,110 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+using namespace cv;
+
+static void checkNearest(flann::Index& index, const Mat& data, const std::vector<bool>& removed,
+                         const Mat& queries, int distType)
+{
+    const int knn = 3;
+    Mat indices, dists;
+    index.knnSearch(queries, indices, dists, knn, flann::SearchParams(-1));
+    ASSERT_EQ(queries.rows, indices.rows);
+
+    for (int i = 0; i < queries.rows; i++)
+    {
+        std::vector<double> expected;
+        for (int j = 0; j < data.rows; j++)
+        {
+            if (!removed[j])
+                expected.push_back(norm(queries.row(i), data.row(j), distType));
+        }
+        std::sort(expected.begin(), expected.end());
+        for (int k = 0; k < knn; k++)
+        {
+            int idx = indices.at<int>(i, k);
+            ASSERT_GE(idx, 0);
+            ASSERT_LT(idx, data.rows);
+            EXPECT_FALSE(removed[idx]) << "query " << i;
+            double d = norm(queries.row(i), data.row(idx), distType);
+            EXPECT_NEAR(expected[k], d, 1e-3) << "query " << i << " neighbor " << k;
+        }
+    }
+}
+
+typedef testing::TestWithParam<int> Flann_Incremental;
+
+TEST_P(Flann_Incremental, addRemove)
+{
+    const int algo = GetParam();
+    const int dims = 8, initial = 300, total = 1500, step = 100;
+    RNG& rng = theRNG();
+
+    // All the points live in one buffer, the index refers to its rows.
+    Mat data(total, dims, CV_32F);
+    rng.fill(data, RNG::UNIFORM, 0, 100);
+    Mat queries(50, dims, CV_32F);
+    rng.fill(queries, RNG::UNIFORM, 0, 100);
+
+    Ptr<flann::IndexParams> params;
+    if (algo == cvflann::FLANN_INDEX_KDTREE)
+        params = makePtr<flann::KDTreeIndexParams>(1);
+    else if (algo == cvflann::FLANN_INDEX_KMEANS)
+        params = makePtr<flann::KMeansIndexParams>(8, 5);
+    else
+        params = makePtr<flann::LinearIndexParams>();
+
+    flann::Index index(data.rowRange(0, initial), *params);
+    std::vector<bool> removed(total, false);
+    int count = initial;
+    while (count < total)
+    {
+        index.addPoints(data.rowRange(count, count + step));
+        count += step;
+        for (int i = 0; i < 10; i++)
+        {
+            int id = rng.uniform(0, count);
+            index.removePoint(id);
+            removed[id] = true;
+        }
+        checkNearest(index, data.rowRange(0, count), removed, queries, NORM_L2);
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, Flann_Incremental, testing::Values(
+    (int)cvflann::FLANN_INDEX_LINEAR, (int)cvflann::FLANN_INDEX_KDTREE, (int)cvflann::FLANN_INDEX_KMEANS));
+
+TEST(Flann_IncrementalLsh, addRemove)
+{
+    const int total = 600, initial = 200;
+    RNG& rng = theRNG();
+    Mat data(total, 32, CV_8U);
+    rng.fill(data, RNG::UNIFORM, 0, 256);
+
+    flann::Index index(data.rowRange(0, initial), flann::LshIndexParams(8, 16, 2));
+    index.addPoints(data.rowRange(initial, total));
+    for (int i = 0; i < total; i += 3)
+        index.removePoint(i);
+
+    Mat indices, dists;
+    index.knnSearch(data, indices, dists, 1);
+    for (int i = 0; i < total; i++)
+    {
+        int idx = indices.at<int>(i, 0);
+        if (i % 3 == 0)
+            EXPECT_NE(i, idx);
+        else
+        {
+            // The point itself is always in the probed buckets.
+            EXPECT_EQ(i, idx);
+            EXPECT_EQ(0, dists.at<int>(i, 0));
+        }
+    }
+}
+
+}} // namespace
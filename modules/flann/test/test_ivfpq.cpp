@@ -0,0 +1,114 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+using namespace cv;
+
+// Clustered data, like the descriptors of the similar image patches.
+static Mat makeClusteredData(int rows, int dims, int clusters)
+{
+    RNG& rng = theRNG();
+    Mat centers(clusters, dims, CV_32F), data(rows, dims, CV_32F);
+    rng.fill(centers, RNG::UNIFORM, 0, 100);
+    rng.fill(data, RNG::NORMAL, 0, 5);
+    for (int i = 0; i < rows; i++)
+        data.row(i) += centers.row(rng.uniform(0, clusters));
+    return data;
+}
+
+// Fraction of the queries whose nearest neighbor is among the knn features found by the index.
+static double recall(flann::Index& index, const Mat& data, const Mat& queries, int knn, const flann::SearchParams& params)
+{
+    flann::Index exact(data, flann::LinearIndexParams());
+    Mat expected, indices, dists;
+    exact.knnSearch(queries, expected, dists, 1);
+    index.knnSearch(queries, indices, dists, knn, params);
+    int found = 0;
+    for (int i = 0; i < queries.rows; i++)
+    {
+        for (int k = 0; k < knn; k++)
+            found += indices.at<int>(i, k) == expected.at<int>(i, 0);
+    }
+    return (double)found / queries.rows;
+}
+
+TEST(Flann_IvfPq, search)
+{
+    const int dims = 64;
+    Mat data = makeClusteredData(5000, dims, 32);
+    Mat queries = makeClusteredData(200, dims, 32);
+
+    flann::Index index(data, flann::IvfPqIndexParams(32, 16, 8, 2000));
+    EXPECT_EQ(cvflann::FLANN_INDEX_IVF_PQ, index.getAlgorithm());
+
+    flann::SearchParams params;
+    params.setInt("probes", 8);
+    double r = recall(index, data, queries, 10, params);
+    EXPECT_GT(r, 0.9);
+
+    // probing all the lists can't miss more
+    EXPECT_GE(recall(index, data, queries, 10, flann::SearchParams(-1)), r);
+}
+
+TEST(Flann_IvfPq, memory)
+{
+    const int dims = 128;
+    Mat data = makeClusteredData(10000, dims, 64);
+    cvflann::Matrix<float> dataset((float*)data.data, data.rows, data.cols);
+    cvflann::IvfPqIndex<cvflann::L2<float> > index(dataset, cvflann::IvfPqIndexParams(64, 16, 8, 2000));
+    index.buildIndex();
+    // 16 bytes of codes and 4 bytes of id per feature instead of 512 bytes, plus the quantizers
+    EXPECT_LT(index.usedMemory(), (int)(data.total() * data.elemSize() / 10));
+}
+
+TEST(Flann_IvfPq, saveLoad)
+{
+    Mat data = makeClusteredData(3000, 32, 16);
+    Mat queries = makeClusteredData(50, 32, 16);
+    const String filename = cv::tempfile(".flann");
+
+    flann::Index index(data, flann::IvfPqIndexParams(16, 8, 6));
+    index.removePoint(5);
+    index.save(filename);
+
+    flann::Index loaded(data, flann::SavedIndexParams(filename));
+    EXPECT_EQ(cvflann::FLANN_INDEX_IVF_PQ, loaded.getAlgorithm());
+    Mat indices0, dists0, indices1, dists1;
+    index.knnSearch(queries, indices0, dists0, 5, flann::SearchParams(-1));
+    loaded.knnSearch(queries, indices1, dists1, 5, flann::SearchParams(-1));
+    EXPECT_EQ(0, cvtest::norm(indices0, indices1, NORM_INF));
+    EXPECT_EQ(0, cvtest::norm(dists0, dists1, NORM_INF));
+    remove(filename.c_str());
+}
+
+TEST(Flann_IvfPq, addRemove)
+{
+    Mat data = makeClusteredData(4000, 32, 16);
+    flann::Index index(data.rowRange(0, 2000), flann::IvfPqIndexParams(16, 8));
+    index.addPoints(data.rowRange(2000, 4000));
+    for (int i = 0; i < data.rows; i += 4)
+        index.removePoint(i);
+
+    Mat indices, dists;
+    index.knnSearch(data, indices, dists, 5, flann::SearchParams(-1));
+    int found = 0;
+    for (int i = 0; i < data.rows; i++)
+    {
+        for (int k = 0; k < 5; k++)
+        {
+            int idx = indices.at<int>(i, k);
+            ASSERT_GE(idx, 0);
+            ASSERT_LT(idx, data.rows);
+            EXPECT_NE(0, idx % 4);
+            found += idx == i;
+        }
+    }
+    // the features are found both in the trained and the added part
+    EXPECT_GT(found, data.rows * 3 / 4 * 0.9);
+}
+
+}} // namespace
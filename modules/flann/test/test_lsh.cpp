@@ -0,0 +1,79 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+using namespace cv;
+
+typedef testing::TestWithParam<int> Flann_LshBuckets;
+
+TEST_P(Flann_LshBuckets, allFeatures)
+{
+    const int featureSize = GetParam(), keySize = 12;
+    Mat data(1000, featureSize, CV_8U);
+    theRNG().fill(data, RNG::UNIFORM, 0, 256);
+
+    cvflann::Matrix<uchar> dataset(data.data, data.rows, data.cols);
+    cvflann::lsh::LshTable<uchar> table(featureSize, keySize);
+    table.add(dataset);
+
+    // every feature is in the bucket of its key exactly once
+    std::vector<int> count(data.rows, 0);
+    size_t total = 0;
+    for (cvflann::lsh::BucketKey key = 0; key < (1u << keySize); key++)
+    {
+        size_t size = 0;
+        const cvflann::lsh::FeatureIndex* bucket = table.getBucketFromKey(key, size);
+        for (size_t i = 0; i < size; i++)
+        {
+            ASSERT_LT(bucket[i], (unsigned)data.rows);
+            EXPECT_EQ(key, table.getKey(data.ptr(bucket[i])));
+            count[bucket[i]]++;
+        }
+        total += size;
+    }
+    EXPECT_EQ((size_t)data.rows, total);
+    EXPECT_EQ(1, *std::min_element(count.begin(), count.end()));
+    EXPECT_EQ(1, *std::max_element(count.begin(), count.end()));
+
+    // the key has keySize bits taken from the feature
+    Mat zeros = Mat::zeros(1, featureSize, CV_8U), ones(1, featureSize, CV_8U, Scalar(255));
+    EXPECT_EQ(0u, table.getKey(zeros.ptr()));
+    EXPECT_EQ((size_t)(1u << keySize) - 1, table.getKey(ones.ptr()));
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, Flann_LshBuckets, testing::Values(13, 32, 61));
+
+TEST(Flann_Lsh, nearDuplicates)
+{
+    const int rows = 2000, featureSize = 32;
+    RNG& rng = theRNG();
+    Mat data(rows, featureSize, CV_8U);
+    rng.fill(data, RNG::UNIFORM, 0, 256);
+    // the queries differ from the features by a few bits
+    Mat queries = data.clone();
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < 4; j++)
+            queries.at<uchar>(i, rng.uniform(0, featureSize)) ^= (uchar)(1 << rng.uniform(0, 8));
+    }
+
+    flann::Index index(data, flann::LshIndexParams(12, 20, 2));
+    Mat indices, dists;
+    index.knnSearch(queries, indices, dists, 1);
+    int found = 0;
+    for (int i = 0; i < rows; i++)
+    {
+        int idx = indices.at<int>(i, 0);
+        if (idx < 0)
+            continue;
+        EXPECT_EQ(cvtest::norm(queries.row(i), data.row(idx), NORM_HAMMING), dists.at<int>(i, 0));
+        found += idx == i;
+    }
+    EXPECT_GT(found, rows * 95 / 100);
+}
+
+}} // namespace
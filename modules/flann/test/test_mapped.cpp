@@ -0,0 +1,152 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+using namespace cv;
+
+static void checkSameResults(flann::Index& expected, flann::Index& actual, const Mat& queries,
+                             const flann::SearchParams& searchParams)
+{
+    Mat indices0, dists0, indices1, dists1;
+    expected.knnSearch(queries, indices0, dists0, 5, searchParams);
+    actual.knnSearch(queries, indices1, dists1, 5, searchParams);
+    EXPECT_EQ(0, cvtest::norm(indices0, indices1, NORM_INF));
+    EXPECT_EQ(0, cvtest::norm(dists0, dists1, NORM_INF));
+}
+
+TEST(Flann_Mapped, kdtree)
+{
+    const int dims = 16;
+    RNG& rng = theRNG();
+    Mat data(2000, dims, CV_32F);
+    rng.fill(data, RNG::UNIFORM, 0, 100);
+    Mat queries(100, dims, CV_32F);
+    rng.fill(queries, RNG::UNIFORM, 0, 100);
+    const String filename = cv::tempfile(".flann");
+
+    for (int trees = 1; trees <= 4; trees += 3)
+    {
+        flann::Index index(data, flann::KDTreeIndexParams(trees));
+        index.saveMappable(filename);
+
+        flann::Index mapped;
+        ASSERT_TRUE(mapped.loadMapped(filename));
+        EXPECT_EQ(cvflann::FLANN_INDEX_KDTREE, mapped.getAlgorithm());
+        EXPECT_EQ(cvflann::FLANN_DIST_L2, mapped.getDistance());
+
+        checkSameResults(index, mapped, queries, flann::SearchParams(64));
+        if (trees == 1)
+            checkSameResults(index, mapped, queries, flann::SearchParams(-1));
+
+        // The mapped index refers to the features stored in the file.
+        Mat indices, dists;
+        mapped.knnSearch(data.rowRange(0, 10), indices, dists, 1, flann::SearchParams(-1));
+        for (int i = 0; i < 10; i++)
+            EXPECT_EQ(0.f, dists.at<float>(i, 0));
+    }
+    remove(filename.c_str());
+}
+
+TEST(Flann_Mapped, linearHamming)
+{
+    RNG& rng = theRNG();
+    Mat data(500, 32, CV_8U);
+    rng.fill(data, RNG::UNIFORM, 0, 256);
+    Mat queries(50, 32, CV_8U);
+    rng.fill(queries, RNG::UNIFORM, 0, 256);
+    const String filename = cv::tempfile(".flann");
+
+    flann::Index index(data, flann::LinearIndexParams(), cvflann::FLANN_DIST_HAMMING);
+    index.saveMappable(filename);
+
+    flann::Index mapped;
+    ASSERT_TRUE(mapped.loadMapped(filename));
+    EXPECT_EQ(cvflann::FLANN_INDEX_LINEAR, mapped.getAlgorithm());
+    EXPECT_EQ(cvflann::FLANN_DIST_HAMMING, mapped.getDistance());
+    checkSameResults(index, mapped, queries, flann::SearchParams());
+    remove(filename.c_str());
+}
+
+TEST(Flann_Mapped, invalidFile)
+{
+    const String filename = cv::tempfile(".flann");
+    FILE* f = fopen(filename.c_str(), "wb");
+    ASSERT_TRUE(f != NULL);
+    fputs("not an index", f);
+    fclose(f);
+
+    flann::Index index;
+    EXPECT_FALSE(index.loadMapped(filename));
+    EXPECT_FALSE(index.loadMapped(filename + ".missing"));
+    remove(filename.c_str());
+}
+
+static std::vector<char> readFile(const String& filename)
+{
+    std::vector<char> buf;
+    FILE* f = fopen(filename.c_str(), "rb");
+    if (!f)
+        return buf;
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        buf.insert(buf.end(), chunk, chunk + n);
+    fclose(f);
+    return buf;
+}
+
+static void writeFile(const String& filename, const std::vector<char>& buf)
+{
+    FILE* f = fopen(filename.c_str(), "wb");
+    ASSERT_TRUE(f != NULL);
+    ASSERT_EQ(buf.size(), fwrite(&buf[0], 1, buf.size(), f));
+    fclose(f);
+}
+
+TEST(Flann_Mapped, corruptedFile)
+{
+    RNG& rng = theRNG();
+    Mat data(200, 8, CV_32F);
+    rng.fill(data, RNG::UNIFORM, 0, 100);
+    const String filename = cv::tempfile(".flann");
+
+    flann::Index index(data, flann::KDTreeIndexParams(2));
+    index.saveMappable(filename);
+    const std::vector<char> saved = readFile(filename);
+    ASSERT_GT(saved.size(), sizeof(cvflann::MappedIndexHeader));
+    typedef cvflann::MappedNode<float> Node;
+
+    flann::Index mapped;
+    ASSERT_TRUE(mapped.loadMapped(filename));
+    mapped.release();
+
+    for (int k = 0; k < 7; k++)
+    {
+        std::vector<char> buf = saved;
+        cvflann::MappedIndexHeader* header = (cvflann::MappedIndexHeader*)&buf[0];
+        int* roots = (int*)&buf[(size_t)header->roots_offset];
+        Node* nodes = (Node*)&buf[(size_t)header->nodes_offset];
+        switch (k)
+        {
+        case 0: header->rows = (uint64)-1 / header->cols + 1; break; // rows*cols overflows
+        case 1: header->data_offset = (uint64)-1 - 63; break;       // offset + size overflows
+        case 2: header->node_count++; break;
+        case 3: roots[1] = (int)header->node_count; break;
+        case 4: nodes[roots[0]].child2 = roots[0]; break;            // cycle
+        case 5: nodes[roots[0]].divfeat = data.cols; break;
+        case 6:
+            for (size_t i = 0; i < header->node_count; i++)
+                if (nodes[i].child1 < 0) { nodes[i].divfeat = data.rows; break; }
+            break;
+        }
+        writeFile(filename, buf);
+        EXPECT_FALSE(mapped.loadMapped(filename)) << "case " << k;
+    }
+    remove(filename.c_str());
+}
+
+}} // namespace
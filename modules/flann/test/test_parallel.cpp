@@ -0,0 +1,73 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+using namespace cv;
+
+typedef testing::TestWithParam<int> Flann_Parallel;
+
+TEST_P(Flann_Parallel, buildAndSearch)
+{
+    const int algo = GetParam();
+    RNG& rng = theRNG();
+    Mat data(3000, 16, CV_32F), queries(500, 16, CV_32F);
+    rng.fill(data, RNG::UNIFORM, 0, 100);
+    rng.fill(queries, RNG::UNIFORM, 0, 100);
+
+    Ptr<flann::IndexParams> params;
+    if (algo == cvflann::FLANN_INDEX_KDTREE)
+        params = makePtr<flann::KDTreeIndexParams>(4);
+    else if (algo == cvflann::FLANN_INDEX_KMEANS)
+        params = makePtr<flann::KMeansIndexParams>(8, 5);
+    else
+        params = makePtr<flann::LinearIndexParams>();
+    params->setInt("cores", 0);
+
+    // The index built in parallel is the same as the one built by one thread from the same seed.
+    const int threads = getNumThreads();
+    const uint64 seed = rng.state;
+    setNumThreads(1);
+    flann::Index single(data, *params);
+    setNumThreads(4);
+    theRNG().state = seed;
+    flann::Index index(data, *params);
+    setNumThreads(threads);
+
+    const int knn = 4;
+    flann::SearchParams sequential(64), parallel(64);
+    parallel.setInt("cores", 0);
+    Mat indices, dists, indicesPar, distsPar, indicesSingle, distsSingle;
+    index.knnSearch(queries, indices, dists, knn, sequential);
+    index.knnSearch(queries, indicesPar, distsPar, knn, parallel);
+    single.knnSearch(queries, indicesSingle, distsSingle, knn, sequential);
+    EXPECT_EQ(0, cvtest::norm(indices, indicesPar, NORM_INF));
+    EXPECT_EQ(0, cvtest::norm(dists, distsPar, NORM_INF));
+    EXPECT_EQ(0, cvtest::norm(indices, indicesSingle, NORM_INF));
+    EXPECT_EQ(0, cvtest::norm(dists, distsSingle, NORM_INF));
+
+    // The exact search checks that the clusters built in parallel index all the points.
+    Mat linearIndices, linearDists, exactIndices, exactDists;
+    flann::Index linear(data, flann::LinearIndexParams());
+    linear.knnSearch(queries, linearIndices, linearDists, knn, sequential);
+    flann::SearchParams exact(-1);
+    exact.setInt("cores", 0);
+    if (algo == cvflann::FLANN_INDEX_KDTREE)
+    {
+        // the exact kd-tree search uses only the first tree, the parallel trees are checked above
+        params->setInt("trees", 1);
+        flann::Index singleTree(data, *params);
+        singleTree.knnSearch(queries, exactIndices, exactDists, knn, exact);
+    }
+    else
+        index.knnSearch(queries, exactIndices, exactDists, knn, exact);
+    EXPECT_LE(cvtest::norm(linearDists, exactDists, NORM_INF), 1e-3);
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, Flann_Parallel, testing::Values(
+    (int)cvflann::FLANN_INDEX_LINEAR, (int)cvflann::FLANN_INDEX_KDTREE, (int)cvflann::FLANN_INDEX_KMEANS));
+
+}} // namespace